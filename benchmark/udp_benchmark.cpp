@@ -0,0 +1,216 @@
+/// \file udp_benchmark.cpp
+/// \brief Measures the UDP receive and transmit rates of the driver with and without AF_XDP.
+/// \details Run by udp_benchmark.sh, which connects two network namespaces with a veth pair.
+/// Usage: udp_benchmark MODE LOCAL_IP REMOTE_IP PORT [SECONDS] [SIZE]
+///   rx-socket, rx-xdp: Receives on the port through the driver and reports the delivered rate.
+///   tx-socket, tx-xdp: Transmits from the port through the driver as fast as possible and reports the rate.
+///   source: Floods the remote endpoint from a plain socket for the rx benchmarks.
+///   sink: Counts datagrams on a plain socket for the tx benchmarks.
+#include "driver.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// The number of datagrams sent or received per system call by the plain socket peers.
+#define BENCHMARK_BATCH 64
+
+namespace
+{
+    double elapsed(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    void report(const std::string& mode, uint64_t messages, uint64_t bytes, double seconds)
+    {
+        std::cout << mode << ": " << messages << " messages in " << seconds << " s, "
+                  << static_cast<uint64_t>(messages / seconds) << " msg/s, "
+                  << bytes * 8.0 / seconds / 1e6 << " Mbit/s" << std::endl;
+    }
+    int open_socket(const std::string& local_ip, uint16_t port)
+    {
+        int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in local;
+        std::memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        inet_pton(AF_INET, local_ip.c_str(), &local.sin_addr);
+        int buffer = 8 * 1024 * 1024;
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        if(socket_fd < 0 || bind(socket_fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+        {
+            throw std::runtime_error("could not bind " + local_ip + ":" + std::to_string(port));
+        }
+        return socket_fd;
+    }
+
+    // Plain socket peers.
+    void source(const std::string& local_ip, const std::string& remote_ip, uint16_t port, double seconds, uint32_t size)
+    {
+        int socket_fd = open_socket(local_ip, port);
+        sockaddr_in remote;
+        std::memset(&remote, 0, sizeof(remote));
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(port);
+        inet_pton(AF_INET, remote_ip.c_str(), &remote.sin_addr);
+
+        std::vector<uint8_t> payload(size, 0xA5);
+        std::vector<iovec> slices(BENCHMARK_BATCH);
+        std::vector<mmsghdr> headers(BENCHMARK_BATCH);
+        for(uint32_t i = 0; i < BENCHMARK_BATCH; i++)
+        {
+            slices[i].iov_base = payload.data();
+            slices[i].iov_len = payload.size();
+            std::memset(&headers[i], 0, sizeof(mmsghdr));
+            headers[i].msg_hdr.msg_iov = &slices[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &remote;
+            headers[i].msg_hdr.msg_namelen = sizeof(remote);
+        }
+
+        uint64_t messages = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(elapsed(start) < seconds)
+        {
+            int sent = sendmmsg(socket_fd, headers.data(), BENCHMARK_BATCH, 0);
+            messages += sent > 0 ? sent : 0;
+        }
+        report("source", messages, messages * size, elapsed(start));
+        close(socket_fd);
+    }
+    void sink(const std::string& local_ip, uint16_t port, double seconds)
+    {
+        int socket_fd = open_socket(local_ip, port);
+        timeval timeout = {0, 100000};
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::vector<uint8_t> buffer(BENCHMARK_BATCH * 2048);
+        std::vector<iovec> slices(BENCHMARK_BATCH);
+        std::vector<mmsghdr> headers(BENCHMARK_BATCH);
+        for(uint32_t i = 0; i < BENCHMARK_BATCH; i++)
+        {
+            slices[i].iov_base = buffer.data() + i * 2048;
+            slices[i].iov_len = 2048;
+            std::memset(&headers[i], 0, sizeof(mmsghdr));
+            headers[i].msg_hdr.msg_iov = &slices[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(elapsed(start) < seconds)
+        {
+            int received = recvmmsg(socket_fd, headers.data(), BENCHMARK_BATCH, MSG_WAITFORONE, nullptr);
+            for(int i = 0; i < received; i++)
+            {
+                bytes += headers[i].msg_len;
+            }
+            messages += received > 0 ? received : 0;
+        }
+        report("sink", messages, bytes, elapsed(start));
+        close(socket_fd);
+    }
+
+    // Driver benchmarks.
+    void run_driver(bool rx, bool xdp, const std::string& local_ip, const std::string& remote_ip, uint16_t port, double seconds, uint32_t size)
+    {
+        std::atomic<uint64_t> messages(0);
+        std::atomic<uint64_t> bytes(0);
+        driver modem(local_ip, remote_ip,
+                     [&messages, &bytes](protocol, uint16_t, uint8_t* data, uint32_t length, address)
+                     {
+                         messages++;
+                         bytes += length;
+                         delete [] data;
+                     },
+                     std::function<void(uint16_t)>(), std::function<void(uint16_t)>(), std::function<void(uint16_t)>());
+        modem.start();
+
+        connection_options options;
+        options.xdp = xdp;
+        if(!modem.add_udp_connection(port, options))
+        {
+            throw std::runtime_error("could not add the UDP connection");
+        }
+
+        std::vector<uint8_t> message(size, 0x5A);
+        uint64_t transmitted = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(elapsed(start) < seconds)
+        {
+            if(rx)
+            {
+                usleep(10000);
+            }
+            else
+            {
+                transmitted += modem.tx(protocol::UDP, port, message.data(), size) ? 1 : 0;
+            }
+        }
+        double duration = elapsed(start);
+
+        std::string mode = std::string(rx ? "rx-" : "tx-") + (xdp ? "xdp" : "socket");
+        if(rx)
+        {
+            report(mode, messages, bytes, duration);
+        }
+        else
+        {
+            report(mode, transmitted, transmitted * size, duration);
+        }
+
+        modem.remove_all_connections();
+        modem.stop();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 5)
+    {
+        std::cerr << "usage: udp_benchmark rx-socket|rx-xdp|tx-socket|tx-xdp|source|sink LOCAL_IP REMOTE_IP PORT [SECONDS] [SIZE]" << std::endl;
+        return 1;
+    }
+    std::string mode = argv[1];
+    std::string local_ip = argv[2];
+    std::string remote_ip = argv[3];
+    uint16_t port = static_cast<uint16_t>(std::stoi(argv[4]));
+    double seconds = argc > 5 ? std::stod(argv[5]) : 5.0;
+    uint32_t size = argc > 6 ? static_cast<uint32_t>(std::stoul(argv[6])) : 64;
+
+    try
+    {
+        if(mode == "source")
+        {
+            source(local_ip, remote_ip, port, seconds, size);
+        }
+        else if(mode == "sink")
+        {
+            sink(local_ip, port, seconds);
+        }
+        else if(mode == "rx-socket" || mode == "rx-xdp" || mode == "tx-socket" || mode == "tx-xdp")
+        {
+            run_driver(mode.compare(0, 2, "rx") == 0, mode.find("xdp") != std::string::npos, local_ip, remote_ip, port, seconds, size);
+        }
+        else
+        {
+            std::cerr << "unknown mode: " << mode << std::endl;
+            return 1;
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cerr << mode << ": " << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Compares the driver's UDP receive and transmit rates through plain sockets and through AF_XDP.
+# Connects the root network namespace to a peer namespace with a veth pair, which runs the XDP program in generic mode.
+# Usage (as root): udp_benchmark.sh PATH_TO_UDP_BENCHMARK [SECONDS] [SIZE]
+set -e
+
+BENCHMARK=${1:?usage: udp_benchmark.sh PATH_TO_UDP_BENCHMARK [SECONDS] [SIZE]}
+SECONDS_PER_RUN=${2:-5}
+SIZE=${3:-64}
+NAMESPACE=modem_bench
+LOCAL_IP=10.201.0.1
+PEER_IP=10.201.0.2
+PORT=47000
+
+cleanup()
+{
+    ip link del mbench0 2>/dev/null || true
+    ip netns del ${NAMESPACE} 2>/dev/null || true
+}
+trap cleanup EXIT
+cleanup
+
+# Create the veth pair, with one end in the peer namespace.
+ip netns add ${NAMESPACE}
+ip link add mbench0 type veth peer name mbench1
+ip link set mbench1 netns ${NAMESPACE}
+ip addr add ${LOCAL_IP}/24 dev mbench0
+ip link set mbench0 up
+ip netns exec ${NAMESPACE} ip addr add ${PEER_IP}/24 dev mbench1
+ip netns exec ${NAMESPACE} ip link set mbench1 up
+
+for MODE in socket xdp; do
+    # Receive: the peer floods the driver's port.
+    ip netns exec ${NAMESPACE} ${BENCHMARK} source ${PEER_IP} ${LOCAL_IP} ${PORT} $((SECONDS_PER_RUN + 2)) ${SIZE} &
+    sleep 1
+    ${BENCHMARK} rx-${MODE} ${LOCAL_IP} ${PEER_IP} ${PORT} ${SECONDS_PER_RUN} ${SIZE}
+    wait
+
+    # Transmit: the driver floods the peer's port.
+    ip netns exec ${NAMESPACE} ${BENCHMARK} sink ${PEER_IP} ${LOCAL_IP} ${PORT} $((SECONDS_PER_RUN + 2)) &
+    sleep 1
+    ${BENCHMARK} tx-${MODE} ${LOCAL_IP} ${PEER_IP} ${PORT} ${SECONDS_PER_RUN} ${SIZE}
+    wait
+done
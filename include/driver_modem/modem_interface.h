@@ -11,6 +11,8 @@
 #include <driver_modem_msgs/active_connections.h>
 #include <driver_modem_msgs/data_packet.h>
 
+#include <set>
+
 /// \brief Namespace for driver_modem package.
 namespace driver_modem {
 
@@ -36,6 +38,11 @@ public:
     void attach_callback_udp_rx(std::function<void (uint16_t, const driver_modem_msgs::data_packetConstPtr &)> callback);
     /// \brief Detaches the current callback for handling received UDP messages.
     void detach_callback_udp_rx();
+    /// \brief Attaches a callback for handling received UNIX messages.
+    /// \param callback The callback function.
+    void attach_callback_unix_rx(std::function<void (uint16_t, const driver_modem_msgs::data_packetConstPtr &)> callback);
+    /// \brief Detaches the current callback for handling received UNIX messages.
+    void detach_callback_unix_rx();
 
 
     // METHODS: Configuration
@@ -60,8 +67,30 @@ public:
     /// \note ROS takes time to connect publishers, subscribers, and services.
     /// The connection will not be immediately available for use.
     bool add_udp_connection(uint16_t port);
+    /// \brief Adds a UDP connection to the modem that joins and transmits to a multicast group.
+    /// \param port The port of the UDP connection.
+    /// \param multicast_group The multicast group address to join.
+    /// \param multicast_interface The local IP address of the interface to join on.  If empty, the modem's local IP is used.
+    /// \param multicast_ttl The time to live of transmitted multicast messages.
+    /// \param multicast_loopback Indicates if transmitted multicast messages are also received on the modem's host.
+    /// \return TRUE if successful, otherwise FALSE.
+    /// \details The multicast settings are stored as the modem's per-port parameters before the connection is added, and
+    /// are deleted when the connection is removed or the port is next added as a unicast connection.
+    /// \note ROS takes time to connect publishers, subscribers, and services.
+    /// The connection will not be immediately available for use.
+    bool add_udp_connection(uint16_t port, std::string multicast_group, std::string multicast_interface = "", uint32_t multicast_ttl = 1, bool multicast_loopback = false);
+    /// \brief Adds a Unix domain socket connection to the modem.
+    /// \param port The port number that identifies the UNIX connection.
+    /// \param mode The mode of the connection ("datagram", "server", or "client").
+    /// \param path The socket path that a datagram connection or stream server binds to, or that a stream client connects to.
+    /// Paths beginning with '@' are in the abstract namespace.  If empty, the modem's default path is used.
+    /// \param remote_path The socket path that a datagram connection transmits to.
+    /// \return TRUE if successful, otherwise FALSE.
+    /// \details The settings are stored as the modem's per-port parameters before the connection is added.
+    /// UNIX connections are not reported in active_connections, so their topics are set up as soon as the connection is added.
+    bool add_unix_connection(uint16_t port, std::string mode = "datagram", std::string path = "", std::string remote_path = "");
     /// \brief Removes a connection from the modem.
-    /// \param type The protocol type of the connection to remove (TCP or UDP)
+    /// \param type The protocol type of the connection to remove (TCP, UDP, or UNIX)
     /// \param port The port of the connection to remove.
     /// \return TRUE if successful, otherwise FALSE.
     bool remove_connection(protocol type, uint16_t port);
@@ -84,6 +113,12 @@ public:
     /// \param length The length of the data to send.
     /// \return TRUE if the messsage was sent.  FALSE if the UDP connection does not exist yet.
     bool send_udp(uint16_t port, const uint8_t* data, uint32_t length);
+    /// \brief Sends data via a UNIX connection.
+    /// \param port The port number to send data over.
+    /// \param data The array of data to send.
+    /// \param length The length of the data to send.
+    /// \return TRUE if the messsage was sent.  FALSE if the UNIX connection was not added through this interface.
+    bool send_unix(uint16_t port, const uint8_t* data, uint32_t length);
 
     // METHODS: Connection Checking
     /// \brief Waits for the modem ROS node to become available.
@@ -118,6 +153,9 @@ public:
     /// \brief Gets the active UDP connections.
     /// \return The list of active UDP ports.
     std::vector<uint16_t> p_active_udp_connections() const;
+    /// \brief Gets the UNIX connections added through this interface.
+    /// \return The list of active UNIX ports.
+    std::vector<uint16_t> p_active_unix_connections() const;
 
 private:
     // VARIABLES: Active Connections
@@ -133,6 +171,8 @@ private:
     std::function<void(uint16_t port, const driver_modem_msgs::data_packetConstPtr&)> m_callback_tcp_rx;
     /// \brief Stores the external callback for handling received UDP messages.
     std::function<void(uint16_t port, const driver_modem_msgs::data_packetConstPtr&)> m_callback_udp_rx;
+    /// \brief Stores the external callback for handling received UNIX messages.
+    std::function<void(uint16_t port, const driver_modem_msgs::data_packetConstPtr&)> m_callback_unix_rx;
 
     // VARIABLES: ROS Node
     /// \brief Maintains a copy of the ROS nodehandle for pub/sub/srv creation.
@@ -151,6 +191,8 @@ private:
     ros::ServiceClient m_service_add_tcp_connection;
     /// \brief The AddUDPConnection service client.
     ros::ServiceClient m_service_add_udp_connection;
+    /// \brief The AddUNIXConnection service client.
+    ros::ServiceClient m_service_add_unix_connection;
     /// \brief The RemoveConnection service client.
     ros::ServiceClient m_service_remove_connection;
 
@@ -163,12 +205,30 @@ private:
     std::map<uint16_t, ros::Subscriber> m_subscribers_tcp_rx;
     /// \brief Subscribers for UDP RX messages.
     std::map<uint16_t, ros::Subscriber> m_subscribers_udp_rx;
+    /// \brief Publishers for sending UNIX messages.
+    std::map<uint16_t, ros::Publisher> m_publishers_unix;
+    /// \brief Subscribers for UNIX RX messages.
+    std::map<uint16_t, ros::Subscriber> m_subscribers_unix_rx;
+
+    // VARIABLES: Multicast
+    /// \brief The UDP ports whose multicast parameters were set by this interface.
+    std::set<uint16_t> m_multicast_ports;
 
     // METHODS
     /// \brief Removes duplicate ports from two lists.
     /// \param a The first list of ports.
     /// \param b The second list of ports.
     void remove_duplicates(std::list<uint16_t>& a, std::list<uint16_t>& b);
+    /// \brief Removes the publisher and subscriber of a UNIX connection.
+    /// \param port The port number of the UNIX connection.
+    void remove_unix_topics(uint16_t port);
+    /// \brief Calls the modem's AddUDPConnection service.
+    /// \param port The port number of the UDP connection.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool request_udp_connection(uint16_t port);
+    /// \brief Deletes the multicast parameters this interface set for a UDP port, so later connections on it are unicast.
+    /// \param port The port number of the UDP connection.
+    void clear_multicast_params(uint16_t port);
 
     // CALLBACKS: Subscribers
     /// \brief Handles active_connections messages.
@@ -182,6 +242,10 @@ private:
     /// \param message The received message.
     /// \param port The port the message was received on.
     void callback_udp_rx(const driver_modem_msgs::data_packetConstPtr& message, uint16_t port);
+    /// \brief Handles received UNIX messages.
+    /// \param message The received message.
+    /// \param port The port number the message was received on.
+    void callback_unix_rx(const driver_modem_msgs::data_packetConstPtr& message, uint16_t port);
 };
 
 }
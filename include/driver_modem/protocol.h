@@ -6,11 +6,12 @@
 /// \brief Namespace for driver_modem package.
 namespace driver_modem {
 
-/// \brief An enumeration of TCP/IP connection protocol types.
+/// \brief An enumeration of connection protocol types.
 enum class protocol
 {
     TCP = 0,    ///< TCP Protocol
-    UDP = 1     ///< UDP Protocol
+    UDP = 1,    ///< UDP Protocol
+    UNIX = 2    ///< Unix Domain Socket Protocol
 };
 
 }
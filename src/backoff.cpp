@@ -0,0 +1,34 @@
+#include "backoff.h"
+
+#include <algorithm>
+
+// CONSTRUCTORS
+backoff::backoff(double initial_interval, double max_interval, double multiplier, double jitter)
+    // Seed random generator.
+    : m_generator(std::random_device()())
+{
+    // Store parameters, clamping to sane values.
+    backoff::m_initial_interval = std::max(initial_interval, 0.001);
+    backoff::m_max_interval = std::max(max_interval, backoff::m_initial_interval);
+    backoff::m_multiplier = std::max(multiplier, 1.0);
+    backoff::m_jitter = std::min(std::max(jitter, 0.0), 1.0);
+
+    backoff::reset();
+}
+
+// METHODS
+void backoff::reset()
+{
+    backoff::m_interval = backoff::m_initial_interval;
+}
+boost::posix_time::time_duration backoff::next()
+{
+    // Vary the current interval uniformly by +/- jitter.
+    std::uniform_real_distribution<double> distribution(1.0 - backoff::m_jitter, 1.0 + backoff::m_jitter);
+    double interval = std::min(backoff::m_interval * distribution(backoff::m_generator), backoff::m_max_interval);
+
+    // Grow the interval for the next retry.
+    backoff::m_interval = std::min(backoff::m_interval * backoff::m_multiplier, backoff::m_max_interval);
+
+    return boost::posix_time::microseconds(static_cast<int64_t>(interval * 1000000.0));
+}
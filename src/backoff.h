@@ -0,0 +1,47 @@
+/// \file backoff.h
+/// \brief Defines the backoff class.
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <random>
+
+/// \brief Generates jittered, exponentially increasing retry intervals.
+class backoff
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new backoff policy.
+    /// \param initial_interval The first retry interval in seconds.
+    /// \param max_interval The maximum retry interval in seconds.
+    /// \param multiplier The factor the interval grows by after each retry.
+    /// \param jitter The fraction (0-1) by which each interval is randomly varied.
+    backoff(double initial_interval = 0.05, double max_interval = 2.0, double multiplier = 2.0, double jitter = 0.2);
+
+    // METHODS
+    /// \brief Resets the policy back to the initial interval.
+    void reset();
+    /// \brief Gets the next retry interval and advances the policy.
+    /// \return The jittered retry interval.
+    boost::posix_time::time_duration next();
+
+private:
+    // VARIABLES: PARAMETERS
+    /// \brief The first retry interval in seconds.
+    double m_initial_interval;
+    /// \brief The maximum retry interval in seconds.
+    double m_max_interval;
+    /// \brief The factor the interval grows by after each retry.
+    double m_multiplier;
+    /// \brief The fraction by which each interval is randomly varied.
+    double m_jitter;
+
+    // VARIABLES: STATE
+    /// \brief The un-jittered interval of the next retry in seconds.
+    double m_interval;
+    /// \brief The random generator for jitter.
+    std::mt19937 m_generator;
+};
+
+#endif // BACKOFF_H
@@ -0,0 +1,324 @@
+#include "capture_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <tuple>
+
+// Records are aligned to 8 bytes, so a padding record always fits in the space left at the end of the ring.
+#define CAPTURE_ALIGNMENT 8
+// The largest message payload written in one synthesized IP packet.
+#define CAPTURE_MAX_SEGMENT 65000
+
+namespace
+{
+    /// \brief The header stored in the ring before each message.
+    struct record_header
+    {
+        /// \brief The total size of the record, including this header and padding.
+        uint32_t size;
+        /// \brief Indicates if the record is a message rather than padding up to the end of the ring.
+        uint8_t message;
+        /// \brief Indicates if the message was transmitted.
+        uint8_t tx;
+        /// \brief The protocol of the port.
+        uint8_t type;
+        /// \brief The IP version of the remote address (4 or 6).
+        uint8_t version;
+        /// \brief The capture time in nanoseconds since the UNIX epoch.
+        uint64_t timestamp;
+        /// \brief The captured length of the message.
+        uint32_t length;
+        /// \brief The original length of the message.
+        uint32_t original_length;
+        /// \brief The local port.
+        uint16_t port;
+        /// \brief The remote port.
+        uint16_t remote_port;
+        /// \brief The remote address.
+        uint8_t remote_address[16];
+    };
+
+    uint64_t aligned(uint64_t size)
+    {
+        return (size + CAPTURE_ALIGNMENT - 1) & ~static_cast<uint64_t>(CAPTURE_ALIGNMENT - 1);
+    }
+    void put16(std::vector<uint8_t>& output, uint16_t value)
+    {
+        output.push_back(static_cast<uint8_t>(value >> 8));
+        output.push_back(static_cast<uint8_t>(value));
+    }
+    void put32(std::vector<uint8_t>& output, uint32_t value)
+    {
+        put16(output, static_cast<uint16_t>(value >> 16));
+        put16(output, static_cast<uint16_t>(value));
+    }
+    void put_address(std::vector<uint8_t>& output, const address& value, bool v6)
+    {
+        if(v6)
+        {
+            address_v6::bytes_type bytes = value.is_v6() ? value.to_v6().to_bytes() : address_v6::v4_mapped(value.to_v4()).to_bytes();
+            output.insert(output.end(), bytes.begin(), bytes.end());
+        }
+        else
+        {
+            address_v4::bytes_type bytes = value.is_v4() ? value.to_v4().to_bytes() : address_v4::any().to_bytes();
+            output.insert(output.end(), bytes.begin(), bytes.end());
+        }
+    }
+}
+
+// CONSTRUCTORS
+capture_ring::capture_ring(uint64_t capacity, protocol type, uint16_t port, address local_address, address remote_address, uint16_t remote_port)
+    : m_buffer(std::max<uint64_t>(aligned(capacity), 2 * sizeof(record_header)), 0)
+{
+    capture_ring::m_type = type;
+    capture_ring::m_port = port;
+    capture_ring::m_local_address = host_resolver::normalize(local_address);
+    capture_ring::m_remote_address = host_resolver::normalize(remote_address);
+    capture_ring::m_remote_port = remote_port;
+    capture_ring::m_head = 0;
+    capture_ring::m_tail = 0;
+}
+
+// PUBLIC METHODS
+void capture_ring::record(bool tx, protocol type, uint16_t port, const address &remote_address, const uint8_t *data, uint32_t length)
+{
+    address remote = remote_address.is_unspecified() ? capture_ring::m_remote_address : host_resolver::normalize(remote_address);
+
+    // Fill in the header before taking the lock.
+    record_header header;
+    header.message = 1;
+    header.tx = tx ? 1 : 0;
+    header.type = static_cast<uint8_t>(type);
+    header.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    header.port = port;
+    header.remote_port = (type == capture_ring::m_type && port == capture_ring::m_port) ? capture_ring::m_remote_port : port;
+    std::memset(header.remote_address, 0, sizeof(header.remote_address));
+    if(remote.is_v6())
+    {
+        header.version = 6;
+        address_v6::bytes_type bytes = remote.to_v6().to_bytes();
+        std::memcpy(header.remote_address, bytes.data(), bytes.size());
+    }
+    else
+    {
+        header.version = 4;
+        address_v4::bytes_type bytes = remote.to_v4().to_bytes();
+        std::memcpy(header.remote_address, bytes.data(), bytes.size());
+    }
+
+    // Truncate messages that are larger than the ring.
+    uint64_t capacity = capture_ring::m_buffer.size();
+    header.original_length = length;
+    header.length = static_cast<uint32_t>(std::min<uint64_t>(length, capacity - sizeof(record_header)));
+    header.size = static_cast<uint32_t>(std::min(aligned(sizeof(record_header) + header.length), capacity));
+
+    boost::mutex::scoped_lock lock(capture_ring::m_mutex);
+
+    // Records are never split, so pad out the end of the ring if the record does not fit before it.
+    uint64_t offset = capture_ring::m_head % capacity;
+    if(offset + header.size > capacity)
+    {
+        uint64_t padding = capacity - offset;
+        capture_ring::evict(padding);
+        record_header pad;
+        pad.size = static_cast<uint32_t>(padding);
+        pad.message = 0;
+        std::memcpy(capture_ring::m_buffer.data() + offset, &pad, std::min<uint64_t>(padding, sizeof(record_header)));
+        capture_ring::m_head += padding;
+        offset = 0;
+    }
+
+    capture_ring::evict(header.size);
+    std::memcpy(capture_ring::m_buffer.data() + offset, &header, sizeof(record_header));
+    std::memcpy(capture_ring::m_buffer.data() + offset + sizeof(record_header), data, header.length);
+    capture_ring::m_head += header.size;
+}
+void capture_ring::copy_packets(std::vector<packet> &output) const
+{
+    // Copy the raw ring while holding the lock, and decode it afterwards.
+    std::vector<uint8_t> records;
+    {
+        boost::mutex::scoped_lock lock(capture_ring::m_mutex);
+        uint64_t capacity = capture_ring::m_buffer.size();
+        uint64_t start = capture_ring::m_tail % capacity;
+        uint64_t used = capture_ring::m_head - capture_ring::m_tail;
+        uint64_t first = std::min(used, capacity - start);
+        records.resize(used);
+        std::memcpy(records.data(), capture_ring::m_buffer.data() + start, first);
+        std::memcpy(records.data() + first, capture_ring::m_buffer.data(), used - first);
+    }
+
+    uint64_t offset = 0;
+    while(offset + sizeof(uint32_t) <= records.size())
+    {
+        record_header header;
+        std::memcpy(&header, records.data() + offset, std::min<uint64_t>(sizeof(record_header), records.size() - offset));
+        if(header.message)
+        {
+            packet message;
+            message.timestamp = header.timestamp;
+            message.tx = header.tx != 0;
+            message.type = static_cast<protocol>(header.type);
+            message.port = header.port;
+            message.local_address = capture_ring::m_local_address;
+            if(header.version == 6)
+            {
+                address_v6::bytes_type bytes;
+                std::memcpy(bytes.data(), header.remote_address, bytes.size());
+                message.remote_address = address_v6(bytes);
+            }
+            else
+            {
+                address_v4::bytes_type bytes;
+                std::memcpy(bytes.data(), header.remote_address, bytes.size());
+                message.remote_address = address_v4(bytes);
+            }
+            message.remote_port = header.remote_port;
+            message.original_length = header.original_length;
+            const uint8_t* data = records.data() + offset + sizeof(record_header);
+            message.data.assign(data, data + header.length);
+            output.push_back(message);
+        }
+        offset += header.size;
+    }
+}
+
+// STATIC METHODS
+bool capture_ring::write_pcap(const std::string &path, std::vector<packet> &packets)
+{
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!file)
+    {
+        return false;
+    }
+
+    // Write the global header: nanosecond timestamps, raw IP link type.
+    // NOTE: The header is written in host byte order, which readers detect from the magic number.
+    struct
+    {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t zone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t network;
+    } global = {0xA1B23C4D, 2, 4, 0, 0, 262144, 101};
+    file.write(reinterpret_cast<const char*>(&global), sizeof(global));
+
+    std::stable_sort(packets.begin(), packets.end(), [](const packet& a, const packet& b){return a.timestamp < b.timestamp;});
+
+    // The next TCP sequence number of each direction of each flow.
+    std::map<std::tuple<bool, uint16_t, address, uint16_t>, uint32_t> sequences;
+
+    std::vector<uint8_t> frame;
+    for(auto it = packets.begin(); it != packets.end(); it++)
+    {
+        bool v6 = it->remote_address.is_v6();
+        bool tcp = it->type == protocol::TCP;
+        address source = it->tx ? it->local_address : it->remote_address;
+        address destination = it->tx ? it->remote_address : it->local_address;
+        uint16_t source_port = it->tx ? it->port : it->remote_port;
+        uint16_t destination_port = it->tx ? it->remote_port : it->port;
+        uint32_t& sequence = sequences[std::make_tuple(it->tx, it->port, it->remote_address, it->remote_port)];
+        if(sequence == 0)
+        {
+            sequence = 1;
+        }
+
+        // Split the message into segments that fit in an IP packet.
+        uint32_t offset = 0;
+        do
+        {
+            uint32_t segment = std::min<uint32_t>(static_cast<uint32_t>(it->data.size()) - offset, CAPTURE_MAX_SEGMENT);
+            uint32_t original_segment = (offset + segment == it->data.size()) ? it->original_length - offset : segment;
+            uint32_t transport_size = tcp ? 20 : 8;
+            uint32_t headers_size = (v6 ? 40 : 20) + transport_size;
+
+            frame.clear();
+            if(v6)
+            {
+                put32(frame, 0x60000000);
+                put16(frame, static_cast<uint16_t>(transport_size + original_segment));
+                frame.push_back(tcp ? 6 : 17);
+                frame.push_back(64);
+                put_address(frame, source, true);
+                put_address(frame, destination, true);
+            }
+            else
+            {
+                frame.push_back(0x45);
+                frame.push_back(0);
+                put16(frame, static_cast<uint16_t>(headers_size + original_segment));
+                put32(frame, 0x00004000);
+                frame.push_back(64);
+                frame.push_back(tcp ? 6 : 17);
+                put16(frame, 0);
+                put_address(frame, source, false);
+                put_address(frame, destination, false);
+
+                // Fill in the IPv4 header checksum.
+                uint32_t sum = 0;
+                for(uint32_t i = 0; i < 20; i += 2)
+                {
+                    sum += static_cast<uint32_t>(frame[i] << 8 | frame[i + 1]);
+                }
+                sum = (sum & 0xFFFF) + (sum >> 16);
+                sum = (sum & 0xFFFF) + (sum >> 16);
+                frame[10] = static_cast<uint8_t>(~sum >> 8);
+                frame[11] = static_cast<uint8_t>(~sum);
+            }
+            put16(frame, source_port);
+            put16(frame, destination_port);
+            if(tcp)
+            {
+                put32(frame, sequence);
+                put32(frame, 0);
+                frame.push_back(5 << 4);
+                frame.push_back(0x18);
+                put16(frame, 65535);
+                put32(frame, 0);
+                sequence += original_segment;
+            }
+            else
+            {
+                put16(frame, static_cast<uint16_t>(transport_size + original_segment));
+                put16(frame, 0);
+            }
+            frame.insert(frame.end(), it->data.begin() + offset, it->data.begin() + offset + segment);
+
+            struct
+            {
+                uint32_t seconds;
+                uint32_t nanoseconds;
+                uint32_t captured_length;
+                uint32_t original_length;
+            } record = {static_cast<uint32_t>(it->timestamp / 1000000000ull),
+                        static_cast<uint32_t>(it->timestamp % 1000000000ull),
+                        static_cast<uint32_t>(frame.size()),
+                        headers_size + original_segment};
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            file.write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(frame.size()));
+
+            offset += segment;
+        } while(offset < it->data.size());
+    }
+
+    return static_cast<bool>(file);
+}
+
+// PRIVATE METHODS
+void capture_ring::evict(uint64_t size)
+{
+    uint64_t capacity = capture_ring::m_buffer.size();
+    while(capture_ring::m_head + size - capture_ring::m_tail > capacity)
+    {
+        uint32_t record_size;
+        std::memcpy(&record_size, capture_ring::m_buffer.data() + capture_ring::m_tail % capacity, sizeof(record_size));
+        capture_ring::m_tail += record_size;
+    }
+}
@@ -0,0 +1,110 @@
+/// \file capture_ring.h
+/// \brief Defines the capture_ring class.
+#ifndef CAPTURE_RING_H
+#define CAPTURE_RING_H
+
+#include "driver_modem/protocol.h"
+#include "host_resolver.h"
+
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Keeps the most recent messages of a port in a preallocated ring buffer for later inspection.
+/// \details Recording copies the message into the ring under a short uncontended lock, evicting the oldest messages
+/// to make room, so capturing costs little more than the copy.  Nothing is formatted until the ring is dumped, at which
+/// point messages are written to a pcap file with synthesized IP and UDP/TCP headers that carry their endpoints.
+class capture_ring
+{
+public:
+    // STRUCTURES
+    /// \brief A captured message.
+    struct packet
+    {
+        /// \brief The time the message was captured, in nanoseconds since the UNIX epoch.
+        uint64_t timestamp;
+        /// \brief Indicates if the message was transmitted rather than received.
+        bool tx;
+        /// \brief The protocol of the port.
+        protocol type;
+        /// \brief The local port.
+        uint16_t port;
+        /// \brief The local address.
+        address local_address;
+        /// \brief The remote address.
+        address remote_address;
+        /// \brief The remote port.
+        uint16_t remote_port;
+        /// \brief The length of the message before it was truncated to fit the ring.
+        uint32_t original_length;
+        /// \brief The captured message.
+        std::vector<uint8_t> data;
+    };
+
+    // CONSTRUCTORS
+    /// \brief Creates a new capture ring for a connection.
+    /// \param capacity The size of the ring in bytes, which is allocated immediately.
+    /// \param type The protocol of the connection.
+    /// \param port The local port of the connection.
+    /// \param local_address The local address of the connection.
+    /// \param remote_address The remote address of the connection.
+    /// \param remote_port The remote port of the connection.
+    capture_ring(uint64_t capacity, protocol type, uint16_t port, address local_address, address remote_address, uint16_t remote_port);
+
+    // METHODS
+    /// \brief Records a message.
+    /// \param tx Indicates if the message was transmitted rather than received.
+    /// \param type The protocol of the port.
+    /// \param port The local port.
+    /// \param remote_address The remote address, or an unspecified address for the connection's remote address.
+    /// \param data The message.
+    /// \param length The length of the message in bytes.
+    /// \details Ports other than the connection's own are tunnelled ports, whose remote port is the same as their own.
+    void record(bool tx, protocol type, uint16_t port, const address& remote_address, const uint8_t* data, uint32_t length);
+    /// \brief Copies out the captured messages, oldest first.
+    /// \param output The vector to append the messages to.
+    void copy_packets(std::vector<packet>& output) const;
+
+    // METHODS: STATIC
+    /// \brief Writes messages to a pcap file.
+    /// \param path The path of the file.
+    /// \param packets The messages, which are sorted by timestamp.
+    /// \return TRUE if the file was written, otherwise FALSE.
+    /// \details Messages are written as raw IP packets (LINKTYPE_RAW) with nanosecond timestamps.  TCP messages are
+    /// numbered as a continuous stream per direction, and messages that do not fit in one IP packet are split across
+    /// consecutive packets.
+    static bool write_pcap(const std::string& path, std::vector<packet>& packets);
+
+private:
+    // VARIABLES
+    /// \brief The ring buffer.
+    std::vector<uint8_t> m_buffer;
+    /// \brief The protocol of the connection.
+    protocol m_type;
+    /// \brief The local port of the connection.
+    uint16_t m_port;
+    /// \brief The local address of the connection.
+    address m_local_address;
+    /// \brief The remote address of the connection.
+    address m_remote_address;
+    /// \brief The remote port of the connection.
+    uint16_t m_remote_port;
+    /// \brief The total number of bytes ever written, whose remainder is the next write offset.
+    uint64_t m_head;
+    /// \brief The total number of bytes ever evicted, whose remainder is the offset of the oldest record.
+    uint64_t m_tail;
+    /// \brief Protects the ring.
+    mutable boost::mutex m_mutex;
+
+    // METHODS
+    /// \brief Evicts the oldest records until the ring has room.
+    /// \param size The number of bytes needed.
+    void evict(uint64_t size);
+};
+
+#endif // CAPTURE_RING_H
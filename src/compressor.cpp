@@ -0,0 +1,255 @@
+#include "compressor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <time.h>
+
+// The largest message that will be decompressed, which guards against corrupt or malicious length headers.
+#define COMPRESSOR_MAX_SIZE (1u << 24)
+
+// CONSTRUCTORS
+compressor::compressor(codec compression_codec, int32_t level)
+    // Initialize counters.
+    : m_uncompressed_bytes(0),
+      m_compressed_bytes(0),
+      m_compress_time(0),
+      m_decompress_time(0),
+      m_errors(0)
+{
+    compressor::m_codec = compression_codec;
+    compressor::m_level = level;
+
+    // Create the contexts once, so messages do not allocate them.
+    // NOTE: Decompression contexts are always created, since the peer may use either codec.
+    compressor::m_lz4_stream = LZ4_createStream();
+    compressor::m_zstd_cctx = ZSTD_createCCtx();
+    compressor::m_zstd_dctx = ZSTD_createDCtx();
+    compressor::m_zstd_cdict = nullptr;
+    compressor::m_zstd_ddict = nullptr;
+}
+compressor::~compressor()
+{
+    LZ4_freeStream(compressor::m_lz4_stream);
+    ZSTD_freeCCtx(compressor::m_zstd_cctx);
+    ZSTD_freeDCtx(compressor::m_zstd_dctx);
+    ZSTD_freeCDict(compressor::m_zstd_cdict);
+    ZSTD_freeDDict(compressor::m_zstd_ddict);
+}
+
+// PUBLIC METHODS
+bool compressor::load_dictionary(const std::string &path)
+{
+    // Read the dictionary file.
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        return false;
+    }
+    std::vector<char> dictionary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(dictionary.empty())
+    {
+        return false;
+    }
+
+    // Digest the dictionary once for all messages.
+    ZSTD_CDict* cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), compressor::m_level);
+    ZSTD_DDict* ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    if(!cdict || !ddict)
+    {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock_compress(compressor::m_mutex_compress);
+    boost::mutex::scoped_lock lock_decompress(compressor::m_mutex_decompress);
+    ZSTD_freeCDict(compressor::m_zstd_cdict);
+    ZSTD_freeDDict(compressor::m_zstd_ddict);
+    compressor::m_zstd_cdict = cdict;
+    compressor::m_zstd_ddict = ddict;
+
+    return true;
+}
+void compressor::compress(const uint8_t *data, uint32_t length, std::vector<uint8_t> &output)
+{
+    uint64_t start = compressor::thread_cpu_time();
+
+    // Write the uncompressed length as a varint after the codec identifier.
+    output.clear();
+    output.push_back(static_cast<uint8_t>(compressor::m_codec));
+    for(uint32_t value = length; ; value >>= 7)
+    {
+        output.push_back(static_cast<uint8_t>(value & 0x7F) | (value >= 0x80 ? 0x80 : 0));
+        if(value < 0x80)
+        {
+            break;
+        }
+    }
+    std::size_t header_size = output.size();
+
+    // Compress after the header.
+    std::size_t compressed_size = 0;
+    switch(compressor::m_codec)
+    {
+    case codec::NONE:
+    {
+        break;
+    }
+    case codec::LZ4:
+    {
+        boost::mutex::scoped_lock lock(compressor::m_mutex_compress);
+        output.resize(header_size + LZ4_compressBound(static_cast<int>(length)));
+        int result = LZ4_compress_fast_extState(compressor::m_lz4_stream, reinterpret_cast<const char*>(data), reinterpret_cast<char*>(output.data() + header_size),
+                                                static_cast<int>(length), static_cast<int>(output.size() - header_size), std::max(1, compressor::m_level));
+        compressed_size = result > 0 ? static_cast<std::size_t>(result) : 0;
+        break;
+    }
+    case codec::ZSTD:
+    {
+        boost::mutex::scoped_lock lock(compressor::m_mutex_compress);
+        output.resize(header_size + ZSTD_compressBound(length));
+        std::size_t result = compressor::m_zstd_cdict ?
+                    ZSTD_compress_usingCDict(compressor::m_zstd_cctx, output.data() + header_size, output.size() - header_size, data, length, compressor::m_zstd_cdict) :
+                    ZSTD_compressCCtx(compressor::m_zstd_cctx, output.data() + header_size, output.size() - header_size, data, length, compressor::m_level);
+        compressed_size = ZSTD_isError(result) ? 0 : result;
+        break;
+    }
+    }
+
+    // Send the message uncompressed if compression did not shrink it.
+    if(compressed_size == 0 || compressed_size >= length)
+    {
+        output[0] = static_cast<uint8_t>(codec::NONE);
+        output.resize(header_size);
+        output.insert(output.end(), data, data + length);
+    }
+    else
+    {
+        output.resize(header_size + compressed_size);
+    }
+
+    compressor::m_uncompressed_bytes += length;
+    compressor::m_compressed_bytes += output.size();
+    compressor::m_compress_time += compressor::thread_cpu_time() - start;
+}
+bool compressor::decompress(const uint8_t *data, uint32_t length, std::vector<uint8_t> &output)
+{
+    uint64_t start = compressor::thread_cpu_time();
+
+    // Read the header.
+    uint32_t position = 1;
+    uint64_t uncompressed_size = 0;
+    for(uint32_t shift = 0; ; shift += 7)
+    {
+        if(position >= length || shift > 28)
+        {
+            compressor::m_errors++;
+            return false;
+        }
+        uncompressed_size |= static_cast<uint64_t>(data[position] & 0x7F) << shift;
+        if((data[position++] & 0x80) == 0)
+        {
+            break;
+        }
+    }
+    if(uncompressed_size > COMPRESSOR_MAX_SIZE)
+    {
+        compressor::m_errors++;
+        return false;
+    }
+
+    bool success = false;
+    output.resize(uncompressed_size);
+    switch(static_cast<codec>(data[0]))
+    {
+    case codec::NONE:
+    {
+        success = (length - position == uncompressed_size);
+        std::copy(data + position, data + std::min<uint64_t>(length, position + uncompressed_size), output.begin());
+        break;
+    }
+    case codec::LZ4:
+    {
+        int result = LZ4_decompress_safe(reinterpret_cast<const char*>(data + position), reinterpret_cast<char*>(output.data()),
+                                         static_cast<int>(length - position), static_cast<int>(uncompressed_size));
+        success = (result >= 0 && static_cast<uint64_t>(result) == uncompressed_size);
+        break;
+    }
+    case codec::ZSTD:
+    {
+        boost::mutex::scoped_lock lock(compressor::m_mutex_decompress);
+        std::size_t result = compressor::m_zstd_ddict ?
+                    ZSTD_decompress_usingDDict(compressor::m_zstd_dctx, output.data(), output.size(), data + position, length - position, compressor::m_zstd_ddict) :
+                    ZSTD_decompressDCtx(compressor::m_zstd_dctx, output.data(), output.size(), data + position, length - position);
+        success = (!ZSTD_isError(result) && result == uncompressed_size);
+        break;
+    }
+    }
+
+    if(success)
+    {
+        compressor::m_uncompressed_bytes += uncompressed_size;
+        compressor::m_compressed_bytes += length;
+    }
+    else
+    {
+        compressor::m_errors++;
+    }
+    compressor::m_decompress_time += compressor::thread_cpu_time() - start;
+
+    return success;
+}
+
+// STATIC METHODS
+bool compressor::parse_codec(const std::string &value, codec &result)
+{
+    if(value == "none")
+    {
+        result = codec::NONE;
+    }
+    else if(value == "lz4")
+    {
+        result = codec::LZ4;
+    }
+    else if(value == "zstd")
+    {
+        result = codec::ZSTD;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// PROPERTIES
+uint64_t compressor::p_uncompressed_bytes() const
+{
+    return compressor::m_uncompressed_bytes;
+}
+uint64_t compressor::p_compressed_bytes() const
+{
+    return compressor::m_compressed_bytes;
+}
+double compressor::p_compress_time() const
+{
+    return compressor::m_compress_time / 1000000000.0;
+}
+double compressor::p_decompress_time() const
+{
+    return compressor::m_decompress_time / 1000000000.0;
+}
+uint64_t compressor::p_errors() const
+{
+    return compressor::m_errors;
+}
+
+// PRIVATE METHODS
+uint64_t compressor::thread_cpu_time()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+}
@@ -0,0 +1,120 @@
+/// \file compressor.h
+/// \brief Defines the compressor class.
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <boost/thread/mutex.hpp>
+
+#include <lz4.h>
+#include <zstd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/// \brief Compresses and decompresses individual messages of a connection.
+/// \details Every message starts with a one byte codec identifier and its uncompressed length (varint), so the receiver
+/// can decompress any message regardless of its own codec.  Messages that do not shrink are sent uncompressed.
+class compressor
+{
+public:
+    // ENUMERATIONS
+    /// \brief Enumerates the compression codecs.
+    enum class codec
+    {
+        NONE = 0,   ///< The message is uncompressed.
+        LZ4 = 1,    ///< LZ4, for the lowest latency.
+        ZSTD = 2    ///< Zstandard, optionally with a trained dictionary, for the highest ratio.
+    };
+
+    // CONSTRUCTORS
+    /// \brief Creates a new compressor.
+    /// \param compression_codec The codec for compressing transmitted messages.
+    /// \param level The compression level (zstd) or acceleration (LZ4), where zero selects the codec's default.
+    compressor(codec compression_codec, int32_t level);
+    ~compressor();
+
+    // METHODS
+    /// \brief Loads a zstd dictionary, such as one trained with "zstd --train" on sample messages.
+    /// \param path The path of the dictionary file.
+    /// \return TRUE if the dictionary was loaded, otherwise FALSE.
+    /// \details Both ends of the link must load the same dictionary.
+    bool load_dictionary(const std::string& path);
+    /// \brief Compresses a message.
+    /// \param data The message to compress.
+    /// \param length The length of the message in bytes.
+    /// \param output The compressed message, including its header.
+    void compress(const uint8_t* data, uint32_t length, std::vector<uint8_t>& output);
+    /// \brief Decompresses a message.
+    /// \param data The compressed message, including its header.
+    /// \param length The length of the compressed message in bytes.
+    /// \param output The decompressed message.
+    /// \return TRUE if the message was decompressed, FALSE if it is corrupt or uses an unavailable dictionary.
+    bool decompress(const uint8_t* data, uint32_t length, std::vector<uint8_t>& output);
+
+    // METHODS: STATIC
+    /// \brief Parses a codec from its string representation.
+    /// \param value The string representation ("none", "lz4", or "zstd").
+    /// \param result The parsed codec.
+    /// \return TRUE if the string is a valid codec, otherwise FALSE.
+    static bool parse_codec(const std::string& value, codec& result);
+
+    // PROPERTIES
+    /// \brief Gets the number of uncompressed bytes transmitted and received.
+    /// \return The number of bytes before compression and after decompression.
+    uint64_t p_uncompressed_bytes() const;
+    /// \brief Gets the number of compressed bytes transmitted and received.
+    /// \return The number of bytes after compression and before decompression, including headers.
+    uint64_t p_compressed_bytes() const;
+    /// \brief Gets the CPU time spent compressing.
+    /// \return The CPU time in seconds.
+    double p_compress_time() const;
+    /// \brief Gets the CPU time spent decompressing.
+    /// \return The CPU time in seconds.
+    double p_decompress_time() const;
+    /// \brief Gets the number of received messages that could not be decompressed.
+    /// \return The number of failed messages.
+    uint64_t p_errors() const;
+
+private:
+    // VARIABLES: CONFIGURATION
+    /// \brief The codec for compressing transmitted messages.
+    codec m_codec;
+    /// \brief The compression level or acceleration.
+    int32_t m_level;
+
+    // VARIABLES: CONTEXTS
+    /// \brief The LZ4 compression state.
+    LZ4_stream_t* m_lz4_stream;
+    /// \brief The zstd compression context.
+    ZSTD_CCtx* m_zstd_cctx;
+    /// \brief The zstd decompression context.
+    ZSTD_DCtx* m_zstd_dctx;
+    /// \brief The zstd compression dictionary, or nullptr.
+    ZSTD_CDict* m_zstd_cdict;
+    /// \brief The zstd decompression dictionary, or nullptr.
+    ZSTD_DDict* m_zstd_ddict;
+    /// \brief Protects the compression state, which may be used by several publishers.
+    boost::mutex m_mutex_compress;
+    /// \brief Protects the decompression state.
+    boost::mutex m_mutex_decompress;
+
+    // VARIABLES: COUNTERS
+    /// \brief The number of uncompressed bytes.
+    std::atomic<uint64_t> m_uncompressed_bytes;
+    /// \brief The number of compressed bytes.
+    std::atomic<uint64_t> m_compressed_bytes;
+    /// \brief The CPU time spent compressing in nanoseconds.
+    std::atomic<uint64_t> m_compress_time;
+    /// \brief The CPU time spent decompressing in nanoseconds.
+    std::atomic<uint64_t> m_decompress_time;
+    /// \brief The number of received messages that could not be decompressed.
+    std::atomic<uint64_t> m_errors;
+
+    // METHODS
+    /// \brief Gets the CPU time consumed by the calling thread.
+    /// \return The CPU time in nanoseconds.
+    static uint64_t thread_cpu_time();
+};
+
+#endif // COMPRESSOR_H
@@ -0,0 +1,219 @@
+/// \file connection_options.h
+/// \brief Defines the connection_options structure.
+#ifndef CONNECTION_OPTIONS_H
+#define CONNECTION_OPTIONS_H
+
+#include "backoff.h"
+
+#include <string>
+
+/// \brief Optional per-connection settings used when adding a connection to the driver.
+struct connection_options
+{
+    // CONSTRUCTORS
+    /// \brief Creates a set of default connection options.
+    connection_options()
+        : remote_port(0),
+          reconnect(false),
+          keepalive(false),
+          keepalive_idle(1.0),
+          keepalive_interval(1.0),
+          keepalive_count(3),
+          user_timeout(0.0),
+          tls(false),
+          tls_verify(true),
+          rx_shards(1),
+          rx_ordered(true),
+          rx_batch(1),
+          xdp(false),
+          xdp_queue(0),
+          xdp_native(false),
+          duplicate_send(false),
+          probe_interval(0.02),
+          probe_timeout(0.08),
+          multicast_ttl(1),
+          multicast_loopback(false),
+          broadcast_filter_echo(true),
+          reliable(false),
+          reliable_window(256),
+          reliable_min_rto(0.05),
+          reliable_max_rto(2.0),
+          tx_loss(0.0),
+          fec_data_shards(0),
+          fec_parity_shards(1),
+          fec_flush_interval(0.01),
+          compression("none"),
+          compression_level(0),
+          fragment_size(0),
+          fragment_timeout(1.0),
+          fragment_buffer(4194304),
+          tunnel(false),
+          tunnel_port(0),
+          tunnel_protocol("udp"),
+          unix_mode("datagram"),
+          capture_size(0.0)
+    {}
+
+    // VARIABLES: REMOTE ENDPOINT
+    /// \brief The remote hostname or IP address of the connection.
+    /// \details If empty, the driver's remote host is used.
+    std::string remote_host;
+    /// \brief The remote port of the connection.
+    /// \details If zero, the remote port is the same as the local port.
+    uint16_t remote_port;
+
+    // VARIABLES: TCP RECONNECT
+    /// \brief Indicates if a TCP connection should automatically reconnect (client) or re-listen (server) when lost.
+    bool reconnect;
+    /// \brief The backoff policy for TCP reconnect attempts.
+    backoff reconnect_backoff;
+
+    // VARIABLES: TCP DEAD PEER DETECTION
+    /// \brief Indicates if TCP keepalive probes are sent on idle sessions.
+    bool keepalive;
+    /// \brief The idle time in seconds before the first keepalive probe.
+    double keepalive_idle;
+    /// \brief The time in seconds between unanswered keepalive probes.
+    double keepalive_interval;
+    /// \brief The number of unanswered keepalive probes before a session is closed.
+    uint32_t keepalive_count;
+    /// \brief The maximum time in seconds that transmitted TCP data may remain unacknowledged.
+    /// \details If zero, the system default is used.
+    double user_timeout;
+
+    // VARIABLES: TCP TLS
+    /// \brief Indicates if a TCP connection is encrypted with TLS.
+    /// \details Record encryption is offloaded to the kernel (kTLS) when available.  Both ends of the link must use TLS.
+    bool tls;
+    /// \brief The path of the PEM certificate (chain) presented to the peer.  Required for servers.
+    std::string tls_certificate;
+    /// \brief The path of the PEM private key of the certificate.
+    /// \details If empty, the key is read from the certificate file.
+    std::string tls_key;
+    /// \brief The path of the PEM certificate(s) that the peer's certificate must be signed by.
+    /// \details If empty, the system's certificate authorities are used.  Servers only verify clients when this is set.
+    std::string tls_ca;
+    /// \brief Indicates if the peer's certificate is verified.
+    bool tls_verify;
+
+    // VARIABLES: UDP RX SHARDS
+    /// \brief The number of sockets receiving on a UDP port, each on its own thread.
+    uint32_t rx_shards;
+    /// \brief Indicates if messages from each source must be received in order across UDP shards.
+    bool rx_ordered;
+    /// \brief The maximum number of messages read from a UDP socket with a single system call.
+    uint32_t rx_batch;
+
+    // VARIABLES: UDP XDP
+    /// \brief Indicates if a UDP port's datagrams are received and transmitted through an AF_XDP socket.
+    bool xdp;
+    /// \brief The name of the interface that the XDP program is attached to.
+    /// \details If empty, the interface of the driver's local IP address is used.
+    std::string xdp_interface;
+    /// \brief The receive queue of the interface that the AF_XDP socket binds to.
+    uint32_t xdp_queue;
+    /// \brief Indicates if the XDP program runs in the interface's driver instead of in generic mode.
+    bool xdp_native;
+
+    // VARIABLES: BONDING
+    /// \brief The local IP address of the backup path of a bonded connection.
+    /// \details If empty, the connection is not bonded.
+    std::string backup_local_ip;
+    /// \brief The remote hostname or IP address of the backup path of a bonded connection.
+    /// \details If empty, the backup path uses the same remote host as the primary path.
+    std::string backup_remote_host;
+    /// \brief Indicates if a bonded UDP connection sends every message on both paths.
+    bool duplicate_send;
+    /// \brief The interval in seconds between health probes on each path of a bonded connection.
+    double probe_interval;
+    /// \brief The time in seconds without traffic after which a path of a bonded connection is unhealthy.
+    double probe_timeout;
+
+    // VARIABLES: UDP MULTICAST
+    /// \brief The multicast group address that a UDP connection joins and transmits to.
+    /// \details If empty, the connection is unicast.
+    std::string multicast_group;
+    /// \brief The local IP address of the interface to join the multicast group on.
+    /// \details If empty, the driver's local IP is used.
+    std::string multicast_interface;
+    /// \brief The time to live (hop limit) of transmitted multicast messages.
+    uint32_t multicast_ttl;
+    /// \brief Indicates if transmitted multicast messages are also received on this host.
+    bool multicast_loopback;
+
+    // VARIABLES: UDP BROADCAST
+    /// \brief The broadcast mode of a UDP connection.
+    /// \details "limited" transmits to 255.255.255.255, "subnet" transmits to the broadcast address of the local IP's subnet,
+    /// and any other value is an explicit broadcast address.  If empty, the connection is unicast.
+    std::string broadcast;
+    /// \brief Indicates if broadcasts echoed back from this host are discarded on receive.
+    bool broadcast_filter_echo;
+
+    // VARIABLES: UDP RELIABILITY
+    /// \brief Indicates if a UDP connection retransmits lost messages and delivers messages in order.
+    /// \details Both ends of the link must enable reliability.
+    bool reliable;
+    /// \brief The maximum number of unacknowledged messages of a reliable UDP connection.
+    uint32_t reliable_window;
+    /// \brief The minimum retransmission timeout in seconds of a reliable UDP connection.
+    double reliable_min_rto;
+    /// \brief The maximum retransmission timeout in seconds of a reliable UDP connection.
+    double reliable_max_rto;
+    /// \brief The probability (0-1) that a transmitted UDP datagram is deliberately dropped, for testing lossy links.
+    double tx_loss;
+
+    // VARIABLES: UDP FORWARD ERROR CORRECTION
+    /// \brief The number of messages per FEC block of a UDP connection (k).
+    /// \details If zero, the connection does not use FEC.  Both ends of the link must use the same FEC settings.
+    uint32_t fec_data_shards;
+    /// \brief The number of parity shards per FEC block of a UDP connection (m).
+    uint32_t fec_parity_shards;
+    /// \brief The maximum time in seconds between the first message of a partial FEC block and its parity shards.
+    double fec_flush_interval;
+
+    // VARIABLES: UDP COMPRESSION
+    /// \brief The codec that compresses transmitted UDP messages ("none", "lz4", or "zstd").
+    /// \details Received messages are decompressed with whichever codec the peer used, but the peer must also
+    /// enable compression, since every message carries a small header.
+    std::string compression;
+    /// \brief The compression level (zstd) or acceleration (LZ4), where zero selects the codec's default.
+    int32_t compression_level;
+    /// \brief The path of a zstd dictionary file, or empty for no dictionary.
+    std::string compression_dictionary;
+
+    // VARIABLES: UDP FRAGMENTATION
+    /// \brief The maximum size in bytes of each datagram that a UDP message is split into.
+    /// \details If zero, the connection does not use fragmentation.  Both ends of the link must use fragmentation.
+    uint32_t fragment_size;
+    /// \brief The time in seconds that a partially received message waits for its missing fragments.
+    double fragment_timeout;
+    /// \brief The maximum number of bytes held by partially received messages, which also limits the message size.
+    uint32_t fragment_buffer;
+
+    // VARIABLES: TUNNELS
+    /// \brief Indicates if a TCP/UDP connection is a tunnel transport that carries other logical ports.
+    /// \details A transport only carries tunnelled ports, and cannot be used for untunnelled messages.
+    bool tunnel;
+    /// \brief The port of the transport connection that carries a logical TCP/UDP port.
+    /// \details If zero, the port has its own socket.  Tunnelled ports are not compressed, fragmented, or encrypted
+    /// themselves, since the transport's own settings apply to everything it carries.
+    uint16_t tunnel_port;
+    /// \brief The protocol of the transport connection ("udp" or "tcp").
+    std::string tunnel_protocol;
+
+    // VARIABLES: UNIX DOMAIN SOCKETS
+    /// \brief The mode of a Unix domain socket connection ("datagram", "server", or "client").
+    std::string unix_mode;
+    /// \brief The socket path that a Unix datagram connection or stream server binds to.
+    /// \details Paths beginning with '@' are in the abstract namespace.
+    std::string unix_path;
+    /// \brief The socket path that a Unix datagram connection transmits to, or that a stream client connects to.
+    std::string unix_remote_path;
+
+    // VARIABLES: CAPTURE
+    /// \brief The size in megabytes of the ring buffer that keeps the most recent TCP/UDP messages for dumping.
+    /// \details If zero, messages are not captured.
+    double capture_size;
+};
+
+#endif // CONNECTION_OPTIONS_H
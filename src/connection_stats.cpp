@@ -0,0 +1,108 @@
+#include "connection_stats.h"
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <linux/sockios.h>
+#include <linux/sock_diag.h>
+
+// CONSTRUCTORS
+connection_stats::connection_stats()
+    // Initialize counters.
+    : m_rx_bytes(0),
+      m_rx_packets(0),
+      m_tx_bytes(0),
+      m_tx_packets(0),
+      m_rx_errors(0),
+      m_tx_errors(0),
+      m_drops(0),
+      m_reconnects(0),
+      m_truncations(0)
+{
+
+}
+connection_stats::snapshot::snapshot()
+    : rx_bytes(0),
+      rx_packets(0),
+      tx_bytes(0),
+      tx_packets(0),
+      rx_errors(0),
+      tx_errors(0),
+      drops(0),
+      reconnects(0),
+      truncations(0),
+      rx_queue(0),
+      tx_queue(0)
+{
+
+}
+
+// PUBLIC METHODS
+connection_stats::snapshot& connection_stats::snapshot::operator+=(const snapshot &other)
+{
+    connection_stats::snapshot::rx_bytes += other.rx_bytes;
+    connection_stats::snapshot::rx_packets += other.rx_packets;
+    connection_stats::snapshot::tx_bytes += other.tx_bytes;
+    connection_stats::snapshot::tx_packets += other.tx_packets;
+    connection_stats::snapshot::rx_errors += other.rx_errors;
+    connection_stats::snapshot::tx_errors += other.tx_errors;
+    connection_stats::snapshot::drops += other.drops;
+    connection_stats::snapshot::reconnects += other.reconnects;
+    connection_stats::snapshot::truncations += other.truncations;
+    connection_stats::snapshot::rx_queue += other.rx_queue;
+    connection_stats::snapshot::tx_queue += other.tx_queue;
+    return *this;
+}
+
+// PROPERTIES
+connection_stats::snapshot connection_stats::p_snapshot() const
+{
+    connection_stats::snapshot result;
+    result.rx_bytes = connection_stats::m_rx_bytes.load(std::memory_order_relaxed);
+    result.rx_packets = connection_stats::m_rx_packets.load(std::memory_order_relaxed);
+    result.tx_bytes = connection_stats::m_tx_bytes.load(std::memory_order_relaxed);
+    result.tx_packets = connection_stats::m_tx_packets.load(std::memory_order_relaxed);
+    result.rx_errors = connection_stats::m_rx_errors.load(std::memory_order_relaxed);
+    result.tx_errors = connection_stats::m_tx_errors.load(std::memory_order_relaxed);
+    result.drops = connection_stats::m_drops.load(std::memory_order_relaxed);
+    result.reconnects = connection_stats::m_reconnects.load(std::memory_order_relaxed);
+    result.truncations = connection_stats::m_truncations.load(std::memory_order_relaxed);
+    return result;
+}
+
+// STATIC METHODS
+void connection_stats::add_queues(int socket, bool stream, snapshot &result)
+{
+    if(socket < 0)
+    {
+        return;
+    }
+
+    int queued = 0;
+    if(stream)
+    {
+        // Unread bytes.
+        if(ioctl(socket, SIOCINQ, &queued) == 0)
+        {
+            result.rx_queue += static_cast<uint64_t>(queued);
+        }
+    }
+    else
+    {
+        // SIOCINQ only reports the next datagram, so use the memory held by all queued datagrams.
+#ifdef SO_MEMINFO
+        uint32_t meminfo[SK_MEMINFO_VARS];
+        socklen_t length = sizeof(meminfo);
+        if(getsockopt(socket, SOL_SOCKET, SO_MEMINFO, meminfo, &length) == 0)
+        {
+            result.rx_queue += meminfo[SK_MEMINFO_RMEM_ALLOC];
+        }
+#endif
+    }
+
+    // Unsent (UDP) or unacknowledged (TCP) bytes.
+    if(ioctl(socket, SIOCOUTQ, &queued) == 0)
+    {
+        result.tx_queue += static_cast<uint64_t>(queued);
+    }
+}
@@ -0,0 +1,130 @@
+/// \file connection_stats.h
+/// \brief Defines the connection_stats class.
+#ifndef CONNECTION_STATS_H
+#define CONNECTION_STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+/// \brief Counts the traffic and faults of a connection.
+/// \details Counters are relaxed atomics updated from the IO threads, so recording costs a single uncontended
+/// atomic add and never takes a lock.  Readers take a snapshot, which is consistent per counter but not across
+/// counters.
+class connection_stats
+{
+public:
+    // STRUCTURES
+    /// \brief A point in time copy of the counters.
+    struct snapshot
+    {
+        /// \brief Creates a new snapshot with all counters at zero.
+        snapshot();
+        /// \brief The number of bytes received.
+        uint64_t rx_bytes;
+        /// \brief The number of messages (UDP) or reads (TCP) received.
+        uint64_t rx_packets;
+        /// \brief The number of bytes transmitted.
+        uint64_t tx_bytes;
+        /// \brief The number of messages transmitted.
+        uint64_t tx_packets;
+        /// \brief The number of failed receives.
+        uint64_t rx_errors;
+        /// \brief The number of failed transmissions.
+        uint64_t tx_errors;
+        /// \brief The number of messages discarded before delivery or transmission.
+        uint64_t drops;
+        /// \brief The number of times the connection was re-established.
+        uint64_t reconnects;
+        /// \brief The number of received messages that were truncated to fit the receive buffer.
+        uint64_t truncations;
+        /// \brief The number of bytes currently waiting in the kernel to be read.
+        uint64_t rx_queue;
+        /// \brief The number of bytes currently waiting in the kernel to be sent (UDP) or acknowledged (TCP).
+        uint64_t tx_queue;
+        /// \brief Adds another snapshot's counters to this one.
+        /// \param other The snapshot to add.
+        /// \return This snapshot.
+        snapshot& operator+=(const snapshot& other);
+    };
+
+    // CONSTRUCTORS
+    /// \brief Creates a new set of counters at zero.
+    connection_stats();
+
+    // METHODS
+    /// \brief Records a received message.
+    /// \param bytes The length of the message in bytes.
+    void record_rx(uint64_t bytes)
+    {
+        connection_stats::m_rx_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        connection_stats::m_rx_packets.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records a transmitted message.
+    /// \param bytes The length of the message in bytes.
+    void record_tx(uint64_t bytes)
+    {
+        connection_stats::m_tx_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        connection_stats::m_tx_packets.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records a failed receive.
+    void record_rx_error()
+    {
+        connection_stats::m_rx_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records a failed transmission.
+    void record_tx_error()
+    {
+        connection_stats::m_tx_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records a discarded message.
+    void record_drop()
+    {
+        connection_stats::m_drops.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records that the connection was re-established.
+    void record_reconnect()
+    {
+        connection_stats::m_reconnects.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// \brief Records a truncated message.
+    void record_truncation()
+    {
+        connection_stats::m_truncations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // PROPERTIES
+    /// \brief Gets a copy of the current counters.
+    /// \return The snapshot of the counters.
+    snapshot p_snapshot() const;
+
+    // METHODS: STATIC
+    /// \brief Adds the kernel queue depths of a socket to a snapshot.
+    /// \param socket The native handle of the socket.
+    /// \param stream Indicates if the socket is a stream (TCP) rather than datagram (UDP) socket.
+    /// \param result The snapshot to add the queue depths to.
+    /// \details Queues that the kernel cannot report are left unchanged.
+    static void add_queues(int socket, bool stream, snapshot& result);
+
+private:
+    // VARIABLES
+    /// \brief The number of bytes received.
+    std::atomic<uint64_t> m_rx_bytes;
+    /// \brief The number of messages received.
+    std::atomic<uint64_t> m_rx_packets;
+    /// \brief The number of bytes transmitted.
+    std::atomic<uint64_t> m_tx_bytes;
+    /// \brief The number of messages transmitted.
+    std::atomic<uint64_t> m_tx_packets;
+    /// \brief The number of failed receives.
+    std::atomic<uint64_t> m_rx_errors;
+    /// \brief The number of failed transmissions.
+    std::atomic<uint64_t> m_tx_errors;
+    /// \brief The number of discarded messages.
+    std::atomic<uint64_t> m_drops;
+    /// \brief The number of reconnections.
+    std::atomic<uint64_t> m_reconnects;
+    /// \brief The number of truncated messages.
+    std::atomic<uint64_t> m_truncations;
+};
+
+#endif // CONNECTION_STATS_H
@@ -1,27 +1,42 @@
 #include "driver.h"
 
+#include <cstring>
+#include <future>
 #include <stdexcept>
 
 // CONSTRUCTORS
 driver::driver(std::string local_ip, std::string remote_host,
                std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> rx_callback,
                std::function<void(uint16_t)> tcp_connected_callback,
+               std::function<void(uint16_t)> tcp_pending_callback,
                std::function<void(uint16_t)> tcp_disconnected_callback)
 {    
+    // The IO service is not running until start() is called.
+    driver::m_running = false;
+    driver::m_service_work = nullptr;
+    driver::m_drain_timeout = 0.0;
+    driver::m_resolver_changes = 0;
+
     // Create and store local ip.
     driver::m_local_ip = boost::asio::ip::address::from_string(local_ip);
 
+    // Create the host resolver.
+    driver::m_resolver = boost::shared_ptr<host_resolver>(new host_resolver(driver::m_service));
+
     // Try to resolve and set remote host.
-    if(driver::set_remote_host(remote_host) == false)
+    // NOTE: The IO service is not yet running, so resolve on this thread.
+    if(driver::resolve_host(remote_host, driver::m_remote_ip) == false)
     {
         std::stringstream message;
         message << "Could not resolve remote host: " << remote_host;
         throw std::runtime_error(message.str());
     }
+    driver::m_remote_host = remote_host;
 
     // Store local copy of callbacks.
     driver::m_callback_rx = rx_callback;
     driver::m_callback_tcp_connected = tcp_connected_callback;
+    driver::m_callback_tcp_pending = tcp_pending_callback;
     driver::m_callback_tcp_disconnected = tcp_disconnected_callback;
 }
 driver::~driver()
@@ -41,16 +56,29 @@ void driver::start()
 {
     // Create worker object to keep io service running.
     driver::m_service_work = new boost::asio::io_service::work(driver::m_service);
+    // Start re-resolving cached hosts in the background.
+    driver::m_resolver->start_refresh();
     // Run io service in separate thread.
-    driver::m_thread = boost::thread(boost::bind(&boost::asio::io_service::run, boost::ref(driver::m_service)));
+    driver::m_thread = boost::thread(boost::bind(&driver::run_service, this));
+    driver::m_running = true;
 }
 void driver::stop()
 {
+    // Drain and close connections while the IO service is still running.
+    if(driver::m_drain_timeout > 0.0)
+    {
+        driver::remove_all_connections();
+    }
+
+    // Stop background host resolution.
+    driver::m_resolver->stop_refresh();
+
     // Stop the service.
     driver::m_service.stop();
 
     // Join the thread.
     driver::m_thread.join();
+    driver::m_running = false;
 
     // Delete the service worker.
     delete driver::m_service_work;
@@ -58,105 +86,168 @@ void driver::stop()
 }
 
 // PUBLIC METHODS: CONNECTION MANAGEMENT
-bool driver::set_remote_host(std::string remote_host)
+bool driver::set_remote_host(std::string remote_host, bool migrate)
 {
     // Resolve and store remote ip.
-    // Can just use UDP resolver here.
-    udp::resolver::query query(remote_host, "");
-    udp::resolver resolver(driver::m_service);
-    try
+    address remote_ip;
+    if(driver::resolve_host(remote_host, remote_ip))
     {
-        // Resolve IP Address
-        driver::m_remote_ip = resolver.resolve(query)->endpoint().address();
+        driver::m_remote_ip = remote_ip;
+        driver::m_remote_host = remote_host;
 
-        // Close all active connections.
-        driver::remove_all_connections();
+        if(migrate)
+        {
+            // Move existing connections to the new remote ip.
+            driver::migrate_connections("", remote_ip);
+        }
+        else
+        {
+            // Close all active network connections.
+            driver::remove_all_connections(false);
+        }
 
         return true;
     }
-    catch(...)
+    else
     {
         return false;
     }
 }
-bool driver::add_tcp_connection(tcp_role role, uint16_t port)
+void driver::set_drain_timeout(double timeout)
 {
-    // Make sure role is valid.
-    if(role != tcp_role::UNASSIGNED)
+    driver::m_drain_timeout = timeout;
+}
+void driver::set_resolver_parameters(double cache_ttl, double refresh_interval, double timeout)
+{
+    driver::m_resolver->set_parameters(cache_ttl, refresh_interval, timeout);
+}
+bool driver::update_remote_hosts()
+{
+    // Collect the hostnames that are still in use, and stop re-resolving the others.
+    std::set<std::string> hosts;
+    hosts.insert(driver::m_remote_host);
+    for(auto it = driver::m_tcp_options.cbegin(); it != driver::m_tcp_options.cend(); it++)
     {
-        // Check if the connection already exists.
-        if(driver::m_tcp_pending.count(port) == 0 && driver::m_tcp_active.count(port) == 0)
-        {
-            // Create the TCP connection.
-            boost::shared_ptr<tcp_connection> new_tcp = boost::shared_ptr<tcp_connection>(new tcp_connection(driver::m_service, tcp::endpoint(driver::m_local_ip, port)));
-
-            // Add the connected/disconnected/rx callbacks.
-            new_tcp->attach_connected_callback(std::bind(&driver::callback_tcp_connected, this, std::placeholders::_1));
-            new_tcp->attach_disconnected_callback(std::bind(&driver::callback_tcp_disconnected, this, std::placeholders::_1));
-            // NOTE: rx callback is forwarded from external.
-            new_tcp->attach_rx_callback(driver::m_callback_rx);
-
-            // Start the connection and track if the start succeeded.
-            bool connection_started = false;
-            switch(role)
-            {
-            case tcp_role::UNASSIGNED:
-            {
-                // This case will never occur due to if condition.
-                return false;
-            }
-            case tcp_role::SERVER:
-            {
-                connection_started = new_tcp->start_server();
-                break;
-            }
-            case tcp_role::CLIENT:
-            {
-                connection_started = new_tcp->start_client(tcp::endpoint(driver::m_remote_ip, port));
-                break;
-            }
-            }
+        hosts.insert(it->second.remote_host);
+        hosts.insert(it->second.backup_remote_host);
+    }
+    for(auto it = driver::m_udp_options.cbegin(); it != driver::m_udp_options.cend(); it++)
+    {
+        hosts.insert(it->second.remote_host);
+        hosts.insert(it->second.backup_remote_host);
+    }
+    driver::m_resolver->retain(hosts);
+    for(auto it = driver::m_resolved_hosts.begin(); it != driver::m_resolved_hosts.end();)
+    {
+        it = (hosts.count(it->first) == 0) ? driver::m_resolved_hosts.erase(it) : std::next(it);
+    }
 
-            // If the connection started, added it to the pending list.
-            if(connection_started)
-            {
-                // Add connection to pending.
-                driver::m_tcp_pending.insert(std::make_pair(port, new_tcp));
-            }
+    // Nothing has moved unless a resolution changed the addresses of a host.
+    uint64_t changes = driver::m_resolver->p_changes();
+    if(changes == driver::m_resolver_changes)
+    {
+        return false;
+    }
+    driver::m_resolver_changes = changes;
 
-            return connection_started;
+    // Copy the hosts, since resolving them again updates the map.
+    bool moved = false;
+    std::vector<std::pair<std::string, address>> resolved(driver::m_resolved_hosts.begin(), driver::m_resolved_hosts.end());
+    for(auto it = resolved.begin(); it != resolved.end(); it++)
+    {
+        // Keep addresses that are still valid, such as when round-robin DNS only reordered them.
+        address target;
+        if(driver::m_resolver->resolves_to(it->first, it->second) || !driver::resolve_host(it->first, target) || target == it->second)
+        {
+            continue;
         }
-        else
+        moved = true;
+
+        // Connections that follow the driver's remote host move along with connections that name the host themselves.
+        if(it->first == driver::m_remote_host)
         {
-            // The connection is already active or pending. Check if it's role matches the requested role.
-            if(driver::m_tcp_active.count(port))
-            {
-                return driver::m_tcp_active.at(port)->p_role() == role;
-            }
-            else
-            {
-                return driver::m_tcp_pending.at(port)->p_role() == role;
-            }
+            driver::m_remote_ip = target;
+            driver::migrate_connections("", target);
         }
+        driver::migrate_connections(it->first, target);
     }
-    else
+
+    return moved;
+}
+bool driver::add_tcp_connection(tcp_role role, uint16_t port, connection_options options)
+{
+    // Tunnelled ports are carried by a transport connection instead of their own socket.
+    if(driver::m_tunnel_channels.count(std::make_pair(protocol::TCP, port)) > 0)
     {
-        // Connection role is unassigned.
-        return false;
+        return true;
+    }
+    else if(options.tunnel_port != 0 && !options.tunnel)
+    {
+        return role != tcp_role::UNASSIGNED && driver::add_tunnel_channel(protocol::TCP, port, options);
+    }
+
+    // The capture ring must exist before a new connection's rx callback is created.
+    bool exists = driver::m_tcp_options.count(port) > 0;
+    if(!exists)
+    {
+        driver::add_capture(protocol::TCP, port, options);
     }
+    bool opened = options.tunnel ? (role != tcp_role::UNASSIGNED && driver::add_tunnel(protocol::TCP, role, port, options)) : driver::open_tcp_connection(role, port, options);
+    if(!opened && !exists)
+    {
+        driver::m_captures.erase(std::make_pair(protocol::TCP, port));
+    }
+
+    return opened;
 }
-bool driver::add_udp_connection(uint16_t port)
+bool driver::add_udp_connection(uint16_t port, connection_options options)
 {
-    if(driver::m_udp_active.count(port) == 0)
+    // Tunnelled ports are carried by a transport connection instead of their own socket.
+    if(driver::m_tunnel_channels.count(std::make_pair(protocol::UDP, port)) > 0)
     {
-        // Create the UDP connection.
-        boost::shared_ptr<udp_connection> new_udp = boost::shared_ptr<udp_connection>(new udp_connection(driver::m_service, udp::endpoint(driver::m_local_ip, port), udp::endpoint(driver::m_remote_ip, port)));
+        return true;
+    }
+    else if(options.tunnel_port != 0 && !options.tunnel)
+    {
+        return driver::add_tunnel_channel(protocol::UDP, port, options);
+    }
+
+    // The capture ring must exist before a new connection's rx callback is created.
+    bool exists = driver::m_udp_options.count(port) > 0;
+    if(!exists)
+    {
+        driver::add_capture(protocol::UDP, port, options);
+    }
+    bool opened = options.tunnel ? driver::add_tunnel(protocol::UDP, tcp_role::UNASSIGNED, port, options) : driver::open_udp_connection(port, options);
+    if(!opened && !exists)
+    {
+        driver::m_captures.erase(std::make_pair(protocol::UDP, port));
+    }
+
+    return opened;
+}
+bool driver::add_unix_connection(uint16_t port, connection_options options)
+{
+    if(driver::m_unix_active.count(port) == 0)
+    {
+        unix_connection::mode mode;
+        if(!unix_connection::parse_mode(options.unix_mode, mode))
+        {
+            return false;
+        }
+
+        // Create the Unix domain socket connection.
+        boost::shared_ptr<unix_connection> new_unix = boost::shared_ptr<unix_connection>(new unix_connection(driver::m_service, port, mode, options.unix_path, options.unix_remote_path));
         // Attach the rx callback.
-        new_udp->attach_rx_callback(driver::m_callback_rx);
-        // Start listening for packets.
-        new_udp->connect();
+        new_unix->attach_rx_callback(driver::recorded_rx_callback(protocol::UNIX, port));
+        // Bind, listen, or connect, and start receiving.
+        if(!new_unix->connect())
+        {
+            new_unix->disconnect();
+            return false;
+        }
         // Add connection to map.
-        driver::m_udp_active.insert(std::make_pair(port, new_udp));
+        driver::m_unix_active.insert(std::make_pair(port, new_unix));
 
         return true;
     }
@@ -168,71 +259,43 @@ bool driver::add_udp_connection(uint16_t port)
 }
 bool driver::remove_connection(protocol type, uint16_t port)
 {
-    switch(type)
-    {
-    case protocol::TCP:
+    return driver::close_connection(type, port, driver::m_drain_timeout);
+}
+void driver::remove_all_connections(bool include_unix)
+{
+    // Connections drain one after another, so they share a single deadline instead of each waiting the full timeout.
+    boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(static_cast<int64_t>(driver::m_drain_timeout * 1000000.0));
+    auto remaining = [deadline]()
     {
-        // Check pending map.
-        if(driver::m_tcp_pending.count(port) > 0)
-        {
-            // Get a pointer to the tcp connection.
-            boost::shared_ptr<tcp_connection> tcp = driver::m_tcp_pending.at(port);
-
-            // Stop the connection.
-            // NOTE: This function causes the tcp_connection pointer to self delete.
-            tcp->disconnect();
-
-            // Remove the entry from the map.
-            driver::m_tcp_pending.erase(port);
-
-            return true;
-        }
-        // Check active map.
-        else if(driver::m_tcp_active.count(port) > 0)
-        {
-            // Get a pointer to the tcp connection.
-            boost::shared_ptr<tcp_connection> tcp = driver::m_tcp_active.at(port);
-
-            // Stop the connection.
-            // NOTE: This function causes the tcp_connection pointer to self delete.
-            tcp->disconnect();
+        return std::max(0.0, (deadline - boost::posix_time::microsec_clock::universal_time()).total_microseconds() / 1000000.0);
+    };
 
-            // Remove the entry from the map.
-            driver::m_tcp_active.erase(port);
+    // Remove tunnelled ports before their transports.
+    while(!driver::m_tunnel_channels.empty())
+    {
+        driver::close_connection(driver::m_tunnel_channels.begin()->first.first, driver::m_tunnel_channels.begin()->first.second, remaining());
+    }
 
-            return true;
-        }
-        else
-        {
-            // Connection already doesn't exist.
-            return true;
-        }
+    // Remove bonded connections.
+    while(!driver::m_tcp_bonds.empty())
+    {
+        driver::close_connection(protocol::TCP, driver::m_tcp_bonds.begin()->first, remaining());
     }
-    case protocol::UDP:
+    while(!driver::m_udp_bonds.empty())
     {
-        if(driver::m_udp_active.count(port) > 0)
-        {
-            // Get a pointer to the udp connection.
-            boost::shared_ptr<udp_connection> udp = driver::m_udp_active.at(port);
-
-            // Stop the connection.
-            udp->disconnect();
-
-            // Remove the entry from the map.
-            driver::m_udp_active.erase(port);
+        driver::close_connection(protocol::UDP, driver::m_udp_bonds.begin()->first, remaining());
+    }
 
-            return true;
-        }
-        else
-        {
-            // Connection already doesn't exist.
-            return true;
-        }
+    // Remove reliable and FEC connections.
+    while(!driver::m_udp_reliable.empty())
+    {
+        driver::close_connection(protocol::UDP, driver::m_udp_reliable.begin()->first, remaining());
     }
+    while(!driver::m_udp_fec.empty())
+    {
+        driver::close_connection(protocol::UDP, driver::m_udp_fec.begin()->first, remaining());
     }
-}
-void driver::remove_all_connections()
-{
+
     // Get list of pending TCP ports.
     std::vector<uint16_t> tcp_pending_ports;
     for(auto it = driver::m_tcp_pending.begin(); it != driver::m_tcp_pending.end(); it++)
@@ -242,7 +305,7 @@ void driver::remove_all_connections()
     // Remove each connection.
     for(uint32_t i = 0; i < tcp_pending_ports.size(); i++)
     {
-        driver::remove_connection(protocol::TCP, tcp_pending_ports.at(i));
+        driver::close_connection(protocol::TCP, tcp_pending_ports.at(i), remaining());
     }
 
     // Get list of active TCP ports.
@@ -254,7 +317,7 @@ void driver::remove_all_connections()
     // Remove each connection.
     for(uint32_t i = 0; i < tcp_active_ports.size(); i++)
     {
-        driver::remove_connection(protocol::TCP, tcp_active_ports.at(i));
+        driver::close_connection(protocol::TCP, tcp_active_ports.at(i), remaining());
     }
 
     // Get list of UDP ports that are open.
@@ -266,39 +329,91 @@ void driver::remove_all_connections()
     // Remove each connection.
     for(uint32_t i = 0; i < udp_active_ports.size(); i++)
     {
-        driver::remove_connection(protocol::UDP, udp_active_ports.at(i));
+        driver::close_connection(protocol::UDP, udp_active_ports.at(i), remaining());
+    }
+
+    // Remove Unix domain socket connections.
+    while(include_unix && !driver::m_unix_active.empty())
+    {
+        driver::close_connection(protocol::UNIX, driver::m_unix_active.begin()->first, remaining());
     }
 }
 
 // PUBLIC METHODS: IO
-bool driver::tx(protocol type, uint16_t port, const uint8_t *data, uint32_t length)
+bool driver::tx(protocol type, uint16_t port, const uint8_t *data, uint32_t length, address destination)
 {
-    switch(type)
-    {
-    case protocol::TCP:
+    TRACE_SCOPE("tx", port);
+    uint64_t start = latency_histogram::now();
+    std::pair<protocol, uint16_t> key(type, port);
+    bool transmitted;
+
+    // Tunnelled ports are wrapped in a channel header and transmitted on their transport.
+    if(driver::m_tunnel_channels.count(key) > 0)
     {
-        if(driver::m_tcp_active.count(port) > 0)
-        {
-            return driver::m_tcp_active.at(port)->tx(data, length);
-        }
-        else
+        std::pair<protocol, uint16_t> transport = driver::m_tunnel_channels.at(key);
+        if(!driver::tunnel_connected(transport))
         {
             return false;
         }
+
+        std::vector<uint8_t> message;
+        driver::m_tunnels.at(transport)->encode(type, port, data, length, message);
+        transmitted = driver::connection_tx(transport.first, transport.second, message.data(), static_cast<uint32_t>(message.size()), destination);
     }
-    case protocol::UDP:
+    // Transports only carry tunnelled ports, since unwrapped data would break the tunnel's framing.
+    else if(driver::m_tunnels.count(key) > 0)
     {
-        if(driver::m_udp_active.count(port) > 0)
-        {
-            driver::m_udp_active.at(port)->tx(data, length);
-            return true;
-        }
-        else
+        return false;
+    }
+    else
+    {
+        transmitted = driver::connection_tx(type, port, data, length, destination);
+    }
+
+    // Record how long the message took to be handed to the kernel.
+    if(transmitted)
+    {
+        driver::latency(driver::m_tx_latency, type, port)->record_since(start);
+
+        // Tunnelled ports are captured by their transport's ring.
+        auto capture = driver::m_captures.find(driver::m_tunnel_channels.count(key) > 0 ? driver::m_tunnel_channels.at(key) : key);
+        if(capture != driver::m_captures.end())
         {
-            return false;
+            capture->second->record(true, type, port, destination, data, length);
         }
     }
+
+    return transmitted;
+}
+
+// PUBLIC METHODS: LATENCY
+bool driver::sample_latency(protocol type, uint16_t port, latency_histogram::snapshot &rx, latency_histogram::snapshot &tx)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    auto rx_histogram = driver::m_rx_latency.find(key);
+    auto tx_histogram = driver::m_tx_latency.find(key);
+    if(rx_histogram == driver::m_rx_latency.end() && tx_histogram == driver::m_tx_latency.end())
+    {
+        return false;
+    }
+
+    rx = (rx_histogram != driver::m_rx_latency.end()) ? rx_histogram->second->sample(true) : latency_histogram::snapshot();
+    tx = (tx_histogram != driver::m_tx_latency.end()) ? tx_histogram->second->sample(true) : latency_histogram::snapshot();
+
+    return true;
+}
+
+// PUBLIC METHODS: CAPTURE
+bool driver::dump_capture(const std::string &path, uint32_t &packets)
+{
+    std::vector<capture_ring::packet> captured;
+    for(auto it = driver::m_captures.begin(); it != driver::m_captures.end(); it++)
+    {
+        it->second->copy_packets(captured);
     }
+    packets = static_cast<uint32_t>(captured.size());
+
+    return capture_ring::write_pcap(path, captured);
 }
 
 // PUBLIC METHODS: STATIC
@@ -310,6 +425,8 @@ std::string driver::protocol_string(protocol value)
         return "TCP";
     case protocol::UDP:
         return "UDP";
+    case protocol::UNIX:
+        return "UNIX";
     }
 }
 std::string driver::tcp_role_string(tcp_role value)
@@ -328,7 +445,7 @@ std::string driver::tcp_role_string(tcp_role value)
 // PROPERTIES
 std::string driver::p_remote_host()
 {
-    return driver::m_remote_ip.to_string();
+    return host_resolver::normalize(driver::m_remote_ip).to_string();
 }
 std::vector<uint16_t> driver::p_pending_tcp_connections() const
 {
@@ -338,6 +455,20 @@ std::vector<uint16_t> driver::p_pending_tcp_connections() const
     {
         output.push_back(it->first);
     }
+    for(auto it = driver::m_tcp_bonds.cbegin(); it != driver::m_tcp_bonds.cend(); it++)
+    {
+        if(it->second->p_status() != tcp_connection::status::CONNECTED)
+        {
+            output.push_back(it->first);
+        }
+    }
+    for(auto it = driver::m_tunnel_channels.cbegin(); it != driver::m_tunnel_channels.cend(); it++)
+    {
+        if(it->first.first == protocol::TCP && !driver::tunnel_connected(it->second))
+        {
+            output.push_back(it->first.second);
+        }
+    }
 
     return output;
 }
@@ -349,6 +480,20 @@ std::vector<uint16_t> driver::p_active_tcp_connections() const
     {
         output.push_back(it->first);
     }
+    for(auto it = driver::m_tcp_bonds.cbegin(); it != driver::m_tcp_bonds.cend(); it++)
+    {
+        if(it->second->p_status() == tcp_connection::status::CONNECTED)
+        {
+            output.push_back(it->first);
+        }
+    }
+    for(auto it = driver::m_tunnel_channels.cbegin(); it != driver::m_tunnel_channels.cend(); it++)
+    {
+        if(it->first.first == protocol::TCP && driver::tunnel_connected(it->second))
+        {
+            output.push_back(it->first.second);
+        }
+    }
 
     return output;
 }
@@ -360,22 +505,1335 @@ std::vector<uint16_t> driver::p_active_udp_connections() const
     {
         output.push_back(it->first);
     }
+    for(auto it = driver::m_udp_bonds.cbegin(); it != driver::m_udp_bonds.cend(); it++)
+    {
+        output.push_back(it->first);
+    }
+    for(auto it = driver::m_udp_reliable.cbegin(); it != driver::m_udp_reliable.cend(); it++)
+    {
+        output.push_back(it->first);
+    }
+    for(auto it = driver::m_udp_fec.cbegin(); it != driver::m_udp_fec.cend(); it++)
+    {
+        output.push_back(it->first);
+    }
+    for(auto it = driver::m_tunnel_channels.cbegin(); it != driver::m_tunnel_channels.cend(); it++)
+    {
+        if(it->first.first == protocol::UDP)
+        {
+            output.push_back(it->first.second);
+        }
+    }
 
     return output;
 }
-
-// CALLBACKS
-void driver::callback_tcp_connected(uint16_t port)
+std::vector<uint16_t> driver::p_active_unix_connections() const
 {
-    // Move TCP connection from pending to active map.
-    if(driver::m_tcp_pending.count(port) > 0)
+    std::vector<uint16_t> output;
+
+    for(auto it = driver::m_unix_active.cbegin(); it != driver::m_unix_active.cend(); it++)
     {
-        driver::m_tcp_active.insert(std::make_pair(port, driver::m_tcp_pending.at(port)));
-        driver::m_tcp_pending.erase(port);
+        output.push_back(it->first);
     }
 
-    // Pass connected callback/signal externally.
-    driver::m_callback_tcp_connected(port);
+    return output;
+}
+bool driver::p_stats(protocol type, uint16_t port, connection_stats::snapshot &result) const
+{
+    result = connection_stats::snapshot();
+
+    switch(type)
+    {
+    case protocol::TCP:
+    {
+        auto active = driver::m_tcp_active.find(port);
+        auto pending = driver::m_tcp_pending.find(port);
+        auto bond = driver::m_tcp_bonds.find(port);
+        if(active != driver::m_tcp_active.end())
+        {
+            result = active->second->p_stats();
+        }
+        else if(pending != driver::m_tcp_pending.end())
+        {
+            result = pending->second->p_stats();
+        }
+        else if(bond != driver::m_tcp_bonds.end())
+        {
+            result = bond->second->p_stats();
+        }
+        else
+        {
+            return false;
+        }
+        break;
+    }
+    case protocol::UDP:
+    {
+        auto active = driver::m_udp_active.find(port);
+        auto bond = driver::m_udp_bonds.find(port);
+        auto reliable = driver::m_udp_reliable.find(port);
+        auto fec = driver::m_udp_fec.find(port);
+        if(active != driver::m_udp_active.end())
+        {
+            result = active->second->p_stats();
+        }
+        else if(bond != driver::m_udp_bonds.end())
+        {
+            result = bond->second->p_stats();
+        }
+        else if(reliable != driver::m_udp_reliable.end())
+        {
+            result = reliable->second->p_stats();
+        }
+        else if(fec != driver::m_udp_fec.end())
+        {
+            result = fec->second->p_stats();
+        }
+        else
+        {
+            return false;
+        }
+
+        // Include the messages lost or rejected by the port's message layers.
+        auto compressor = driver::m_udp_compressors.find(port);
+        if(compressor != driver::m_udp_compressors.end())
+        {
+            result.rx_errors += compressor->second->p_errors();
+        }
+        auto fragmenter = driver::m_udp_fragmenters.find(port);
+        if(fragmenter != driver::m_udp_fragmenters.end())
+        {
+            result.drops += fragmenter->second->p_discarded();
+        }
+        break;
+    }
+    default:
+    {
+        return false;
+    }
+    }
+
+    // Include the tunnel's malformed and unroutable messages on its transport.
+    auto transport = driver::m_tunnels.find(std::make_pair(type, port));
+    if(transport != driver::m_tunnels.end())
+    {
+        result.drops += transport->second->p_dropped();
+    }
+
+    return true;
+}
+
+// PRIVATE METHODS: SERVICE
+void driver::run_service()
+{
+    TRACE_THREAD("io");
+    driver::m_service.run();
+}
+
+// PRIVATE METHODS: CONNECTIONS
+bool driver::close_connection(protocol type, uint16_t port, double drain_timeout)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    driver::m_rx_latency.erase(key);
+    driver::m_tx_latency.erase(key);
+    driver::m_captures.erase(key);
+
+    // Tunnelled ports have no connection of their own.
+    if(driver::m_tunnel_channels.count(key) > 0)
+    {
+        std::pair<protocol, uint16_t> transport = driver::m_tunnel_channels.at(key);
+        if(driver::m_tunnels.count(transport) > 0)
+        {
+            driver::m_tunnels.at(transport)->remove_channel(type, port);
+        }
+        driver::m_tunnel_channels.erase(key);
+
+        return true;
+    }
+    // Transport connections take their tunnel with them.
+    if(driver::m_tunnels.count(key) > 0)
+    {
+        driver::remove_tunnel(type, port);
+    }
+
+    switch(type)
+    {
+    case protocol::TCP:
+    {
+        driver::m_tcp_options.erase(port);
+
+        // Check bond map.
+        if(driver::m_tcp_bonds.count(port) > 0)
+        {
+            driver::m_tcp_bonds.at(port)->disconnect(drain_timeout);
+            driver::m_tcp_bonds.erase(port);
+
+            return true;
+        }
+        // Check pending map.
+        else if(driver::m_tcp_pending.count(port) > 0)
+        {
+            // Get a pointer to the tcp connection.
+            boost::shared_ptr<tcp_connection> tcp = driver::m_tcp_pending.at(port);
+
+            // Stop the connection.
+            // NOTE: This function causes the tcp_connection pointer to self delete.
+            tcp->disconnect(drain_timeout);
+
+            // Remove the entry from the map.
+            driver::m_tcp_pending.erase(port);
+
+            return true;
+        }
+        // Check active map.
+        else if(driver::m_tcp_active.count(port) > 0)
+        {
+            // Get a pointer to the tcp connection.
+            boost::shared_ptr<tcp_connection> tcp = driver::m_tcp_active.at(port);
+
+            // Stop the connection.
+            // NOTE: This function causes the tcp_connection pointer to self delete.
+            tcp->disconnect(drain_timeout);
+
+            // Remove the entry from the map.
+            driver::m_tcp_active.erase(port);
+
+            return true;
+        }
+        else
+        {
+            // Connection already doesn't exist.
+            return true;
+        }
+    }
+    case protocol::UDP:
+    {
+        driver::m_udp_options.erase(port);
+        driver::m_udp_compressors.erase(port);
+        driver::m_udp_fragmenters.erase(port);
+
+        if(driver::m_udp_bonds.count(port) > 0)
+        {
+            driver::m_udp_bonds.at(port)->disconnect(drain_timeout);
+            driver::m_udp_bonds.erase(port);
+
+            return true;
+        }
+        else if(driver::m_udp_reliable.count(port) > 0)
+        {
+            // Give unacknowledged messages a chance to be delivered.
+            driver::m_udp_reliable.at(port)->disconnect(drain_timeout);
+            driver::m_udp_reliable.erase(port);
+
+            return true;
+        }
+        else if(driver::m_udp_fec.count(port) > 0)
+        {
+            // Transmit the parity of the last block before closing.
+            driver::m_udp_fec.at(port)->disconnect(drain_timeout);
+            driver::m_udp_fec.erase(port);
+
+            return true;
+        }
+        else if(driver::m_udp_active.count(port) > 0)
+        {
+            // Get a pointer to the udp connection.
+            boost::shared_ptr<udp_connection> udp = driver::m_udp_active.at(port);
+
+            // Stop the connection.
+            udp->disconnect(drain_timeout);
+
+            // Remove the entry from the map.
+            driver::m_udp_active.erase(port);
+
+            return true;
+        }
+        else
+        {
+            // Connection already doesn't exist.
+            return true;
+        }
+    }
+    case protocol::UNIX:
+    {
+        if(driver::m_unix_active.count(port) > 0)
+        {
+            // Stop the connection.
+            driver::m_unix_active.at(port)->disconnect();
+
+            // Remove the entry from the map.
+            driver::m_unix_active.erase(port);
+        }
+
+        return true;
+    }
+    }
+}
+bool driver::open_tcp_connection(tcp_role role, uint16_t port, const connection_options& options)
+{
+    // Make sure role is valid.
+    if(role != tcp_role::UNASSIGNED)
+    {
+        // Check if the connection already exists.
+        if(driver::m_tcp_pending.count(port) == 0 && driver::m_tcp_active.count(port) == 0 && driver::m_tcp_bonds.count(port) == 0)
+        {
+            // Bonded connections are managed separately.
+            if(!options.backup_local_ip.empty())
+            {
+                return driver::add_tcp_bond(role, port, options);
+            }
+
+            // Load the TLS configuration before creating anything, so bad certificates fail the add.
+            boost::shared_ptr<tls_context> tls;
+            if(!driver::create_tls_context(options, tls))
+            {
+                return false;
+            }
+
+            // Create the TCP connection.
+            boost::shared_ptr<tcp_connection> new_tcp = boost::shared_ptr<tcp_connection>(new tcp_connection(driver::m_service, tcp::endpoint(driver::m_local_ip, port)));
+
+            // Add the connected/disconnected/rx callbacks.
+            new_tcp->attach_connected_callback(std::bind(&driver::callback_tcp_connected, this, std::placeholders::_1));
+            new_tcp->attach_pending_callback(std::bind(&driver::callback_tcp_pending, this, std::placeholders::_1));
+            new_tcp->attach_disconnected_callback(std::bind(&driver::callback_tcp_disconnected, this, std::placeholders::_1));
+            // NOTE: rx callback is forwarded from external, or to the connection's tunnel.
+            new_tcp->attach_rx_callback(driver::rx_callback(protocol::TCP, port));
+            new_tcp->attach_session_closed_callback(driver::session_closed_callback(port));
+            // NOTE: The tunnel only holds a weak reference, since the connection owns the tunnel through its rx callback.
+            boost::weak_ptr<tcp_connection> weak_tcp = new_tcp;
+            driver::attach_tunnel_transport(port, [weak_tcp](tcp::endpoint session)
+            {
+                boost::shared_ptr<tcp_connection> instance = weak_tcp.lock();
+                if(instance)
+                {
+                    instance->close_session(session);
+                }
+            });
+
+            // Configure automatic reconnection.
+            new_tcp->set_reconnect(options.reconnect, options.reconnect_backoff);
+
+            // Configure dead peer detection.
+            new_tcp->set_dead_peer_detection(options.keepalive, options.keepalive_idle, options.keepalive_interval, options.keepalive_count, options.user_timeout);
+
+            // Configure encryption.
+            new_tcp->set_tls(tls, driver::tls_host(options.remote_host));
+
+            // Add connection to pending before starting it, since it may connect on the IO thread right away.
+            driver::m_tcp_pending.insert(std::make_pair(port, new_tcp));
+            driver::m_tcp_options[port] = options;
+
+            // Start the connection and track if the start succeeded.
+            bool connection_started = false;
+            switch(role)
+            {
+            case tcp_role::UNASSIGNED:
+            {
+                // This case will never occur due to if condition.
+                return false;
+            }
+            case tcp_role::SERVER:
+            {
+                connection_started = new_tcp->start_server();
+                break;
+            }
+            case tcp_role::CLIENT:
+            {
+                address remote_ip;
+                if(driver::remote_ip(options, remote_ip))
+                {
+                    connection_started = new_tcp->start_client(tcp::endpoint(remote_ip, driver::remote_port(options, port)));
+                }
+                break;
+            }
+            }
+
+            // If the connection did not start, remove it from the pending list.
+            if(!connection_started)
+            {
+                driver::m_tcp_pending.erase(port);
+                driver::m_tcp_options.erase(port);
+            }
+
+            return connection_started;
+        }
+        else
+        {
+            // The connection is already active or pending. Check if it's role matches the requested role.
+            if(driver::m_tcp_bonds.count(port))
+            {
+                return driver::m_tcp_bonds.at(port)->p_role() == role;
+            }
+            else if(driver::m_tcp_active.count(port))
+            {
+                return driver::m_tcp_active.at(port)->p_role() == role;
+            }
+            else
+            {
+                return driver::m_tcp_pending.at(port)->p_role() == role;
+            }
+        }
+    }
+    else
+    {
+        // Connection role is unassigned.
+        return false;
+    }
+}
+bool driver::open_udp_connection(uint16_t port, const connection_options& options)
+{
+    if(driver::m_udp_active.count(port) == 0 && driver::m_udp_bonds.count(port) == 0 && driver::m_udp_reliable.count(port) == 0 && driver::m_udp_fec.count(port) == 0)
+    {
+        // Compression and fragmentation apply to every type of UDP connection, so they are set up first.
+        if(!driver::add_udp_compressor(port, options))
+        {
+            return false;
+        }
+        driver::add_udp_fragmenter(port, options);
+
+        // Bonded connections are managed separately.
+        if(!options.backup_local_ip.empty())
+        {
+            return driver::add_udp_bond(port, options);
+        }
+        // Multicast connections do not use a remote host.
+        if(!options.multicast_group.empty())
+        {
+            return driver::add_udp_multicast(port, options);
+        }
+        // Broadcast connections do not use a remote host.
+        if(!options.broadcast.empty())
+        {
+            return driver::add_udp_broadcast(port, options);
+        }
+        // Reliable connections wrap a UDP connection.
+        if(options.reliable)
+        {
+            return driver::add_udp_reliable(port, options);
+        }
+        // FEC connections wrap a UDP connection.
+        if(options.fec_data_shards > 0)
+        {
+            return driver::add_udp_fec(port, options);
+        }
+
+        // Get the connection's remote address.
+        address remote_ip;
+        if(!driver::remote_ip(options, remote_ip))
+        {
+            return false;
+        }
+
+        // Create the UDP connection.
+        boost::shared_ptr<udp_connection> new_udp = boost::shared_ptr<udp_connection>(new udp_connection(driver::m_service, udp::endpoint(driver::m_local_ip, port), udp::endpoint(remote_ip, driver::remote_port(options, port)), 1024, options.rx_shards, options.rx_ordered, options.rx_batch));
+        new_udp->set_tx_loss(options.tx_loss);
+        // Attach the rx callback.
+        new_udp->attach_rx_callback(driver::udp_rx_callback(port));
+        // Bypass the kernel's network stack if requested.
+        if(options.xdp && !driver::enable_xdp(new_udp, options))
+        {
+            new_udp->disconnect();
+            return false;
+        }
+        // Start listening for packets.
+        if(!new_udp->connect())
+        {
+            new_udp->disconnect();
+            return false;
+        }
+        // Add connection to map.
+        driver::m_udp_active.insert(std::make_pair(port, new_udp));
+        driver::m_udp_options[port] = options;
+
+        return true;
+    }
+    else
+    {
+        // Return true since the connection already exists.
+        return true;
+    }
+}
+std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> driver::rx_callback(protocol type, uint16_t port)
+{
+    // Transport connections hand everything they receive to their tunnel.
+    std::pair<protocol, uint16_t> key(type, port);
+    if(driver::m_tunnels.count(key) > 0)
+    {
+        return std::bind(&tunnel::rx, driver::m_tunnels.at(key), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
+    }
+
+    return driver::recorded_rx_callback(type, port);
+}
+std::function<void(tcp::endpoint)> driver::session_closed_callback(uint16_t port)
+{
+    // Tunnels drop the partial message of a closed session, since other sessions may keep the transport connected.
+    auto transport = driver::m_tunnels.find(std::make_pair(protocol::TCP, port));
+    if(transport != driver::m_tunnels.end())
+    {
+        return std::bind(&tunnel::close_session, transport->second, std::placeholders::_1);
+    }
+
+    return std::function<void(tcp::endpoint)>();
+}
+void driver::attach_tunnel_transport(uint16_t port, std::function<void(tcp::endpoint)> close_session)
+{
+    auto transport = driver::m_tunnels.find(std::make_pair(protocol::TCP, port));
+    if(transport != driver::m_tunnels.end())
+    {
+        transport->second->attach_corrupt_session_callback(close_session);
+    }
+}
+std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> driver::recorded_rx_callback(protocol type, uint16_t port)
+{
+    // Measure from the socket read that completed the message until the external callback has handled it.
+    // NOTE: The histogram and capture ring are captured so that recording on the IO threads never touches the driver's maps.
+    boost::shared_ptr<latency_histogram> histogram = driver::latency(driver::m_rx_latency, type, port);
+    auto capture_entry = driver::m_captures.find(std::make_pair(type, port));
+    boost::shared_ptr<capture_ring> capture = (capture_entry != driver::m_captures.end()) ? capture_entry->second : boost::shared_ptr<capture_ring>();
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback = driver::m_callback_rx;
+
+    return [histogram, capture, callback](protocol rx_type, uint16_t rx_port, uint8_t* data, uint32_t length, address source)
+    {
+        TRACE_SCOPE("rx_callback", rx_port);
+        uint64_t start = latency_histogram::rx_mark();
+        // The callback takes ownership of the data, so it is captured first.
+        if(capture)
+        {
+            capture->record(false, rx_type, rx_port, source, data, length);
+        }
+        callback(rx_type, rx_port, data, length, source);
+        histogram->record_since(start);
+    };
+}
+boost::shared_ptr<latency_histogram> driver::latency(std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<latency_histogram>> &histograms, protocol type, uint16_t port)
+{
+    boost::shared_ptr<latency_histogram>& histogram = histograms[std::make_pair(type, port)];
+    if(!histogram)
+    {
+        histogram = boost::shared_ptr<latency_histogram>(new latency_histogram());
+    }
+
+    return histogram;
+}
+
+void driver::add_capture(protocol type, uint16_t port, const connection_options &options)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    if(options.capture_size <= 0.0 || driver::m_captures.count(key) > 0)
+    {
+        return;
+    }
+
+    // Unresolvable remote hosts fail when the connection opens, so an unspecified address is fine here.
+    address remote_ip;
+    driver::remote_ip(options, remote_ip);
+    uint64_t capacity = static_cast<uint64_t>(options.capture_size * 1048576.0);
+    driver::m_captures[key] = boost::shared_ptr<capture_ring>(new capture_ring(capacity, type, port, driver::m_local_ip, remote_ip, driver::remote_port(options, port)));
+}
+
+// PRIVATE METHODS: TUNNELS
+bool driver::add_tunnel(protocol type, tcp_role role, uint16_t port, const connection_options &options)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    if(driver::m_tunnels.count(key) > 0)
+    {
+        return true;
+    }
+
+    // The port must not already be open as a plain connection, since its rx callback could not be redirected.
+    bool exists = (type == protocol::TCP) ? (driver::m_tcp_pending.count(port) > 0 || driver::m_tcp_active.count(port) > 0 || driver::m_tcp_bonds.count(port) > 0)
+                                          : (driver::m_udp_active.count(port) > 0 || driver::m_udp_bonds.count(port) > 0 || driver::m_udp_reliable.count(port) > 0 || driver::m_udp_fec.count(port) > 0);
+    if(exists)
+    {
+        return false;
+    }
+
+    // Create the tunnel before the connection, so the connection's rx callback is the tunnel.
+    boost::shared_ptr<tunnel> new_tunnel(new tunnel(type == protocol::TCP));
+    new_tunnel->attach_rx_callback(driver::recorded_rx_callback(type, port));
+    for(auto it = driver::m_tunnel_channels.begin(); it != driver::m_tunnel_channels.end(); it++)
+    {
+        if(it->second == key)
+        {
+            new_tunnel->add_channel(it->first.first, it->first.second);
+        }
+    }
+    driver::m_tunnels.insert(std::make_pair(key, new_tunnel));
+
+    bool opened = (type == protocol::TCP) ? driver::open_tcp_connection(role, port, options) : driver::open_udp_connection(port, options);
+    if(!opened)
+    {
+        driver::m_tunnels.erase(key);
+        return false;
+    }
+
+    // UDP transports can carry messages right away, while TCP transports signal once connected.
+    if(type == protocol::UDP)
+    {
+        driver::signal_tunnel_channels(type, port, driver::m_callback_tcp_connected);
+    }
+
+    return true;
+}
+void driver::remove_tunnel(protocol type, uint16_t port)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    bool connected = driver::tunnel_connected(key);
+    driver::m_tunnels.erase(key);
+
+    // Tunnelled TCP ports are pending until the transport is added again.
+    if(connected)
+    {
+        driver::signal_tunnel_channels(type, port, driver::m_callback_tcp_pending);
+    }
+}
+bool driver::add_tunnel_channel(protocol type, uint16_t port, const connection_options &options)
+{
+    // Get the transport connection.
+    std::pair<protocol, uint16_t> key(type, port);
+    std::pair<protocol, uint16_t> transport;
+    if(options.tunnel_protocol == "udp")
+    {
+        transport = std::make_pair(protocol::UDP, options.tunnel_port);
+    }
+    else if(options.tunnel_protocol == "tcp")
+    {
+        transport = std::make_pair(protocol::TCP, options.tunnel_port);
+    }
+    else
+    {
+        return false;
+    }
+
+    // The port must not be its own transport, or already be open as a plain connection.
+    bool exists = (type == protocol::TCP) ? (driver::m_tcp_pending.count(port) > 0 || driver::m_tcp_active.count(port) > 0 || driver::m_tcp_bonds.count(port) > 0)
+                                          : (driver::m_udp_active.count(port) > 0 || driver::m_udp_bonds.count(port) > 0 || driver::m_udp_reliable.count(port) > 0 || driver::m_udp_fec.count(port) > 0);
+    if(transport == key || exists)
+    {
+        return false;
+    }
+
+    // Register the port, whether or not its transport has been added yet.
+    driver::m_tunnel_channels.insert(std::make_pair(key, transport));
+    if(driver::m_tunnels.count(transport) > 0)
+    {
+        driver::m_tunnels.at(transport)->add_channel(type, port);
+    }
+
+    // Tunnelled TCP ports are connected whenever their transport is.
+    if(type == protocol::TCP && driver::tunnel_connected(transport))
+    {
+        driver::m_callback_tcp_connected(port);
+    }
+
+    return true;
+}
+bool driver::tunnel_connected(std::pair<protocol, uint16_t> transport) const
+{
+    if(driver::m_tunnels.count(transport) == 0)
+    {
+        return false;
+    }
+    else if(transport.first == protocol::TCP)
+    {
+        return driver::m_tcp_active.count(transport.second) > 0 ||
+               (driver::m_tcp_bonds.count(transport.second) > 0 && driver::m_tcp_bonds.at(transport.second)->p_status() == tcp_connection::status::CONNECTED);
+    }
+    else
+    {
+        // UDP transports are always ready.
+        return true;
+    }
+}
+void driver::signal_tunnel_channels(protocol type, uint16_t port, std::function<void(uint16_t)> callback)
+{
+    // Collect the ports first, since callbacks may add or remove connections.
+    std::vector<uint16_t> ports;
+    for(auto it = driver::m_tunnel_channels.begin(); it != driver::m_tunnel_channels.end(); it++)
+    {
+        if(it->first.first == protocol::TCP && it->second == std::make_pair(type, port))
+        {
+            ports.push_back(it->first.second);
+        }
+    }
+
+    for(auto it = ports.begin(); it != ports.end(); it++)
+    {
+        callback(*it);
+    }
+}
+
+// PRIVATE METHODS: BONDING
+bool driver::add_tcp_bond(tcp_role role, uint16_t port, const connection_options &options)
+{
+    // Get the addresses of both paths.
+    address primary_remote_ip, backup_local_ip, backup_remote_ip;
+    if(!driver::remote_ip(options, primary_remote_ip) || !driver::backup_ips(options, backup_local_ip, backup_remote_ip))
+    {
+        return false;
+    }
+
+    // Load the TLS configuration shared by both paths.
+    boost::shared_ptr<tls_context> tls;
+    if(!driver::create_tls_context(options, tls))
+    {
+        return false;
+    }
+
+    // Create the bonded TCP connection.
+    boost::shared_ptr<tcp_bond> new_bond = boost::shared_ptr<tcp_bond>(new tcp_bond(driver::m_service, tcp::endpoint(driver::m_local_ip, port), tcp::endpoint(backup_local_ip, port),
+                                                                                   options.probe_interval, options.probe_timeout));
+
+    // Add the connected/pending/rx callbacks.
+    // NOTE: Bonds are only removed externally, so they never raise a disconnected callback.
+    new_bond->attach_connected_callback(std::bind(&driver::callback_tcp_connected, this, std::placeholders::_1));
+    new_bond->attach_pending_callback(std::bind(&driver::callback_tcp_pending, this, std::placeholders::_1));
+    new_bond->attach_rx_callback(driver::rx_callback(protocol::TCP, port));
+    new_bond->attach_session_closed_callback(driver::session_closed_callback(port));
+    // NOTE: The tunnel only holds a weak reference, since the bond owns the tunnel through its rx callback.
+    boost::weak_ptr<tcp_bond> weak_bond = new_bond;
+    driver::attach_tunnel_transport(port, [weak_bond](tcp::endpoint session)
+    {
+        boost::shared_ptr<tcp_bond> instance = weak_bond.lock();
+        if(instance)
+        {
+            instance->close_session(session);
+        }
+    });
+
+    // Configure path re-establishment and dead peer detection.
+    new_bond->set_reconnect(options.reconnect_backoff);
+    new_bond->set_dead_peer_detection(options.keepalive, options.keepalive_idle, options.keepalive_interval, options.keepalive_count, options.user_timeout);
+    new_bond->set_tls(tls, driver::tls_host(options.remote_host), driver::tls_host(options.backup_remote_host.empty() ? options.remote_host : options.backup_remote_host));
+
+    // Add bond before starting it, since it may connect on the IO thread right away.
+    driver::m_tcp_bonds.insert(std::make_pair(port, new_bond));
+    driver::m_tcp_options[port] = options;
+
+    bool started = false;
+    uint16_t remote_port = driver::remote_port(options, port);
+    switch(role)
+    {
+    case tcp_role::UNASSIGNED:
+    {
+        break;
+    }
+    case tcp_role::SERVER:
+    {
+        started = new_bond->start_server();
+        break;
+    }
+    case tcp_role::CLIENT:
+    {
+        started = new_bond->start_client(tcp::endpoint(primary_remote_ip, remote_port), tcp::endpoint(backup_remote_ip, remote_port));
+        break;
+    }
+    }
+
+    if(!started)
+    {
+        driver::m_tcp_bonds.erase(port);
+        driver::m_tcp_options.erase(port);
+    }
+
+    return started;
+}
+bool driver::add_udp_bond(uint16_t port, const connection_options &options)
+{
+    // Get the addresses of both paths.
+    address primary_remote_ip, backup_local_ip, backup_remote_ip;
+    if(!driver::remote_ip(options, primary_remote_ip) || !driver::backup_ips(options, backup_local_ip, backup_remote_ip))
+    {
+        return false;
+    }
+
+    // Create the bonded UDP connection.
+    uint16_t remote_port = driver::remote_port(options, port);
+    boost::shared_ptr<udp_bond> new_bond = boost::shared_ptr<udp_bond>(new udp_bond(driver::m_service,
+                                                                                   udp::endpoint(driver::m_local_ip, port), udp::endpoint(primary_remote_ip, remote_port),
+                                                                                   udp::endpoint(backup_local_ip, port), udp::endpoint(backup_remote_ip, remote_port),
+                                                                                   options.duplicate_send, options.probe_interval, options.probe_timeout));
+    // Attach the rx callback.
+    new_bond->attach_rx_callback(driver::udp_rx_callback(port));
+    // Start listening and probing.
+    if(!new_bond->connect())
+    {
+        new_bond->disconnect();
+        return false;
+    }
+    // Add bond to map.
+    driver::m_udp_bonds.insert(std::make_pair(port, new_bond));
+    driver::m_udp_options[port] = options;
+
+    return true;
+}
+bool driver::backup_ips(const connection_options &options, address &local_ip, address &remote_ip)
+{
+    boost::system::error_code error;
+    local_ip = address::from_string(options.backup_local_ip, error);
+    if(error)
+    {
+        return false;
+    }
+
+    // The backup path uses the primary remote host unless one is given.
+    bool resolved = options.backup_remote_host.empty() ? driver::remote_ip(options, remote_ip) : driver::resolve_host(options.backup_remote_host, remote_ip);
+    if(resolved)
+    {
+        remote_ip = host_resolver::match_family(remote_ip, local_ip);
+    }
+
+    return resolved;
+}
+
+// PRIVATE METHODS: MULTICAST
+bool driver::add_udp_multicast(uint16_t port, const connection_options &options)
+{
+    // Parse the group and the interface to join it on.
+    boost::system::error_code error;
+    address group = address::from_string(options.multicast_group, error);
+    if(error || !group.is_multicast())
+    {
+        return false;
+    }
+    address interface_ip = options.multicast_interface.empty() ? driver::m_local_ip : address::from_string(options.multicast_interface, error);
+    if(error)
+    {
+        return false;
+    }
+
+    // Bind to the group so that only the group's messages are received, and transmit to the group.
+    // NOTE: Every socket bound to the group receives each message, so the connection is never sharded.
+    boost::shared_ptr<udp_connection> new_udp = boost::shared_ptr<udp_connection>(new udp_connection(driver::m_service, udp::endpoint(group, port), udp::endpoint(group, driver::remote_port(options, port)), 1024, 1, true, options.rx_batch));
+    if(!new_udp->join_group(group, interface_ip, options.multicast_ttl, options.multicast_loopback))
+    {
+        new_udp->disconnect();
+        return false;
+    }
+    // Attach the rx callback.
+    new_udp->attach_rx_callback(driver::udp_rx_callback(port));
+    // Start listening for packets.
+    if(!new_udp->connect())
+    {
+        new_udp->disconnect();
+        return false;
+    }
+    // Add connection to map.
+    driver::m_udp_active.insert(std::make_pair(port, new_udp));
+    driver::m_udp_options[port] = options;
+
+    return true;
+}
+
+// PRIVATE METHODS: BROADCAST
+bool driver::add_udp_broadcast(uint16_t port, const connection_options &options)
+{
+    // Get the broadcast address.
+    address broadcast_ip;
+    if(options.broadcast == "limited")
+    {
+        broadcast_ip = address_v4::broadcast();
+    }
+    else if(options.broadcast == "subnet")
+    {
+        if(!udp_connection::subnet_broadcast(driver::m_local_ip, broadcast_ip))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        boost::system::error_code error;
+        broadcast_ip = address::from_string(options.broadcast, error);
+        if(error || !broadcast_ip.is_v4())
+        {
+            return false;
+        }
+    }
+
+    // Bind to any address, since a socket bound to a unicast address does not receive broadcasts.
+    // NOTE: Every socket on the port receives each broadcast, so the connection is never sharded.
+    boost::shared_ptr<udp_connection> new_udp = boost::shared_ptr<udp_connection>(new udp_connection(driver::m_service, udp::endpoint(address_v4::any(), port), udp::endpoint(broadcast_ip, driver::remote_port(options, port)), 1024, 1, true, options.rx_batch));
+    if(!new_udp->enable_broadcast(options.broadcast_filter_echo))
+    {
+        new_udp->disconnect();
+        return false;
+    }
+    // Attach the rx callback.
+    new_udp->attach_rx_callback(driver::udp_rx_callback(port));
+    // Start listening for packets.
+    if(!new_udp->connect())
+    {
+        new_udp->disconnect();
+        return false;
+    }
+    // Add connection to map.
+    driver::m_udp_active.insert(std::make_pair(port, new_udp));
+    driver::m_udp_options[port] = options;
+
+    return true;
+}
+
+// PRIVATE METHODS: RELIABILITY
+bool driver::add_udp_reliable(uint16_t port, const connection_options &options)
+{
+    // Get the connection's remote address.
+    address remote_ip;
+    if(!driver::remote_ip(options, remote_ip))
+    {
+        return false;
+    }
+
+    // Create the reliable UDP connection.
+    boost::shared_ptr<udp_reliable> new_reliable = boost::shared_ptr<udp_reliable>(new udp_reliable(driver::m_service,
+                                                                                                   udp::endpoint(driver::m_local_ip, port), udp::endpoint(remote_ip, driver::remote_port(options, port)),
+                                                                                                   options.reliable_window, options.reliable_min_rto, options.reliable_max_rto));
+    new_reliable->set_tx_loss(options.tx_loss);
+    // Attach the rx callback.
+    new_reliable->attach_rx_callback(driver::udp_rx_callback(port));
+    // Start listening and retransmitting.
+    if(!new_reliable->connect())
+    {
+        new_reliable->disconnect();
+        return false;
+    }
+    // Add connection to map.
+    driver::m_udp_reliable.insert(std::make_pair(port, new_reliable));
+    driver::m_udp_options[port] = options;
+
+    return true;
+}
+
+// PRIVATE METHODS: FORWARD ERROR CORRECTION
+bool driver::add_udp_fec(uint16_t port, const connection_options &options)
+{
+    // Get the connection's remote address.
+    address remote_ip;
+    if(!driver::remote_ip(options, remote_ip))
+    {
+        return false;
+    }
+
+    // Create the FEC protected UDP connection.
+    boost::shared_ptr<udp_fec> new_fec = boost::shared_ptr<udp_fec>(new udp_fec(driver::m_service,
+                                                                                udp::endpoint(driver::m_local_ip, port), udp::endpoint(remote_ip, driver::remote_port(options, port)),
+                                                                                options.fec_data_shards, options.fec_parity_shards, options.fec_flush_interval));
+    new_fec->set_tx_loss(options.tx_loss);
+    // Attach the rx callback.
+    new_fec->attach_rx_callback(driver::udp_rx_callback(port));
+    // Start listening for packets.
+    if(!new_fec->connect())
+    {
+        new_fec->disconnect();
+        return false;
+    }
+    // Add connection to map.
+    driver::m_udp_fec.insert(std::make_pair(port, new_fec));
+    driver::m_udp_options[port] = options;
+
+    return true;
+}
+
+// PRIVATE METHODS: COMPRESSION
+bool driver::add_udp_compressor(uint16_t port, const connection_options &options)
+{
+    driver::m_udp_compressors.erase(port);
+
+    compressor::codec codec;
+    if(!compressor::parse_codec(options.compression, codec))
+    {
+        return false;
+    }
+    if(codec == compressor::codec::NONE)
+    {
+        return true;
+    }
+
+    boost::shared_ptr<compressor> new_compressor(new compressor(codec, options.compression_level));
+    if(!options.compression_dictionary.empty() && !new_compressor->load_dictionary(options.compression_dictionary))
+    {
+        return false;
+    }
+    driver::m_udp_compressors.insert(std::make_pair(port, new_compressor));
+
+    return true;
+}
+std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> driver::udp_rx_callback(uint16_t port)
+{
+    if(driver::m_udp_compressors.count(port) == 0 && driver::m_udp_fragmenters.count(port) == 0)
+    {
+        return driver::rx_callback(protocol::UDP, port);
+    }
+
+    // The callback holds its own references to the compressor and fragmenter, so receiving never touches the driver's maps.
+    boost::shared_ptr<compressor> port_compressor = driver::m_udp_compressors.count(port) > 0 ? driver::m_udp_compressors.at(port) : boost::shared_ptr<compressor>();
+    boost::shared_ptr<fragmenter> port_fragmenter = driver::m_udp_fragmenters.count(port) > 0 ? driver::m_udp_fragmenters.at(port) : boost::shared_ptr<fragmenter>();
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback = driver::rx_callback(protocol::UDP, port);
+    return [port_compressor, port_fragmenter, callback](protocol type, uint16_t port, uint8_t* data, uint32_t length, address source)
+    {
+        // Undo the transmit pipeline in reverse, dropping messages that are incomplete or cannot be decompressed.
+        std::vector<uint8_t> message(data, data + length);
+        delete [] data;
+        std::vector<uint8_t> stage;
+        if(port_fragmenter)
+        {
+            if(!port_fragmenter->reassemble(message.data(), static_cast<uint32_t>(message.size()), source, stage))
+            {
+                return;
+            }
+            message.swap(stage);
+        }
+        if(port_compressor)
+        {
+            if(!port_compressor->decompress(message.data(), static_cast<uint32_t>(message.size()), stage))
+            {
+                return;
+            }
+            message.swap(stage);
+        }
+
+        if(callback)
+        {
+            uint8_t* output_array = new uint8_t[message.size()];
+            std::memcpy(output_array, message.data(), message.size());
+            callback(type, port, output_array, static_cast<uint32_t>(message.size()), source);
+        }
+    };
+}
+
+// PRIVATE METHODS: FRAGMENTATION
+void driver::add_udp_fragmenter(uint16_t port, const connection_options &options)
+{
+    driver::m_udp_fragmenters.erase(port);
+    if(options.fragment_size == 0)
+    {
+        return;
+    }
+
+    // Fragments must fit in the connection's RX buffer along with the headers of bonding, reliability, or FEC.
+    uint32_t datagram_size = 1024;
+    if(!options.backup_local_ip.empty())
+    {
+        datagram_size -= udp_bond::overhead();
+    }
+    else if(options.reliable)
+    {
+        datagram_size -= udp_reliable::overhead();
+    }
+    else if(options.fec_data_shards > 0)
+    {
+        datagram_size -= udp_fec::overhead();
+    }
+
+    boost::shared_ptr<fragmenter> new_fragmenter(new fragmenter(std::min(options.fragment_size, datagram_size), options.fragment_timeout, options.fragment_buffer));
+    driver::m_udp_fragmenters.insert(std::make_pair(port, new_fragmenter));
+}
+
+// PRIVATE METHODS: XDP
+bool driver::enable_xdp(boost::shared_ptr<udp_connection> connection, const connection_options &options)
+{
+    std::string interface = options.xdp_interface.empty() ? xdp_socket::interface_name(driver::m_local_ip) : options.xdp_interface;
+    if(interface.empty())
+    {
+        return false;
+    }
+
+    // Only one AF_XDP socket can bind to an interface queue, so ports on the same queue share it.
+    boost::weak_ptr<xdp_socket>& entry = driver::m_xdp_sockets[std::make_pair(interface, options.xdp_queue)];
+    boost::shared_ptr<xdp_socket> socket = entry.lock();
+    if(!socket)
+    {
+        socket = boost::shared_ptr<xdp_socket>(new xdp_socket());
+        if(!socket->open(interface, options.xdp_queue, driver::m_local_ip, options.xdp_native))
+        {
+            return false;
+        }
+        entry = socket;
+    }
+
+    return connection->enable_xdp(socket);
+}
+
+// PRIVATE METHODS: IO
+bool driver::connection_tx(protocol type, uint16_t port, const uint8_t *data, uint32_t length, address destination)
+{
+    switch(type)
+    {
+    case protocol::TCP:
+    {
+        if(driver::m_tcp_bonds.count(port) > 0)
+        {
+            return driver::m_tcp_bonds.at(port)->tx(data, length, destination);
+        }
+        else if(driver::m_tcp_active.count(port) > 0)
+        {
+            return driver::m_tcp_active.at(port)->tx(data, length, destination);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    case protocol::UDP:
+    {
+        // Compress the message if the connection uses compression.
+        std::vector<uint8_t> compressed;
+        if(driver::m_udp_compressors.count(port) > 0)
+        {
+            driver::m_udp_compressors.at(port)->compress(data, length, compressed);
+            data = compressed.data();
+            length = static_cast<uint32_t>(compressed.size());
+        }
+
+        // Split the message into datagrams if the connection uses fragmentation.
+        if(driver::m_udp_fragmenters.count(port) > 0)
+        {
+            std::vector<std::vector<uint8_t>> fragments;
+            if(!driver::m_udp_fragmenters.at(port)->split(data, length, fragments))
+            {
+                return false;
+            }
+            bool sent = true;
+            for(auto it = fragments.begin(); it != fragments.end(); it++)
+            {
+                sent = driver::udp_tx(port, it->data(), static_cast<uint32_t>(it->size())) && sent;
+            }
+            return sent;
+        }
+
+        return driver::udp_tx(port, data, length);
+    }
+    case protocol::UNIX:
+    {
+        if(driver::m_unix_active.count(port) > 0)
+        {
+            return driver::m_unix_active.at(port)->tx(data, length);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    }
+}
+bool driver::udp_tx(uint16_t port, const uint8_t *data, uint32_t length)
+{
+    if(driver::m_udp_bonds.count(port) > 0)
+    {
+        return driver::m_udp_bonds.at(port)->tx(data, length);
+    }
+    else if(driver::m_udp_reliable.count(port) > 0)
+    {
+        return driver::m_udp_reliable.at(port)->tx(data, length);
+    }
+    else if(driver::m_udp_fec.count(port) > 0)
+    {
+        return driver::m_udp_fec.at(port)->tx(data, length);
+    }
+    else if(driver::m_udp_active.count(port) > 0)
+    {
+        return driver::m_udp_active.at(port)->tx(data, length);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// PRIVATE METHODS: TLS
+bool driver::create_tls_context(const connection_options &options, boost::shared_ptr<tls_context> &result)
+{
+    result.reset();
+    if(!options.tls)
+    {
+        return true;
+    }
+
+    boost::shared_ptr<tls_context> context(new tls_context());
+    if(!context->load(options.tls_certificate, options.tls_key, options.tls_ca, options.tls_verify))
+    {
+        return false;
+    }
+    result = context;
+
+    return true;
+}
+std::string driver::tls_host(const std::string &host) const
+{
+    std::string name = host.empty() ? driver::m_remote_host : host;
+
+    // IP addresses are verified against the address the connection actually uses.
+    boost::system::error_code error;
+    address::from_string(name, error);
+
+    return error ? name : "";
+}
+// PRIVATE METHODS: REMOTE ENDPOINTS
+bool driver::resolve_host(std::string host, address &result)
+{
+    // Prefer addresses of the same family as the local address.
+    bool prefer_v6 = driver::m_local_ip.is_v6();
+
+    // Asynchronous resolution requires the IO service to be running.
+    bool resolved;
+    if(driver::m_running)
+    {
+        resolved = driver::m_resolver->resolve(host, result, prefer_v6);
+    }
+    else
+    {
+        resolved = driver::m_resolver->resolve_blocking(host, result, prefer_v6);
+    }
+
+    // Convert the result so it can be used on sockets bound to the local address.
+    // NOTE: The address is recorded so that connections can follow the host if it moves.
+    if(resolved)
+    {
+        result = host_resolver::match_family(result, driver::m_local_ip);
+        driver::m_resolved_hosts[host] = result;
+    }
+
+    return resolved;
+}
+bool driver::remote_ip(const connection_options &options, address &result)
+{
+    if(options.remote_host.empty())
+    {
+        result = driver::m_remote_ip;
+        return true;
+    }
+    else
+    {
+        return driver::resolve_host(options.remote_host, result);
+    }
+}
+uint16_t driver::remote_port(const connection_options &options, uint16_t local_port)
+{
+    return (options.remote_port != 0) ? options.remote_port : local_port;
+}
+void driver::migrate_connections(const std::string &host, const address &target)
+{
+    // Retarget UDP connections in place.
+    for(auto it = driver::m_udp_active.begin(); it != driver::m_udp_active.end(); it++)
+    {
+        connection_options options = driver::m_udp_options[it->first];
+        if(options.remote_host == host && options.multicast_group.empty() && options.broadcast.empty())
+        {
+            it->second->set_remote_endpoint(udp::endpoint(target, driver::remote_port(options, it->first)));
+        }
+    }
+
+    // Retarget the primary path of bonded UDP connections in place.
+    for(auto it = driver::m_udp_bonds.begin(); it != driver::m_udp_bonds.end(); it++)
+    {
+        connection_options options = driver::m_udp_options[it->first];
+        if(options.remote_host == host)
+        {
+            it->second->set_remote_endpoint(udp::endpoint(target, driver::remote_port(options, it->first)));
+        }
+    }
+
+    // Retarget reliable UDP connections in place, keeping their unacknowledged messages.
+    for(auto it = driver::m_udp_reliable.begin(); it != driver::m_udp_reliable.end(); it++)
+    {
+        connection_options options = driver::m_udp_options[it->first];
+        if(options.remote_host == host)
+        {
+            it->second->set_remote_endpoint(udp::endpoint(target, driver::remote_port(options, it->first)));
+        }
+    }
+
+    // Retarget FEC connections in place.
+    for(auto it = driver::m_udp_fec.begin(); it != driver::m_udp_fec.end(); it++)
+    {
+        connection_options options = driver::m_udp_options[it->first];
+        if(options.remote_host == host)
+        {
+            it->second->set_remote_endpoint(udp::endpoint(target, driver::remote_port(options, it->first)));
+        }
+    }
+
+    // Reconnect TCP clients on the IO thread, and wait so that the service call reports the migrated state.
+    if(driver::m_running)
+    {
+        boost::shared_ptr<std::promise<void>> completed(new std::promise<void>());
+        std::future<void> future = completed->get_future();
+        driver::m_service.post([this, host, target, completed]{driver::migrate_tcp_connections(host, target); completed->set_value();});
+        future.wait();
+    }
+    else
+    {
+        driver::migrate_tcp_connections(host, target);
+    }
+}
+void driver::migrate_tcp_connections(const std::string &host, const address &target)
+{
+    // Reconnect the primary path of bonded TCP clients to the new address.
+    for(auto it = driver::m_tcp_bonds.begin(); it != driver::m_tcp_bonds.end(); it++)
+    {
+        connection_options options = driver::m_tcp_options[it->first];
+        if(it->second->p_role() == tcp_role::CLIENT && options.remote_host == host)
+        {
+            it->second->set_remote_endpoint(tcp::endpoint(target, driver::remote_port(options, it->first)), driver::tls_host(host));
+        }
+    }
+
+    // Collect TCP connections, since reconnecting moves them between the pending and active maps.
+    std::vector<std::pair<uint16_t, boost::shared_ptr<tcp_connection>>> tcp_connections(driver::m_tcp_pending.begin(), driver::m_tcp_pending.end());
+    tcp_connections.insert(tcp_connections.end(), driver::m_tcp_active.begin(), driver::m_tcp_active.end());
+
+    // Reconnect TCP clients to the new address.
+    for(auto it = tcp_connections.begin(); it != tcp_connections.end(); it++)
+    {
+        connection_options options = driver::m_tcp_options[it->first];
+        if(it->second->p_role() == tcp_role::CLIENT && options.remote_host == host)
+        {
+            it->second->set_remote_endpoint(tcp::endpoint(target, driver::remote_port(options, it->first)), driver::tls_host(host));
+        }
+    }
+}
+
+// CALLBACKS
+void driver::callback_tcp_connected(uint16_t port)
+{
+    // Move TCP connection from pending to active map.
+    if(driver::m_tcp_pending.count(port) > 0)
+    {
+        driver::m_tcp_active.insert(std::make_pair(port, driver::m_tcp_pending.at(port)));
+        driver::m_tcp_pending.erase(port);
+    }
+
+    // Pass connected callback/signal externally.
+    driver::m_callback_tcp_connected(port);
+
+    // Tunnelled TCP ports are connected along with their transport.
+    std::pair<protocol, uint16_t> key(protocol::TCP, port);
+    if(driver::m_tunnels.count(key) > 0)
+    {
+        driver::m_tunnels.at(key)->reset();
+        driver::signal_tunnel_channels(protocol::TCP, port, driver::m_callback_tcp_connected);
+    }
+}
+void driver::callback_tcp_pending(uint16_t port)
+{
+    // Move TCP connection from active back to pending map while it reconnects.
+    if(driver::m_tcp_active.count(port) > 0)
+    {
+        driver::m_tcp_pending.insert(std::make_pair(port, driver::m_tcp_active.at(port)));
+        driver::m_tcp_active.erase(port);
+    }
+
+    // Pass pending callback/signal externally.
+    driver::m_callback_tcp_pending(port);
+
+    // Tunnelled TCP ports wait along with their transport.
+    std::pair<protocol, uint16_t> key(protocol::TCP, port);
+    if(driver::m_tunnels.count(key) > 0)
+    {
+        driver::m_tunnels.at(key)->reset();
+        driver::signal_tunnel_channels(protocol::TCP, port, driver::m_callback_tcp_pending);
+    }
 }
 void driver::callback_tcp_disconnected(uint16_t port)
 {
@@ -5,10 +5,23 @@
 
 #include "tcp_connection.h"
 #include "udp_connection.h"
+#include "tcp_bond.h"
+#include "udp_bond.h"
+#include "udp_reliable.h"
+#include "udp_fec.h"
+#include "compressor.h"
+#include "fragmenter.h"
+#include "tunnel.h"
+#include "unix_connection.h"
+#include "host_resolver.h"
+#include "connection_options.h"
+#include "latency_histogram.h"
+#include "capture_ring.h"
+#include "trace.h"
 
 #include <boost/thread.hpp>
 
-/// \brief A driver for TCP/UDP communications over a network interface.
+/// \brief A driver for TCP/UDP communications over a network interface, and Unix domain socket communications with local processes.
 class driver
 {
 public:
@@ -18,10 +31,12 @@ public:
     /// \param remote_host The remote IP or hostname to communicate with.
     /// \param rx_callback A callback for handling received TCP/UDP messages.
     /// \param tcp_connected_callback A callback for handling TCP connection events.
+    /// \param tcp_pending_callback A callback for handling TCP connections that were lost and are reconnecting.
     /// \param tcp_disconnected_callback A callback for handling TCP disconnection events.
     driver(std::string local_ip, std::string remote_host,
            std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> rx_callback,
            std::function<void(uint16_t)> tcp_connected_callback,
+           std::function<void(uint16_t)> tcp_pending_callback,
            std::function<void(uint16_t)> tcp_disconnected_callback);
     ~driver();
 
@@ -29,29 +44,62 @@ public:
     /// \brief Starts the IO service event loop in a separate thread.
     void start();
     /// \brief Stops the IO service event loop running in the separate thread.
+    /// \details If a drain timeout is set, all connections are drained and removed first.
     void stop();
 
     // METHODS: CONNECTION MANAGEMENT
     /// \brief Sets the remote host of the driver.
     /// \param remote_host The remote host to communicate with.
+    /// \param migrate Indicates if existing connections should be migrated to the new host instead of removed.
     /// \return TRUE if the remove host could be resolved, otheriwse FALSE.
-    bool set_remote_host(std::string remote_host);
+    /// \details Hostnames are resolved asynchronously on the IO thread, and this method returns
+    /// as soon as resolution completes or times out.  Cached results are returned immediately.
+    /// When migrating, UDP connections are retargeted in place and TCP clients reconnect to the new host.
+    /// TCP servers and connections with their own remote host are left untouched.
+    /// Unix domain socket connections are never affected.
+    bool set_remote_host(std::string remote_host, bool migrate = false);
+    /// \brief Sets the caching and timeout parameters for remote host resolution.
+    /// \param cache_ttl The time in seconds that a resolved address is considered fresh.
+    /// \param refresh_interval The interval in seconds at which cached hosts are re-resolved in the background.
+    /// \param timeout The maximum time in seconds to wait for a resolution.
+    void set_resolver_parameters(double cache_ttl, double refresh_interval, double timeout);
+    /// \brief Retargets connections whose remote hostnames have moved to new addresses.
+    /// \return TRUE if any hostname moved, otherwise FALSE.
+    /// \details Hostnames are re-resolved on the IO thread every refresh interval, and this method applies the results
+    /// like a migrating set_remote_host: UDP connections are retargeted in place and TCP clients reconnect.  Addresses
+    /// that a hostname still resolves to are kept.  Hostnames that no connection uses are no longer re-resolved.
+    /// Call it periodically from the thread that manages connections.
+    bool update_remote_hosts();
+    /// \brief Sets the maximum time to wait for queued data to be sent when connections are removed.
+    /// \param timeout The drain timeout in seconds.  Zero closes connections immediately.
+    /// \details Removed connections refuse new transmissions immediately, then wait for data queued in the kernel
+    /// to be sent (UDP) or acknowledged (TCP) before closing.
+    void set_drain_timeout(double timeout);
     /// \brief Adds a TCP connection to the driver.
     /// \param role The role that the TCP connection should operate as.
     /// \param port The port that the connection shall communicate through.
+    /// \param options The optional settings of the connection, such as its remote endpoint.
     /// \return TRUE if the connection was added, otherwise FALSE.
-    bool add_tcp_connection(tcp_role role, uint16_t port);
+    bool add_tcp_connection(tcp_role role, uint16_t port, connection_options options = connection_options());
     /// \brief Adds a UDP connection to the driver.
     /// \param port The port that the connection shall communicate through.
+    /// \param options The optional settings of the connection, such as its remote endpoint.
     /// \return TRUE if the connection was added, otherwise FALSE.
-    bool add_udp_connection(uint16_t port);
-    /// \brief Removes an existing TCP/UDP connection.
-    /// \param type The protocol type of connection to remove (TCP or UDP).
+    bool add_udp_connection(uint16_t port, connection_options options = connection_options());
+    /// \brief Adds a Unix domain socket connection to the driver.
+    /// \param port The port number that identifies the connection.
+    /// \param options The settings of the connection, including its mode and socket paths.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_unix_connection(uint16_t port, connection_options options = connection_options());
+    /// \brief Removes an existing TCP/UDP/UNIX connection.
+    /// \param type The protocol type of connection to remove (TCP, UDP, or UNIX).
     /// \param port The port of the connection.
     /// \return TRUE if the connection was removed, otherwise FALSE.
     bool remove_connection(protocol type, uint16_t port);
     /// \brief Removes all active and pending connections.
-    void remove_all_connections();
+    /// \param include_unix Indicates if Unix domain socket connections, which do not use the remote host, are also removed.
+    /// \details All connections are drained within a single drain timeout, rather than one drain timeout each.
+    void remove_all_connections(bool include_unix = true);
 
     // METHODS: IO
     /// \brief Transmits data over a connection.
@@ -59,9 +107,30 @@ public:
     /// \param port The port to transmit from.
     /// \param data The array of data to transmit.
     /// \param length The length of the data to transmit.
+    /// \param destination For TCP servers, the remote address of the session(s) to transmit to.
+    /// An unspecified address transmits to all sessions.
     /// \return TRUE if the transmit operation succeeded, otherwise FALSE.
     /// \note This method takes ownership of the data pointer.
-    bool tx(protocol type, uint16_t port, const uint8_t* data, uint32_t length);
+    bool tx(protocol type, uint16_t port, const uint8_t* data, uint32_t length, address destination = address());
+
+    // METHODS: LATENCY
+    /// \brief Takes the latency histograms of a port for the interval since they were last sampled.
+    /// \param type The protocol of the port.
+    /// \param port The port.
+    /// \param rx The latency from the socket read that completed each received message until the rx callback returned.
+    /// \param tx The latency from each tx() call until its message was handed to the kernel.
+    /// \return TRUE if the port has histograms, otherwise FALSE.
+    /// \details The histograms restart after sampling.  Messages received on a tunnelled port are recorded on the
+    /// tunnel's transport, since they are separated from its stream on the transport's IO thread.
+    bool sample_latency(protocol type, uint16_t port, latency_histogram::snapshot& rx, latency_histogram::snapshot& tx);
+
+    // METHODS: CAPTURE
+    /// \brief Writes the messages held by every port's capture ring to a pcap file.
+    /// \param path The path of the file.
+    /// \param packets Returns the number of messages written.
+    /// \return TRUE if the file was written, otherwise FALSE.
+    /// \details Messages of tunnelled ports are captured by their transport's ring.
+    bool dump_capture(const std::string& path, uint32_t& packets);
 
     // METHODS: Static
     /// \brief Gets the string representation of a protocol.
@@ -86,17 +155,41 @@ public:
     /// \brief Gets the list of active UDP connections.
     /// \return The list of active UDP connections.
     std::vector<uint16_t> p_active_udp_connections() const;
+    /// \brief Gets the list of active Unix domain socket connections.
+    /// \return The list of active Unix domain socket connections.
+    std::vector<uint16_t> p_active_unix_connections() const;
+    /// \brief Gets the traffic counters of a TCP or UDP connection.
+    /// \param type The protocol of the connection.
+    /// \param port The port of the connection.
+    /// \param result The snapshot of the connection's counters.
+    /// \return TRUE if the connection has counters, otherwise FALSE.
+    /// \details Bonds report the sum of both paths, and layered connections (reliability, FEC) report the datagrams
+    /// of their underlying connection.  Tunnelled ports have no counters of their own, since their traffic is counted
+    /// on the tunnel's transport.
+    bool p_stats(protocol type, uint16_t port, connection_stats::snapshot& result) const;
 
 private:
     // VARIABLES: SOCKET
     /// \brief Stores the driver's io_service instance.
     boost::asio::io_service m_service;
+    /// \brief Resolves and caches remote hostnames.
+    boost::shared_ptr<host_resolver> m_resolver;
     /// \brief Stores the local IP address for all connections.
     boost::asio::ip::address m_local_ip;
     /// \brief Stores the remote IP address for all connections.
     boost::asio::ip::address m_remote_ip;
+    /// \brief Stores the remote hostname or IP address that m_remote_ip was resolved from.
+    std::string m_remote_host;
+    /// \brief The address that connections use for each resolved hostname, by hostname.
+    std::map<std::string, address> m_resolved_hosts;
+    /// \brief The resolver's change count when remote hosts were last updated.
+    uint64_t m_resolver_changes;
     /// \brief A separate thread for running the IO service event loop.
     boost::thread m_thread;
+    /// \brief Indicates if the IO service event loop is running.
+    bool m_running;
+    /// \brief The maximum time in seconds to wait for queued data when removing connections.
+    double m_drain_timeout;
     /// \brief IO service worker instance for keepign io_service::run running.
     boost::asio::io_service::work* m_service_work;
 
@@ -107,19 +200,269 @@ private:
     std::map<uint16_t, boost::shared_ptr<tcp_connection>> m_tcp_active;
     /// \brief The map of active UDP connections.
     std::map<uint16_t, boost::shared_ptr<udp_connection>> m_udp_active;
+    /// \brief The map of bonded TCP connections.
+    std::map<uint16_t, boost::shared_ptr<tcp_bond>> m_tcp_bonds;
+    /// \brief The map of bonded UDP connections.
+    std::map<uint16_t, boost::shared_ptr<udp_bond>> m_udp_bonds;
+    /// \brief The map of reliable UDP connections.
+    std::map<uint16_t, boost::shared_ptr<udp_reliable>> m_udp_reliable;
+    /// \brief The map of FEC protected UDP connections.
+    std::map<uint16_t, boost::shared_ptr<udp_fec>> m_udp_fec;
+    /// \brief The compressors of UDP connections that use compression.
+    std::map<uint16_t, boost::shared_ptr<compressor>> m_udp_compressors;
+    /// \brief The fragmenters of UDP connections that use fragmentation.
+    std::map<uint16_t, boost::shared_ptr<fragmenter>> m_udp_fragmenters;
+    /// \brief The map of active Unix domain socket connections.
+    std::map<uint16_t, boost::shared_ptr<unix_connection>> m_unix_active;
+    /// \brief The options of each TCP connection.
+    std::map<uint16_t, connection_options> m_tcp_options;
+    /// \brief The options of each UDP connection.
+    std::map<uint16_t, connection_options> m_udp_options;
+    /// \brief The tunnels carried by transport connections, by the transport's protocol and port.
+    std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<tunnel>> m_tunnels;
+    /// \brief The transport of each tunnelled logical port, by the logical port's protocol and port.
+    /// \details Tunnelled ports have no socket of their own.
+    std::map<std::pair<protocol, uint16_t>, std::pair<protocol, uint16_t>> m_tunnel_channels;
+
+    // VARIABLES: XDP
+    /// \brief The AF_XDP sockets shared by the UDP connections on each interface queue, by interface name and queue.
+    /// \details Each socket closes once the last connection using it is removed.
+    std::map<std::pair<std::string, uint32_t>, boost::weak_ptr<xdp_socket>> m_xdp_sockets;
+
+    // VARIABLES: LATENCY
+    /// \brief The receive latency histograms, by protocol and port.
+    std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<latency_histogram>> m_rx_latency;
+    /// \brief The transmit latency histograms, by protocol and port.
+    std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<latency_histogram>> m_tx_latency;
+
+    // VARIABLES: CAPTURE
+    /// \brief The capture rings of connections that keep their recent messages, by protocol and port.
+    std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<capture_ring>> m_captures;
 
     // VARIABLES: CALLBACKS
     /// \brief The callback to raise when TCP connections are made.
     std::function<void(uint16_t)> m_callback_tcp_connected;
+    /// \brief The callback to raise when TCP connections are lost and return to pending.
+    std::function<void(uint16_t)> m_callback_tcp_pending;
     /// \brief The callback to raise when TCP disconnections occur.
     std::function<void(uint16_t)> m_callback_tcp_disconnected;
     /// \brief The callback to raise when messages are received.
     std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_callback_rx;
 
+    // METHODS: SERVICE
+    /// \brief Runs the IO service on the driver's IO thread.
+    void run_service();
+
+    // METHODS: CONNECTIONS
+    /// \brief Removes an existing TCP/UDP/UNIX connection.
+    /// \param type The protocol type of connection to remove (TCP, UDP, or UNIX).
+    /// \param port The port of the connection.
+    /// \param drain_timeout The maximum time in seconds to wait for queued data to be sent before closing.
+    /// \return TRUE if the connection was removed, otherwise FALSE.
+    bool close_connection(protocol type, uint16_t port, double drain_timeout);
+    /// \brief Opens a TCP connection with its own socket.
+    /// \param role The role that the TCP connection should operate as.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection.
+    /// \return TRUE if the connection was opened, otherwise FALSE.
+    bool open_tcp_connection(tcp_role role, uint16_t port, const connection_options& options);
+    /// \brief Opens a UDP connection with its own socket.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection.
+    /// \return TRUE if the connection was opened, otherwise FALSE.
+    bool open_udp_connection(uint16_t port, const connection_options& options);
+    /// \brief Gets the rx callback to attach to a connection, which demultiplexes tunnels.
+    /// \param type The protocol of the connection.
+    /// \param port The port of the connection.
+    /// \return The rx callback.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> rx_callback(protocol type, uint16_t port);
+    /// \brief Gets the session closed callback to attach to a TCP connection.
+    /// \param port The port of the connection.
+    /// \return The callback, which is empty unless the connection carries a tunnel.
+    std::function<void(tcp::endpoint)> session_closed_callback(uint16_t port);
+    /// \brief Lets the tunnel carried by a TCP connection close sessions whose stream is corrupt.
+    /// \param port The port of the connection.
+    /// \param close_session The callback that closes a session of the connection by its remote endpoint.
+    /// \details Does nothing unless the connection carries a tunnel.  Must be called before the connection starts.
+    void attach_tunnel_transport(uint16_t port, std::function<void(tcp::endpoint)> close_session);
+    /// \brief Gets the external rx callback wrapped to record the port's receive latency and capture its messages.
+    /// \param type The protocol of the port.
+    /// \param port The port.
+    /// \return The rx callback.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> recorded_rx_callback(protocol type, uint16_t port);
+    /// \brief Gets the latency histogram of a port, creating it if needed.
+    /// \param histograms The receive or transmit histograms.
+    /// \param type The protocol of the port.
+    /// \param port The port.
+    /// \return The port's histogram.
+    static boost::shared_ptr<latency_histogram> latency(std::map<std::pair<protocol, uint16_t>, boost::shared_ptr<latency_histogram>>& histograms, protocol type, uint16_t port);
+    /// \brief Creates the capture ring of a connection if its options enable capture.
+    /// \param type The protocol of the connection.
+    /// \param port The port of the connection.
+    /// \param options The settings of the connection.
+    void add_capture(protocol type, uint16_t port, const connection_options& options);
+
+    // METHODS: TUNNELS
+    /// \brief Opens a connection that carries a tunnel.
+    /// \param type The protocol of the transport connection.
+    /// \param role The role of a TCP transport connection.
+    /// \param port The port of the transport connection.
+    /// \param options The settings of the transport connection.
+    /// \return TRUE if the connection was opened, otherwise FALSE.
+    bool add_tunnel(protocol type, tcp_role role, uint16_t port, const connection_options& options);
+    /// \brief Removes the tunnel of a transport connection that is being removed.
+    /// \param type The protocol of the transport connection.
+    /// \param port The port of the transport connection.
+    /// \details Tunnelled TCP ports return to pending until the transport is added again.
+    void remove_tunnel(protocol type, uint16_t port);
+    /// \brief Adds a logical port that is carried by a tunnel.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    /// \param options The settings of the logical port, including its transport.
+    /// \return TRUE if the port was added, FALSE if its transport settings are invalid.
+    bool add_tunnel_channel(protocol type, uint16_t port, const connection_options& options);
+    /// \brief Indicates if a tunnel's transport connection exists and is connected.
+    /// \param transport The protocol and port of the transport connection.
+    /// \return TRUE if the tunnel can carry messages, otherwise FALSE.
+    bool tunnel_connected(std::pair<protocol, uint16_t> transport) const;
+    /// \brief Raises a callback for every tunnelled TCP port carried by a transport connection.
+    /// \param type The protocol of the transport connection.
+    /// \param port The port of the transport connection.
+    /// \param callback The callback to raise for each tunnelled TCP port.
+    void signal_tunnel_channels(protocol type, uint16_t port, std::function<void(uint16_t)> callback);
+
+    // METHODS: BONDING
+    /// \brief Adds a bonded TCP connection to the driver.
+    /// \param role The role that the TCP connection should operate as.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its backup path.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_tcp_bond(tcp_role role, uint16_t port, const connection_options& options);
+    /// \brief Adds a bonded UDP connection to the driver.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its backup path.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_udp_bond(uint16_t port, const connection_options& options);
+    /// \brief Gets the local and remote addresses of the backup path of a bonded connection.
+    /// \param options The options of the connection.
+    /// \param local_ip The local address of the backup path.
+    /// \param remote_ip The remote address of the backup path.
+    /// \return TRUE if the addresses were resolved, otherwise FALSE.
+    bool backup_ips(const connection_options& options, address& local_ip, address& remote_ip);
+
+    // METHODS: MULTICAST
+    /// \brief Adds a UDP connection that joins and transmits to a multicast group.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its multicast group.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_udp_multicast(uint16_t port, const connection_options& options);
+
+    // METHODS: BROADCAST
+    /// \brief Adds a UDP connection that transmits to a broadcast address.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its broadcast mode.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_udp_broadcast(uint16_t port, const connection_options& options);
+
+    // METHODS: RELIABILITY
+    /// \brief Adds a UDP connection that retransmits lost messages and delivers messages in order.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its reliability settings.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_udp_reliable(uint16_t port, const connection_options& options);
+
+    // METHODS: FORWARD ERROR CORRECTION
+    /// \brief Adds a UDP connection that recovers lost messages from parity shards.
+    /// \param port The port that the connection shall communicate through.
+    /// \param options The settings of the connection, including its FEC settings.
+    /// \return TRUE if the connection was added, otherwise FALSE.
+    bool add_udp_fec(uint16_t port, const connection_options& options);
+
+    // METHODS: COMPRESSION
+    /// \brief Creates the compressor of a UDP connection, if it uses compression.
+    /// \param port The port of the connection.
+    /// \param options The settings of the connection, including its compression settings.
+    /// \return TRUE if the compressor was created or is not needed, FALSE if the settings are invalid.
+    bool add_udp_compressor(uint16_t port, const connection_options& options);
+    /// \brief Gets the rx callback to attach to a UDP connection, which reassembles and decompresses messages as needed.
+    /// \param port The port of the connection.
+    /// \return The rx callback.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> udp_rx_callback(uint16_t port);
+
+    // METHODS: FRAGMENTATION
+    /// \brief Creates the fragmenter of a UDP connection, if it uses fragmentation.
+    /// \param port The port of the connection.
+    /// \param options The settings of the connection, including its fragmentation settings.
+    void add_udp_fragmenter(uint16_t port, const connection_options& options);
+
+    // METHODS: XDP
+    /// \brief Redirects a UDP connection's port into the AF_XDP socket of its interface queue, opening it if needed.
+    /// \param connection The UDP connection.
+    /// \param options The settings of the connection, including its XDP settings.
+    /// \return TRUE if the port is redirected, otherwise FALSE.
+    bool enable_xdp(boost::shared_ptr<udp_connection> connection, const connection_options& options);
+
+    // METHODS: IO
+    /// \brief Transmits data over a connection with its own socket.
+    /// \param type The connection type to transmit via.
+    /// \param port The port to transmit from.
+    /// \param data The array of data to transmit.
+    /// \param length The length of the data to transmit.
+    /// \param destination For TCP servers, the remote address of the session(s) to transmit to.
+    /// \return TRUE if the transmit operation succeeded, otherwise FALSE.
+    bool connection_tx(protocol type, uint16_t port, const uint8_t* data, uint32_t length, address destination);
+    /// \brief Transmits a single datagram on a UDP connection of any type.
+    /// \param port The port of the connection.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the transmit operation succeeded, otherwise FALSE.
+    bool udp_tx(uint16_t port, const uint8_t* data, uint32_t length);
+
+    // METHODS: TLS
+    /// \brief Creates the TLS configuration of a TCP connection.
+    /// \param options The options of the connection.
+    /// \param result The TLS configuration, or null if the connection is not encrypted.
+    /// \return TRUE if the configuration was created, FALSE if its certificates could not be loaded.
+    static bool create_tls_context(const connection_options& options, boost::shared_ptr<tls_context>& result);
+    /// \brief Gets the name that a TLS client verifies the server's certificate against.
+    /// \param host The remote host of the connection, or empty for the driver's remote host.
+    /// \return The hostname, or empty if the host is an IP address, which the connection verifies against directly.
+    std::string tls_host(const std::string& host) const;
+
+    // METHODS: REMOTE ENDPOINTS
+    /// \brief Resolves a host, asynchronously if the IO service is running.
+    /// \param host The hostname or IP address to resolve.
+    /// \param result The resolved address.
+    /// \return TRUE if the host was resolved, otherwise FALSE.
+    bool resolve_host(std::string host, address& result);
+    /// \brief Gets the remote address of a connection.
+    /// \param options The options of the connection.
+    /// \param result The connection's remote address, or the driver's remote host if the connection has none.
+    /// \return TRUE if the remote address was resolved, otherwise FALSE.
+    bool remote_ip(const connection_options& options, address& result);
+    /// \brief Gets the remote port of a connection.
+    /// \param options The options of the connection.
+    /// \param local_port The local port of the connection.
+    /// \return The connection's remote port, or the local port if the connection has none.
+    static uint16_t remote_port(const connection_options& options, uint16_t local_port);
+    /// \brief Retargets all connections that follow a remote host to a new address.
+    /// \param host The remote host of the connections, or empty for connections that follow the driver's remote host.
+    /// \param target The new address of the remote host.
+    /// \details Waits for TCP clients to be retargeted on the IO thread if it is running.
+    void migrate_connections(const std::string& host, const address& target);
+    /// \brief Reconnects all TCP clients that follow a remote host to a new address.
+    /// \param host The remote host of the connections, or empty for connections that follow the driver's remote host.
+    /// \param target The new address of the remote host.
+    /// \details Must run on the IO thread while it is running, since it owns each client's sessions and reconnect timer.
+    void migrate_tcp_connections(const std::string& host, const address& target);
+
     // CALLBACKS
     /// \brief The callback for handling TCP connection events.
     /// \param port The port of the connection that was connected.
     void callback_tcp_connected(uint16_t port);
+    /// \brief The callback for handling TCP connections returning to pending.
+    /// \param port The port of the connection that is reconnecting.
+    void callback_tcp_pending(uint16_t port);
     /// \brief The callback for handling TCP disconnection events.
     /// \param port The port of the connection that was disconnected.
     void callback_tcp_disconnected(uint16_t port);
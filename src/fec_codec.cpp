@@ -0,0 +1,223 @@
+#include "fec_codec.h"
+
+#include <algorithm>
+
+// GALOIS FIELD
+namespace {
+
+/// \brief The arithmetic tables of GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1.
+struct galois_field
+{
+    galois_field()
+    {
+        // Generate the exponent and logarithm tables, doubling the exponent table to avoid a modulo.
+        uint32_t value = 1;
+        for(uint32_t i = 0; i < 255; i++)
+        {
+            exp[i] = static_cast<uint8_t>(value);
+            exp[i + 255] = static_cast<uint8_t>(value);
+            log[value] = static_cast<uint8_t>(i);
+            value <<= 1;
+            if(value & 0x100)
+            {
+                value ^= 0x11D;
+            }
+        }
+        log[0] = 0;
+
+        // Generate the full multiplication table, so each region multiply is a single lookup per byte.
+        for(uint32_t a = 0; a < 256; a++)
+        {
+            for(uint32_t b = 0; b < 256; b++)
+            {
+                mul[a][b] = (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+            }
+        }
+    }
+    uint8_t inverse(uint8_t a) const
+    {
+        return exp[255 - log[a]];
+    }
+
+    uint8_t exp[510];
+    uint8_t log[256];
+    uint8_t mul[256][256];
+};
+
+const galois_field& field()
+{
+    static const galois_field instance;
+    return instance;
+}
+
+}
+
+// CONSTRUCTORS
+fec_codec::fec_codec(uint32_t parity_shards)
+{
+    fec_codec::m_parity_shards = std::max(1u, std::min(parity_shards, 128u));
+}
+
+// PUBLIC METHODS
+void fec_codec::encode(const std::vector<std::vector<uint8_t>>& data, std::vector<std::vector<uint8_t>>& parity) const
+{
+    // Parity shards are the length of the longest data shard.
+    std::size_t length = 0;
+    for(auto it = data.begin(); it != data.end(); it++)
+    {
+        length = std::max(length, it->size());
+    }
+
+    parity.assign(fec_codec::m_parity_shards, std::vector<uint8_t>(length, 0));
+    for(uint32_t i = 0; i < fec_codec::m_parity_shards; i++)
+    {
+        for(uint32_t j = 0; j < data.size(); j++)
+        {
+            fec_codec::multiply_add(parity[i].data(), data[j].data(), data[j].size(), fec_codec::coefficient(i, j));
+        }
+    }
+}
+bool fec_codec::decode(std::vector<std::vector<uint8_t>>& data, const std::vector<bool>& present, const std::map<uint32_t, std::vector<uint8_t>>& parity) const
+{
+    // Find the missing data shards.
+    std::vector<uint32_t> missing;
+    for(uint32_t j = 0; j < data.size(); j++)
+    {
+        if(!present[j])
+        {
+            missing.push_back(j);
+        }
+    }
+    if(missing.empty())
+    {
+        return true;
+    }
+    if(parity.size() < missing.size())
+    {
+        return false;
+    }
+
+    // Use one parity shard per missing data shard.
+    std::vector<uint32_t> rows;
+    std::size_t length = parity.begin()->second.size();
+    for(auto it = parity.begin(); rows.size() < missing.size(); it++)
+    {
+        if(it->first >= fec_codec::m_parity_shards || it->second.size() != length)
+        {
+            return false;
+        }
+        rows.push_back(it->first);
+    }
+    uint32_t n = static_cast<uint32_t>(missing.size());
+
+    // Remove the received data shards from each parity shard, leaving only the contribution of the missing shards.
+    std::vector<std::vector<uint8_t>> syndromes(n);
+    for(uint32_t r = 0; r < n; r++)
+    {
+        syndromes[r] = parity.at(rows[r]);
+        for(uint32_t j = 0; j < data.size(); j++)
+        {
+            if(present[j])
+            {
+                fec_codec::multiply_add(syndromes[r].data(), data[j].data(), std::min(data[j].size(), length), fec_codec::coefficient(rows[r], j));
+            }
+        }
+    }
+
+    // Invert the coefficients of the missing shards with Gauss-Jordan elimination.
+    const galois_field& gf = field();
+    std::vector<std::vector<uint8_t>> matrix(n, std::vector<uint8_t>(2 * n, 0));
+    for(uint32_t r = 0; r < n; r++)
+    {
+        for(uint32_t c = 0; c < n; c++)
+        {
+            matrix[r][c] = fec_codec::coefficient(rows[r], missing[c]);
+        }
+        matrix[r][n + r] = 1;
+    }
+    for(uint32_t c = 0; c < n; c++)
+    {
+        // Find a pivot.
+        uint32_t pivot = c;
+        while(pivot < n && matrix[pivot][c] == 0)
+        {
+            pivot++;
+        }
+        if(pivot == n)
+        {
+            return false;
+        }
+        std::swap(matrix[c], matrix[pivot]);
+
+        // Normalize the pivot row, and eliminate the column from every other row.
+        uint8_t scale = gf.inverse(matrix[c][c]);
+        for(uint32_t k = 0; k < 2 * n; k++)
+        {
+            matrix[c][k] = gf.mul[scale][matrix[c][k]];
+        }
+        for(uint32_t r = 0; r < n; r++)
+        {
+            if(r != c && matrix[r][c] != 0)
+            {
+                fec_codec::multiply_add(matrix[r].data(), matrix[c].data(), 2 * n, matrix[r][c]);
+            }
+        }
+    }
+
+    // Recover each missing shard from the syndromes.
+    for(uint32_t r = 0; r < n; r++)
+    {
+        std::vector<uint8_t>& shard = data[missing[r]];
+        shard.assign(length, 0);
+        for(uint32_t c = 0; c < n; c++)
+        {
+            fec_codec::multiply_add(shard.data(), syndromes[c].data(), length, matrix[r][n + c]);
+        }
+    }
+
+    return true;
+}
+
+// PROPERTIES
+uint32_t fec_codec::p_max_data_shards() const
+{
+    // Cauchy coefficients need distinct field elements for every parity and data shard.
+    return 256 - fec_codec::m_parity_shards;
+}
+
+// PRIVATE METHODS
+uint8_t fec_codec::coefficient(uint32_t parity_index, uint32_t data_index) const
+{
+    // A single parity shard is plain XOR parity.
+    if(fec_codec::m_parity_shards == 1)
+    {
+        return 1;
+    }
+
+    // Every square submatrix of a Cauchy matrix is invertible, so any k shards recover the block.
+    return field().inverse(static_cast<uint8_t>(parity_index ^ (fec_codec::m_parity_shards + data_index)));
+}
+void fec_codec::multiply_add(uint8_t *output, const uint8_t *input, std::size_t length, uint8_t factor)
+{
+    if(factor == 0)
+    {
+        return;
+    }
+    else if(factor == 1)
+    {
+        // Plain XOR, which the compiler vectorizes.
+        for(std::size_t i = 0; i < length; i++)
+        {
+            output[i] ^= input[i];
+        }
+    }
+    else
+    {
+        // One table row serves the entire region.
+        const uint8_t* row = field().mul[factor];
+        for(std::size_t i = 0; i < length; i++)
+        {
+            output[i] ^= row[input[i]];
+        }
+    }
+}
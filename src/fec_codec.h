@@ -0,0 +1,59 @@
+/// \file fec_codec.h
+/// \brief Defines the fec_codec class.
+#ifndef FEC_CODEC_H
+#define FEC_CODEC_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/// \brief A systematic Reed-Solomon erasure code over GF(2^8).
+/// \details A block of up to k data shards is protected by m parity shards, and any k of the k + m shards recover the
+/// block.  A single parity shard is the XOR of the data shards.  Multiple parity shards use a Cauchy matrix.
+/// Shards of different lengths are treated as if zero padded to the longest shard, which is the length of the parity.
+class fec_codec
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new codec.
+    /// \param parity_shards The number of parity shards per block (m).
+    fec_codec(uint32_t parity_shards);
+
+    // METHODS
+    /// \brief Encodes the parity shards of a block.
+    /// \param data The data shards of the block.
+    /// \param parity The encoded parity shards.
+    void encode(const std::vector<std::vector<uint8_t>>& data, std::vector<std::vector<uint8_t>>& parity) const;
+    /// \brief Recovers the missing data shards of a block.
+    /// \param data The data shards of the block, where missing shards are replaced with recovered shards.
+    /// \param present Indicates which data shards were received.
+    /// \param parity The received parity shards, by parity index.
+    /// \return TRUE if the missing shards were recovered, FALSE if too few shards were received.
+    /// \details Recovered shards have the length of the parity shards, including any zero padding.
+    bool decode(std::vector<std::vector<uint8_t>>& data, const std::vector<bool>& present, const std::map<uint32_t, std::vector<uint8_t>>& parity) const;
+
+    // PROPERTIES
+    /// \brief Gets the maximum number of data shards per block for the codec's number of parity shards.
+    /// \return The maximum number of data shards.
+    uint32_t p_max_data_shards() const;
+
+private:
+    // VARIABLES
+    /// \brief The number of parity shards per block.
+    uint32_t m_parity_shards;
+
+    // METHODS
+    /// \brief Gets the coefficient of a data shard in a parity shard.
+    /// \param parity_index The index of the parity shard.
+    /// \param data_index The index of the data shard.
+    /// \return The coefficient.
+    uint8_t coefficient(uint32_t parity_index, uint32_t data_index) const;
+    /// \brief Multiplies a region by a coefficient and adds it into another region.
+    /// \param output The region to add into.
+    /// \param input The region to multiply.
+    /// \param length The length of the input region in bytes.
+    /// \param factor The coefficient to multiply by.
+    static void multiply_add(uint8_t* output, const uint8_t* input, std::size_t length, uint8_t factor);
+};
+
+#endif // FEC_CODEC_H
@@ -0,0 +1,196 @@
+#include "fragmenter.h"
+
+#include <algorithm>
+#include <random>
+
+// The fragment header is: magic (1), message identifier (4), fragment index (2), and fragment count (2), all big endian.
+#define FRAGMENT_MAGIC 0xA7
+#define FRAGMENT_HEADER_SIZE 9
+#define FRAGMENT_MAX_COUNT 0xFFFF
+
+// CONSTRUCTORS
+fragmenter::fragmenter(uint32_t fragment_size, double timeout, uint32_t buffer_size)
+    // Start message identifiers at random, so a restarted sender is not mixed up with its old partial messages.
+    : m_tx_message(std::random_device()())
+{
+    // Every fragment must carry at least one byte.
+    fragmenter::m_fragment_size = std::max(fragment_size, static_cast<uint32_t>(FRAGMENT_HEADER_SIZE + 1));
+    fragmenter::m_timeout = boost::posix_time::microseconds(static_cast<int64_t>(timeout * 1000000.0));
+    fragmenter::m_buffer_size = buffer_size;
+
+    fragmenter::m_buffered = 0;
+    fragmenter::m_last_check = boost::posix_time::microsec_clock::universal_time();
+    fragmenter::m_reassembled = 0;
+    fragmenter::m_discarded = 0;
+}
+
+// PUBLIC METHODS
+bool fragmenter::split(const uint8_t *data, uint32_t length, std::vector<std::vector<uint8_t>> &fragments)
+{
+    // A message that the receiver cannot hold along with its fragment table is never sent.
+    uint32_t payload_size = fragmenter::m_fragment_size - FRAGMENT_HEADER_SIZE;
+    uint32_t count = std::max(1u, (length + payload_size - 1) / payload_size);
+    if(count > FRAGMENT_MAX_COUNT || length + static_cast<uint64_t>(count) * sizeof(std::vector<uint8_t>) > fragmenter::m_buffer_size)
+    {
+        return false;
+    }
+
+    uint32_t message = fragmenter::m_tx_message++;
+    fragments.resize(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t offset = i * payload_size;
+        uint32_t size = std::min(payload_size, length - offset);
+
+        std::vector<uint8_t>& fragment = fragments[i];
+        fragment.resize(FRAGMENT_HEADER_SIZE + size);
+        fragment[0] = FRAGMENT_MAGIC;
+        fragment[1] = static_cast<uint8_t>(message >> 24);
+        fragment[2] = static_cast<uint8_t>(message >> 16);
+        fragment[3] = static_cast<uint8_t>(message >> 8);
+        fragment[4] = static_cast<uint8_t>(message);
+        fragment[5] = static_cast<uint8_t>(i >> 8);
+        fragment[6] = static_cast<uint8_t>(i);
+        fragment[7] = static_cast<uint8_t>(count >> 8);
+        fragment[8] = static_cast<uint8_t>(count);
+        std::copy(data + offset, data + offset + size, fragment.begin() + FRAGMENT_HEADER_SIZE);
+    }
+
+    return true;
+}
+bool fragmenter::reassemble(const uint8_t *data, uint32_t length, address source, std::vector<uint8_t> &message)
+{
+    // Ignore anything that isn't a fragment.
+    if(length < FRAGMENT_HEADER_SIZE || data[0] != FRAGMENT_MAGIC)
+    {
+        return false;
+    }
+    uint32_t identifier = (static_cast<uint32_t>(data[1]) << 24) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 8) | data[4];
+    uint32_t index = (static_cast<uint32_t>(data[5]) << 8) | data[6];
+    uint32_t count = (static_cast<uint32_t>(data[7]) << 8) | data[8];
+    uint32_t size = length - FRAGMENT_HEADER_SIZE;
+    // Every fragment carries at least one byte, so larger counts cannot fit the memory limit.
+    if(index >= count || count > fragmenter::m_buffer_size)
+    {
+        return false;
+    }
+
+    // Single fragment messages skip reassembly.
+    if(count == 1)
+    {
+        message.assign(data + FRAGMENT_HEADER_SIZE, data + length);
+        return true;
+    }
+
+    boost::mutex::scoped_lock lock(fragmenter::m_mutex);
+
+    // Make room for the fragment, and for the fragment table if it starts a new message.
+    // NOTE: The table is charged before it is allocated, so a forged count cannot allocate beyond the limit.
+    std::pair<address, uint32_t> key(source, identifier);
+    bool started = fragmenter::m_partials.count(key) > 0;
+    uint64_t table = started ? 0 : static_cast<uint64_t>(count) * sizeof(std::vector<uint8_t>);
+    if(table + size > fragmenter::m_buffer_size)
+    {
+        return false;
+    }
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    fragmenter::discard(now, static_cast<uint32_t>(table) + size);
+    if(fragmenter::m_buffered + table + size > fragmenter::m_buffer_size)
+    {
+        return false;
+    }
+
+    // Find or start the fragment's message.
+    auto it = fragmenter::m_partials.find(key);
+    if(it == fragmenter::m_partials.end())
+    {
+        if(started)
+        {
+            // The message was just discarded, so it can no longer be completed.
+            return false;
+        }
+        it = fragmenter::m_partials.insert(std::make_pair(key, partial())).first;
+        it->second.fragments.resize(count);
+        it->second.received = 0;
+        it->second.bytes = 0;
+        it->second.table = static_cast<uint32_t>(table);
+        it->second.started = now;
+        fragmenter::m_buffered += it->second.table;
+    }
+    partial& state = it->second;
+
+    // Store the fragment, ignoring duplicates and fragments that disagree with the message's count.
+    if(count != state.fragments.size() || state.fragments[index].size() > 0 || size == 0)
+    {
+        return false;
+    }
+    state.fragments[index].assign(data + FRAGMENT_HEADER_SIZE, data + length);
+    state.received++;
+    state.bytes += size;
+    fragmenter::m_buffered += size;
+
+    // Join the message once every fragment has arrived.
+    if(state.received < count)
+    {
+        return false;
+    }
+    message.clear();
+    message.reserve(state.bytes);
+    for(auto fragment = state.fragments.begin(); fragment != state.fragments.end(); fragment++)
+    {
+        message.insert(message.end(), fragment->begin(), fragment->end());
+    }
+    fragmenter::m_buffered -= state.bytes + state.table;
+    fragmenter::m_partials.erase(it);
+    fragmenter::m_reassembled++;
+
+    return true;
+}
+
+// PROPERTIES
+uint64_t fragmenter::p_reassembled() const
+{
+    boost::mutex::scoped_lock lock(fragmenter::m_mutex);
+    return fragmenter::m_reassembled;
+}
+uint64_t fragmenter::p_discarded() const
+{
+    boost::mutex::scoped_lock lock(fragmenter::m_mutex);
+    return fragmenter::m_discarded;
+}
+
+// PRIVATE METHODS
+void fragmenter::discard(boost::posix_time::ptime now, uint32_t incoming)
+{
+    // Check for timeouts a few times per timeout period, rather than on every fragment.
+    if(now - fragmenter::m_last_check >= fragmenter::m_timeout / 4)
+    {
+        fragmenter::m_last_check = now;
+        for(auto it = fragmenter::m_partials.begin(); it != fragmenter::m_partials.end();)
+        {
+            if(now - it->second.started >= fragmenter::m_timeout)
+            {
+                fragmenter::m_buffered -= it->second.bytes + it->second.table;
+                fragmenter::m_discarded++;
+                it = fragmenter::m_partials.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    // Discard the oldest messages until the fragment fits.
+    while(fragmenter::m_buffered + incoming > fragmenter::m_buffer_size && !fragmenter::m_partials.empty())
+    {
+        auto oldest = std::min_element(fragmenter::m_partials.begin(), fragmenter::m_partials.end(),
+                                       [](const std::pair<const std::pair<address, uint32_t>, partial>& a, const std::pair<const std::pair<address, uint32_t>, partial>& b)
+        {
+            return a.second.started < b.second.started;
+        });
+        fragmenter::m_buffered -= oldest->second.bytes + oldest->second.table;
+        fragmenter::m_discarded++;
+        fragmenter::m_partials.erase(oldest);
+    }
+}
@@ -0,0 +1,104 @@
+/// \file fragmenter.h
+/// \brief Defines the fragmenter class.
+#ifndef FRAGMENTER_H
+#define FRAGMENTER_H
+
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+using namespace boost::asio::ip;
+
+/// \brief Splits messages into datagram sized fragments and reassembles them.
+/// \details Every fragment carries a small header with its message's identifier, its index, and the fragment count.
+/// Partial messages are discarded when they time out, or when they exceed the reassembly memory limit, oldest first.
+/// The limit covers each partial message's fragment table as well as its data, since the fragment count is untrusted.
+/// Only complete messages are returned, so losing a single fragment loses its message without truncating it.
+class fragmenter
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new fragmenter.
+    /// \param fragment_size The maximum size of each fragment in bytes, including its header.
+    /// \param timeout The time in seconds that a partial message waits for its missing fragments.
+    /// \param buffer_size The maximum number of bytes held by partial messages and their fragment tables, which also limits the message size.
+    fragmenter(uint32_t fragment_size, double timeout, uint32_t buffer_size);
+
+    // METHODS
+    /// \brief Splits a message into fragments.
+    /// \param data The message to split.
+    /// \param length The length of the message in bytes.
+    /// \param fragments The fragments of the message.
+    /// \return TRUE if the message was split, FALSE if it is too large to be reassembled.
+    bool split(const uint8_t* data, uint32_t length, std::vector<std::vector<uint8_t>>& fragments);
+    /// \brief Adds a received fragment to its message.
+    /// \param data The received fragment.
+    /// \param length The length of the fragment in bytes.
+    /// \param source The source address of the fragment.
+    /// \param message The complete message, if this fragment completed it.
+    /// \return TRUE if a message was completed, otherwise FALSE.
+    bool reassemble(const uint8_t* data, uint32_t length, address source, std::vector<uint8_t>& message);
+
+    // PROPERTIES
+    /// \brief Gets the number of messages reassembled from more than one fragment.
+    /// \return The number of reassembled messages.
+    uint64_t p_reassembled() const;
+    /// \brief Gets the number of partial messages discarded after timing out or exceeding the memory limit.
+    /// \return The number of discarded messages.
+    uint64_t p_discarded() const;
+
+private:
+    // STRUCTURES
+    /// \brief A message being reassembled.
+    struct partial
+    {
+        /// \brief The received fragments, by index.
+        std::vector<std::vector<uint8_t>> fragments;
+        /// \brief The number of received fragments.
+        uint32_t received;
+        /// \brief The number of bytes held by the received fragments.
+        uint32_t bytes;
+        /// \brief The number of bytes charged to the memory limit for the fragment table.
+        uint32_t table;
+        /// \brief The time that the first fragment was received.
+        boost::posix_time::ptime started;
+    };
+
+    // VARIABLES: CONFIGURATION
+    /// \brief The maximum size of each fragment in bytes, including its header.
+    uint32_t m_fragment_size;
+    /// \brief The time that a partial message waits for its missing fragments.
+    boost::posix_time::time_duration m_timeout;
+    /// \brief The maximum number of bytes held by partial messages.
+    uint32_t m_buffer_size;
+
+    // VARIABLES: SENDER
+    /// \brief The identifier of the next transmitted message.
+    std::atomic<uint32_t> m_tx_message;
+
+    // VARIABLES: RECEIVER
+    /// \brief The messages being reassembled, by source and message identifier.
+    std::map<std::pair<address, uint32_t>, partial> m_partials;
+    /// \brief The number of bytes held by partial messages, including their fragment tables.
+    uint32_t m_buffered;
+    /// \brief The last time that partial messages were checked for timeouts.
+    boost::posix_time::ptime m_last_check;
+    /// \brief Protects the messages being reassembled, which may be received on several threads.
+    mutable boost::mutex m_mutex;
+    /// \brief The number of reassembled messages.
+    uint64_t m_reassembled;
+    /// \brief The number of discarded messages.
+    uint64_t m_discarded;
+
+    // METHODS
+    /// \brief Discards partial messages that have timed out, and the oldest messages while over the memory limit.
+    /// \param now The current time.
+    /// \param incoming The number of bytes about to be buffered.
+    /// \note m_mutex must be held.
+    void discard(boost::posix_time::ptime now, uint32_t incoming);
+};
+
+#endif // FRAGMENTER_H
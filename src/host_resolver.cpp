@@ -0,0 +1,257 @@
+#include "host_resolver.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+// CONSTRUCTORS
+host_resolver::host_resolver(boost::asio::io_service& io_service)
+    // Initialize service reference, resolver, timer, and counter.
+    : m_service(io_service),
+      m_resolver(io_service),
+      m_timer_refresh(io_service),
+      m_changes(0)
+{
+    // Set default parameters.
+    host_resolver::set_parameters(60.0, 30.0, 2.0);
+}
+
+// PUBLIC METHODS
+void host_resolver::set_parameters(double cache_ttl, double refresh_interval, double timeout)
+{
+    host_resolver::m_cache_ttl = boost::posix_time::milliseconds(static_cast<int64_t>(cache_ttl * 1000.0));
+    host_resolver::m_refresh_interval = boost::posix_time::milliseconds(static_cast<int64_t>(refresh_interval * 1000.0));
+    host_resolver::m_timeout = boost::posix_time::milliseconds(static_cast<int64_t>(timeout * 1000.0));
+}
+bool host_resolver::resolve(std::string host, address &result, bool prefer_v6)
+{
+    // IP address literals do not need to be resolved.
+    boost::system::error_code error;
+    result = address::from_string(host, error);
+    if(!error)
+    {
+        return true;
+    }
+
+    // Use a fresh cached address if available.
+    if(host_resolver::lookup(host, result, prefer_v6, true))
+    {
+        return true;
+    }
+
+    // Resolve on the IO thread and wait for completion or timeout.
+    boost::shared_ptr<std::promise<void>> completed(new std::promise<void>());
+    std::future<void> future = completed->get_future();
+    host_resolver::m_service.post(boost::bind(&host_resolver::async_resolve, host_resolver::shared_from_this(), host, completed));
+    future.wait_for(std::chrono::milliseconds(host_resolver::m_timeout.total_milliseconds()));
+
+    // Use whatever is in the cache, falling back to a stale address if resolution failed.
+    return host_resolver::lookup(host, result, prefer_v6, false);
+}
+bool host_resolver::resolve_blocking(std::string host, address &result, bool prefer_v6)
+{
+    // IP address literals do not need to be resolved.
+    boost::system::error_code error;
+    result = address::from_string(host, error);
+    if(!error)
+    {
+        return true;
+    }
+
+    // Resolve synchronously.
+    udp::resolver::query query(host, "");
+    udp::resolver::iterator results = host_resolver::m_resolver.resolve(query, error);
+    if(error || !host_resolver::store(host, results))
+    {
+        return false;
+    }
+
+    return host_resolver::lookup(host, result, prefer_v6, false);
+}
+void host_resolver::start_refresh()
+{
+    // A zero interval disables background re-resolution.
+    if(host_resolver::m_refresh_interval > boost::posix_time::time_duration(0, 0, 0))
+    {
+        host_resolver::schedule_refresh();
+    }
+}
+void host_resolver::stop_refresh()
+{
+    host_resolver::m_timer_refresh.cancel();
+}
+bool host_resolver::resolves_to(const std::string &host, const address &ip)
+{
+    boost::mutex::scoped_lock lock(host_resolver::m_mutex_cache);
+
+    auto entry = host_resolver::m_cache.find(host);
+    return entry != host_resolver::m_cache.end() &&
+           std::find(entry->second.ips.begin(), entry->second.ips.end(), host_resolver::normalize(ip)) != entry->second.ips.end();
+}
+void host_resolver::retain(const std::set<std::string> &hosts)
+{
+    boost::mutex::scoped_lock lock(host_resolver::m_mutex_cache);
+
+    for(auto it = host_resolver::m_cache.begin(); it != host_resolver::m_cache.end();)
+    {
+        if(hosts.count(it->first) == 0)
+        {
+            it = host_resolver::m_cache.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+// PROPERTIES
+uint64_t host_resolver::p_changes() const
+{
+    return host_resolver::m_changes;
+}
+
+// PUBLIC METHODS: STATIC
+address host_resolver::match_family(const address &remote, const address &local)
+{
+    if(local.is_v6() && remote.is_v4())
+    {
+        // Dual-stack IPv6 sockets reach IPv4 hosts through IPv4-mapped addresses.
+        return address_v6::v4_mapped(remote.to_v4());
+    }
+    else if(local.is_v4())
+    {
+        return host_resolver::normalize(remote);
+    }
+    else
+    {
+        return remote;
+    }
+}
+address host_resolver::normalize(const address &value)
+{
+    if(value.is_v6() && value.to_v6().is_v4_mapped())
+    {
+        return value.to_v6().to_v4();
+    }
+    else
+    {
+        return value;
+    }
+}
+
+// PRIVATE METHODS
+bool host_resolver::lookup(const std::string &host, address &result, bool prefer_v6, bool fresh_only)
+{
+    boost::mutex::scoped_lock lock(host_resolver::m_mutex_cache);
+
+    auto entry = host_resolver::m_cache.find(host);
+    if(entry == host_resolver::m_cache.end())
+    {
+        return false;
+    }
+    if(fresh_only && boost::posix_time::microsec_clock::universal_time() >= entry->second.expiry)
+    {
+        return false;
+    }
+
+    // Use the first address of the preferred family, otherwise the first address.
+    const std::vector<address>& ips = entry->second.ips;
+    result = ips.front();
+    for(auto it = ips.cbegin(); it != ips.cend(); it++)
+    {
+        if(it->is_v6() == prefer_v6)
+        {
+            result = *it;
+            break;
+        }
+    }
+
+    return true;
+}
+bool host_resolver::store(const std::string &host, udp::resolver::iterator results)
+{
+    // Collect all unique resolved addresses, in resolver order.
+    std::vector<address> ips;
+    for(; results != udp::resolver::iterator(); results++)
+    {
+        address ip = host_resolver::normalize(results->endpoint().address());
+        if(std::find(ips.begin(), ips.end(), ip) == ips.end())
+        {
+            ips.push_back(ip);
+        }
+    }
+    if(ips.empty())
+    {
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock(host_resolver::m_mutex_cache);
+
+    // Count changes to hosts that were already resolved, since their users may need to follow them.
+    // NOTE: Addresses are compared regardless of order, since round-robin DNS rotates them.
+    auto existing = host_resolver::m_cache.find(host);
+    if(existing != host_resolver::m_cache.end() &&
+       std::set<address>(existing->second.ips.begin(), existing->second.ips.end()) != std::set<address>(ips.begin(), ips.end()))
+    {
+        host_resolver::m_changes++;
+    }
+
+    cache_entry& entry = host_resolver::m_cache[host];
+    entry.ips = ips;
+    entry.expiry = boost::posix_time::microsec_clock::universal_time() + host_resolver::m_cache_ttl;
+
+    return true;
+}
+void host_resolver::async_resolve(std::string host, boost::shared_ptr<std::promise<void>> completed)
+{
+    udp::resolver::query query(host, "");
+    host_resolver::m_resolver.async_resolve(query, boost::bind(&host_resolver::resolve_callback, host_resolver::shared_from_this(), host, completed, boost::asio::placeholders::error, boost::asio::placeholders::iterator));
+}
+void host_resolver::schedule_refresh()
+{
+    host_resolver::m_timer_refresh.expires_from_now(host_resolver::m_refresh_interval);
+    host_resolver::m_timer_refresh.async_wait(boost::bind(&host_resolver::refresh_callback, host_resolver::shared_from_this(), boost::placeholders::_1));
+}
+
+// CALLBACKS
+void host_resolver::refresh_callback(const boost::system::error_code &error)
+{
+    if(error)
+    {
+        // Refresh was stopped.
+        return;
+    }
+
+    // Get list of cached hosts.
+    std::vector<std::string> hosts;
+    {
+        boost::mutex::scoped_lock lock(host_resolver::m_mutex_cache);
+        for(auto it = host_resolver::m_cache.cbegin(); it != host_resolver::m_cache.cend(); it++)
+        {
+            hosts.push_back(it->first);
+        }
+    }
+
+    // Re-resolve each host so the cache stays fresh.
+    for(uint32_t i = 0; i < hosts.size(); i++)
+    {
+        host_resolver::async_resolve(hosts.at(i), boost::shared_ptr<std::promise<void>>());
+    }
+
+    host_resolver::schedule_refresh();
+}
+void host_resolver::resolve_callback(std::string host, boost::shared_ptr<std::promise<void>> completed, const boost::system::error_code &error, udp::resolver::iterator results)
+{
+    // Store successful results.  Failed results leave any stale entry in place.
+    if(!error)
+    {
+        host_resolver::store(host, results);
+    }
+
+    // Signal any waiting caller.
+    if(completed)
+    {
+        completed->set_value();
+    }
+}
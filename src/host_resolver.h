@@ -0,0 +1,152 @@
+/// \file host_resolver.h
+/// \brief Defines the host_resolver class.
+#ifndef HOST_RESOLVER_H
+#define HOST_RESOLVER_H
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+using namespace boost::asio::ip;
+
+/// \brief Resolves hostnames asynchronously on the IO service and caches the results.
+class host_resolver
+        : public boost::enable_shared_from_this<host_resolver>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new host resolver.
+    /// \param io_service The global IO Service to resolve hosts on.
+    host_resolver(boost::asio::io_service& io_service);
+
+    // METHODS
+    /// \brief Sets the caching and timeout parameters of the resolver.
+    /// \param cache_ttl The time in seconds that a resolved address is considered fresh.
+    /// \param refresh_interval The interval in seconds at which cached hosts are re-resolved in the background.
+    /// \param timeout The maximum time in seconds that resolve() waits for a result.
+    void set_parameters(double cache_ttl, double refresh_interval, double timeout);
+    /// \brief Resolves a host using the cache, or asynchronously on the IO service.
+    /// \param host The hostname or IP address to resolve.
+    /// \param result The resolved address.
+    /// \param prefer_v6 Indicates if IPv6 results are preferred over IPv4 results.
+    /// \return TRUE if the host was resolved before the timeout, otherwise FALSE.
+    /// \details Blocks the calling thread until the resolution completes or times out.
+    /// A resolution that times out still populates the cache when it completes.
+    /// If resolution fails, a stale cached address is returned if one exists.
+    /// \note The IO service must be running in another thread.
+    bool resolve(std::string host, address& result, bool prefer_v6 = false);
+    /// \brief Resolves a host synchronously on the calling thread and caches the result.
+    /// \param host The hostname or IP address to resolve.
+    /// \param result The resolved address.
+    /// \param prefer_v6 Indicates if IPv6 results are preferred over IPv4 results.
+    /// \return TRUE if the host was resolved, otherwise FALSE.
+    /// \details Used before the IO service is running.
+    bool resolve_blocking(std::string host, address& result, bool prefer_v6 = false);
+    /// \brief Starts periodically re-resolving cached hosts in the background, unless the refresh interval is zero.
+    void start_refresh();
+    /// \brief Stops periodically re-resolving cached hosts.
+    void stop_refresh();
+    /// \brief Checks if a cached host still resolves to an address.
+    /// \param host The hostname.
+    /// \param ip The address, which may be IPv4-mapped.
+    /// \return TRUE if the address is among the host's cached addresses, otherwise FALSE.
+    /// \details Lets users keep an address that is still valid, rather than following hosts whose addresses rotate.
+    bool resolves_to(const std::string& host, const address& ip);
+    /// \brief Discards the cached hosts that are no longer used, so they are no longer re-resolved.
+    /// \param hosts The hosts that are still used.
+    void retain(const std::set<std::string>& hosts);
+
+    // PROPERTIES
+    /// \brief Gets a counter that increases whenever a resolution changes the addresses of a cached host.
+    /// \return The number of changes so far.
+    /// \details Lets users of the resolved addresses check cheaply if a background refresh has moved any host.
+    uint64_t p_changes() const;
+
+    // METHODS: STATIC
+    /// \brief Converts an address to the family of a local address.
+    /// \param remote The address to convert.
+    /// \param local The local address that the remote address will be used with.
+    /// \return An IPv4-mapped IPv6 address if the local address is IPv6 and the remote is IPv4,
+    /// an IPv4 address if the local address is IPv4 and the remote is IPv4-mapped, otherwise the remote address.
+    static address match_family(const address& remote, const address& local);
+    /// \brief Converts IPv4-mapped IPv6 addresses to their IPv4 equivalent.
+    /// \param value The address to normalize.
+    /// \return The IPv4 address if the value is IPv4-mapped, otherwise the value.
+    static address normalize(const address& value);
+
+private:
+    // STRUCTURES
+    /// \brief A cached resolution result.
+    struct cache_entry
+    {
+        /// \brief The resolved addresses.
+        std::vector<address> ips;
+        /// \brief The time at which the address is no longer fresh.
+        boost::posix_time::ptime expiry;
+    };
+
+    // VARIABLES: RESOLVER
+    /// \brief The global IO service that resolutions run on.
+    boost::asio::io_service& m_service;
+    /// \brief The asynchronous resolver.
+    udp::resolver m_resolver;
+    /// \brief The timer for periodic background re-resolution.
+    boost::asio::deadline_timer m_timer_refresh;
+
+    // VARIABLES: PARAMETERS
+    /// \brief The time that a resolved address is considered fresh.
+    boost::posix_time::time_duration m_cache_ttl;
+    /// \brief The interval at which cached hosts are re-resolved.
+    boost::posix_time::time_duration m_refresh_interval;
+    /// \brief The maximum time that resolve() waits for a result.
+    boost::posix_time::time_duration m_timeout;
+
+    // VARIABLES: CACHE
+    /// \brief The cache of resolved hosts.
+    std::map<std::string, cache_entry> m_cache;
+    /// \brief Protects the cache between the IO thread and calling threads.
+    boost::mutex m_mutex_cache;
+    /// \brief The number of times that the addresses of a cached host have changed.
+    std::atomic<uint64_t> m_changes;
+
+    // METHODS
+    /// \brief Looks up a host in the cache.
+    /// \param host The host to look up.
+    /// \param result The cached address.
+    /// \param prefer_v6 Indicates if IPv6 results are preferred over IPv4 results.
+    /// \param fresh_only Indicates if expired entries should be ignored.
+    /// \return TRUE if a matching entry was found, otherwise FALSE.
+    bool lookup(const std::string& host, address& result, bool prefer_v6, bool fresh_only);
+    /// \brief Stores resolved addresses in the cache.
+    /// \param host The host that was resolved.
+    /// \param results The resolved endpoints.
+    /// \return TRUE if any addresses were stored, otherwise FALSE.
+    bool store(const std::string& host, udp::resolver::iterator results);
+    /// \brief Initiates an asynchronous resolution of a host.
+    /// \param host The host to resolve.
+    /// \param completed The optional promise to fulfill once the resolution completes.
+    /// \note Must be called on the IO thread.
+    void async_resolve(std::string host, boost::shared_ptr<std::promise<void>> completed);
+    /// \brief Schedules the next background refresh.
+    void schedule_refresh();
+
+    // CALLBACKS
+    /// \brief The callback for handling background refresh timer events.
+    /// \param error The error passed back from the refresh timer.
+    void refresh_callback(const boost::system::error_code& error);
+    /// \brief The callback for handling completed asynchronous resolutions.
+    /// \param host The host that was resolved.
+    /// \param completed The optional promise to fulfill.
+    /// \param error The error passed back from the resolver.
+    /// \param results The resolved endpoints.
+    void resolve_callback(std::string host, boost::shared_ptr<std::promise<void>> completed, const boost::system::error_code& error, udp::resolver::iterator results);
+};
+
+#endif // HOST_RESOLVER_H
@@ -0,0 +1,135 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Each power of two range is split into 2^LATENCY_SUB_BITS linear sub-buckets.
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_COUNT (1u << LATENCY_SUB_BITS)
+
+namespace
+{
+    /// \brief The time at which each thread last received data from a socket.
+    thread_local uint64_t rx_mark_time = 0;
+}
+
+// CONSTRUCTORS
+latency_histogram::latency_histogram()
+    // Initialize counters.
+    : m_count(0),
+      m_max(0),
+      m_sum(0)
+{
+    for(uint32_t i = 0; i < latency_histogram::m_bucket_count; i++)
+    {
+        latency_histogram::m_buckets[i] = 0;
+    }
+}
+latency_histogram::snapshot::snapshot()
+    : count(0),
+      max(0),
+      sum(0)
+{
+
+}
+
+// PUBLIC METHODS
+void latency_histogram::record(uint64_t nanoseconds)
+{
+    latency_histogram::m_buckets[latency_histogram::bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    latency_histogram::m_count.fetch_add(1, std::memory_order_relaxed);
+    latency_histogram::m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t max = latency_histogram::m_max.load(std::memory_order_relaxed);
+    while(nanoseconds > max && !latency_histogram::m_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+void latency_histogram::record_since(uint64_t start)
+{
+    uint64_t end = latency_histogram::now();
+    latency_histogram::record(end > start ? end - start : 0);
+}
+latency_histogram::snapshot latency_histogram::sample(bool reset)
+{
+    latency_histogram::snapshot output;
+    output.buckets.resize(latency_histogram::m_bucket_count);
+
+    // NOTE: Latencies recorded while sampling are counted in either this interval or the next.
+    for(uint32_t i = 0; i < latency_histogram::m_bucket_count; i++)
+    {
+        output.buckets[i] = reset ? latency_histogram::m_buckets[i].exchange(0, std::memory_order_relaxed) : latency_histogram::m_buckets[i].load(std::memory_order_relaxed);
+        output.count += output.buckets[i];
+    }
+    output.max = reset ? latency_histogram::m_max.exchange(0, std::memory_order_relaxed) : latency_histogram::m_max.load(std::memory_order_relaxed);
+    output.sum = reset ? latency_histogram::m_sum.exchange(0, std::memory_order_relaxed) : latency_histogram::m_sum.load(std::memory_order_relaxed);
+    if(reset)
+    {
+        latency_histogram::m_count.store(0, std::memory_order_relaxed);
+    }
+
+    return output;
+}
+uint64_t latency_histogram::snapshot::percentile(double percentile) const
+{
+    if(latency_histogram::snapshot::count == 0)
+    {
+        return 0;
+    }
+
+    // Find the bucket holding the requested rank.
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(latency_histogram::snapshot::count) + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, latency_histogram::snapshot::count));
+    uint64_t seen = 0;
+    for(uint32_t i = 0; i < latency_histogram::snapshot::buckets.size(); i++)
+    {
+        seen += latency_histogram::snapshot::buckets[i];
+        if(seen >= rank)
+        {
+            // Never report more than the true maximum.
+            return std::min(latency_histogram::bucket_value(i), latency_histogram::snapshot::max);
+        }
+    }
+
+    return latency_histogram::snapshot::max;
+}
+double latency_histogram::snapshot::mean() const
+{
+    return (latency_histogram::snapshot::count == 0) ? 0.0 : static_cast<double>(latency_histogram::snapshot::sum) / static_cast<double>(latency_histogram::snapshot::count);
+}
+
+// STATIC METHODS
+uint64_t latency_histogram::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+void latency_histogram::mark_rx()
+{
+    rx_mark_time = latency_histogram::now();
+}
+uint64_t latency_histogram::rx_mark()
+{
+    return rx_mark_time;
+}
+
+// PRIVATE METHODS
+uint32_t latency_histogram::bucket(uint64_t nanoseconds)
+{
+    // Values below 2 * LATENCY_SUB_COUNT are counted exactly.  Above that, drop the low bits that are finer than
+    // the precision of the value's power of two range.
+    uint32_t shift = 0;
+    if(nanoseconds >= 2 * LATENCY_SUB_COUNT)
+    {
+        shift = static_cast<uint32_t>(63 - __builtin_clzll(nanoseconds)) - LATENCY_SUB_BITS;
+    }
+    uint64_t index = static_cast<uint64_t>(shift) * LATENCY_SUB_COUNT + (nanoseconds >> shift);
+
+    return static_cast<uint32_t>(std::min<uint64_t>(index, latency_histogram::m_bucket_count - 1));
+}
+uint64_t latency_histogram::bucket_value(uint32_t index)
+{
+    uint32_t shift = (index < 2 * LATENCY_SUB_COUNT) ? 0 : index / LATENCY_SUB_COUNT - 1;
+    uint64_t lowest = static_cast<uint64_t>(index - shift * LATENCY_SUB_COUNT) << shift;
+
+    return lowest + ((1ull << shift) - 1);
+}
@@ -0,0 +1,94 @@
+/// \file latency_histogram.h
+/// \brief Defines the latency_histogram class.
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// \brief Records the distribution of latencies with a fixed amount of memory.
+/// \details Latencies are counted in log-linear buckets in the style of an HDR histogram: each power of two range
+/// of nanoseconds is split into 32 linear sub-buckets, so any value is reported within about 3% of its true value
+/// from 1 ns up to about 68 s.  Recording is lock-free and may happen from any number of threads, while reading
+/// takes a snapshot that can optionally restart the histogram for the next interval.
+class latency_histogram
+{
+public:
+    // STRUCTURES
+    /// \brief A point in time copy of the histogram.
+    struct snapshot
+    {
+        /// \brief Creates a new empty snapshot.
+        snapshot();
+        /// \brief The number of recorded latencies.
+        uint64_t count;
+        /// \brief The largest recorded latency in nanoseconds.
+        uint64_t max;
+        /// \brief The sum of recorded latencies in nanoseconds.
+        uint64_t sum;
+        /// \brief The number of latencies in each bucket.
+        std::vector<uint64_t> buckets;
+        /// \brief Gets the latency at a percentile.
+        /// \param percentile The percentile (0-100).
+        /// \return The latency in nanoseconds, or zero if nothing was recorded.
+        uint64_t percentile(double percentile) const;
+        /// \brief Gets the mean latency.
+        /// \return The mean latency in nanoseconds, or zero if nothing was recorded.
+        double mean() const;
+    };
+
+    // CONSTRUCTORS
+    /// \brief Creates a new empty histogram.
+    latency_histogram();
+
+    // METHODS
+    /// \brief Records a latency.
+    /// \param nanoseconds The latency in nanoseconds.
+    void record(uint64_t nanoseconds);
+    /// \brief Records the latency from a start time until now.
+    /// \param start The start time, from now().
+    void record_since(uint64_t start);
+    /// \brief Takes a snapshot of the histogram.
+    /// \param reset Indicates if the histogram is emptied, so the next snapshot only covers the next interval.
+    /// \return The snapshot.
+    snapshot sample(bool reset);
+
+    // METHODS: STATIC
+    /// \brief Gets the current time of the clock that latencies are measured with.
+    /// \return The monotonic time in nanoseconds.
+    static uint64_t now();
+    /// \brief Marks the time at which the calling thread received data from a socket.
+    /// \details Receive latency is measured from the last mark of the thread that delivers the message.
+    static void mark_rx();
+    /// \brief Gets the time at which the calling thread last received data from a socket.
+    /// \return The time from now(), or zero if the thread never received.
+    static uint64_t rx_mark();
+
+private:
+    // CONSTANTS
+    /// \brief The number of buckets, which covers latencies up to 2^36 ns.
+    static const uint32_t m_bucket_count = 1024;
+
+    // VARIABLES
+    /// \brief The number of latencies in each bucket.
+    std::atomic<uint64_t> m_buckets[m_bucket_count];
+    /// \brief The number of recorded latencies.
+    std::atomic<uint64_t> m_count;
+    /// \brief The largest recorded latency.
+    std::atomic<uint64_t> m_max;
+    /// \brief The sum of recorded latencies.
+    std::atomic<uint64_t> m_sum;
+
+    // METHODS: STATIC
+    /// \brief Gets the bucket that a latency is counted in.
+    /// \param nanoseconds The latency in nanoseconds.
+    /// \return The index of the bucket.
+    static uint32_t bucket(uint64_t nanoseconds);
+    /// \brief Gets the highest latency counted in a bucket.
+    /// \param index The index of the bucket.
+    /// \return The latency in nanoseconds.
+    static uint64_t bucket_value(uint32_t index);
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -24,6 +24,7 @@ modem_interface::modem_interface(std::string modem_name)
     modem_interface::m_service_get_remote_host = modem_interface::m_node->serviceClient<driver_modem_msgs::get_remote_host>("get_remote_host");
     modem_interface::m_service_add_tcp_connection = modem_interface::m_node->serviceClient<driver_modem_msgs::add_tcp_connection>("add_tcp_connection");
     modem_interface::m_service_add_udp_connection = modem_interface::m_node->serviceClient<driver_modem_msgs::add_udp_connection>("add_udp_connection");
+    modem_interface::m_service_add_unix_connection = modem_interface::m_node->serviceClient<driver_modem_msgs::add_udp_connection>("add_unix_connection");
     modem_interface::m_service_remove_connection = modem_interface::m_node->serviceClient<driver_modem_msgs::remove_connection>("remove_connection");
 }
 modem_interface::~modem_interface()
@@ -36,6 +37,7 @@ modem_interface::~modem_interface()
     modem_interface::m_service_get_remote_host.shutdown();
     modem_interface::m_service_add_tcp_connection.shutdown();
     modem_interface::m_service_add_udp_connection.shutdown();
+    modem_interface::m_service_add_unix_connection.shutdown();
     modem_interface::m_service_remove_connection.shutdown();
 
     // Shut down transmission publishers, subscribers, and service clients.
@@ -55,6 +57,14 @@ modem_interface::~modem_interface()
     {
         it->second.shutdown();
     }
+    for(auto it = modem_interface::m_publishers_unix.begin(); it != modem_interface::m_publishers_unix.end(); it++)
+    {
+        it->second.shutdown();
+    }
+    for(auto it = modem_interface::m_subscribers_unix_rx.begin(); it != modem_interface::m_subscribers_unix_rx.end(); it++)
+    {
+        it->second.shutdown();
+    }
 
     // Delete the nodehandle pointer.
     delete modem_interface::m_node;
@@ -77,6 +87,14 @@ void modem_interface::detach_callback_udp_rx()
 {
     modem_interface::m_callback_udp_rx = nullptr;
 }
+void modem_interface::attach_callback_unix_rx(std::function<void (uint16_t, const driver_modem_msgs::data_packetConstPtr &)> callback)
+{
+    modem_interface::m_callback_unix_rx = callback;
+}
+void modem_interface::detach_callback_unix_rx()
+{
+    modem_interface::m_callback_unix_rx = nullptr;
+}
 
 // METHODS: Connection Management
 bool modem_interface::set_remote_host(std::string remote_host)
@@ -130,14 +148,56 @@ bool modem_interface::add_tcp_connection(tcp_role role, uint16_t port)
 }
 bool modem_interface::add_udp_connection(uint16_t port)
 {
+    // Drop any multicast settings left over from an earlier multicast connection on this port.
+    modem_interface::clear_multicast_params(port);
+
+    return modem_interface::request_udp_connection(port);
+}
+bool modem_interface::add_udp_connection(uint16_t port, std::string multicast_group, std::string multicast_interface, uint32_t multicast_ttl, bool multicast_loopback)
+{
+    // Store the multicast settings in the modem's per-port parameters, which are read when the connection is added.
+    std::stringstream prefix;
+    prefix << "udp/" << port << "/";
+    modem_interface::m_node->setParam(prefix.str() + "multicast_group", multicast_group);
+    modem_interface::m_node->setParam(prefix.str() + "multicast_interface", multicast_interface);
+    modem_interface::m_node->setParam(prefix.str() + "multicast_ttl", static_cast<int>(multicast_ttl));
+    modem_interface::m_node->setParam(prefix.str() + "multicast_loopback", multicast_loopback);
+    modem_interface::m_multicast_ports.insert(port);
+
+    return modem_interface::request_udp_connection(port);
+}
+bool modem_interface::add_unix_connection(uint16_t port, std::string mode, std::string path, std::string remote_path)
+{
+    // Store the settings in the modem's per-port parameters, which are read when the connection is added.
+    std::stringstream prefix;
+    prefix << "unix/" << port << "/";
+    modem_interface::m_node->setParam(prefix.str() + "mode", mode);
+    if(path.empty())
+    {
+        modem_interface::m_node->deleteParam(prefix.str() + "path");
+    }
+    else
+    {
+        modem_interface::m_node->setParam(prefix.str() + "path", path);
+    }
+    modem_interface::m_node->setParam(prefix.str() + "remote_path", remote_path);
+
     // Build request.
     driver_modem_msgs::add_udp_connection service;
     service.request.port = port;
 
     // Call service.
-    if(modem_interface::m_service_add_udp_connection.call(service))
+    if(modem_interface::m_service_add_unix_connection.call(service) && service.response.success)
     {
-        return service.response.success;
+        // Set up the connection's topics, since UNIX connections are not reported in active_connections.
+        if(modem_interface::m_publishers_unix.count(port) == 0)
+        {
+            std::stringstream topic_front;
+            topic_front << "unix/" << port;
+            modem_interface::m_publishers_unix.insert(std::make_pair(port, modem_interface::m_node->advertise<driver_modem_msgs::data_packet>(topic_front.str() + "/tx", 1)));
+            modem_interface::m_subscribers_unix_rx.insert(std::make_pair(port, modem_interface::m_node->subscribe<driver_modem_msgs::data_packet>(topic_front.str() + "/rx", 1, std::bind(&modem_interface::callback_unix_rx, this, std::placeholders::_1, port))));
+        }
+        return true;
     }
     else
     {
@@ -154,6 +214,14 @@ bool modem_interface::remove_connection(protocol type, uint16_t port)
     // Call service.
     if(modem_interface::m_service_remove_connection.call(service))
     {
+        if(type == protocol::UNIX && service.response.success)
+        {
+            modem_interface::remove_unix_topics(port);
+        }
+        else if(type == protocol::UDP && service.response.success)
+        {
+            modem_interface::clear_multicast_params(port);
+        }
         return service.response.success;
     }
     else
@@ -169,6 +237,17 @@ bool modem_interface::remove_all_connections()
     // Call service.
     if(modem_interface::m_service_remove_connection.call(service))
     {
+        if(service.response.success)
+        {
+            while(!modem_interface::m_publishers_unix.empty())
+            {
+                modem_interface::remove_unix_topics(modem_interface::m_publishers_unix.begin()->first);
+            }
+            while(!modem_interface::m_multicast_ports.empty())
+            {
+                modem_interface::clear_multicast_params(*modem_interface::m_multicast_ports.begin());
+            }
+        }
         return service.response.success;
     }
     else
@@ -232,6 +311,26 @@ bool modem_interface::send_udp(uint16_t port, const uint8_t *data, uint32_t leng
     }
 }
 
+bool modem_interface::send_unix(uint16_t port, const uint8_t *data, uint32_t length)
+{
+    // Check if connection exists.
+    if(modem_interface::m_publishers_unix.count(port) != 0)
+    {
+        // Create message.
+        driver_modem_msgs::data_packet message;
+        message.data.assign(data, data + length);
+
+        // Send message.
+        modem_interface::m_publishers_unix.at(port).publish(message);
+
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
 // METHODS: Connection Checking
 bool modem_interface::wait_for_modem(ros::Duration timeout)
 {
@@ -264,6 +363,10 @@ bool modem_interface::is_connected(protocol type, uint16_t port) const
         }
         return false;
     }
+    case protocol::UNIX:
+    {
+        return modem_interface::m_publishers_unix.count(port) != 0;
+    }
     }
 
 }
@@ -334,6 +437,44 @@ void modem_interface::remove_duplicates(std::list<uint16_t> &a, std::list<uint16
         }
     }
 }
+void modem_interface::remove_unix_topics(uint16_t port)
+{
+    if(modem_interface::m_publishers_unix.count(port) != 0)
+    {
+        modem_interface::m_publishers_unix.at(port).shutdown();
+        modem_interface::m_publishers_unix.erase(port);
+        modem_interface::m_subscribers_unix_rx.at(port).shutdown();
+        modem_interface::m_subscribers_unix_rx.erase(port);
+    }
+}
+bool modem_interface::request_udp_connection(uint16_t port)
+{
+    // Build request.
+    driver_modem_msgs::add_udp_connection service;
+    service.request.port = port;
+
+    // Call service.
+    if(modem_interface::m_service_add_udp_connection.call(service))
+    {
+        return service.response.success;
+    }
+    else
+    {
+        return false;
+    }
+}
+void modem_interface::clear_multicast_params(uint16_t port)
+{
+    if(modem_interface::m_multicast_ports.erase(port) != 0)
+    {
+        std::stringstream prefix;
+        prefix << "udp/" << port << "/";
+        modem_interface::m_node->deleteParam(prefix.str() + "multicast_group");
+        modem_interface::m_node->deleteParam(prefix.str() + "multicast_interface");
+        modem_interface::m_node->deleteParam(prefix.str() + "multicast_ttl");
+        modem_interface::m_node->deleteParam(prefix.str() + "multicast_loopback");
+    }
+}
 
 // PROPERTIES
 std::vector<uint16_t> modem_interface::p_active_tcp_connections() const
@@ -348,6 +489,15 @@ std::vector<uint16_t> modem_interface::p_active_udp_connections() const
 {
     return modem_interface::m_active_udp_connections;
 }
+std::vector<uint16_t> modem_interface::p_active_unix_connections() const
+{
+    std::vector<uint16_t> output;
+    for(auto it = modem_interface::m_publishers_unix.begin(); it != modem_interface::m_publishers_unix.end(); it++)
+    {
+        output.push_back(it->first);
+    }
+    return output;
+}
 
 // CALLBACKS: Subscribers
 void modem_interface::callback_active_connections(const driver_modem_msgs::active_connectionsPtr &message)
@@ -420,3 +570,11 @@ void modem_interface::callback_udp_rx(const driver_modem_msgs::data_packetConstP
     // Forward to external callback.
     modem_interface::m_callback_udp_rx(port, message);
 }
+void modem_interface::callback_unix_rx(const driver_modem_msgs::data_packetConstPtr &message, uint16_t port)
+{
+    // Forward to external callback.
+    if(modem_interface::m_callback_unix_rx)
+    {
+        modem_interface::m_callback_unix_rx(port, message);
+    }
+}
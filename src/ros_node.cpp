@@ -1,21 +1,51 @@
 #include "ros_node.h"
 
+#include <ros/callback_queue.h>
 #include <driver_modem_msgs/active_connections.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <algorithm>
+#include <iomanip>
+
+// STATIC VARIABLES
+volatile std::sig_atomic_t ros_node::m_shutdown_requested = 0;
 
 // CONSTRUCTORS
 ros_node::ros_node(int argc, char **argv)
 {
     // Initialize the ROS node.
-    ros::init(argc, argv, "driver_modem");
+    // NOTE: SIGINT is handled by the node so that connections can be drained before ROS shuts down.
+    ros::init(argc, argv, "driver_modem", ros::init_options::NoSigintHandler);
+    std::signal(SIGINT, &ros_node::signal_shutdown);
+    // NOTE: OpenSSL writes TLS records with write(), which raises SIGPIPE instead of an error on a broken connection.
+    std::signal(SIGPIPE, SIG_IGN);
+    TRACE_THREAD("ros");
 
     // Get the node's handle.
     ros_node::m_node = new ros::NodeHandle("~");
 
+    // Set up the diagnostics updater, which publishes the health of each connection on /diagnostics.
+    ros_node::m_updater = new diagnostic_updater::Updater();
+    ros_node::m_updater->setHardwareID("modem");
+
     // Read standard parameters.
     std::string param_local_ip;
     ros_node::m_node->param<std::string>("local_ip", param_local_ip, "192.168.1.2");
     std::string param_remote_host;
     ros_node::m_node->param<std::string>("remote_host", param_remote_host, "192.168.1.3");
+    ros_node::m_node->param<bool>("migrate_remote_host", ros_node::m_migrate_remote_host, false);
+    ros_node::m_migrating = false;
+
+    // Read host resolution parameters.
+    double param_dns_cache_ttl, param_dns_refresh_interval, param_dns_timeout;
+    ros_node::m_node->param<double>("dns_cache_ttl", param_dns_cache_ttl, 60.0);
+    ros_node::m_node->param<double>("dns_refresh_interval", param_dns_refresh_interval, 30.0);
+    ros_node::m_node->param<double>("dns_timeout", param_dns_timeout, 2.0);
+
+    // Read drain parameters.
+    double param_drain_timeout;
+    ros_node::m_node->param<double>("drain_timeout", param_drain_timeout, 0.0);
 
     // Read connect port parameters.
     std::vector<int> param_tcp_server_ports;
@@ -24,6 +54,8 @@ ros_node::ros_node(int argc, char **argv)
     ros_node::m_node->getParam("tcp_client_ports", param_tcp_client_ports);
     std::vector<int> param_udp_ports;
     ros_node::m_node->getParam("udp_ports", param_udp_ports);
+    std::vector<int> param_unix_ports;
+    ros_node::m_node->getParam("unix_ports", param_unix_ports);
 
     // Initialize driver.
     try
@@ -32,14 +64,24 @@ ros_node::ros_node(int argc, char **argv)
                                         param_remote_host,
                                         std::bind(&ros_node::callback_rx, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5),
                                         std::bind(&ros_node::callback_tcp_connected, this, std::placeholders::_1),
+                                        std::bind(&ros_node::callback_tcp_pending, this, std::placeholders::_1),
                                         std::bind(&ros_node::callback_tcp_disconnected, this, std::placeholders::_1));
     }
     catch (std::exception& e)
     {
         ROS_FATAL_STREAM(e.what());
+        delete ros_node::m_updater;
         delete ros_node::m_node;
         exit(1);
     }
+    ros_node::m_driver->set_resolver_parameters(param_dns_cache_ttl, param_dns_refresh_interval, param_dns_timeout);
+    ros_node::m_driver->set_drain_timeout(param_drain_timeout);
+
+    // Move connections to the new addresses of remote hostnames as they are re-resolved in the background.
+    if(param_dns_refresh_interval > 0.0)
+    {
+        ros_node::m_timer_remote_hosts = ros_node::m_node->createTimer(ros::Duration(param_dns_refresh_interval), &ros_node::callback_remote_hosts, this);
+    }
 
 
     // Set up active connections publisher.
@@ -47,6 +89,16 @@ ros_node::ros_node(int argc, char **argv)
     // Use latching so new nodes always have the latest information.
     ros_node::m_publisher_active_connections = ros_node::m_node->advertise<driver_modem_msgs::active_connections>("active_connections", 1, true);
 
+    // Set up the traffic statistics publisher.
+    // This will publish the counters of every connection at a fixed rate, unless the rate is zero.
+    double param_stats_rate;
+    ros_node::m_node->param<double>("stats_rate", param_stats_rate, 1.0);
+    if(param_stats_rate > 0.0)
+    {
+        ros_node::m_publisher_stats = ros_node::m_node->advertise<diagnostic_msgs::DiagnosticArray>("stats", 1);
+        ros_node::m_timer_stats = ros_node::m_node->createTimer(ros::Duration(1.0 / param_stats_rate), &ros_node::callback_stats, this);
+    }
+
     // Set up service for setting/getting remote host.
     ros_node::m_service_set_remote_host = ros_node::m_node->advertiseService("set_remote_host", &ros_node::service_set_remote_host, this);
     ros_node::m_service_get_remote_host = ros_node::m_node->advertiseService("get_remote_host", &ros_node::service_get_remote_host, this);
@@ -54,9 +106,15 @@ ros_node::ros_node(int argc, char **argv)
     // Set up services for adding/removing connections.
     ros_node::m_service_add_tcp_connection = ros_node::m_node->advertiseService("add_tcp_connection", &ros_node::service_add_tcp_connection, this);
     ros_node::m_service_add_udp_connection = ros_node::m_node->advertiseService("add_udp_connection", &ros_node::service_add_udp_connection, this);
+    ros_node::m_service_add_unix_connection = ros_node::m_node->advertiseService("add_unix_connection", &ros_node::service_add_unix_connection, this);
     ros_node::m_service_remove_connection = ros_node::m_node->advertiseService("remove_connection", &ros_node::service_remove_connection, this);
     ros_node::m_service_remove_all_connections = ros_node::m_node->advertiseService("remove_all_connections", &ros_node::service_remove_all_connections, this);
 
+    // Set up services for dumping captured messages and trace events.
+    ros_node::m_node->param<std::string>("capture_directory", ros_node::m_capture_directory, "/tmp");
+    ros_node::m_service_dump_capture = ros_node::m_node->advertiseService("dump_capture", &ros_node::service_dump_capture, this);
+    ros_node::m_service_dump_trace = ros_node::m_node->advertiseService("dump_trace", &ros_node::service_dump_trace, this);
+
     // Set up tx/rx publishers, subscribers, and services.
 
     // TCP Servers:
@@ -89,6 +147,16 @@ ros_node::ros_node(int argc, char **argv)
         ros_node::add_udp_connection(port, false);
     }
 
+    // UNIX:
+    for(uint32_t i = 0; i < param_unix_ports.size(); i++)
+    {
+        // Get port from vector.
+        uint16_t port = static_cast<uint16_t>(param_unix_ports.at(i));
+
+        // Add connection to node.
+        ros_node::add_unix_connection(port, false);
+    }
+
     // Manually publish connections after group add.
     ros_node::publish_active_connections();
 
@@ -97,6 +165,7 @@ ros_node::ros_node(int argc, char **argv)
 ros_node::~ros_node()
 {
     // Clean up resources.
+    delete ros_node::m_updater;
     delete ros_node::m_node;
     delete ros_node::m_driver;
 }
@@ -107,25 +176,53 @@ void ros_node::spin()
     // Start the driver thread.
     ros_node::m_driver->start();
 
-    // Spin ROS node.
-    ros::spin();
+    // Spin ROS node until shutdown is requested.
+    while(ros::ok() && !ros_node::m_shutdown_requested)
+    {
+        ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.1));
+
+        // Publish diagnostics, which the updater limits to its own period.
+        ros_node::m_updater->update();
+    }
+
+    // Deliver tx messages that have already been received, then stop accepting new ones.
+    ros::getGlobalCallbackQueue()->callAvailable();
+    ros_node::remove_connection_topics();
 
-    // Stop the driver thread.
+    // Stop the driver thread, draining connections.
     ros_node::m_driver->stop();
+
+    ros::shutdown();
 }
 
 // PRIVATE METHODS: CONNECTION MANAGEMENT
 bool ros_node::set_remote_host(std::string remote_host)
 {
-    if(ros_node::m_driver->set_remote_host(remote_host))
+    // Flag the migration so TCP clients reconnecting to the new host keep their topics.
+    ros_node::m_migrating = ros_node::m_migrate_remote_host;
+    bool set = ros_node::m_driver->set_remote_host(remote_host, ros_node::m_migrate_remote_host);
+    ros_node::m_migrating = false;
+
+    if(set)
     {
-        // Remove all connection topics.
-        ros_node::remove_connection_topics();
+        if(ros_node::m_migrate_remote_host)
+        {
+            // Publish active connections, since TCP clients are now reconnecting.
+            ros_node::publish_active_connections();
 
-        // Publish active connections.
-        ros_node::publish_active_connections();
+            ROS_INFO_STREAM("Remote host set to " << remote_host << " and all connections migrated");
+        }
+        else
+        {
+            // Remove all network connection topics.
+            ros_node::remove_connection_topics(protocol::TCP);
+            ros_node::remove_connection_topics(protocol::UDP);
 
-        ROS_INFO_STREAM("Remote host set to " << remote_host << " and all connections closed");
+            // Publish active connections.
+            ros_node::publish_active_connections();
+
+            ROS_INFO_STREAM("Remote host set to " << remote_host << " and all connections closed");
+        }
 
         return true;
     }
@@ -138,7 +235,7 @@ bool ros_node::set_remote_host(std::string remote_host)
 }
 bool ros_node::add_tcp_connection(tcp_role role, uint16_t port, bool publish_connections)
 {
-    if(ros_node::m_driver->add_tcp_connection(role, port))
+    if(ros_node::m_driver->add_tcp_connection(role, port, ros_node::read_connection_options(protocol::TCP, port)))
     {
         if(publish_connections)
         {
@@ -160,7 +257,7 @@ bool ros_node::add_tcp_connection(tcp_role role, uint16_t port, bool publish_con
 }
 bool ros_node::add_udp_connection(uint16_t port, bool publish_connections)
 {
-    if(ros_node::m_driver->add_udp_connection(port))
+    if(ros_node::m_driver->add_udp_connection(port, ros_node::read_connection_options(protocol::UDP, port)))
     {
         // Add UDP topic.
         ros_node::add_connection_topics(protocol::UDP, port);
@@ -181,6 +278,29 @@ bool ros_node::add_udp_connection(uint16_t port, bool publish_connections)
         return false;
     }
 }
+bool ros_node::add_unix_connection(uint16_t port, bool publish_connections)
+{
+    if(ros_node::m_driver->add_unix_connection(port, ros_node::read_connection_options(protocol::UNIX, port)))
+    {
+        // Add UNIX topic.
+        ros_node::add_connection_topics(protocol::UNIX, port);
+
+        if(publish_connections)
+        {
+            // Publish active connections.
+            ros_node::publish_active_connections();
+        }
+
+        ROS_INFO_STREAM("Connection added on UNIX:" << port);
+
+        return true;
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Could not add connection on UNIX:" << port);
+        return false;
+    }
+}
 bool ros_node::remove_connection(protocol type, uint16_t port, bool publish_connections)
 {
     // Instruct driver to remove connection.
@@ -245,6 +365,9 @@ void ros_node::add_connection_topics(protocol type, uint16_t port)
         // Add new tx service server to the map.
         ros_node::m_tcp_tx.insert(std::make_pair(port, ros_node::m_node->advertiseService<driver_modem_msgs::send_tcpRequest, driver_modem_msgs::send_tcpResponse>(tx_topic.str(), std::bind(&ros_node::service_tcp_tx, this, std::placeholders::_1, std::placeholders::_2, port))));
 
+        // Diagnostics:
+        ros_node::add_diagnostics(type, port);
+
         break;
     }
     case protocol::UDP:
@@ -263,12 +386,39 @@ void ros_node::add_connection_topics(protocol type, uint16_t port)
         // Add new tx subscriber to the map.
         ros_node::m_udp_tx.insert(std::make_pair(port, ros_node::m_node->subscribe<driver_modem_msgs::data_packet>(tx_topic.str(), 1, std::bind(&ros_node::callback_udp_tx, this, std::placeholders::_1, port))));
 
+        // Diagnostics:
+        ros_node::add_diagnostics(type, port);
+
+        break;
+    }
+    case protocol::UNIX:
+    {
+        // RX Publisher:
+        // Generate topic name.
+        std::stringstream rx_topic;
+        rx_topic << "unix/" << port << "/rx";
+        // Add new rx publisher to the map.
+        ros_node::m_unix_rx.insert(std::make_pair(port, ros_node::m_node->advertise<driver_modem_msgs::data_packet>(rx_topic.str(), 1)));
+
+        // TX Subscriber:
+        // Generate topic name.
+        std::stringstream tx_topic;
+        tx_topic << "unix/" << port << "/tx";
+        // Add new tx subscriber to the map.
+        ros_node::m_unix_tx.insert(std::make_pair(port, ros_node::m_node->subscribe<driver_modem_msgs::data_packet>(tx_topic.str(), 1, std::bind(&ros_node::callback_unix_tx, this, std::placeholders::_1, port))));
+
+        // Diagnostics:
+        ros_node::add_diagnostics(type, port);
+
         break;
     }
     }
 }
 void ros_node::remove_connection_topics(protocol type, uint16_t port)
 {
+    // Stop reporting the health of the connection.
+    ros_node::remove_diagnostics(type, port);
+
     // Remove publishers/subscribers/callbacks of the connection.
     switch(type)
     {
@@ -312,31 +462,96 @@ void ros_node::remove_connection_topics(protocol type, uint16_t port)
         }
         break;
     }
+    case protocol::UNIX:
+    {
+        // Remove RX publisher
+        if(ros_node::m_unix_rx.count(port) > 0)
+        {
+            // Cancel topic.
+            ros_node::m_unix_rx.at(port).shutdown();
+            // Remove from map.
+            ros_node::m_unix_rx.erase(port);
+        }
+        // Remove TX subscriber
+        if(ros_node::m_unix_tx.count(port) > 0)
+        {
+            // Cancel subscriber.
+            ros_node::m_unix_tx.at(port).shutdown();
+            // Remove from map.
+            ros_node::m_unix_tx.erase(port);
+        }
+        break;
+    }
     }
 }
-void ros_node::remove_connection_topics()
+void ros_node::remove_connection_topics(protocol type)
 {
-    // Remove all TCP and UDP topics.
-    for(auto it = ros_node::m_tcp_rx.begin(); it != ros_node::m_tcp_rx.end(); it++)
+    // Remove the topics of each port of the protocol.
+    std::vector<uint16_t> ports;
+    std::map<uint16_t, ros::Publisher>& rx = (type == protocol::TCP) ? ros_node::m_tcp_rx : (type == protocol::UDP) ? ros_node::m_udp_rx : ros_node::m_unix_rx;
+    for(auto it = rx.begin(); it != rx.end(); it++)
     {
-        it->second.shutdown();
+        ports.push_back(it->first);
     }
-    ros_node::m_tcp_rx.clear();
-    for(auto it = ros_node::m_tcp_tx.begin(); it != ros_node::m_tcp_tx.end(); it++)
+    for(uint32_t i = 0; i < ports.size(); i++)
     {
-        it->second.shutdown();
+        ros_node::remove_connection_topics(type, ports.at(i));
     }
-    ros_node::m_tcp_tx.clear();
-    for(auto it = ros_node::m_udp_rx.begin(); it != ros_node::m_udp_rx.end(); it++)
+}
+void ros_node::remove_connection_topics()
+{
+    // Remove all TCP, UDP, and UNIX topics.
+    ros_node::remove_connection_topics(protocol::TCP);
+    ros_node::remove_connection_topics(protocol::UDP);
+    ros_node::remove_connection_topics(protocol::UNIX);
+}
+
+// PRIVATE METHODS: DIAGNOSTICS
+std::string ros_node::diagnostics_name(protocol type, uint16_t port)
+{
+    std::stringstream name;
+    name << driver::protocol_string(type) << ":" << port;
+    return name.str();
+}
+void ros_node::add_diagnostics(protocol type, uint16_t port)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+
+    // Read the thresholds of the port.  Zero disables a threshold.
+    port_diagnostics diagnostics;
+    diagnostics.min_rx_rate_warn = ros_node::port_param<double>(type, port, "diagnostics_min_rx_rate_warn", 0.0);
+    diagnostics.min_rx_rate_error = ros_node::port_param<double>(type, port, "diagnostics_min_rx_rate_error", 0.0);
+    diagnostics.max_queue_warn = ros_node::port_param<double>(type, port, "diagnostics_max_queue_warn", 0.0);
+    diagnostics.max_queue_error = ros_node::port_param<double>(type, port, "diagnostics_max_queue_error", 0.0);
+    diagnostics.max_error_rate_warn = ros_node::port_param<double>(type, port, "diagnostics_max_error_rate_warn", 0.0);
+    diagnostics.max_error_rate_error = ros_node::port_param<double>(type, port, "diagnostics_max_error_rate_error", 0.0);
+    diagnostics.has_previous = false;
     {
-        it->second.shutdown();
+        boost::mutex::scoped_lock lock(ros_node::m_mutex_diagnostics);
+        if(!ros_node::m_diagnostics.insert(std::make_pair(key, diagnostics)).second)
+        {
+            return;
+        }
     }
-    ros_node::m_udp_rx.clear();
-    for(auto it = ros_node::m_udp_tx.begin(); it != ros_node::m_udp_tx.end(); it++)
+
+    // Register the task outside of the lock, since the updater holds its own lock while raising callback_diagnostics.
+    ros_node::m_updater->add(ros_node::diagnostics_name(type, port), std::bind(&ros_node::callback_diagnostics, this, std::placeholders::_1, type, port));
+}
+void ros_node::remove_diagnostics(protocol type, uint16_t port)
+{
+    std::pair<protocol, uint16_t> key(type, port);
     {
-        it->second.shutdown();
+        boost::mutex::scoped_lock lock(ros_node::m_mutex_diagnostics);
+        if(ros_node::m_diagnostics.count(key) == 0)
+        {
+            return;
+        }
     }
-    ros_node::m_udp_tx.clear();
+
+    // Remove the task before its entry, so that an update in progress still finds the entry.
+    ros_node::m_updater->removeByName(ros_node::diagnostics_name(type, port));
+    boost::mutex::scoped_lock lock(ros_node::m_mutex_diagnostics);
+    ros_node::m_diagnostics.erase(key);
 }
 
 // PRIVATE METHODS: MISC
@@ -369,6 +584,234 @@ void ros_node::publish_active_connections()
     // Publish the message.
     ros_node::m_publisher_active_connections.publish(message);
 }
+void ros_node::publish_stats()
+{
+    // Create output message.
+    diagnostic_msgs::DiagnosticArray message;
+    message.header.stamp = ros::Time::now();
+
+    // Gather every open port.
+    std::vector<std::pair<protocol, uint16_t>> ports;
+    std::vector<uint16_t> pending_tcp = ros_node::m_driver->p_pending_tcp_connections();
+    std::vector<uint16_t> active_tcp = ros_node::m_driver->p_active_tcp_connections();
+    std::vector<uint16_t> active_udp = ros_node::m_driver->p_active_udp_connections();
+    std::vector<uint16_t> active_unix = ros_node::m_driver->p_active_unix_connections();
+    for(uint32_t i = 0; i < pending_tcp.size(); i++)
+    {
+        ports.push_back(std::make_pair(protocol::TCP, pending_tcp.at(i)));
+    }
+    for(uint32_t i = 0; i < active_tcp.size(); i++)
+    {
+        ports.push_back(std::make_pair(protocol::TCP, active_tcp.at(i)));
+    }
+    for(uint32_t i = 0; i < active_udp.size(); i++)
+    {
+        ports.push_back(std::make_pair(protocol::UDP, active_udp.at(i)));
+    }
+    for(uint32_t i = 0; i < active_unix.size(); i++)
+    {
+        ports.push_back(std::make_pair(protocol::UNIX, active_unix.at(i)));
+    }
+
+    // Add a status with the counters and latencies of each port.
+    for(auto it = ports.begin(); it != ports.end(); it++)
+    {
+        connection_stats::snapshot stats;
+        latency_histogram::snapshot rx_latency, tx_latency;
+        bool has_stats = ros_node::m_driver->p_stats(it->first, it->second, stats);
+        bool has_latency = ros_node::m_driver->sample_latency(it->first, it->second, rx_latency, tx_latency);
+        if(!has_stats && !has_latency)
+        {
+            continue;
+        }
+
+        diagnostic_msgs::DiagnosticStatus status;
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        std::stringstream name;
+        name << (it->first == protocol::TCP ? "tcp/" : (it->first == protocol::UDP ? "udp/" : "unix/")) << it->second;
+        status.name = name.str();
+
+        std::vector<std::pair<std::string, std::string>> values;
+        if(has_stats)
+        {
+            values.push_back(std::make_pair("rx_bytes", std::to_string(stats.rx_bytes)));
+            values.push_back(std::make_pair("rx_packets", std::to_string(stats.rx_packets)));
+            values.push_back(std::make_pair("tx_bytes", std::to_string(stats.tx_bytes)));
+            values.push_back(std::make_pair("tx_packets", std::to_string(stats.tx_packets)));
+            values.push_back(std::make_pair("rx_errors", std::to_string(stats.rx_errors)));
+            values.push_back(std::make_pair("tx_errors", std::to_string(stats.tx_errors)));
+            values.push_back(std::make_pair("drops", std::to_string(stats.drops)));
+            values.push_back(std::make_pair("reconnects", std::to_string(stats.reconnects)));
+            values.push_back(std::make_pair("truncations", std::to_string(stats.truncations)));
+            values.push_back(std::make_pair("rx_queue", std::to_string(stats.rx_queue)));
+            values.push_back(std::make_pair("tx_queue", std::to_string(stats.tx_queue)));
+        }
+        if(has_latency)
+        {
+            // Latencies cover the interval since the last publish, in microseconds.
+            std::pair<std::string, const latency_histogram::snapshot*> histograms[] = {{"rx_latency", &rx_latency}, {"tx_latency", &tx_latency}};
+            for(auto histogram = std::begin(histograms); histogram != std::end(histograms); histogram++)
+            {
+                const latency_histogram::snapshot& snapshot = *histogram->second;
+                values.push_back(std::make_pair(histogram->first + "_count", std::to_string(snapshot.count)));
+                std::pair<std::string, double> percentiles[] = {{"_p50_us", 50.0}, {"_p90_us", 90.0}, {"_p99_us", 99.0}, {"_p999_us", 99.9}, {"_max_us", 100.0}};
+                for(auto percentile = std::begin(percentiles); percentile != std::end(percentiles); percentile++)
+                {
+                    std::stringstream value;
+                    value << std::fixed << std::setprecision(1) << static_cast<double>(snapshot.percentile(percentile->second)) / 1000.0;
+                    values.push_back(std::make_pair(histogram->first + percentile->first, value.str()));
+                }
+            }
+        }
+
+        for(auto value = values.begin(); value != values.end(); value++)
+        {
+            diagnostic_msgs::KeyValue key_value;
+            key_value.key = value->first;
+            key_value.value = value->second;
+            status.values.push_back(key_value);
+        }
+
+        message.status.push_back(status);
+    }
+
+    // Publish the message.
+    ros_node::m_publisher_stats.publish(message);
+}
+
+template<typename T>
+T ros_node::port_param(protocol type, uint16_t port, std::string name, T default_value)
+{
+    // Generate parameter namespace for the protocol.
+    std::string protocol_ns = (type == protocol::TCP) ? "tcp" : (type == protocol::UDP) ? "udp" : "unix";
+    std::stringstream port_name;
+    port_name << protocol_ns << "/" << port << "/" << name;
+
+    // Port-specific values override protocol-wide values.
+    T value;
+    if(ros_node::m_node->getParam(port_name.str(), value))
+    {
+        return value;
+    }
+    ros_node::m_node->param<T>(protocol_ns + "/" + name, value, default_value);
+    return value;
+}
+
+connection_options ros_node::read_connection_options(protocol type, uint16_t port)
+{
+    connection_options options;
+
+    // Remote endpoint.
+    options.remote_host = ros_node::port_param<std::string>(type, port, "remote_host", "");
+    options.remote_port = static_cast<uint16_t>(ros_node::port_param<int>(type, port, "remote_port", 0));
+
+    // TCP reconnect, dead peer detection, and TLS.
+    if(type == protocol::TCP)
+    {
+        options.reconnect = ros_node::port_param<bool>(type, port, "reconnect", false);
+        options.reconnect_backoff = backoff(ros_node::port_param<double>(type, port, "reconnect_initial_interval", 0.05),
+                                            ros_node::port_param<double>(type, port, "reconnect_max_interval", 2.0),
+                                            ros_node::port_param<double>(type, port, "reconnect_multiplier", 2.0),
+                                            ros_node::port_param<double>(type, port, "reconnect_jitter", 0.2));
+
+        // Dead peer detection.
+        options.keepalive = ros_node::port_param<bool>(type, port, "keepalive", false);
+        options.keepalive_idle = ros_node::port_param<double>(type, port, "keepalive_idle", 1.0);
+        options.keepalive_interval = ros_node::port_param<double>(type, port, "keepalive_interval", 1.0);
+        options.keepalive_count = static_cast<uint32_t>(std::max(1, ros_node::port_param<int>(type, port, "keepalive_count", 3)));
+        options.user_timeout = ros_node::port_param<double>(type, port, "user_timeout", 0.0);
+
+        // TLS.
+        options.tls = ros_node::port_param<bool>(type, port, "tls", false);
+        options.tls_certificate = ros_node::port_param<std::string>(type, port, "tls_certificate", "");
+        options.tls_key = ros_node::port_param<std::string>(type, port, "tls_key", "");
+        options.tls_ca = ros_node::port_param<std::string>(type, port, "tls_ca", "");
+        options.tls_verify = ros_node::port_param<bool>(type, port, "tls_verify", true);
+    }
+
+    // Tunnels.
+    if(type == protocol::TCP || type == protocol::UDP)
+    {
+        options.tunnel = ros_node::port_param<bool>(type, port, "tunnel", false);
+        options.tunnel_port = static_cast<uint16_t>(ros_node::port_param<int>(type, port, "tunnel_port", 0));
+        options.tunnel_protocol = ros_node::port_param<std::string>(type, port, "tunnel_protocol", "udp");
+    }
+
+    // Capture.
+    if(type == protocol::TCP || type == protocol::UDP)
+    {
+        options.capture_size = std::max(0.0, ros_node::port_param<double>(type, port, "capture_size", 0.0));
+    }
+
+    // Bonding.
+    options.backup_local_ip = ros_node::port_param<std::string>(type, port, "backup_local_ip", "");
+    options.backup_remote_host = ros_node::port_param<std::string>(type, port, "backup_remote_host", "");
+    options.probe_interval = ros_node::port_param<double>(type, port, "probe_interval", 0.02);
+    options.probe_timeout = ros_node::port_param<double>(type, port, "probe_timeout", 0.08);
+
+    // UDP rx shards, XDP, duplicate sends, multicast, broadcast, reliability, FEC, compression, and fragmentation.
+    if(type == protocol::UDP)
+    {
+        options.rx_shards = static_cast<uint32_t>(std::max(1, ros_node::port_param<int>(type, port, "rx_shards", 1)));
+        options.rx_ordered = ros_node::port_param<bool>(type, port, "rx_ordered", true);
+        options.rx_batch = static_cast<uint32_t>(std::max(1, ros_node::port_param<int>(type, port, "rx_batch", 1)));
+        options.xdp = ros_node::port_param<bool>(type, port, "xdp", false);
+        options.xdp_interface = ros_node::port_param<std::string>(type, port, "xdp_interface", "");
+        options.xdp_queue = static_cast<uint32_t>(std::max(0, ros_node::port_param<int>(type, port, "xdp_queue", 0)));
+        options.xdp_native = ros_node::port_param<bool>(type, port, "xdp_native", false);
+        options.duplicate_send = ros_node::port_param<bool>(type, port, "duplicate_send", false);
+
+        // Multicast.
+        options.multicast_group = ros_node::port_param<std::string>(type, port, "multicast_group", "");
+        options.multicast_interface = ros_node::port_param<std::string>(type, port, "multicast_interface", "");
+        options.multicast_ttl = static_cast<uint32_t>(std::max(0, ros_node::port_param<int>(type, port, "multicast_ttl", 1)));
+        options.multicast_loopback = ros_node::port_param<bool>(type, port, "multicast_loopback", false);
+
+        // Broadcast.
+        options.broadcast = ros_node::port_param<std::string>(type, port, "broadcast", "");
+        options.broadcast_filter_echo = ros_node::port_param<bool>(type, port, "broadcast_filter_echo", true);
+
+        // Reliability and loss injection.
+        options.reliable = ros_node::port_param<bool>(type, port, "reliable", false);
+        options.reliable_window = static_cast<uint32_t>(std::max(1, ros_node::port_param<int>(type, port, "reliable_window", 256)));
+        options.reliable_min_rto = ros_node::port_param<double>(type, port, "reliable_min_rto", 0.05);
+        options.reliable_max_rto = ros_node::port_param<double>(type, port, "reliable_max_rto", 2.0);
+        options.tx_loss = std::min(1.0, std::max(0.0, ros_node::port_param<double>(type, port, "tx_loss", 0.0)));
+
+        // Forward error correction.
+        options.fec_data_shards = static_cast<uint32_t>(std::max(0, ros_node::port_param<int>(type, port, "fec_data_shards", 0)));
+        options.fec_parity_shards = static_cast<uint32_t>(std::max(1, ros_node::port_param<int>(type, port, "fec_parity_shards", 1)));
+        options.fec_flush_interval = ros_node::port_param<double>(type, port, "fec_flush_interval", 0.01);
+
+        // Compression.
+        options.compression = ros_node::port_param<std::string>(type, port, "compression", "none");
+        options.compression_level = ros_node::port_param<int>(type, port, "compression_level", 0);
+        options.compression_dictionary = ros_node::port_param<std::string>(type, port, "compression_dictionary", "");
+
+        // Fragmentation.
+        options.fragment_size = static_cast<uint32_t>(std::max(0, ros_node::port_param<int>(type, port, "fragment_size", 0)));
+        options.fragment_timeout = ros_node::port_param<double>(type, port, "fragment_timeout", 1.0);
+        options.fragment_buffer = static_cast<uint32_t>(std::max(0, ros_node::port_param<int>(type, port, "fragment_buffer", 4194304)));
+    }
+
+    // Unix domain sockets.
+    if(type == protocol::UNIX)
+    {
+        std::stringstream default_path;
+        default_path << "@driver_modem/" << port;
+        options.unix_mode = ros_node::port_param<std::string>(type, port, "mode", "datagram");
+        options.unix_path = ros_node::port_param<std::string>(type, port, "path", default_path.str());
+        options.unix_remote_path = ros_node::port_param<std::string>(type, port, "remote_path", options.unix_mode == "client" ? options.unix_path : "");
+    }
+
+    return options;
+}
+
+// CALLBACKS: SIGNALS
+void ros_node::signal_shutdown(int signal)
+{
+    ros_node::m_shutdown_requested = 1;
+}
 
 // CALLBACKS: DRIVER
 void ros_node::callback_tcp_connected(uint16_t port)
@@ -376,13 +819,34 @@ void ros_node::callback_tcp_connected(uint16_t port)
     // TCP has transitioned from pending to active.
 
     // Add the associated topic/service.
-    ros_node::add_connection_topics(protocol::TCP, port);
+    // NOTE: Connections migrated to a new remote host have kept their topic/service.
+    if(ros_node::m_tcp_rx.count(port) == 0)
+    {
+        ros_node::add_connection_topics(protocol::TCP, port);
+    }
 
     // Publish updated connections.
     ros_node::publish_active_connections();
 
     ROS_INFO_STREAM("TCP:" << port << " connected.");
 }
+void ros_node::callback_tcp_pending(uint16_t port)
+{
+    // Keep the topic/service of clients migrating to a new remote host.
+    if(ros_node::m_migrating)
+    {
+        ROS_INFO_STREAM("TCP:" << port << " migrating to new remote host.");
+        return;
+    }
+
+    // Remove the associated topic/service while the connection is re-established.
+    ros_node::remove_connection_topics(protocol::TCP, port);
+
+    // Publish updated connections.
+    ros_node::publish_active_connections();
+
+    ROS_INFO_STREAM("TCP:" << port << " lost, reconnecting.");
+}
 void ros_node::callback_tcp_disconnected(uint16_t port)
 {
     // Remove the associated topic/service.  Driver has already internally removed connection.
@@ -395,9 +859,12 @@ void ros_node::callback_tcp_disconnected(uint16_t port)
 }
 void ros_node::callback_rx(protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
 {
+    TRACE_SCOPE("publish", port);
+
     // Deep copy data into new data_packet message.
     driver_modem_msgs::data_packet message;
-    message.source_ip = source.to_string();
+    // NOTE: Local sockets have no source IP address.
+    message.source_ip = (type == protocol::UNIX) ? "" : host_resolver::normalize(source).to_string();
     for(uint32_t i = 0; i < length; i++)
     {
         message.data.push_back(data[i]);
@@ -424,7 +891,140 @@ void ros_node::callback_rx(protocol type, uint16_t port, uint8_t *data, uint32_t
         }
         break;
     }
+    case protocol::UNIX:
+    {
+        if(ros_node::m_unix_rx.count(port))
+        {
+            ros_node::m_unix_rx.at(port).publish(message);
+        }
+        break;
+    }
+    }
+}
+
+// CALLBACKS: TIMERS
+void ros_node::callback_stats(const ros::TimerEvent &event)
+{
+    (void)event;
+    ros_node::publish_stats();
+}
+void ros_node::callback_remote_hosts(const ros::TimerEvent &event)
+{
+    (void)event;
+    if(ros_node::m_driver->update_remote_hosts())
+    {
+        ROS_INFO_STREAM("Remote hosts re-resolved to new addresses and connections migrated");
+    }
+}
+
+// CALLBACKS: DIAGNOSTICS
+void ros_node::callback_diagnostics(diagnostic_updater::DiagnosticStatusWrapper &status, protocol type, uint16_t port)
+{
+    std::pair<protocol, uint16_t> key(type, port);
+    boost::mutex::scoped_lock lock(ros_node::m_mutex_diagnostics);
+    if(ros_node::m_diagnostics.count(key) == 0)
+    {
+        return;
+    }
+    port_diagnostics& diagnostics = ros_node::m_diagnostics.at(key);
+
+    // Report the connection state.
+    if(type == protocol::TCP)
+    {
+        std::vector<uint16_t> active = ros_node::m_driver->p_active_tcp_connections();
+        std::vector<uint16_t> pending = ros_node::m_driver->p_pending_tcp_connections();
+        if(std::find(active.begin(), active.end(), port) != active.end())
+        {
+            status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Connected");
+            status.add("State", "Connected");
+        }
+        else if(std::find(pending.begin(), pending.end(), port) != pending.end())
+        {
+            status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Pending");
+            status.add("State", "Pending");
+        }
+        else
+        {
+            status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Disconnected");
+            status.add("State", "Disconnected");
+        }
+    }
+    else
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Open");
+        status.add("State", "Open");
+    }
+
+    // Tunnelled and UNIX ports have no traffic counters of their own.
+    connection_stats::snapshot stats;
+    if(!ros_node::m_driver->p_stats(type, port, stats))
+    {
+        return;
+    }
+
+    status.add("RX Errors", stats.rx_errors);
+    status.add("TX Errors", stats.tx_errors);
+    status.add("Drops", stats.drops);
+    status.add("Reconnects", stats.reconnects);
+    status.add("Truncations", stats.truncations);
+    status.add("RX Queue (bytes)", stats.rx_queue);
+    status.add("TX Queue (bytes)", stats.tx_queue);
+
+    // Check for backed up queues.
+    double queue = static_cast<double>(std::max(stats.rx_queue, stats.tx_queue));
+    if(diagnostics.max_queue_error > 0.0 && queue >= diagnostics.max_queue_error)
+    {
+        status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Queue backed up");
+    }
+    else if(diagnostics.max_queue_warn > 0.0 && queue >= diagnostics.max_queue_warn)
+    {
+        status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "Queue backing up");
     }
+
+    // Rates are measured between consecutive updates.
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    uint64_t errors = stats.rx_errors + stats.tx_errors + stats.drops;
+    uint64_t previous_errors = diagnostics.previous.rx_errors + diagnostics.previous.tx_errors + diagnostics.previous.drops;
+    // NOTE: Counters start over if the connection was re-created, such as when the remote host changes.
+    bool restarted = stats.rx_bytes < diagnostics.previous.rx_bytes || stats.tx_bytes < diagnostics.previous.tx_bytes ||
+                     stats.rx_packets < diagnostics.previous.rx_packets || stats.tx_packets < diagnostics.previous.tx_packets ||
+                     errors < previous_errors;
+    double interval = (diagnostics.has_previous && !restarted) ? static_cast<double>((now - diagnostics.previous_time).total_microseconds()) / 1000000.0 : 0.0;
+    if(interval > 0.0)
+    {
+        double rx_rate = static_cast<double>(stats.rx_bytes - diagnostics.previous.rx_bytes) / interval;
+        double tx_rate = static_cast<double>(stats.tx_bytes - diagnostics.previous.tx_bytes) / interval;
+        double error_rate = static_cast<double>(errors - previous_errors) / interval;
+        status.add("RX Rate (bytes/s)", rx_rate);
+        status.add("TX Rate (bytes/s)", tx_rate);
+        status.add("RX Rate (packets/s)", static_cast<double>(stats.rx_packets - diagnostics.previous.rx_packets) / interval);
+        status.add("TX Rate (packets/s)", static_cast<double>(stats.tx_packets - diagnostics.previous.tx_packets) / interval);
+        status.add("Error Rate (1/s)", error_rate);
+
+        // Check for low throughput.
+        if(diagnostics.min_rx_rate_error > 0.0 && rx_rate < diagnostics.min_rx_rate_error)
+        {
+            status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "RX throughput too low");
+        }
+        else if(diagnostics.min_rx_rate_warn > 0.0 && rx_rate < diagnostics.min_rx_rate_warn)
+        {
+            status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "RX throughput low");
+        }
+
+        // Check for error spikes.
+        if(diagnostics.max_error_rate_error > 0.0 && error_rate >= diagnostics.max_error_rate_error)
+        {
+            status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Error rate too high");
+        }
+        else if(diagnostics.max_error_rate_warn > 0.0 && error_rate >= diagnostics.max_error_rate_warn)
+        {
+            status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "Error rate high");
+        }
+    }
+
+    diagnostics.has_previous = true;
+    diagnostics.previous = stats;
+    diagnostics.previous_time = now;
 }
 
 // CALLBACKS: SUBSCRIBERS
@@ -432,6 +1032,10 @@ void ros_node::callback_udp_tx(const driver_modem_msgs::data_packetConstPtr &mes
 {
     ros_node::m_driver->tx(protocol::UDP, port, message->data.data(), static_cast<uint32_t>(message->data.size()));
 }
+void ros_node::callback_unix_tx(const driver_modem_msgs::data_packetConstPtr &message, uint16_t port)
+{
+    ros_node::m_driver->tx(protocol::UNIX, port, message->data.data(), static_cast<uint32_t>(message->data.size()));
+}
 
 // CALLBACKS: SERVICES
 bool ros_node::service_set_remote_host(driver_modem_msgs::set_remote_hostRequest &request, driver_modem_msgs::set_remote_hostResponse &response)
@@ -458,6 +1062,12 @@ bool ros_node::service_add_udp_connection(driver_modem_msgs::add_udp_connectionR
 
     return true;
 }
+bool ros_node::service_add_unix_connection(driver_modem_msgs::add_udp_connectionRequest& request, driver_modem_msgs::add_udp_connectionResponse& response)
+{
+    response.success = ros_node::add_unix_connection(request.port);
+
+    return true;
+}
 bool ros_node::service_remove_connection(driver_modem_msgs::remove_connectionRequest& request, driver_modem_msgs::remove_connectionResponse& response)
 {
     response.success = ros_node::remove_connection(static_cast<protocol>(request.protocol), request.port);
@@ -474,9 +1084,72 @@ bool ros_node::service_remove_all_connections(driver_modem_msgs::remove_all_conn
 
     return true;
 }
+bool ros_node::service_dump_capture(std_srvs::TriggerRequest &request, std_srvs::TriggerResponse &response)
+{
+    // Name the file after the current time so that earlier dumps are kept.
+    std::stringstream path;
+    path << ros_node::m_capture_directory << "/driver_modem_" << boost::posix_time::to_iso_string(boost::posix_time::microsec_clock::universal_time()) << ".pcap";
+
+    uint32_t packets = 0;
+    response.success = ros_node::m_driver->dump_capture(path.str(), packets);
+    if(response.success)
+    {
+        std::stringstream message;
+        message << path.str() << " (" << packets << " messages)";
+        response.message = message.str();
+    }
+    else
+    {
+        response.message = "Could not write " + path.str();
+    }
+
+    return true;
+}
+bool ros_node::service_dump_trace(std_srvs::TriggerRequest &request, std_srvs::TriggerResponse &response)
+{
+    // Events are only recorded when the driver is built with tracing.
+    if(!trace::p_enabled())
+    {
+        response.success = false;
+        response.message = "Tracing is not enabled in this build (DRIVER_MODEM_TRACING)";
+        return true;
+    }
+
+    std::stringstream path;
+    path << ros_node::m_capture_directory << "/driver_modem_" << boost::posix_time::to_iso_string(boost::posix_time::microsec_clock::universal_time()) << ".json";
+
+    uint32_t events = 0;
+    response.success = trace::dump(path.str(), events);
+    if(response.success)
+    {
+        std::stringstream message;
+        message << path.str() << " (" << events << " events)";
+        response.message = message.str();
+    }
+    else
+    {
+        response.message = "Could not write " + path.str();
+    }
+
+    return true;
+}
 bool ros_node::service_tcp_tx(driver_modem_msgs::send_tcpRequest &request, driver_modem_msgs::send_tcpResponse &response, uint16_t port)
 {
-    response.success = ros_node::m_driver->tx(protocol::TCP, port, request.packet.data.data(), static_cast<uint32_t>(request.packet.data.size()));
+    // An optional source_ip targets a single session of a TCP server.  Otherwise, transmit to all sessions.
+    address destination;
+    if(!request.packet.source_ip.empty())
+    {
+        boost::system::error_code error;
+        destination = address::from_string(request.packet.source_ip, error);
+        if(error)
+        {
+            ROS_ERROR_STREAM("Invalid TCP:" << port << " session address " << request.packet.source_ip);
+            response.success = false;
+            return true;
+        }
+    }
+
+    response.success = ros_node::m_driver->tx(protocol::TCP, port, request.packet.data.data(), static_cast<uint32_t>(request.packet.data.size()), destination);
 
     return true;
 }
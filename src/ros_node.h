@@ -6,6 +6,7 @@
 #include "driver.h"
 
 #include <ros/ros.h>
+#include <diagnostic_updater/diagnostic_updater.h>
 
 #include <driver_modem_msgs/data_packet.h>
 #include <driver_modem_msgs/set_remote_host.h>
@@ -15,6 +16,11 @@
 #include <driver_modem_msgs/remove_connection.h>
 #include <driver_modem_msgs/remove_all_connections.h>
 #include <driver_modem_msgs/send_tcp.h>
+#include <std_srvs/Trigger.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <csignal>
 
 /// \brief Implements the driver's ROS node functionality.
 class ros_node
@@ -37,18 +43,31 @@ private:
     driver* m_driver;
     /// \brief The node's handle.
     ros::NodeHandle* m_node;
+    /// \brief Indicates if a shutdown has been requested by SIGINT.
+    static volatile std::sig_atomic_t m_shutdown_requested;
+    /// \brief Indicates if set_remote_host migrates existing connections instead of removing them.
+    bool m_migrate_remote_host;
+    /// \brief Indicates if a remote host migration is in progress.
+    bool m_migrating;
+    /// \brief The directory that capture and trace dumps are written to.
+    std::string m_capture_directory;
 
     // VARIABLES: PUBLISHERS
     /// \brief The publisher for ActiveConnection messages.
     ros::Publisher m_publisher_active_connections;
+    ros::Publisher m_publisher_stats;
     /// \brief The map of TCP RX publishers.
     std::map<uint16_t, ros::Publisher> m_tcp_rx;
     /// \brief The map of UDP RX publishers.
     std::map<uint16_t, ros::Publisher> m_udp_rx;
+    /// \brief The map of UNIX RX publishers.
+    std::map<uint16_t, ros::Publisher> m_unix_rx;
 
     // VARIABLES: SUBSCRIBERS
     /// \brief The map of UDP TX subscribers.
     std::map<uint16_t, ros::Subscriber> m_udp_tx;
+    /// \brief The map of UNIX TX subscribers.
+    std::map<uint16_t, ros::Subscriber> m_unix_tx;
     /// \brief The map of TCP TX service servers.
     std::map<uint16_t, ros::ServiceServer> m_tcp_tx;
 
@@ -61,13 +80,42 @@ private:
     ros::ServiceServer m_service_add_tcp_connection;
     /// \brief Service for adding UDP connections.
     ros::ServiceServer m_service_add_udp_connection;
-    /// \brief Service for removing TCP/UDP connections.
+    /// \brief Service for adding UNIX connections.
+    ros::ServiceServer m_service_add_unix_connection;
+    /// \brief Service for removing TCP/UDP/UNIX connections.
     ros::ServiceServer m_service_remove_connection;
     /// \brief Service for removing all connections.
     ros::ServiceServer m_service_remove_all_connections;
+    /// \brief Service for dumping the capture rings to a pcap file.
+    ros::ServiceServer m_service_dump_capture;
+    /// \brief Service for dumping trace events to a Chrome trace file.
+    ros::ServiceServer m_service_dump_trace;
+
+    // VARIABLES: TIMERS
+    ros::Timer m_timer_stats;
+    ros::Timer m_timer_remote_hosts;
+
+    // VARIABLES: DIAGNOSTICS
+    struct port_diagnostics
+    {
+        double min_rx_rate_warn;
+        double min_rx_rate_error;
+        double max_queue_warn;
+        double max_queue_error;
+        double max_error_rate_warn;
+        double max_error_rate_error;
+        bool has_previous;
+        connection_stats::snapshot previous;
+        boost::posix_time::ptime previous_time;
+    };
+    diagnostic_updater::Updater* m_updater;
+    std::map<std::pair<protocol, uint16_t>, port_diagnostics> m_diagnostics;
+    /// \brief Protects m_diagnostics, which connection callbacks modify from the driver's IO thread.
+    /// \details Never held while calling into m_updater, whose own lock is held while it raises callback_diagnostics.
+    boost::mutex m_mutex_diagnostics;
 
     // METHODS: CONNECTION MANAGEMENT
-    /// \brief Sets the remote host of the modem and clears all current connections.
+    /// \brief Sets the remote host of the modem and either migrates or clears all current connections.
     /// \param remote_host The new remote host.
     /// \return TRUE if successful, otherwise FALSE.
     bool set_remote_host(std::string remote_host);
@@ -82,7 +130,12 @@ private:
     /// \param publish_connections Indicates if the method should publish the active_connections method.
     /// \return TRUE if the new connection was added, otherwise FALSE.
     bool add_udp_connection(uint16_t port, bool publish_connections = true);
-    /// \brief Instructs the driver to remove a TCP or UDP connection
+    /// \brief Instructs the driver to add a new UNIX connection.
+    /// \param port The port number of the new UNIX connection.
+    /// \param publish_connections Indicates if the method should publish the active_connections method.
+    /// \return TRUE if the new connection was added, otherwise FALSE.
+    bool add_unix_connection(uint16_t port, bool publish_connections = true);
+    /// \brief Instructs the driver to remove a TCP, UDP, or UNIX connection
     /// \param type The protocol type of the connection to remove.
     /// \param port The port of the connection to remove.
     /// \param publish_connections Indicates if the method should publish the active_connections method.
@@ -100,17 +153,47 @@ private:
     /// \param type The protocol type of connected removed.
     /// \param port The port of the connection removed.
     void remove_connection_topics(protocol type, uint16_t port);
+    /// \brief Removes all publishers, subscribers, and services of a protocol.
+    /// \param type The protocol type of the connections removed.
+    void remove_connection_topics(protocol type);
     /// \brief Removes all publishers, subscribers, and services.
     void remove_connection_topics();
 
+    // METHODS: DIAGNOSTICS
+    static std::string diagnostics_name(protocol type, uint16_t port);
+    void add_diagnostics(protocol type, uint16_t port);
+    void remove_diagnostics(protocol type, uint16_t port);
+
     // METHODS: MISC
     /// \brief Publishes active connections.
     void publish_active_connections();
+    void publish_stats();
+    /// \brief Reads a per-connection parameter.
+    /// \param type The protocol type of the connection.
+    /// \param port The port of the connection.
+    /// \param name The name of the parameter.
+    /// \param default_value The value to use if the parameter is not set.
+    /// \return The value of ~protocol/port/name if set, otherwise ~protocol/name if set, otherwise the default value.
+    template<typename T>
+    T port_param(protocol type, uint16_t port, std::string name, T default_value);
+    /// \brief Reads the per-connection parameters of a connection.
+    /// \param type The protocol type of the connection.
+    /// \param port The port of the connection.
+    /// \return The connection options read from the parameter server.
+    connection_options read_connection_options(protocol type, uint16_t port);
+
+    // CALLBACKS: SIGNALS
+    /// \brief Requests a graceful shutdown of the node.
+    /// \param signal The signal that was raised.
+    static void signal_shutdown(int signal);
 
     // CALLBACKS: DRIVER
     /// \brief The callback for handling driver TCP connection events.
     /// \param port The port of the new TCP connection.
     void callback_tcp_connected(uint16_t port);
+    /// \brief The callback for handling driver TCP connections that were lost and are reconnecting.
+    /// \param port The port of the reconnecting TCP connection.
+    void callback_tcp_pending(uint16_t port);
     /// \brief The callback for handling driver TCP disconnection events.
     /// \param port The port of the closed TCP connection.
     void callback_tcp_disconnected(uint16_t port);
@@ -122,11 +205,22 @@ private:
     /// \param source The IP address of the data source.
     void callback_rx(protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
 
+    // CALLBACKS: TIMERS
+    void callback_stats(const ros::TimerEvent& event);
+    void callback_remote_hosts(const ros::TimerEvent& event);
+
+    // CALLBACKS: DIAGNOSTICS
+    void callback_diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status, protocol type, uint16_t port);
+
     // CALLBACKS: SUBSCRIBERS
     /// \brief Forwards received data_packet messages from udp tx topics.
     /// \param message The message to forward.
     /// \param port The local port to forward the message to.
     void callback_udp_tx(const driver_modem_msgs::data_packetConstPtr& message, uint16_t port);
+    /// \brief Forwards received data_packet messages from unix tx topics.
+    /// \param message The message to forward.
+    /// \param port The port number to forward the message to.
+    void callback_unix_tx(const driver_modem_msgs::data_packetConstPtr& message, uint16_t port);
 
     // CALLBACKS: SERVICES
     /// \brief Service callback for setting the driver's remote host.
@@ -149,7 +243,12 @@ private:
     /// \param response The service response.
     /// \return TRUE if the service succeeded, otherwise FALSE.
     bool service_add_udp_connection(driver_modem_msgs::add_udp_connectionRequest& request, driver_modem_msgs::add_udp_connectionResponse& response);
-    /// \brief Service callback for removing TCP/UDP connections.
+    /// \brief Service callback for adding UNIX connections.
+    /// \param request The service request, which shares the add_udp_connection definition.
+    /// \param response The service response.
+    /// \return TRUE if the service succeeded, otherwise FALSE.
+    bool service_add_unix_connection(driver_modem_msgs::add_udp_connectionRequest& request, driver_modem_msgs::add_udp_connectionResponse& response);
+    /// \brief Service callback for removing TCP/UDP/UNIX connections.
     /// \param request The service request.
     /// \param response The service response.
     /// \return TRUE if the service succeeded, otherwise FALSE.
@@ -159,6 +258,16 @@ private:
     /// \param response The service response.
     /// \return TRUE if the service succeeded, otherwise FALSE.
     bool service_remove_all_connections(driver_modem_msgs::remove_all_connectionsRequest& request, driver_modem_msgs::remove_all_connectionsResponse& response);
+    /// \brief Service callback for dumping the capture rings to a pcap file.
+    /// \param request The service request.
+    /// \param response The service response, whose message is the path of the file.
+    /// \return TRUE if the service succeeded, otherwise FALSE.
+    bool service_dump_capture(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response);
+    /// \brief Service callback for dumping trace events to a Chrome trace file.
+    /// \param request The service request.
+    /// \param response The service response, whose message is the path of the file.
+    /// \return TRUE if the service succeeded, otherwise FALSE.
+    bool service_dump_trace(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response);
     /// \brief Service for transmitting data over a TCP connection.
     /// \param request The service request.
     /// \param response The service response.
@@ -0,0 +1,455 @@
+#include "tcp_bond.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// The bond header is: magic (1), type (1), payload length (4, big endian).
+#define BOND_MAGIC 0xB1
+#define BOND_HEADER_SIZE 6
+// The largest message accepted from a path, which guards against corrupt length fields.
+#define BOND_MAX_MESSAGE (1u << 26)
+
+// CONSTRUCTORS
+tcp_bond::tcp_bond(boost::asio::io_service& io_service, tcp::endpoint primary_local_endpoint, tcp::endpoint backup_local_endpoint,
+                   double probe_interval, double probe_timeout)
+    // Initialize timer.
+    : m_timer_probe(io_service)
+{
+    // Create the paths.
+    tcp_bond::m_paths[0] = boost::shared_ptr<tcp_connection>(new tcp_connection(io_service, primary_local_endpoint));
+    tcp_bond::m_paths[1] = boost::shared_ptr<tcp_connection>(new tcp_connection(io_service, backup_local_endpoint));
+
+    // Paths always reconnect so that a lost path is restored as a standby.
+    tcp_bond::set_reconnect(backoff());
+
+    tcp_bond::m_local_port = primary_local_endpoint.port();
+    tcp_bond::m_status = tcp_connection::status::DISCONNECTED;
+
+    // Store probe parameters.
+    tcp_bond::m_probe_interval = boost::posix_time::microseconds(static_cast<int64_t>(probe_interval * 1000000.0));
+    tcp_bond::m_probe_timeout = boost::posix_time::microseconds(static_cast<int64_t>(probe_timeout * 1000000.0));
+}
+
+// PUBLIC METHODS: START/STOP
+bool tcp_bond::start_client(tcp::endpoint primary_remote_endpoint, tcp::endpoint backup_remote_endpoint)
+{
+    tcp_bond::attach_path(0);
+    tcp_bond::attach_path(1);
+
+    bool started = tcp_bond::m_paths[0]->start_client(primary_remote_endpoint) &&
+                   tcp_bond::m_paths[1]->start_client(backup_remote_endpoint);
+    if(started)
+    {
+        // Start probing.
+        tcp_bond::schedule_probe();
+    }
+    else
+    {
+        tcp_bond::disconnect();
+    }
+
+    return started;
+}
+bool tcp_bond::start_server()
+{
+    tcp_bond::attach_path(0);
+    tcp_bond::attach_path(1);
+
+    bool started = tcp_bond::m_paths[0]->start_server() &&
+                   tcp_bond::m_paths[1]->start_server();
+    if(started)
+    {
+        // Start probing.
+        tcp_bond::schedule_probe();
+    }
+    else
+    {
+        tcp_bond::disconnect();
+    }
+
+    return started;
+}
+bool tcp_bond::disconnect(double drain_timeout)
+{
+    // Do not raise signal, since this function is called externally.
+    tcp_bond::m_status = tcp_connection::status::DISCONNECTED;
+    tcp_bond::m_timer_probe.cancel();
+
+    // Share the drain timeout between both paths.
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    bool drained = tcp_bond::m_paths[0]->disconnect(drain_timeout);
+    double remaining = std::max(0.0, drain_timeout - (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0);
+    drained = tcp_bond::m_paths[1]->disconnect(remaining) && drained;
+
+    // Sessions closed from this end do not raise the session closed callback, so their partial messages are dropped here.
+    boost::mutex::scoped_lock lock(tcp_bond::m_mutex_rx);
+    tcp_bond::m_partials[0].clear();
+    tcp_bond::m_partials[1].clear();
+
+    return drained;
+}
+void tcp_bond::set_reconnect(backoff policy)
+{
+    tcp_bond::m_paths[0]->set_reconnect(true, policy);
+    tcp_bond::m_paths[1]->set_reconnect(true, policy);
+}
+void tcp_bond::set_dead_peer_detection(bool keepalive, double keepalive_idle, double keepalive_interval, uint32_t keepalive_count, double user_timeout)
+{
+    tcp_bond::m_paths[0]->set_dead_peer_detection(keepalive, keepalive_idle, keepalive_interval, keepalive_count, user_timeout);
+    tcp_bond::m_paths[1]->set_dead_peer_detection(keepalive, keepalive_idle, keepalive_interval, keepalive_count, user_timeout);
+}
+void tcp_bond::set_tls(boost::shared_ptr<tls_context> context, const std::string &primary_host, const std::string &backup_host)
+{
+    tcp_bond::m_paths[0]->set_tls(context, primary_host);
+    tcp_bond::m_paths[1]->set_tls(context, backup_host);
+}
+bool tcp_bond::set_remote_endpoint(tcp::endpoint remote_endpoint, const std::string &host)
+{
+    // The primary path is only healthy again once heard from at its new endpoint.
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_paths);
+        tcp_bond::m_last_heard[0] = boost::posix_time::ptime();
+        tcp_bond::m_probe_sent[0] = boost::posix_time::ptime();
+    }
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_rx);
+        tcp_bond::m_partials[0].clear();
+    }
+
+    return tcp_bond::m_paths[0]->set_remote_endpoint(remote_endpoint, host);
+}
+
+// PUBLIC METHODS: CALLBACK ATTACHMENT
+void tcp_bond::attach_connected_callback(std::function<void(uint16_t)> callback)
+{
+    tcp_bond::m_connected_callback = callback;
+}
+void tcp_bond::attach_pending_callback(std::function<void(uint16_t)> callback)
+{
+    tcp_bond::m_pending_callback = callback;
+}
+void tcp_bond::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    tcp_bond::m_rx_callback = callback;
+}
+void tcp_bond::attach_session_closed_callback(std::function<void(tcp::endpoint)> callback)
+{
+    tcp_bond::m_session_closed_callback = callback;
+}
+
+// PUBLIC METHODS: IO
+bool tcp_bond::tx(const uint8_t *data, uint32_t length, address destination)
+{
+    // The peer rejects longer messages as corrupt.
+    if(length > BOND_MAX_MESSAGE)
+    {
+        return false;
+    }
+
+    // Send on the active path, failing over to the standby path if the send fails.
+    uint32_t path = tcp_bond::p_active_path();
+    return tcp_bond::tx_path(path, message_type::DATA, data, length, destination, true) ||
+           tcp_bond::tx_path(1 - path, message_type::DATA, data, length, destination, true);
+}
+void tcp_bond::close_session(tcp::endpoint remote_endpoint)
+{
+    // Only the path holding the session will find it.
+    tcp_bond::m_paths[0]->close_session(remote_endpoint);
+    tcp_bond::m_paths[1]->close_session(remote_endpoint);
+}
+
+// PROPERTIES
+tcp_role tcp_bond::p_role() const
+{
+    return tcp_bond::m_paths[0]->p_role();
+}
+tcp_connection::status tcp_bond::p_status() const
+{
+    tcp_connection::status primary = tcp_bond::m_paths[0]->p_status();
+    tcp_connection::status backup = tcp_bond::m_paths[1]->p_status();
+
+    if(primary == tcp_connection::status::CONNECTED || backup == tcp_connection::status::CONNECTED)
+    {
+        return tcp_connection::status::CONNECTED;
+    }
+    else if(primary == tcp_connection::status::PENDING || backup == tcp_connection::status::PENDING)
+    {
+        return tcp_connection::status::PENDING;
+    }
+    else
+    {
+        return tcp_connection::status::DISCONNECTED;
+    }
+}
+uint32_t tcp_bond::p_active_path() const
+{
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_paths);
+
+        // Prefer the primary path, unless only the backup path is healthy.
+        bool primary = tcp_bond::healthy(0);
+        bool backup = tcp_bond::healthy(1);
+        if(primary || backup)
+        {
+            return primary ? 0 : 1;
+        }
+    }
+
+    // Neither path has been heard from recently, such as right after connecting, so prefer the connected path.
+    return (tcp_bond::m_paths[0]->p_status() != tcp_connection::status::CONNECTED &&
+            tcp_bond::m_paths[1]->p_status() == tcp_connection::status::CONNECTED) ? 1 : 0;
+}
+connection_stats::snapshot tcp_bond::p_stats() const
+{
+    connection_stats::snapshot output = tcp_bond::m_paths[0]->p_stats();
+    output += tcp_bond::m_paths[1]->p_stats();
+    return output;
+}
+
+// PRIVATE METHODS
+void tcp_bond::attach_path(uint32_t path)
+{
+    // NOTE: The paths only hold a weak reference, since the bond owns the paths.
+    boost::weak_ptr<tcp_bond> bond = tcp_bond::shared_from_this();
+    std::function<void(uint16_t)> callback = [bond](uint16_t)
+    {
+        boost::shared_ptr<tcp_bond> instance = bond.lock();
+        if(instance)
+        {
+            instance->update_status();
+        }
+    };
+
+    tcp_bond::m_paths[path]->attach_connected_callback(callback);
+    tcp_bond::m_paths[path]->attach_pending_callback(callback);
+    tcp_bond::m_paths[path]->attach_disconnected_callback(callback);
+
+    // Tag received data and session closures with the path index.
+    tcp_bond::m_paths[path]->attach_rx_callback([bond, path](protocol type, uint16_t port, uint8_t* data, uint32_t length, address source)
+    {
+        boost::shared_ptr<tcp_bond> instance = bond.lock();
+        if(instance)
+        {
+            instance->rx_callback(path, type, port, data, length, source);
+        }
+        else
+        {
+            delete [] data;
+        }
+    });
+    tcp_bond::m_paths[path]->attach_session_closed_callback([bond, path](tcp::endpoint session)
+    {
+        boost::shared_ptr<tcp_bond> instance = bond.lock();
+        if(instance)
+        {
+            instance->session_closed_callback(path, session);
+        }
+    });
+}
+void tcp_bond::update_status()
+{
+    tcp_connection::status old_status = tcp_bond::m_status;
+    tcp_bond::m_status = tcp_bond::p_status();
+
+    if(tcp_bond::m_status == tcp_connection::status::CONNECTED && old_status != tcp_connection::status::CONNECTED)
+    {
+        // The first path has connected.
+        if(tcp_bond::m_connected_callback)
+        {
+            tcp_bond::m_connected_callback(tcp_bond::m_local_port);
+        }
+    }
+    else if(tcp_bond::m_status != tcp_connection::status::CONNECTED && old_status == tcp_connection::status::CONNECTED)
+    {
+        // Both paths have been lost, and are reconnecting.
+        if(tcp_bond::m_pending_callback)
+        {
+            tcp_bond::m_pending_callback(tcp_bond::m_local_port);
+        }
+    }
+}
+bool tcp_bond::tx_path(uint32_t path, message_type type, const uint8_t *data, uint32_t length, address destination, bool wait)
+{
+    // Build the message, so that it is written to the stream in one piece.
+    std::vector<uint8_t> message(BOND_HEADER_SIZE + length);
+    message[0] = BOND_MAGIC;
+    message[1] = static_cast<uint8_t>(type);
+    message[2] = static_cast<uint8_t>(length >> 24);
+    message[3] = static_cast<uint8_t>(length >> 16);
+    message[4] = static_cast<uint8_t>(length >> 8);
+    message[5] = static_cast<uint8_t>(length);
+    if(length > 0)
+    {
+        std::memcpy(message.data() + BOND_HEADER_SIZE, data, length);
+    }
+
+    // Probes skip a busy path, so that the IO thread never waits behind a send blocked on a dead path.
+    boost::mutex::scoped_lock lock(tcp_bond::m_mutex_tx[path], boost::defer_lock);
+    if(wait)
+    {
+        lock.lock();
+    }
+    else if(!lock.try_lock())
+    {
+        return false;
+    }
+
+    return tcp_bond::m_paths[path]->tx(message.data(), static_cast<uint32_t>(message.size()), destination);
+}
+bool tcp_bond::healthy(uint32_t path) const
+{
+    return !tcp_bond::m_last_heard[path].is_not_a_date_time() &&
+           boost::posix_time::microsec_clock::universal_time() - tcp_bond::m_last_heard[path] < tcp_bond::m_probe_timeout;
+}
+void tcp_bond::schedule_probe()
+{
+    tcp_bond::m_timer_probe.expires_from_now(tcp_bond::m_probe_interval);
+    tcp_bond::m_timer_probe.async_wait(boost::bind(&tcp_bond::probe_callback, tcp_bond::shared_from_this(), boost::placeholders::_1));
+}
+
+// CALLBACKS
+void tcp_bond::rx_callback(uint32_t path, protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
+{
+    // Separate the complete messages from the session's stream.
+    // NOTE: Messages are delivered after releasing the lock, so callbacks never run while holding it.
+    tcp::endpoint session = tcp_session::rx_endpoint();
+    std::vector<std::vector<uint8_t>> messages;
+    bool probed = false;
+    bool replied = false;
+    bool corrupt = false;
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_rx);
+
+        std::vector<uint8_t>& buffer = tcp_bond::m_partials[path][session];
+        buffer.insert(buffer.end(), data, data + length);
+
+        uint32_t offset = 0;
+        while(buffer.size() - offset >= BOND_HEADER_SIZE)
+        {
+            const uint8_t* header = buffer.data() + offset;
+            uint32_t message_length = (static_cast<uint32_t>(header[2]) << 24) | (static_cast<uint32_t>(header[3]) << 16) |
+                                      (static_cast<uint32_t>(header[4]) << 8) | static_cast<uint32_t>(header[5]);
+            if(header[0] != BOND_MAGIC || header[1] > static_cast<uint8_t>(message_type::PROBE_REPLY) || message_length > BOND_MAX_MESSAGE)
+            {
+                // The stream is corrupt and cannot be resynchronized, so discard everything received so far.
+                offset = static_cast<uint32_t>(buffer.size());
+                corrupt = true;
+                break;
+            }
+            if(buffer.size() - offset - BOND_HEADER_SIZE < message_length)
+            {
+                // Wait for the rest of the message.
+                break;
+            }
+
+            switch(static_cast<message_type>(header[1]))
+            {
+            case message_type::DATA:
+            {
+                messages.push_back(std::vector<uint8_t>(header + BOND_HEADER_SIZE, header + BOND_HEADER_SIZE + message_length));
+                break;
+            }
+            case message_type::PROBE:
+            {
+                probed = true;
+                break;
+            }
+            case message_type::PROBE_REPLY:
+            {
+                replied = true;
+                break;
+            }
+            }
+            offset += BOND_HEADER_SIZE + message_length;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+        if(buffer.empty())
+        {
+            tcp_bond::m_partials[path].erase(session);
+        }
+    }
+    delete [] data;
+
+    if(corrupt)
+    {
+        // Close the session, so that it reconnects on a message boundary.
+        tcp_bond::m_paths[path]->close_session(session);
+        return;
+    }
+
+    // Any received data shows that the path is healthy, even part of a large message.
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_paths);
+        tcp_bond::m_last_heard[path] = boost::posix_time::microsec_clock::universal_time();
+        if(replied)
+        {
+            tcp_bond::m_probe_sent[path] = boost::posix_time::ptime();
+        }
+    }
+
+    // Reply on the same path so the peer can measure the path's health.
+    if(probed)
+    {
+        tcp_bond::tx_path(path, message_type::PROBE_REPLY, nullptr, 0, source, false);
+    }
+
+    // Forward the data messages.
+    if(tcp_bond::m_rx_callback)
+    {
+        for(auto it = messages.begin(); it != messages.end(); it++)
+        {
+            uint8_t* payload = new uint8_t[it->size()];
+            std::memcpy(payload, it->data(), it->size());
+            tcp_bond::m_rx_callback(type, port, payload, static_cast<uint32_t>(it->size()), source);
+        }
+    }
+}
+void tcp_bond::session_closed_callback(uint32_t path, tcp::endpoint session)
+{
+    {
+        boost::mutex::scoped_lock lock(tcp_bond::m_mutex_rx);
+        tcp_bond::m_partials[path].erase(session);
+    }
+
+    if(tcp_bond::m_session_closed_callback)
+    {
+        tcp_bond::m_session_closed_callback(session);
+    }
+}
+void tcp_bond::probe_callback(const boost::system::error_code &error)
+{
+    // Stop probing once the bond is disconnected, since its paths then never reconnect.
+    if(error || tcp_bond::p_status() == tcp_connection::status::DISCONNECTED)
+    {
+        return;
+    }
+
+    for(uint32_t path = 0; path < 2; path++)
+    {
+        if(tcp_bond::m_paths[path]->p_status() != tcp_connection::status::CONNECTED)
+        {
+            continue;
+        }
+
+        // Probe again once the previous probe was answered or timed out, so that probes queued in a dead path's
+        // send buffer cannot fill it faster than one per timeout.
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        {
+            boost::mutex::scoped_lock lock(tcp_bond::m_mutex_paths);
+            if(!tcp_bond::m_probe_sent[path].is_not_a_date_time() && now - tcp_bond::m_probe_sent[path] < tcp_bond::m_probe_timeout)
+            {
+                continue;
+            }
+        }
+
+        if(tcp_bond::tx_path(path, message_type::PROBE, nullptr, 0, address(), false))
+        {
+            boost::mutex::scoped_lock lock(tcp_bond::m_mutex_paths);
+            tcp_bond::m_probe_sent[path] = now;
+        }
+    }
+
+    tcp_bond::schedule_probe();
+}
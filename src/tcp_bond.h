@@ -0,0 +1,205 @@
+/// \file tcp_bond.h
+/// \brief Defines the tcp_bond class.
+#ifndef TCP_BOND_H
+#define TCP_BOND_H
+
+#include "tcp_connection.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Provides a single logical TCP port backed by a primary and a backup network path.
+/// \details Each path is a separate tcp_connection with its own local and remote endpoint, and both paths are kept
+/// established at the same time.  Both ends of the link must be bonded, since every message is framed with a small
+/// header carrying its type and length.  Paths are health probed with heartbeats, and messages are sent on the healthy
+/// path (preferring the primary), failing over to the other path if a send fails.  Heartbeats detect a dead path
+/// well before TCP does, since sends into a dead path's socket buffer still succeed.
+/// Paths always reconnect while the bond exists.
+class tcp_bond
+        : public boost::enable_shared_from_this<tcp_bond>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new bonded TCP connection.
+    /// \param io_service The global IO Service to run the connection on.
+    /// \param primary_local_endpoint The local endpoint of the primary path.
+    /// \param backup_local_endpoint The local endpoint of the backup path.
+    /// \param probe_interval The interval in seconds between health probes on each path.
+    /// \param probe_timeout The time in seconds without traffic after which a path is considered unhealthy.
+    tcp_bond(boost::asio::io_service& io_service, tcp::endpoint primary_local_endpoint, tcp::endpoint backup_local_endpoint,
+             double probe_interval, double probe_timeout);
+
+    // METHODS: START/STOP
+    /// \brief Starts both paths as TCP clients.
+    /// \param primary_remote_endpoint The remote endpoint of the primary path.
+    /// \param backup_remote_endpoint The remote endpoint of the backup path.
+    /// \return TRUE if both paths were started, otherwise FALSE.
+    bool start_client(tcp::endpoint primary_remote_endpoint, tcp::endpoint backup_remote_endpoint);
+    /// \brief Starts both paths as TCP servers.
+    /// \return TRUE if both paths were started, otherwise FALSE.
+    bool start_server();
+    /// \brief Disconnects both paths.
+    /// \param drain_timeout The maximum time in seconds to wait for queued data to be acknowledged before closing.
+    /// \return TRUE if all queued data was acknowledged, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
+    /// \brief Configures the backoff of path re-establishment attempts.
+    /// \param policy The backoff policy for spacing re-establishment attempts.
+    void set_reconnect(backoff policy);
+    /// \brief Configures dead peer detection for both paths.
+    /// \details See tcp_connection::set_dead_peer_detection.
+    void set_dead_peer_detection(bool keepalive, double keepalive_idle, double keepalive_interval, uint32_t keepalive_count, double user_timeout);
+    /// \brief Encrypts both paths with TLS.
+    /// \param context The TLS configuration.
+    /// \param primary_host The hostname or IP address that the primary server's certificate must be issued to.
+    /// \param backup_host The hostname or IP address that the backup server's certificate must be issued to.
+    /// \details See tcp_connection::set_tls.
+    void set_tls(boost::shared_ptr<tls_context> context, const std::string& primary_host = "", const std::string& backup_host = "");
+    /// \brief Retargets the primary path to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint of the primary path.
+    /// \param host The hostname or IP address that the new primary server's TLS certificate must be issued to.
+    /// \return TRUE if the primary path is reconnecting to the new endpoint, otherwise FALSE.
+    /// \details Must be called on the IO thread once it is running.
+    bool set_remote_endpoint(tcp::endpoint remote_endpoint, const std::string& host = "");
+
+    // METHODS: CALLBACK ATTACHMENT
+    /// \brief Attaches a callback for handling the bond becoming connected.
+    /// \param callback The callback to handle connection.
+    void attach_connected_callback(std::function<void(uint16_t)> callback);
+    /// \brief Attaches a callback for handling the loss of both paths.
+    /// \param callback The callback to handle the loss of both paths.
+    void attach_pending_callback(std::function<void(uint16_t)> callback);
+    /// \brief Attaches a callback for handling received messages.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Attaches a callback for handling the closure of individual sessions on either path.
+    /// \param callback The callback to handle session closure.
+    /// \details See tcp_connection::attach_session_closed_callback.
+    void attach_session_closed_callback(std::function<void(tcp::endpoint)> callback);
+
+    // METHODS: IO
+    /// \brief Transmits a message on the active path, failing over to the other path if the send fails.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \param destination For TCP servers, the remote address of the session(s) to transmit to.
+    /// \return TRUE if the data was transmitted, otherwise FALSE.
+    bool tx(const uint8_t *data, uint32_t length, address destination = address());
+    /// \brief Closes a single session on either path as if its remote endpoint had broken it.
+    /// \param remote_endpoint The remote endpoint of the session to close.
+    /// \details See tcp_connection::close_session.
+    void close_session(tcp::endpoint remote_endpoint);
+
+    // PROPERTIES
+    /// \brief Gets the role of the bond.
+    /// \return The role of the bond.
+    tcp_role p_role() const;
+    /// \brief Gets the combined status of the bond's paths.
+    /// \return CONNECTED if any path is connected, PENDING if any path is pending, otherwise DISCONNECTED.
+    tcp_connection::status p_status() const;
+    /// \brief Gets the path that messages are currently sent on.
+    /// \return 0 for the primary path, 1 for the backup path.
+    /// \details The healthy path is preferred.  Until either path has been heard from, the connected path is used.
+    uint32_t p_active_path() const;
+    /// \brief Gets the traffic counters of the bond, summed over both paths.
+    /// \return A snapshot of the bond's counters.
+    connection_stats::snapshot p_stats() const;
+
+private:
+    // ENUMERATIONS
+    /// \brief Enumerates the types of message exchanged between bonded peers.
+    enum class message_type
+    {
+        DATA = 0,           ///< A data message.
+        PROBE = 1,          ///< A health probe request.
+        PROBE_REPLY = 2     ///< A health probe reply.
+    };
+
+    // VARIABLES: PATHS
+    /// \brief The primary [0] and backup [1] paths.
+    boost::shared_ptr<tcp_connection> m_paths[2];
+    /// \brief The local port of the bond.
+    uint16_t m_local_port;
+    /// \brief The last combined status reported through the callbacks.
+    tcp_connection::status m_status;
+    /// \brief Serializes the messages written to each path, so that concurrent sends cannot interleave their bytes.
+    boost::mutex m_mutex_tx[2];
+
+    // VARIABLES: HEALTH
+    /// \brief The time that traffic was last received on each path.
+    boost::posix_time::ptime m_last_heard[2];
+    /// \brief The time that the unanswered probe on each path was sent, or not_a_date_time if it was answered.
+    boost::posix_time::ptime m_probe_sent[2];
+    /// \brief Protects the path health state.
+    mutable boost::mutex m_mutex_paths;
+    /// \brief The interval between health probes.
+    boost::posix_time::time_duration m_probe_interval;
+    /// \brief The time without traffic after which a path is unhealthy.
+    boost::posix_time::time_duration m_probe_timeout;
+    /// \brief The timer for sending health probes.
+    boost::asio::deadline_timer m_timer_probe;
+
+    // VARIABLES: FRAMING
+    /// \brief The partially received messages of each path, by the remote endpoint of the session.
+    std::map<tcp::endpoint, std::vector<uint8_t>> m_partials[2];
+    /// \brief Protects the partially received messages.
+    boost::mutex m_mutex_rx;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when the bond becomes connected.
+    std::function<void(uint16_t)> m_connected_callback;
+    /// \brief The callback to raise when both paths are lost.
+    std::function<void(uint16_t)> m_pending_callback;
+    /// \brief The callback to raise when a message is received.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+    /// \brief The callback to raise when a session on either path closes.
+    std::function<void(tcp::endpoint)> m_session_closed_callback;
+
+    // METHODS
+    /// \brief Attaches the bond's status, rx, and session closed callbacks to a path.
+    /// \param path The path to attach to.
+    void attach_path(uint32_t path);
+    /// \brief Raises the bond's callbacks if its combined status has changed.
+    void update_status();
+    /// \brief Transmits a message with the bond header on a single path.
+    /// \param path The path to transmit on.
+    /// \param type The type of message.
+    /// \param data The payload of the message.
+    /// \param length The length of the payload in bytes.
+    /// \param destination For TCP servers, the remote address of the session(s) to transmit to.
+    /// \param wait Indicates if the send waits for another send on the path to finish, rather than being skipped.
+    /// \return TRUE if the message was transmitted, otherwise FALSE.
+    bool tx_path(uint32_t path, message_type type, const uint8_t* data, uint32_t length, address destination, bool wait);
+    /// \brief Checks if a path has received traffic within the probe timeout.
+    /// \param path The path to check.
+    /// \return TRUE if the path is healthy, otherwise FALSE.
+    /// \note m_mutex_paths must be held.
+    bool healthy(uint32_t path) const;
+    /// \brief Schedules the next round of health probes.
+    void schedule_probe();
+
+    // CALLBACKS
+    /// \brief The callback for handling data received on a path.
+    /// \param path The path that received the data.
+    /// \param type The protocol of the data.
+    /// \param port The local port of the path.
+    /// \param data The received data.  Ownership is taken.
+    /// \param length The length of the data in bytes.
+    /// \param source The source address of the data.
+    void rx_callback(uint32_t path, protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
+    /// \brief The callback for handling the closure of a session on a path.
+    /// \param path The path of the session.
+    /// \param session The remote endpoint of the session.
+    void session_closed_callback(uint32_t path, tcp::endpoint session);
+    /// \brief The callback for sending health probes.
+    /// \param error The error code provided by the timer.
+    void probe_callback(const boost::system::error_code& error);
+};
+
+#endif // TCP_BOND_H
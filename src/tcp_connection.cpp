@@ -1,27 +1,41 @@
 #include "tcp_connection.h"
+#include "host_resolver.h"
+#include "trace.h"
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 // CONSTRUCTORS
 tcp_connection::tcp_connection(boost::asio::io_service& io_service, tcp::endpoint local_endpoint, uint32_t buffer_size)
-    // Initialize socket and acceptor
-    : m_socket(io_service),
-      m_acceptor(io_service)
+    // Initialize service reference, acceptor, and timer
+    : m_service(io_service),
+      m_acceptor(io_service),
+      m_timer_reconnect(io_service)
 {
     // Store local endpoint for feeding socket (client) and acceptor (server) connections.
     tcp_connection::m_local_endpoint = local_endpoint;
 
-    // Dynamically allocate buffer.
+    // Store buffer size for creating sessions.
     tcp_connection::m_buffer_size = buffer_size;
-    tcp_connection::m_buffer = new uint8_t[buffer_size];
+
+    // Reconnect is disabled by default.
+    tcp_connection::m_reconnect = false;
+
+    // Dead peer detection uses system defaults by default.
+    tcp_connection::set_dead_peer_detection(false, 0.0, 0.0, 0, 0.0);
 
     // Initialize role and status.
     tcp_connection::m_role = tcp_role::UNASSIGNED;
     tcp_connection::m_status = tcp_connection::status::DISCONNECTED;
+
+    // Initialize the counters.
+    tcp_connection::m_stats = boost::shared_ptr<connection_stats>(new connection_stats());
+    tcp_connection::m_connected_before = false;
 }
 tcp_connection::~tcp_connection()
 {
-    delete [] tcp_connection::m_buffer;
+
 }
 
 // PUBLIC METHODS:  START/STOP
@@ -29,29 +43,30 @@ bool tcp_connection::start_server()
 {
     if(tcp_connection::m_status == tcp_connection::status::DISCONNECTED)
     {
-        // Open the acceptor
-        tcp_connection::m_acceptor.open(tcp_connection::m_local_endpoint.protocol());
-
-        // Instruct acceptor to reuse the address/port if it is still left open.
-        // NOTE: This can happen with TCP even after socket/acceptor is closed or deleted.
-        boost::asio::socket_base::reuse_address option(true);
-        tcp_connection::m_acceptor.set_option(option);
-
-        // Bind it to the local endpoint.
-        tcp_connection::m_acceptor.bind(tcp_connection::m_local_endpoint);
-
-        // Instruct acceptor to listen on local endpoint.
-        tcp_connection::m_acceptor.listen();
-
-        // Start asynchronously accepting connections.
-        tcp_connection::async_accept();
-
         // Set role.
         tcp_connection::m_role = tcp_role::SERVER;
 
         // Update status.
+        // NOTE: This must happen before listening, since a session may be accepted on the IO thread right away.
         tcp_connection::update_status(tcp_connection::status::PENDING);
 
+        // Start listening.
+        if(!tcp_connection::open_server())
+        {
+            if(tcp_connection::m_reconnect)
+            {
+                // Keep retrying to listen in the background.
+                tcp_connection::schedule_reconnect();
+            }
+            else
+            {
+                // Update status without signaling, since the failure is reported by the return value.
+                tcp_connection::update_status(tcp_connection::status::DISCONNECTED, false);
+
+                return false;
+            }
+        }
+
         return true;
     }
     else
@@ -63,53 +78,138 @@ bool tcp_connection::start_client(tcp::endpoint remote_endpoint)
 {
     if(tcp_connection::m_status == tcp_connection::status::DISCONNECTED)
     {
-        try
-        {
-            // Open the socket.
-            tcp_connection::m_socket.open(tcp_connection::m_local_endpoint.protocol());
-
-            // Instruct socket to reuse the address/port if it is still left open.
-            // NOTE: This can happen with TCP even after socket/acceptor is closed or deleted.
-            boost::asio::socket_base::reuse_address option(true);
-            tcp_connection::m_socket.set_option(option);
-
-            // Bind socket to the local endpoint.
-            tcp_connection::m_socket.bind(tcp_connection::m_local_endpoint);
-
-            // Start async connect attempt.
-            tcp_connection::m_socket.async_connect(remote_endpoint, boost::bind(&tcp_connection::connect_callback, tcp_connection::shared_from_this(), boost::placeholders::_1));
+        // Store remote endpoint for reconnection attempts.
+        tcp_connection::m_remote_endpoint = remote_endpoint;
 
-            // Set role.
-            tcp_connection::m_role = tcp_role::CLIENT;
+        // Set role.
+        tcp_connection::m_role = tcp_role::CLIENT;
 
-            // Update status.
-            tcp_connection::update_status(tcp_connection::status::PENDING);
+        // Update status.
+        // NOTE: This must happen before connecting, since the connection may complete on the IO thread right away.
+        tcp_connection::update_status(tcp_connection::status::PENDING);
 
-            return true;
-        }
-        catch (...)
+        // Start connecting.
+        if(!tcp_connection::open_client())
         {
-            // Update status.
-            tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+            if(tcp_connection::m_reconnect)
+            {
+                // Keep retrying to connect in the background.
+                tcp_connection::schedule_reconnect();
+            }
+            else
+            {
+                // Update status without signaling, since the failure is reported by the return value.
+                tcp_connection::update_status(tcp_connection::status::DISCONNECTED, false);
 
-            return false;
+                return false;
+            }
         }
+
+        return true;
     }
     else
     {
         return false;
     }
 }
-void tcp_connection::disconnect()
+bool tcp_connection::disconnect(double drain_timeout)
 {
+    // Stop any scheduled reconnect attempt.
+    tcp_connection::m_timer_reconnect.cancel();
     // If acceptor is open, close it.
-    tcp_connection::m_acceptor.close();
-    // Close the socket
-    tcp_connection::m_socket.close();
+    boost::system::error_code error;
+    tcp_connection::m_acceptor.close(error);
+    // Close the session being connected/accepted into.
+    if(tcp_connection::m_pending_session)
+    {
+        tcp_connection::m_pending_session->close();
+        tcp_connection::m_pending_session.reset();
+    }
 
     // Update status (and ultimately self-delete)
     // Do not raise signal, since this function is called externally.
+    // NOTE: This also refuses new transmissions and lifecycle signals from sessions closing while draining.
     tcp_connection::update_status(tcp_connection::status::DISCONNECTED, false);
+
+    // Wait for each session's queued data to be acknowledged.
+    bool drained = true;
+    if(drain_timeout > 0.0)
+    {
+        boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(static_cast<int64_t>(drain_timeout * 1000000.0));
+
+        std::list<boost::shared_ptr<tcp_session>> sessions;
+        {
+            boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+            sessions = tcp_connection::m_sessions;
+        }
+        for(auto it = sessions.begin(); it != sessions.end(); it++)
+        {
+            drained &= (*it)->drain(deadline);
+        }
+    }
+
+    // Close all connected sessions.
+    tcp_connection::close_sessions();
+
+    return drained;
+}
+void tcp_connection::set_reconnect(bool enabled, backoff policy)
+{
+    tcp_connection::m_reconnect = enabled;
+    tcp_connection::m_backoff = policy;
+}
+void tcp_connection::set_dead_peer_detection(bool keepalive, double keepalive_idle, double keepalive_interval, uint32_t keepalive_count, double user_timeout)
+{
+    tcp_connection::m_keepalive = keepalive;
+    tcp_connection::m_keepalive_idle = keepalive_idle;
+    tcp_connection::m_keepalive_interval = keepalive_interval;
+    tcp_connection::m_keepalive_count = keepalive_count;
+    tcp_connection::m_user_timeout = user_timeout;
+}
+void tcp_connection::set_tls(boost::shared_ptr<tls_context> context, const std::string &host)
+{
+    tcp_connection::m_tls = context;
+    tcp_connection::m_tls_host = host;
+}
+bool tcp_connection::set_remote_endpoint(tcp::endpoint remote_endpoint, const std::string &host)
+{
+    // Only clients have a remote endpoint to retarget.
+    if(tcp_connection::m_role != tcp_role::CLIENT)
+    {
+        return false;
+    }
+
+    // Store the new remote endpoint for this and any future reconnect attempts.
+    tcp_connection::m_remote_endpoint = remote_endpoint;
+    tcp_connection::m_tls_host = host;
+
+    // Abandon any scheduled or in-flight attempt to the old endpoint.
+    tcp_connection::m_timer_reconnect.cancel();
+    if(tcp_connection::m_pending_session)
+    {
+        tcp_connection::m_pending_session->close();
+        tcp_connection::m_pending_session.reset();
+    }
+    // Close the session to the old endpoint.
+    tcp_connection::close_sessions();
+
+    // Connect to the new endpoint immediately rather than after backoff.
+    tcp_connection::m_backoff.reset();
+    tcp_connection::update_status(tcp_connection::status::PENDING);
+    if(tcp_connection::open_client())
+    {
+        return true;
+    }
+    else if(tcp_connection::m_reconnect)
+    {
+        tcp_connection::schedule_reconnect();
+        return true;
+    }
+    else
+    {
+        tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+        return false;
+    }
 }
 
 // PUBLIC METHODS: CALLBACK ATTACHMENT
@@ -117,6 +217,10 @@ void tcp_connection::attach_connected_callback(std::function<void (uint16_t)> ca
 {
     tcp_connection::m_connected_callback = callback;
 }
+void tcp_connection::attach_pending_callback(std::function<void(uint16_t)> callback)
+{
+    tcp_connection::m_pending_callback = callback;
+}
 void tcp_connection::attach_disconnected_callback(std::function<void(uint16_t)> callback)
 {
     tcp_connection::m_disconnected_callback = callback;
@@ -125,47 +229,250 @@ void tcp_connection::attach_rx_callback(std::function<void(protocol, uint16_t, u
 {
     tcp_connection::m_rx_callback = callback;
 }
+void tcp_connection::attach_session_closed_callback(std::function<void(tcp::endpoint)> callback)
+{
+    tcp_connection::m_session_closed_callback = callback;
+}
 
 // PUBLIC METHODS: IO
-bool tcp_connection::tx(const uint8_t *data, uint32_t length)
+bool tcp_connection::tx(const uint8_t *data, uint32_t length, address destination)
 {
     // Check if connection is active.
     if(tcp_connection::m_status == tcp_connection::status::CONNECTED)
     {
-        // Send message with error reporting.
-        boost::system::error_code error;
-        tcp_connection::m_socket.send(boost::asio::buffer(data, length), 0, error);
+        // Copy the session list so sessions closing during transmit can remove themselves.
+        std::list<boost::shared_ptr<tcp_session>> sessions;
+        {
+            boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+            sessions = tcp_connection::m_sessions;
+        }
 
-        // Check if error is broken_pipe, indicating connection broken.
-        if(error.value() == boost::system::errc::broken_pipe)
+        // Send message to each targeted session.
+        bool transmitted = false;
+        for(auto it = sessions.begin(); it != sessions.end(); it++)
         {
-            // Connection is broken.  Update status.
-            tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+            if(destination.is_unspecified() || host_resolver::normalize((*it)->p_remote_endpoint().address()) == host_resolver::normalize(destination))
+            {
+                transmitted |= (*it)->tx(data, length);
+            }
         }
 
-        return true;
+        if(transmitted)
+        {
+            tcp_connection::m_stats->record_tx(length);
+        }
+        else
+        {
+            tcp_connection::m_stats->record_tx_error();
+        }
+
+        return transmitted;
     }
     else
     {
+        // Messages sent while the connection is down are discarded.
+        tcp_connection::m_stats->record_drop();
         return false;
     }
 }
+void tcp_connection::close_session(tcp::endpoint remote_endpoint)
+{
+    boost::shared_ptr<tcp_session> session;
+    {
+        boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+        for(auto it = tcp_connection::m_sessions.begin(); it != tcp_connection::m_sessions.end(); it++)
+        {
+            if((*it)->p_remote_endpoint() == remote_endpoint)
+            {
+                session = *it;
+                break;
+            }
+        }
+    }
+
+    // Defer the close, since the session may be in the middle of delivering data.
+    if(session)
+    {
+        tcp_connection::m_service.post(boost::bind(&tcp_session::abort, session));
+    }
+}
 
 // PRIVATE METHODS
+bool tcp_connection::open_server()
+{
+    try
+    {
+        // Open the acceptor
+        tcp_connection::m_acceptor.open(tcp_connection::m_local_endpoint.protocol());
+
+        // Instruct acceptor to reuse the address/port if it is still left open.
+        // NOTE: This can happen with TCP even after socket/acceptor is closed or deleted.
+        boost::asio::socket_base::reuse_address option(true);
+        tcp_connection::m_acceptor.set_option(option);
+
+        // Accept IPv4 clients on IPv6 acceptors for dual-stack operation.
+        if(tcp_connection::m_local_endpoint.address().is_v6())
+        {
+            boost::asio::ip::v6_only v6_option(false);
+            tcp_connection::m_acceptor.set_option(v6_option);
+        }
+
+        // Bind it to the local endpoint.
+        tcp_connection::m_acceptor.bind(tcp_connection::m_local_endpoint);
+
+        // Instruct acceptor to listen on local endpoint.
+        tcp_connection::m_acceptor.listen();
+
+        // Start asynchronously accepting connections.
+        tcp_connection::async_accept();
+
+        return true;
+    }
+    catch (...)
+    {
+        // Close the acceptor so it can be reopened.
+        boost::system::error_code error;
+        tcp_connection::m_acceptor.close(error);
+
+        return false;
+    }
+}
+bool tcp_connection::open_client()
+{
+    try
+    {
+        // Create the session to connect with.
+        tcp_connection::m_pending_session = tcp_connection::create_session();
+        tcp::socket& socket = tcp_connection::m_pending_session->p_socket();
+
+        // Open the socket.
+        socket.open(tcp_connection::m_local_endpoint.protocol());
+
+        // Instruct socket to reuse the address/port if it is still left open.
+        // NOTE: This can happen with TCP even after socket/acceptor is closed or deleted.
+        boost::asio::socket_base::reuse_address option(true);
+        socket.set_option(option);
+
+        // Allow IPv6 sockets to connect to IPv4-mapped addresses for dual-stack operation.
+        if(tcp_connection::m_local_endpoint.address().is_v6())
+        {
+            boost::asio::ip::v6_only v6_option(false);
+            socket.set_option(v6_option);
+        }
+
+        // Bind socket to the local endpoint.
+        socket.bind(tcp_connection::m_local_endpoint);
+
+        // Start async connect attempt.
+        socket.async_connect(tcp_connection::m_remote_endpoint, boost::bind(&tcp_connection::connect_callback, tcp_connection::shared_from_this(), tcp_connection::m_pending_session, boost::placeholders::_1));
+
+        return true;
+    }
+    catch (...)
+    {
+        // Discard the session.
+        tcp_connection::m_pending_session->close();
+        tcp_connection::m_pending_session.reset();
+
+        return false;
+    }
+}
 void tcp_connection::async_accept()
 {
-    tcp_connection::m_acceptor.async_accept(tcp_connection::m_socket, boost::bind(&tcp_connection::accept_callback, tcp_connection::shared_from_this(), boost::placeholders::_1));
+    // Create a new session to accept into.
+    tcp_connection::m_pending_session = tcp_connection::create_session();
+
+    tcp_connection::m_acceptor.async_accept(tcp_connection::m_pending_session->p_socket(), boost::bind(&tcp_connection::accept_callback, tcp_connection::shared_from_this(), tcp_connection::m_pending_session, boost::placeholders::_1));
+}
+void tcp_connection::schedule_reconnect()
+{
+    tcp_connection::m_timer_reconnect.expires_from_now(tcp_connection::m_backoff.next());
+    tcp_connection::m_timer_reconnect.async_wait(boost::bind(&tcp_connection::reconnect_callback, tcp_connection::shared_from_this(), boost::placeholders::_1));
+}
+boost::shared_ptr<tcp_session> tcp_connection::create_session()
+{
+    boost::shared_ptr<tcp_session> session = boost::shared_ptr<tcp_session>(new tcp_session(tcp_connection::m_service, tcp_connection::m_buffer_size));
+
+    // Encrypt the session, accepting the handshake as a server or initiating it as a client.
+    // Clients without a hostname verify the server against the address they connect to.
+    if(tcp_connection::m_tls)
+    {
+        std::string host = tcp_connection::m_tls_host;
+        if(host.empty() && tcp_connection::m_role == tcp_role::CLIENT)
+        {
+            address remote_ip = host_resolver::normalize(tcp_connection::m_remote_endpoint.address());
+            if(remote_ip.is_v6())
+            {
+                // Link-local scopes are not part of a certificate's IP address.
+                address_v6 remote_v6 = remote_ip.to_v6();
+                remote_v6.scope_id(0);
+                remote_ip = remote_v6;
+            }
+            host = remote_ip.to_string();
+        }
+        session->set_tls(tcp_connection::m_tls, tcp_connection::m_role == tcp_role::SERVER, host);
+    }
+
+    // Attach established and closed callbacks.
+    session->attach_established_callback(boost::bind(&tcp_connection::session_established_callback, tcp_connection::shared_from_this(), boost::placeholders::_1));
+    session->attach_closed_callback(boost::bind(&tcp_connection::session_closed_callback, tcp_connection::shared_from_this(), boost::placeholders::_1));
+    // NOTE: rx callback is forwarded from external.
+    session->attach_rx_callback(tcp_connection::m_rx_callback);
+    session->set_stats(tcp_connection::m_stats);
+
+    return session;
+}
+bool tcp_connection::add_session(boost::shared_ptr<tcp_session> session)
+{
+    // Track the session until it is established.
+    {
+        boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+        tcp_connection::m_starting_sessions.push_back(session);
+    }
+
+    // Configure dead peer detection on the established socket.
+    // NOTE: This happens before starting, so it also covers the TLS handshake.
+    if(tcp_connection::m_keepalive)
+    {
+        session->set_keepalive(tcp_connection::m_keepalive_idle, tcp_connection::m_keepalive_interval, tcp_connection::m_keepalive_count);
+    }
+    if(tcp_connection::m_user_timeout > 0.0)
+    {
+        session->set_user_timeout(tcp_connection::m_user_timeout);
+    }
+
+    // Start the session, which raises the established callback once it is ready for data.
+    if(!session->start())
+    {
+        boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+        tcp_connection::m_starting_sessions.remove(session);
+
+        return false;
+    }
+
+    return true;
 }
-void tcp_connection::async_rx()
+void tcp_connection::close_sessions()
 {
-    tcp_connection::m_socket.async_receive(boost::asio::buffer(tcp_connection::m_buffer, tcp_connection::m_buffer_size),
-                                           boost::bind(&tcp_connection::rx_callback, tcp_connection::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+
+    for(auto it = tcp_connection::m_starting_sessions.begin(); it != tcp_connection::m_starting_sessions.end(); it++)
+    {
+        (*it)->close();
+    }
+    tcp_connection::m_starting_sessions.clear();
+    for(auto it = tcp_connection::m_sessions.begin(); it != tcp_connection::m_sessions.end(); it++)
+    {
+        (*it)->close();
+    }
+    tcp_connection::m_sessions.clear();
 }
 void tcp_connection::update_status(status new_status, bool signal)
 {
     if(new_status != tcp_connection::m_status)
     {
         // Update status flag.
+        status old_status = tcp_connection::m_status;
         tcp_connection::m_status = new_status;
 
         switch(new_status)
@@ -185,17 +492,29 @@ void tcp_connection::update_status(status new_status, bool signal)
         }
         case tcp_connection::status::CONNECTED:
         {
+            // Count connections after the first as reconnects.
+            if(tcp_connection::m_connected_before)
+            {
+                tcp_connection::m_stats->record_reconnect();
+            }
+            tcp_connection::m_connected_before = true;
+
             // Raise connected handler.
             if(signal && tcp_connection::m_connected_callback)
             {
-                tcp_connection::m_connected_callback(tcp_connection::m_socket.local_endpoint().port());
+                tcp_connection::m_connected_callback(tcp_connection::m_local_endpoint.port());
             }
 
             break;
         }
         case tcp_connection::status::PENDING:
         {
-            // Do nothing else specific.
+            // Raise pending handler if an established connection was lost.
+            if(signal && old_status == tcp_connection::status::CONNECTED && tcp_connection::m_pending_callback)
+            {
+                tcp_connection::m_pending_callback(tcp_connection::m_local_endpoint.port());
+            }
+
             break;
         }
         }
@@ -211,93 +530,191 @@ tcp_connection::status tcp_connection::p_status() const
 {
     return tcp_connection::m_status;
 }
-tcp::endpoint tcp_connection::p_remote_endpoint() const
+std::vector<tcp::endpoint> tcp_connection::p_remote_endpoints() const
+{
+    std::vector<tcp::endpoint> output;
+
+    boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+    for(auto it = tcp_connection::m_sessions.cbegin(); it != tcp_connection::m_sessions.cend(); it++)
+    {
+        output.push_back((*it)->p_remote_endpoint());
+    }
+
+    return output;
+}
+connection_stats::snapshot tcp_connection::p_stats() const
 {
-    return tcp_connection::m_socket.remote_endpoint();
+    connection_stats::snapshot output = tcp_connection::m_stats->p_snapshot();
+
+    // Add the kernel queues of every established session.
+    boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+    for(auto it = tcp_connection::m_sessions.cbegin(); it != tcp_connection::m_sessions.cend(); it++)
+    {
+        connection_stats::add_queues((*it)->p_socket().native_handle(), true, output);
+    }
+
+    return output;
 }
 
 // CALLBACKS
-void tcp_connection::accept_callback(const boost::system::error_code &error)
+void tcp_connection::accept_callback(boost::shared_ptr<tcp_session> session, const boost::system::error_code &error)
 {
-    // Check if the socket is still open.
-    // Closing the socket stops async operations, but callback handlers can still be in io_service queue.
-    if(tcp_connection::m_socket.is_open())
+    // Check if the acceptor is still open.
+    // Closing the acceptor stops async operations, but callback handlers can still be in io_service queue.
+    if(tcp_connection::m_acceptor.is_open() && error != boost::asio::error::operation_aborted)
     {
         if(!error)
         {
-            // Connection has been made.  Update status.
-            tcp_connection::update_status(tcp_connection::status::CONNECTED);
-
-            // Start first asynchronous read.
-            tcp_connection::async_rx();
+            // A new session has been accepted.
+            TRACE_INSTANT("accept", tcp_connection::m_local_endpoint.port());
+            tcp_connection::add_session(session);
         }
-        else
+        else if(tcp_connection::m_reconnect)
         {
-            // Restart async_accept
-            tcp_connection::async_accept();
+            // The listener has failed.  Close and re-listen after backoff.
+            boost::system::error_code close_error;
+            tcp_connection::m_acceptor.close(close_error);
+            tcp_connection::schedule_reconnect();
+            return;
         }
+
+        // Continue accepting new sessions.
+        tcp_connection::async_accept();
     }
 }
-void tcp_connection::connect_callback(const boost::system::error_code &error)
+void tcp_connection::connect_callback(boost::shared_ptr<tcp_session> session, const boost::system::error_code &error)
 {
     // Check if the socket is still open.
     // Closing the socket stops async operations, but callback handlers can still be in io_service queue.
-    if(tcp_connection::m_socket.is_open())
+    if(session->p_socket().is_open())
     {
-        if(!error)
-        {
-            // Client has successfully connected to a server.  Update status.
-            tcp_connection::update_status(tcp_connection::status::CONNECTED);
+        // Connection attempt has completed.
+        tcp_connection::m_pending_session.reset();
+        TRACE_INSTANT(error ? "connect_failed" : "connect", tcp_connection::m_local_endpoint.port());
 
-            // Start first asynchronous read.
-            tcp_connection::async_rx();
+        // If the client has successfully connected to a server, add the session.
+        if(error || !tcp_connection::add_session(session))
+        {
+            if(tcp_connection::m_reconnect)
+            {
+                // Connection failed.  Retry after backoff.
+                session->close();
+                tcp_connection::schedule_reconnect();
+            }
+            else
+            {
+                // Connection failed.  Update status.
+                tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+            }
         }
-        else
+    }
+}
+void tcp_connection::reconnect_callback(const boost::system::error_code &error)
+{
+    // Ignore cancelled timers and connections that have since been disconnected.
+    if(error || tcp_connection::m_status != tcp_connection::status::PENDING)
+    {
+        return;
+    }
+
+    bool opened = false;
+    switch(tcp_connection::m_role)
+    {
+    case tcp_role::SERVER:
+    {
+        opened = tcp_connection::m_acceptor.is_open() || tcp_connection::open_server();
+        break;
+    }
+    case tcp_role::CLIENT:
+    {
+        opened = tcp_connection::open_client();
+        break;
+    }
+    case tcp_role::UNASSIGNED:
+    {
+        return;
+    }
+    }
+
+    // Try again later if the attempt could not be started.
+    if(!opened)
+    {
+        tcp_connection::schedule_reconnect();
+    }
+}
+void tcp_connection::session_established_callback(boost::shared_ptr<tcp_session> session)
+{
+    // Move the session to the list of connected sessions.
+    // NOTE: A session that is no longer starting was closed by disconnect() while its handshake was in flight.
+    {
+        boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+        auto it = std::find(tcp_connection::m_starting_sessions.begin(), tcp_connection::m_starting_sessions.end(), session);
+        if(it == tcp_connection::m_starting_sessions.end())
         {
-            // Connection failed.  Update status.
-            tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+            return;
         }
+        tcp_connection::m_starting_sessions.erase(it);
+        tcp_connection::m_sessions.push_back(session);
     }
+
+    // Connection is established, so restart the backoff for the next outage.
+    tcp_connection::m_backoff.reset();
+
+    // Update status.  Only signals on the first session.
+    tcp_connection::update_status(tcp_connection::status::CONNECTED);
 }
-void tcp_connection::rx_callback(const boost::system::error_code &error, std::size_t bytes_read)
+void tcp_connection::session_closed_callback(boost::shared_ptr<tcp_session> session)
 {
-    // Check if the socket is still open.
-    // Closing the socket stops async operations, but callback handlers can still be in io_service queue.
-    if(tcp_connection::m_socket.is_open())
+    // Remove the session from the lists.
+    bool established;
+    bool sessions_empty;
     {
-        // Make sure there are no errors, and that the rx callback is attached.
-        if(!error)
+        boost::mutex::scoped_lock lock(tcp_connection::m_mutex_sessions);
+        established = std::find(tcp_connection::m_sessions.begin(), tcp_connection::m_sessions.end(), session) != tcp_connection::m_sessions.end();
+        tcp_connection::m_starting_sessions.remove(session);
+        tcp_connection::m_sessions.remove(session);
+        sessions_empty = tcp_connection::m_sessions.empty();
+    }
+    if(tcp_connection::m_session_closed_callback)
+    {
+        tcp_connection::m_session_closed_callback(session->p_remote_endpoint());
+    }
+
+    // A client session that closes before being established, such as from a failed TLS handshake, is a failed connection attempt.
+    // NOTE: Servers simply continue accepting.
+    if(!established)
+    {
+        if(tcp_connection::m_role == tcp_role::CLIENT && tcp_connection::m_status == tcp_connection::status::PENDING)
         {
-            if(tcp_connection::m_rx_callback)
+            if(tcp_connection::m_reconnect)
             {
-                // Deep copy the data into a new output array.
-                uint8_t* output_array = new uint8_t[bytes_read];
-                std::memcpy(output_array, tcp_connection::m_buffer, bytes_read);
-
-                // Raise the callback.
-                // NOTE: Upon connection, the remote endpoint is stored in m_socket.
-                tcp_connection::m_rx_callback(protocol::TCP,
-                                              tcp_connection::m_socket.local_endpoint().port(),
-                                              output_array,
-                                              static_cast<uint32_t>(bytes_read),
-                                              tcp_connection::m_socket.remote_endpoint().address());
+                tcp_connection::schedule_reconnect();
             }
-
-            // Start a new asynchronous receive.
-            tcp_connection::async_rx();
-        }
-        else
-        {
-            if(error == boost::asio::error::eof || error == boost::asio::error::connection_reset || error == boost::asio::error::connection_aborted)
+            else
             {
-                // Connection has been closed from the other end.
                 tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
             }
-            // Only other acceptable error is operation_aborted, which is caused by connection closed from this end.
-            else if(error != boost::asio::error::operation_aborted)
+        }
+        return;
+    }
+
+    // The connection is lost once its last session has closed.
+    if(sessions_empty && tcp_connection::m_status == tcp_connection::status::CONNECTED)
+    {
+        if(tcp_connection::m_reconnect)
+        {
+            // Return to pending while the connection is re-established.
+            tcp_connection::update_status(tcp_connection::status::PENDING);
+
+            // Servers continue listening, while clients must reconnect.
+            if(tcp_connection::m_role == tcp_role::CLIENT)
             {
-                throw std::runtime_error("tcp_connection::rx_callback: " + error.message());
+                tcp_connection::schedule_reconnect();
             }
         }
+        else
+        {
+            tcp_connection::update_status(tcp_connection::status::DISCONNECTED);
+        }
     }
 }
@@ -3,17 +3,24 @@
 #ifndef TCP_CONNECTION_H
 #define TCP_CONNECTION_H
 
+#include "tcp_session.h"
+#include "backoff.h"
+
 #include "driver_modem/protocol.h"
 #include "driver_modem/tcp_role.h"
 
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
 #include <functional>
+#include <list>
 
 using namespace boost::asio::ip;
 using namespace driver_modem;
 
-/// \brief Provides a single asynchronous TCP connection for a specific IP address and port.
+/// \brief Provides an asynchronous TCP connection for a specific IP address and port.
+/// \details As a client, the connection holds a single session with the remote server.
+/// As a server, the connection accepts any number of concurrent sessions from remote clients.
 class tcp_connection
         : public boost::enable_shared_from_this<tcp_connection>
 {
@@ -42,30 +49,81 @@ public:
     bool start_client(tcp::endpoint remote_endpoint);
     /// \brief Asynchronously starts the connection as a TCP server.
     /// \return TRUE if the listening process was started, otherwise FALSE.
+    /// \details The server continues to accept new sessions while existing sessions are connected.
     bool start_server();
     /// \brief Disconnects the connection.
-    void disconnect();
+    /// \param drain_timeout The maximum time in seconds to wait for queued data to be acknowledged before closing sessions.
+    /// \details New transmissions are refused as soon as this method is called.
+    /// \return TRUE if all queued data was acknowledged, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
+    /// \brief Configures automatic re-establishment of the connection.
+    /// \param enabled Indicates if the connection should automatically reconnect (client) or re-listen (server).
+    /// \param policy The backoff policy for spacing re-establishment attempts.
+    /// \details When enabled, the connection remains PENDING instead of DISCONNECTED when
+    /// a connection attempt fails or the last session is lost.
+    void set_reconnect(bool enabled, backoff policy = backoff());
+    /// \brief Configures dead peer detection for the connection's sessions.
+    /// \param keepalive Indicates if keepalive probes are sent on idle sessions.
+    /// \param keepalive_idle The idle time in seconds before the first keepalive probe.
+    /// \param keepalive_interval The time in seconds between unanswered keepalive probes.
+    /// \param keepalive_count The number of unanswered keepalive probes before a session is closed.
+    /// \param user_timeout The maximum time in seconds that transmitted data may remain unacknowledged before a session is closed.
+    /// Zero uses the system default.
+    /// \details Applies to sessions established after this method is called.
+    void set_dead_peer_detection(bool keepalive, double keepalive_idle, double keepalive_interval, uint32_t keepalive_count, double user_timeout);
+    /// \brief Encrypts the connection's sessions with TLS.
+    /// \param context The TLS configuration, or null for plain sessions.
+    /// \param host For clients, the hostname or IP address that the server's certificate must be issued to.
+    /// If empty, the certificate must be issued to the remote endpoint's IP address.
+    /// \details Applies to sessions established after this method is called.  Sessions count as connected once
+    /// their handshake completes, and a client whose handshake fails is treated as a failed connection attempt.
+    void set_tls(boost::shared_ptr<tls_context> context, const std::string& host = "");
+    /// \brief Retargets a client connection to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint to connect to.
+    /// \param host The hostname or IP address that the new server's TLS certificate must be issued to.
+    /// If empty, the certificate must be issued to the remote endpoint's IP address.
+    /// \return TRUE if the client is reconnecting to the new endpoint, FALSE if the connection is not a client or could not reconnect.
+    /// \details Any existing session is closed and the connection returns to PENDING while it
+    /// immediately connects to the new endpoint.  Must be called on the IO thread once it is running, since the
+    /// connection's sessions, reconnect timer, and backoff are otherwise only touched by its handlers.
+    bool set_remote_endpoint(tcp::endpoint remote_endpoint, const std::string& host = "");
 
     // METHODS: CALLBACK ATTACHMENT
     /// \brief Attaches a callback for handling new connection events.
     /// \param callback The callback to handle new connection events.
-    /// \details The callback is raised whenever a new connection is established after start_client() or start_server() is called.
+    /// \details The callback is raised when the first session is established after start_client() or start_server() is called.
     void attach_connected_callback(std::function<void(uint16_t)> callback);
+    /// \brief Attaches a callback for handling connections returning to pending.
+    /// \param callback The callback to handle pending events.
+    /// \details The callback is raised when the last session is lost and the connection is re-establishing itself.
+    void attach_pending_callback(std::function<void(uint16_t)> callback);
     /// \brief Attaches a callback for handling disconnection events.
     /// \param callback The callback to handle disconnection events.
-    /// \details The callback is raised whenever the connection is lost or disconnected from the other side.
+    /// \details The callback is raised when the last session is lost or disconnected from the other side.
     /// It is NOT raised when the disconnect() method is called.
     void attach_disconnected_callback(std::function<void(uint16_t)> callback);
     /// \brief Attaches a callback for handling received messages.
     /// \param callback The callback to handle received messages.
     void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Attaches a callback for handling the closure of individual sessions.
+    /// \param callback The callback to handle session closure, which receives the session's remote endpoint.
+    /// \details The callback is raised when the remote endpoint closes or breaks a session, even if other
+    /// sessions remain.  It is NOT raised for sessions closed by disconnect() or set_remote_endpoint().
+    void attach_session_closed_callback(std::function<void(tcp::endpoint)> callback);
 
     // METHODS: IO
-    /// \brief Transmits data to the remote endpoint.
+    /// \brief Transmits data to the remote endpoint(s).
     /// \param data The data to transmit.
     /// \param length The length of the data in bytes.
-    /// \return TRUE if the data was transmitted, otherwise FALSE.
-    bool tx(const uint8_t *data, uint32_t length);
+    /// \param destination The remote address of the session(s) to transmit to.
+    /// An unspecified address transmits to all sessions.
+    /// \return TRUE if the data was transmitted to at least one session, otherwise FALSE.
+    bool tx(const uint8_t *data, uint32_t length, address destination = address());
+    /// \brief Closes a single session as if its remote endpoint had broken it.
+    /// \param remote_endpoint The remote endpoint of the session to close.
+    /// \details The session is closed on the IO thread after the current handler returns, so this may be called from
+    /// the rx callback.  The session closed callback is raised, and clients reconnect as configured.
+    void close_session(tcp::endpoint remote_endpoint);
 
     // PROPERTIES
     /// \brief Gets the current role of the connection.
@@ -74,24 +132,61 @@ public:
     /// \brief Gets the status of the connection.
     /// \return The current status of the connection.
     status p_status() const;
-    /// \brief Gets the remote endpoint of the connection.
-    /// \return The remote endpoint of the connection.
-    tcp::endpoint p_remote_endpoint() const;
+    /// \brief Gets the remote endpoints of the connection's sessions.
+    /// \return The remote endpoints of all connected sessions.
+    std::vector<tcp::endpoint> p_remote_endpoints() const;
+    /// \brief Gets the traffic counters of the connection, summed over all of its sessions.
+    /// \return A snapshot of the connection's counters.
+    connection_stats::snapshot p_stats() const;
 
 private:
     // VARIABLES: SOCKET
-    /// \brief The socket implementing the TCP connection.
-    tcp::socket m_socket;
+    /// \brief The global IO service that sessions are created on.
+    boost::asio::io_service& m_service;
     /// \brief A TCP acceptor that listens for and accepts connections.
     tcp::acceptor m_acceptor;
     /// \brief The local endpoint assigned to the connection.
     tcp::endpoint m_local_endpoint;
-
-    // VARIABLES: RX BUFFER
-    /// \brief The internal buffer for storing received messages.
-    uint8_t* m_buffer;
-    /// \brief The size of the internal buffer in bytes.
+    /// \brief The size of each session's RX buffer in bytes.
     uint32_t m_buffer_size;
+    /// \brief The remote endpoint that the client connects to.
+    tcp::endpoint m_remote_endpoint;
+
+    // VARIABLES: RECONNECT
+    /// \brief Indicates if the connection automatically re-establishes itself.
+    bool m_reconnect;
+    /// \brief The backoff policy for re-establishment attempts.
+    backoff m_backoff;
+    /// \brief The timer for scheduling re-establishment attempts.
+    boost::asio::deadline_timer m_timer_reconnect;
+
+    // VARIABLES: DEAD PEER DETECTION
+    /// \brief Indicates if keepalive probes are sent on idle sessions.
+    bool m_keepalive;
+    /// \brief The idle time in seconds before the first keepalive probe.
+    double m_keepalive_idle;
+    /// \brief The time in seconds between unanswered keepalive probes.
+    double m_keepalive_interval;
+    /// \brief The number of unanswered keepalive probes before a session is closed.
+    uint32_t m_keepalive_count;
+    /// \brief The maximum time in seconds that transmitted data may remain unacknowledged.
+    double m_user_timeout;
+
+    // VARIABLES: TLS
+    /// \brief The TLS configuration of new sessions, or null for plain sessions.
+    boost::shared_ptr<tls_context> m_tls;
+    /// \brief The hostname or IP address that a client verifies the server's certificate against.
+    std::string m_tls_host;
+
+    // VARIABLES: SESSIONS
+    /// \brief The session currently being connected (client) or accepted into (server).
+    boost::shared_ptr<tcp_session> m_pending_session;
+    /// \brief The list of sessions that are connected but not yet established, such as during the TLS handshake.
+    std::list<boost::shared_ptr<tcp_session>> m_starting_sessions;
+    /// \brief The list of connected sessions.
+    std::list<boost::shared_ptr<tcp_session>> m_sessions;
+    /// \brief Protects the session list between the IO thread and transmitting threads.
+    mutable boost::mutex m_mutex_sessions;
 
     // VARIABLES: FLAGS
     /// \brief Stores the current role of the connection.
@@ -99,19 +194,44 @@ private:
     /// \brief Stores the current status of the connection.
     status m_status;
 
+    // VARIABLES: STATS
+    /// \brief The traffic counters, shared with the connection's sessions.
+    boost::shared_ptr<connection_stats> m_stats;
+    /// \brief Indicates if the connection has been established before, so later connections count as reconnects.
+    bool m_connected_before;
+
     // VARIABLES: CALLBACKS
     /// \brief The callback to raise when a new connection event occurs.
     std::function<void(uint16_t)> m_connected_callback;
+    /// \brief The callback to raise when a connection returns to pending.
+    std::function<void(uint16_t)> m_pending_callback;
     /// \brief The callback to raise when a new disconnection event occurs.
     std::function<void(uint16_t)> m_disconnected_callback;
     /// \brief The callback to raise when a message is received.
     std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+    /// \brief The callback to raise when a session is closed.
+    std::function<void(tcp::endpoint)> m_session_closed_callback;
 
     // METHODS: SOCKET
+    /// \brief Opens the acceptor and starts accepting connections in SERVER mode.
+    /// \return TRUE if the acceptor is listening, otherwise FALSE.
+    bool open_server();
+    /// \brief Opens a new session and starts connecting to the remote endpoint in CLIENT mode.
+    /// \return TRUE if the connection attempt was started, otherwise FALSE.
+    bool open_client();
     /// \brief Initiates an asynchronous listen/acceptance of new connections in SERVER mode
     void async_accept();
-    /// \brief Initiates an asynchronous read of a single TCP packet.
-    void async_rx();
+    /// \brief Schedules the next re-establishment attempt according to the backoff policy.
+    void schedule_reconnect();
+    /// \brief Creates a new session with the connection's callbacks attached.
+    /// \return The new session.
+    boost::shared_ptr<tcp_session> create_session();
+    /// \brief Starts a connected session, which is added to the session list once established.
+    /// \param session The session to add.
+    /// \return TRUE if the session was started, otherwise FALSE.
+    bool add_session(boost::shared_ptr<tcp_session> session);
+    /// \brief Closes and removes all sessions.
+    void close_sessions();
 
     // METHODS:
     /// \brief Updates the status of the connection, raising callbacks as necessary.
@@ -121,15 +241,22 @@ private:
 
     // CALLBACKS
     /// \brief The callback for handling newly accepted connections from async_accept().
+    /// \param session The session that was accepted into.
     /// \param error The error passed back from the async_accept() method.
-    void accept_callback(const boost::system::error_code& error);
+    void accept_callback(boost::shared_ptr<tcp_session> session, const boost::system::error_code& error);
     /// \brief The callback for handling new connections from asynchronous connect calls.
+    /// \param session The session that was connected.
     /// \param error The error passed back from the async connect method.
-    void connect_callback(const boost::system::error_code& error);
-    /// \brief The internal callback for handling messages received asynchronously.
-    /// \param error The error code provided by the async read operation.
-    /// \param bytes_read The number of bytes ready by the async read operation.
-    void rx_callback(const boost::system::error_code& error, std::size_t bytes_read);
+    void connect_callback(boost::shared_ptr<tcp_session> session, const boost::system::error_code& error);
+    /// \brief The callback for handling scheduled re-establishment attempts.
+    /// \param error The error passed back from the reconnect timer.
+    void reconnect_callback(const boost::system::error_code& error);
+    /// \brief The callback for handling sessions that have been established.
+    /// \param session The session that was established.
+    void session_established_callback(boost::shared_ptr<tcp_session> session);
+    /// \brief The callback for handling sessions closed by the remote endpoint.
+    /// \param session The session that was closed.
+    void session_closed_callback(boost::shared_ptr<tcp_session> session);
 };
 
 #endif // TCP_CONNECTION_H
@@ -0,0 +1,484 @@
+#include "tcp_session.h"
+#include "latency_histogram.h"
+#include "trace.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <openssl/err.h>
+
+#include <algorithm>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+
+namespace
+{
+    /// \brief The remote endpoint of the session delivering data on this thread.
+    thread_local tcp::endpoint rx_endpoint_current;
+}
+
+// CONSTRUCTORS
+tcp_session::tcp_session(boost::asio::io_service& io_service, uint32_t buffer_size)
+    // Initialize socket.
+    : m_socket(io_service)
+{
+    // Dynamically allocate buffer.
+    tcp_session::m_buffer_size = buffer_size;
+    tcp_session::m_buffer = new uint8_t[buffer_size];
+
+    tcp_session::m_local_port = 0;
+
+    // Sessions are plain unless TLS is set.
+    tcp_session::m_tls_server = false;
+    tcp_session::m_tls = nullptr;
+    tcp_session::m_tls_established = false;
+    tcp_session::m_ktls_send = false;
+}
+tcp_session::~tcp_session()
+{
+    delete [] tcp_session::m_buffer;
+
+    // NOTE: The socket's file descriptor is not owned by the TLS state.
+    SSL_free(tcp_session::m_tls);
+}
+
+// PUBLIC METHODS: START/STOP
+void tcp_session::set_tls(boost::shared_ptr<tls_context> context, bool server, const std::string &host)
+{
+    tcp_session::m_tls_context = context;
+    tcp_session::m_tls_server = server;
+    tcp_session::m_tls_host = host;
+}
+void tcp_session::set_stats(boost::shared_ptr<connection_stats> stats)
+{
+    tcp_session::m_stats = stats;
+}
+bool tcp_session::start()
+{
+    // Capture endpoints while the socket is connected.
+    // NOTE: The socket may have been closed from another thread before the session could start.
+    boost::system::error_code error;
+    tcp::endpoint local_endpoint = tcp_session::m_socket.local_endpoint(error);
+    if(!error)
+    {
+        tcp_session::m_remote_endpoint = tcp_session::m_socket.remote_endpoint(error);
+    }
+    if(error)
+    {
+        return false;
+    }
+    tcp_session::m_local_port = local_endpoint.port();
+
+    // Encrypted sessions are established once the handshake completes.
+    if(tcp_session::m_tls_context)
+    {
+        tcp_session::m_tls = tcp_session::m_tls_context->create_session(tcp_session::m_tls_server, tcp_session::m_tls_host);
+        if(!tcp_session::m_tls || SSL_set_fd(tcp_session::m_tls, tcp_session::m_socket.native_handle()) != 1)
+        {
+            return false;
+        }
+
+        // OpenSSL must return instead of blocking the IO thread, so it can wait for the socket asynchronously.
+        // NOTE: Synchronous socket operations still block, since only the native socket is non-blocking.
+        tcp_session::m_socket.native_non_blocking(true, error);
+        if(error)
+        {
+            return false;
+        }
+
+        tcp_session::tls_handshake();
+
+        return true;
+    }
+
+    // Start first asynchronous read.
+    tcp_session::async_rx();
+
+    tcp_session::signal_established();
+
+    return true;
+}
+void tcp_session::close()
+{
+    // Notify the peer that no more records will follow.
+    if(tcp_session::m_tls_established && tcp_session::m_socket.is_open())
+    {
+        boost::mutex::scoped_lock lock(tcp_session::m_mutex_tls);
+        SSL_shutdown(tcp_session::m_tls);
+    }
+
+    // Closing the socket stops all async operations.
+    boost::system::error_code error;
+    tcp_session::m_socket.close(error);
+}
+void tcp_session::abort()
+{
+    if(tcp_session::m_socket.is_open())
+    {
+        tcp_session::signal_closed();
+    }
+}
+bool tcp_session::drain(boost::posix_time::ptime deadline)
+{
+#ifdef SIOCOUTQ
+    while(tcp_session::m_socket.is_open())
+    {
+        // Check the number of bytes not yet acknowledged by the remote endpoint.
+        int queued = 0;
+        if(ioctl(tcp_session::m_socket.native_handle(), SIOCOUTQ, &queued) != 0 || queued == 0)
+        {
+            return true;
+        }
+        if(boost::posix_time::microsec_clock::universal_time() >= deadline)
+        {
+            return false;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+#endif
+
+    return true;
+}
+
+// PUBLIC METHODS: CALLBACK ATTACHMENT
+void tcp_session::attach_established_callback(std::function<void(boost::shared_ptr<tcp_session>)> callback)
+{
+    tcp_session::m_established_callback = callback;
+}
+void tcp_session::attach_closed_callback(std::function<void(boost::shared_ptr<tcp_session>)> callback)
+{
+    tcp_session::m_closed_callback = callback;
+}
+void tcp_session::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    tcp_session::m_rx_callback = callback;
+}
+
+// PUBLIC METHODS: IO
+bool tcp_session::tx(const uint8_t *data, uint32_t length)
+{
+    TRACE_SCOPE("tcp_send", tcp_session::m_local_port);
+
+    if(tcp_session::m_tls && !tcp_session::m_tls_established)
+    {
+        // Nothing may be sent in the clear before the handshake completes.
+        return false;
+    }
+    else if(tcp_session::m_tls && !tcp_session::m_ktls_send && tcp_session::m_socket.is_open())
+    {
+        // Encrypt in userspace, since the kernel could not take over transmission.
+        boost::mutex::scoped_lock tx_lock(tcp_session::m_mutex_tls_tx);
+        while(true)
+        {
+            int result, ssl_error;
+            {
+                boost::mutex::scoped_lock lock(tcp_session::m_mutex_tls);
+                ERR_clear_error();
+                result = SSL_write(tcp_session::m_tls, data, static_cast<int>(length));
+                ssl_error = (result > 0) ? SSL_ERROR_NONE : SSL_get_error(tcp_session::m_tls, result);
+            }
+            if(ssl_error == SSL_ERROR_NONE)
+            {
+                return true;
+            }
+            else if(ssl_error == SSL_ERROR_WANT_WRITE)
+            {
+                // Wait for room in the socket without holding the TLS state, so the IO thread can keep reading.
+                boost::system::error_code error;
+                tcp_session::m_socket.wait(tcp::socket::wait_write, error);
+                if(error)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                // The TLS stream is broken.
+                tcp_session::signal_closed();
+                return false;
+            }
+        }
+    }
+    else if(tcp_session::m_socket.is_open())
+    {
+        // Send the whole message with error reporting, since a single send may only be partially accepted.
+        // NOTE: Plaintext written to a kTLS socket is encrypted by the kernel.
+        boost::system::error_code error;
+        boost::asio::write(tcp_session::m_socket, boost::asio::buffer(data, length), error);
+
+        // Check if error is broken_pipe or timed_out, indicating session broken.
+        if(error.value() == boost::system::errc::broken_pipe || error == boost::asio::error::timed_out)
+        {
+            tcp_session::signal_closed();
+        }
+
+        return !error;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// PUBLIC METHODS: SOCKET OPTIONS
+bool tcp_session::set_keepalive(double idle, double interval, uint32_t count)
+{
+    boost::system::error_code error;
+
+    // Enable keepalive.
+    tcp_session::m_socket.set_option(boost::asio::socket_base::keep_alive(true), error);
+
+    // Set probe timing.  Values are in whole seconds, with a minimum of 1.
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+    if(!error)
+    {
+        tcp_session::m_socket.set_option(boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPIDLE>(std::max(1, static_cast<int>(idle))), error);
+    }
+    if(!error)
+    {
+        tcp_session::m_socket.set_option(boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPINTVL>(std::max(1, static_cast<int>(interval))), error);
+    }
+    if(!error)
+    {
+        tcp_session::m_socket.set_option(boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPCNT>(std::max(1, static_cast<int>(count))), error);
+    }
+#endif
+
+    return !error;
+}
+bool tcp_session::set_user_timeout(double timeout)
+{
+#ifdef TCP_USER_TIMEOUT
+    // The timeout is specified in milliseconds.
+    boost::system::error_code error;
+    tcp_session::m_socket.set_option(boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_USER_TIMEOUT>(static_cast<int>(timeout * 1000.0)), error);
+
+    return !error;
+#else
+    return false;
+#endif
+}
+
+// PROPERTIES
+tcp::socket& tcp_session::p_socket()
+{
+    return tcp_session::m_socket;
+}
+tcp::endpoint tcp_session::p_remote_endpoint() const
+{
+    return tcp_session::m_remote_endpoint;
+}
+bool tcp_session::p_kernel_tls() const
+{
+    return tcp_session::m_ktls_send;
+}
+
+// STATIC PROPERTIES
+tcp::endpoint tcp_session::rx_endpoint()
+{
+    return rx_endpoint_current;
+}
+
+// PRIVATE METHODS
+void tcp_session::async_rx()
+{
+    TRACE_INSTANT("async_rx", tcp_session::m_local_port);
+    tcp_session::m_socket.async_receive(boost::asio::buffer(tcp_session::m_buffer, tcp_session::m_buffer_size),
+                                        boost::bind(&tcp_session::rx_callback, tcp_session::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+void tcp_session::signal_closed()
+{
+    // Close the socket so any queued handlers are ignored.
+    tcp_session::close();
+
+    // Raise the closed callback.
+    if(tcp_session::m_closed_callback)
+    {
+        tcp_session::m_closed_callback(tcp_session::shared_from_this());
+    }
+}
+
+void tcp_session::deliver(uint32_t length)
+{
+    latency_histogram::mark_rx();
+    TRACE_SCOPE("tcp_deliver", tcp_session::m_local_port);
+    if(tcp_session::m_stats)
+    {
+        tcp_session::m_stats->record_rx(length);
+    }
+
+    if(tcp_session::m_rx_callback)
+    {
+        // Deep copy the data into a new output array.
+        uint8_t* output_array = new uint8_t[length];
+        std::memcpy(output_array, tcp_session::m_buffer, length);
+
+        // Raise the callback, tagged with the remote address of this session.
+        rx_endpoint_current = tcp_session::m_remote_endpoint;
+        tcp_session::m_rx_callback(protocol::TCP,
+                                   tcp_session::m_local_port,
+                                   output_array,
+                                   length,
+                                   tcp_session::m_remote_endpoint.address());
+    }
+}
+void tcp_session::signal_established()
+{
+    if(tcp_session::m_established_callback)
+    {
+        tcp_session::m_established_callback(tcp_session::shared_from_this());
+    }
+}
+void tcp_session::tls_handshake()
+{
+    int result, ssl_error;
+    {
+        boost::mutex::scoped_lock lock(tcp_session::m_mutex_tls);
+        ERR_clear_error();
+        result = SSL_do_handshake(tcp_session::m_tls);
+        ssl_error = (result == 1) ? SSL_ERROR_NONE : SSL_get_error(tcp_session::m_tls, result);
+    }
+
+    if(ssl_error == SSL_ERROR_NONE)
+    {
+        TRACE_INSTANT("tls_handshake", tcp_session::m_local_port);
+
+        // Check if OpenSSL handed record encryption over to the kernel.
+#ifdef BIO_get_ktls_send
+        tcp_session::m_ktls_send = BIO_get_ktls_send(SSL_get_wbio(tcp_session::m_tls));
+#endif
+        tcp_session::m_tls_established = true;
+        tcp_session::signal_established();
+
+        // Start reading, which also delivers any data that arrived with the end of the handshake.
+        // NOTE: Reads go through OpenSSL even with kTLS receive offload, since it handles non-data records.
+        tcp_session::tls_rx();
+    }
+    else if(!tcp_session::tls_wait(ssl_error, boost::bind(&tcp_session::tls_handshake_callback, tcp_session::shared_from_this(), boost::placeholders::_1)))
+    {
+        // The handshake failed, such as the peer's certificate being rejected.
+        tcp_session::signal_closed();
+    }
+}
+void tcp_session::tls_rx()
+{
+    while(tcp_session::m_socket.is_open())
+    {
+        int result, ssl_error;
+        {
+            boost::mutex::scoped_lock lock(tcp_session::m_mutex_tls);
+            ERR_clear_error();
+            result = SSL_read(tcp_session::m_tls, tcp_session::m_buffer, static_cast<int>(tcp_session::m_buffer_size));
+            ssl_error = (result > 0) ? SSL_ERROR_NONE : SSL_get_error(tcp_session::m_tls, result);
+        }
+
+        if(ssl_error == SSL_ERROR_NONE)
+        {
+            tcp_session::deliver(static_cast<uint32_t>(result));
+        }
+        else
+        {
+            // Wait for more records, or close if the peer closed the stream or it is broken.
+            if(!tcp_session::tls_wait(ssl_error, boost::bind(&tcp_session::tls_rx_callback, tcp_session::shared_from_this(), boost::placeholders::_1)))
+            {
+                tcp_session::signal_closed();
+            }
+            return;
+        }
+    }
+}
+bool tcp_session::tls_wait(int ssl_error, std::function<void(const boost::system::error_code&)> handler)
+{
+    switch(ssl_error)
+    {
+    case SSL_ERROR_WANT_READ:
+    {
+        tcp_session::m_socket.async_wait(tcp::socket::wait_read, handler);
+        return true;
+    }
+    case SSL_ERROR_WANT_WRITE:
+    {
+        tcp_session::m_socket.async_wait(tcp::socket::wait_write, handler);
+        return true;
+    }
+    default:
+    {
+        return false;
+    }
+    }
+}
+
+// CALLBACKS
+void tcp_session::rx_callback(const boost::system::error_code &error, std::size_t bytes_read)
+{
+    // Check if the socket is still open.
+    // Closing the socket stops async operations, but callback handlers can still be in io_service queue.
+    if(tcp_session::m_socket.is_open())
+    {
+        // Make sure there are no errors, and that the rx callback is attached.
+        if(!error)
+        {
+            tcp_session::deliver(static_cast<uint32_t>(bytes_read));
+
+            // Start a new asynchronous receive.
+            tcp_session::async_rx();
+        }
+        else
+        {
+            // Count abnormal closures as receive errors.
+            if(tcp_session::m_stats && error != boost::asio::error::eof && error != boost::asio::error::operation_aborted)
+            {
+                tcp_session::m_stats->record_rx_error();
+            }
+
+            if(error == boost::asio::error::eof || error == boost::asio::error::connection_reset || error == boost::asio::error::connection_aborted)
+            {
+                // Session has been closed from the other end.
+                tcp_session::signal_closed();
+            }
+            else if(error == boost::asio::error::timed_out)
+            {
+                // Keepalive probes or transmitted data went unacknowledged, so the remote endpoint is unreachable.
+                tcp_session::signal_closed();
+            }
+            // Only other acceptable error is operation_aborted, which is caused by session closed from this end.
+            else if(error != boost::asio::error::operation_aborted)
+            {
+                throw std::runtime_error("tcp_session::rx_callback: " + error.message());
+            }
+        }
+    }
+}
+void tcp_session::tls_handshake_callback(const boost::system::error_code &error)
+{
+    // Ignore handlers left in the io_service queue after the session was closed.
+    if(tcp_session::m_socket.is_open())
+    {
+        if(!error)
+        {
+            tcp_session::tls_handshake();
+        }
+        else if(error != boost::asio::error::operation_aborted)
+        {
+            tcp_session::signal_closed();
+        }
+    }
+}
+void tcp_session::tls_rx_callback(const boost::system::error_code &error)
+{
+    // Ignore handlers left in the io_service queue after the session was closed.
+    if(tcp_session::m_socket.is_open())
+    {
+        if(!error)
+        {
+            tcp_session::tls_rx();
+        }
+        else if(error != boost::asio::error::operation_aborted)
+        {
+            tcp_session::signal_closed();
+        }
+    }
+}
@@ -0,0 +1,186 @@
+/// \file tcp_session.h
+/// \brief Defines the tcp_session class.
+#ifndef TCP_SESSION_H
+#define TCP_SESSION_H
+
+#include "tls_context.h"
+#include "connection_stats.h"
+
+#include "driver_modem/protocol.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <functional>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Provides a single established TCP stream between the local endpoint and one remote endpoint.
+/// \details A tcp_connection owns one session as a client, or any number of sessions as a server.
+/// Encrypted sessions perform a TLS handshake when started, and are only established once it completes.
+class tcp_session
+        : public boost::enable_shared_from_this<tcp_session>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new, unopened TCP session.
+    /// \param io_service The global IO Service to run the session on.
+    /// \param buffer_size The size of the RX buffer in bytes.
+    tcp_session(boost::asio::io_service& io_service, uint32_t buffer_size=1024);
+    ~tcp_session();
+
+    // METHODS: START/STOP
+    /// \brief Encrypts the session with TLS.
+    /// \param context The TLS configuration.
+    /// \param server Indicates if the session accepts (server) or initiates (client) the handshake.
+    /// \param host For clients, the hostname or IP address that the server's certificate must be issued to.
+    /// \details Must be called before start().
+    void set_tls(boost::shared_ptr<tls_context> context, bool server, const std::string& host = "");
+    /// \brief Attaches the traffic counters that received data is recorded in.
+    /// \param stats The counters, shared with the owning connection.
+    /// \details Must be called before start().
+    void set_stats(boost::shared_ptr<connection_stats> stats);
+    /// \brief Starts the session once its socket has been connected or accepted.
+    /// \return TRUE if the session was started, FALSE if the socket is no longer connected.
+    /// \details Plain sessions are established immediately.  Encrypted sessions are established asynchronously
+    /// once the TLS handshake completes, or closed if it fails.
+    bool start();
+    /// \brief Closes the session.
+    /// \details The closed callback is NOT raised when this method is called.
+    void close();
+    /// \brief Closes the session as if the remote endpoint had broken it, raising the closed callback.
+    /// \details Must be called on the IO thread.  Has no effect if the session is already closed.
+    void abort();
+    /// \brief Waits for data queued in the kernel to be acknowledged by the remote endpoint.
+    /// \param deadline The time at which to stop waiting.
+    /// \return TRUE if all queued data was acknowledged, FALSE if the deadline passed first.
+    /// \details Blocks the calling thread.  The session remains open.
+    bool drain(boost::posix_time::ptime deadline);
+
+    // METHODS: CALLBACK ATTACHMENT
+    /// \brief Attaches a callback for handling establishment of the session.
+    /// \param callback The callback to handle session establishment.
+    void attach_established_callback(std::function<void(boost::shared_ptr<tcp_session>)> callback);
+    /// \brief Attaches a callback for handling closure of the session by the remote endpoint.
+    /// \param callback The callback to handle session closure.
+    void attach_closed_callback(std::function<void(boost::shared_ptr<tcp_session>)> callback);
+    /// \brief Attaches a callback for handling received messages.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+
+    // METHODS: IO
+    /// \brief Transmits data to the remote endpoint of the session.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the data was transmitted, otherwise FALSE.
+    bool tx(const uint8_t *data, uint32_t length);
+
+    // METHODS: SOCKET OPTIONS
+    /// \brief Configures TCP keepalive probing of the remote endpoint.
+    /// \param idle The idle time in seconds before the first probe is sent.
+    /// \param interval The time in seconds between unanswered probes.
+    /// \param count The number of unanswered probes before the session is considered dead.
+    /// \return TRUE if the options were applied, otherwise FALSE.
+    bool set_keepalive(double idle, double interval, uint32_t count);
+    /// \brief Configures the maximum time that transmitted data may remain unacknowledged (TCP_USER_TIMEOUT).
+    /// \param timeout The timeout in seconds.
+    /// \return TRUE if the option was applied, otherwise FALSE.
+    bool set_user_timeout(double timeout);
+
+    // PROPERTIES
+    /// \brief Gets the socket of the session for connecting or accepting into.
+    /// \return A reference to the session's socket.
+    tcp::socket& p_socket();
+    /// \brief Gets the remote endpoint of the session.
+    /// \return The remote endpoint captured when the session was started.
+    tcp::endpoint p_remote_endpoint() const;
+    /// \brief Indicates if transmitted TLS records are encrypted by the kernel.
+    /// \return TRUE if kTLS transmit offload is active, otherwise FALSE.
+    bool p_kernel_tls() const;
+
+    // PROPERTIES: STATIC
+    /// \brief Gets the remote endpoint of the session whose data is being delivered on the calling thread.
+    /// \return The remote endpoint, which distinguishes sessions from the same address during an rx callback.
+    static tcp::endpoint rx_endpoint();
+
+private:
+    // VARIABLES: SOCKET
+    /// \brief The socket implementing the TCP session.
+    tcp::socket m_socket;
+    /// \brief The local port of the session.
+    uint16_t m_local_port;
+    /// \brief The remote endpoint of the session.
+    /// \details Stored on start, since the socket can no longer report it once closed.
+    tcp::endpoint m_remote_endpoint;
+
+    // VARIABLES: RX BUFFER
+    /// \brief The internal buffer for storing received messages.
+    uint8_t* m_buffer;
+    /// \brief The size of the internal buffer in bytes.
+    uint32_t m_buffer_size;
+
+    // VARIABLES: TLS
+    /// \brief The TLS configuration, or null for a plain session.
+    boost::shared_ptr<tls_context> m_tls_context;
+    /// \brief Indicates if the session accepts the TLS handshake.
+    bool m_tls_server;
+    /// \brief The hostname or IP address that a client verifies the server's certificate against.
+    std::string m_tls_host;
+    /// \brief The TLS state of the session, or nullptr for a plain session.
+    SSL* m_tls;
+    /// \brief Indicates if the TLS handshake has completed.
+    bool m_tls_established;
+    /// \brief Indicates if the kernel encrypts transmitted records, so plaintext can be written straight to the socket.
+    bool m_ktls_send;
+    /// \brief Protects the TLS state between the IO thread and transmitting threads.
+    boost::mutex m_mutex_tls;
+    /// \brief Serializes transmissions through OpenSSL, which must be retried with the same data until complete.
+    boost::mutex m_mutex_tls_tx;
+
+    // VARIABLES: STATS
+    /// \brief The traffic counters of the owning connection, or null if not recorded.
+    boost::shared_ptr<connection_stats> m_stats;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when the session is established.
+    std::function<void(boost::shared_ptr<tcp_session>)> m_established_callback;
+    /// \brief The callback to raise when the session is closed by the remote endpoint.
+    std::function<void(boost::shared_ptr<tcp_session>)> m_closed_callback;
+    /// \brief The callback to raise when a message is received.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+
+    // METHODS
+    /// \brief Initiates an asynchronous read of a single TCP packet.
+    void async_rx();
+    /// \brief Closes the socket and raises the closed callback.
+    void signal_closed();
+    /// \brief Raises the rx callback with a copy of the data in the RX buffer.
+    /// \param length The number of bytes received into the RX buffer.
+    void deliver(uint32_t length);
+    /// \brief Marks the session as established and raises the established callback.
+    void signal_established();
+    /// \brief Advances the TLS handshake until it completes or must wait for the socket.
+    void tls_handshake();
+    /// \brief Reads and delivers decrypted messages until OpenSSL must wait for the socket.
+    void tls_rx();
+    /// \brief Waits asynchronously for the socket to become ready for a pending TLS operation.
+    /// \param ssl_error The OpenSSL error code of the operation.
+    /// \param handler The handler to raise once the socket is ready.
+    /// \return TRUE if the operation is waiting, FALSE if the error is fatal.
+    bool tls_wait(int ssl_error, std::function<void(const boost::system::error_code&)> handler);
+
+    // CALLBACKS
+    /// \brief The internal callback for handling messages received asynchronously.
+    /// \param error The error code provided by the async read operation.
+    /// \param bytes_read The number of bytes ready by the async read operation.
+    void rx_callback(const boost::system::error_code& error, std::size_t bytes_read);
+    /// \brief The callback for continuing the TLS handshake once the socket is ready.
+    /// \param error The error code provided by the async wait operation.
+    void tls_handshake_callback(const boost::system::error_code& error);
+    /// \brief The callback for continuing to read TLS records once the socket is ready.
+    /// \param error The error code provided by the async wait operation.
+    void tls_rx_callback(const boost::system::error_code& error);
+};
+
+#endif // TCP_SESSION_H
@@ -0,0 +1,101 @@
+#include "tls_context.h"
+
+#include <openssl/x509v3.h>
+
+// CONSTRUCTORS
+tls_context::tls_context()
+{
+    tls_context::m_context = SSL_CTX_new(TLS_method());
+    tls_context::m_verify_clients = false;
+    tls_context::m_verify_servers = false;
+
+    if(tls_context::m_context)
+    {
+        // kTLS only offloads TLS 1.2 and later.
+        SSL_CTX_set_min_proto_version(tls_context::m_context, TLS1_2_VERSION);
+        // Sessions are never resumed, so skip sending tickets after the handshake.
+        SSL_CTX_set_num_tickets(tls_context::m_context, 0);
+        // Allow SSL_write to be retried from a different buffer address after a partial write.
+        SSL_CTX_set_mode(tls_context::m_context, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+        // Offload record encryption to the kernel once the handshake completes.
+        SSL_CTX_set_options(tls_context::m_context, SSL_OP_ENABLE_KTLS);
+#endif
+    }
+}
+tls_context::~tls_context()
+{
+    SSL_CTX_free(tls_context::m_context);
+}
+
+// PUBLIC METHODS
+bool tls_context::load(const std::string &certificate, const std::string &key, const std::string &ca, bool verify)
+{
+    if(!tls_context::m_context)
+    {
+        return false;
+    }
+
+    // Load the local certificate and its key.
+    if(!certificate.empty())
+    {
+        if(SSL_CTX_use_certificate_chain_file(tls_context::m_context, certificate.c_str()) != 1 ||
+           SSL_CTX_use_PrivateKey_file(tls_context::m_context, (key.empty() ? certificate : key).c_str(), SSL_FILETYPE_PEM) != 1 ||
+           SSL_CTX_check_private_key(tls_context::m_context) != 1)
+        {
+            return false;
+        }
+    }
+
+    // Load the certificate authorities that the peer is verified against.
+    if(verify)
+    {
+        int result = ca.empty() ? SSL_CTX_set_default_verify_paths(tls_context::m_context) : SSL_CTX_load_verify_locations(tls_context::m_context, ca.c_str(), nullptr);
+        if(result != 1)
+        {
+            return false;
+        }
+    }
+    tls_context::m_verify_servers = verify;
+    tls_context::m_verify_clients = verify && !ca.empty();
+
+    return true;
+}
+SSL* tls_context::create_session(bool server, const std::string &host)
+{
+    if(!tls_context::m_context)
+    {
+        return nullptr;
+    }
+
+    SSL* session = SSL_new(tls_context::m_context);
+    if(session)
+    {
+        if(server)
+        {
+            SSL_set_accept_state(session);
+            SSL_set_verify(session, tls_context::m_verify_clients ? (SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT) : SSL_VERIFY_NONE, nullptr);
+        }
+        else
+        {
+            SSL_set_connect_state(session);
+            SSL_set_verify(session, tls_context::m_verify_servers ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr);
+
+            // Bind the session to the server's identity, since chaining to the CA alone accepts any of its certificates.
+            // NOTE: IP addresses are matched against IP SANs, and are never sent as SNI.
+            if(!host.empty())
+            {
+                bool ip = X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(session), host.c_str()) == 1;
+                bool bound = ip || ((!tls_context::m_verify_servers || SSL_set1_host(session, host.c_str()) == 1) &&
+                                    SSL_set_tlsext_host_name(session, host.c_str()) == 1);
+                if(!bound)
+                {
+                    SSL_free(session);
+                    return nullptr;
+                }
+            }
+        }
+    }
+
+    return session;
+}
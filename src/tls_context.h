@@ -0,0 +1,51 @@
+/// \file tls_context.h
+/// \brief Defines the tls_context class.
+#ifndef TLS_CONTEXT_H
+#define TLS_CONTEXT_H
+
+#include <openssl/ssl.h>
+
+#include <string>
+
+/// \brief Holds the TLS configuration shared by the sessions of an encrypted TCP connection.
+/// \details The handshake is performed in userspace by OpenSSL, after which record encryption is offloaded to the
+/// kernel (kTLS) where the kernel and cipher support it.  Offloaded sessions transmit plaintext straight into the
+/// socket, so transmission costs about the same as plain TCP and sendfile() remains usable on the socket.
+class tls_context
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new TLS context.
+    tls_context();
+    ~tls_context();
+
+    // METHODS
+    /// \brief Loads the certificates and configures peer verification.
+    /// \param certificate The path of the PEM certificate (chain) presented to the peer, or empty for none.
+    /// \param key The path of the PEM private key of the certificate.
+    /// \param ca The path of the PEM certificate(s) that the peer's certificate must be signed by.
+    /// If empty, the system's default certificate authorities are used.
+    /// \param verify Indicates if the peer's certificate is verified.
+    /// \return TRUE if the configuration was loaded, otherwise FALSE.
+    /// \details Servers require a certificate.  Servers only request client certificates when verify is set and
+    /// a CA is given, while clients always verify the server when verify is set.
+    bool load(const std::string& certificate, const std::string& key, const std::string& ca, bool verify);
+    /// \brief Creates the TLS state of a new session.
+    /// \param server Indicates if the session accepts (server) or initiates (client) the handshake.
+    /// \param host For clients, the hostname or IP address that the server's certificate must be issued to.
+    /// \return The new TLS state, or nullptr on failure.  The caller owns the state.
+    /// \details Clients send hostnames as the server name indication (SNI).  When servers are verified, the
+    /// handshake fails unless the certificate's subject alternative names match the host.
+    SSL* create_session(bool server, const std::string& host = "");
+
+private:
+    // VARIABLES
+    /// \brief The OpenSSL context.
+    SSL_CTX* m_context;
+    /// \brief Indicates if servers request and verify client certificates.
+    bool m_verify_clients;
+    /// \brief Indicates if clients verify server certificates.
+    bool m_verify_servers;
+};
+
+#endif // TLS_CONTEXT_H
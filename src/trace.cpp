@@ -0,0 +1,208 @@
+#include "trace.h"
+
+#include "latency_histogram.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+// The number of events kept by each thread (32 bytes each).
+#define TRACE_RING_SIZE 32768
+
+namespace
+{
+    /// \brief A recorded event.
+    struct event
+    {
+        /// \brief The time the event started, in steady clock nanoseconds.
+        uint64_t timestamp;
+        /// \brief The duration of the event in nanoseconds, for complete events.
+        uint64_t duration;
+        /// \brief The name of the event.
+        const char* name;
+        /// \brief The port that the event belongs to.
+        uint32_t port;
+        /// \brief Indicates if the event is a complete event rather than an instant.
+        bool complete;
+    };
+
+    /// \brief The events of one thread.
+    struct thread_ring
+    {
+        /// \brief The number of the thread in exported traces.
+        uint32_t id;
+        /// \brief The name of the thread in exported traces.
+        std::string name;
+        /// \brief The number of events ever recorded, whose remainder is the next slot to write.
+        /// \details Only the owning thread writes events, and it publishes each one by advancing the head.
+        std::atomic<uint64_t> head;
+        /// \brief The event slots.
+        event events[TRACE_RING_SIZE];
+    };
+
+    /// \brief The rings of every thread that has recorded an event.
+    /// \details Rings are kept after their thread exits, so that its events can still be dumped.
+    std::vector<boost::shared_ptr<thread_ring>> rings;
+    /// \brief Protects the list of rings and the thread names.
+    boost::mutex rings_mutex;
+    /// \brief The ring of the calling thread.
+    thread_local thread_ring* local_ring = nullptr;
+
+    thread_ring* get_ring()
+    {
+        if(!local_ring)
+        {
+            boost::shared_ptr<thread_ring> ring(new thread_ring());
+            ring->head.store(0, std::memory_order_relaxed);
+
+            boost::mutex::scoped_lock lock(rings_mutex);
+            ring->id = static_cast<uint32_t>(rings.size()) + 1;
+            rings.push_back(ring);
+            local_ring = ring.get();
+        }
+
+        return local_ring;
+    }
+    void record(const char* name, uint32_t port, uint64_t start, uint64_t duration, bool complete)
+    {
+        thread_ring* ring = get_ring();
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        event& slot = ring->events[head % TRACE_RING_SIZE];
+        slot.timestamp = start;
+        slot.duration = duration;
+        slot.name = name;
+        slot.port = port;
+        slot.complete = complete;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+}
+
+// SCOPE
+trace::scope::scope(const char *name, uint32_t port)
+{
+    trace::scope::m_name = name;
+    trace::scope::m_port = port;
+    trace::scope::m_start = latency_histogram::now();
+}
+trace::scope::~scope()
+{
+    record(trace::scope::m_name, trace::scope::m_port, trace::scope::m_start, latency_histogram::now() - trace::scope::m_start, true);
+}
+
+// STATIC METHODS
+void trace::instant(const char *name, uint32_t port)
+{
+    record(name, port, latency_histogram::now(), 0, false);
+}
+void trace::complete(const char *name, uint32_t port, uint64_t start, uint64_t duration)
+{
+    record(name, port, start, duration, true);
+}
+void trace::name_thread(const std::string &name)
+{
+    thread_ring* ring = get_ring();
+
+    boost::mutex::scoped_lock lock(rings_mutex);
+    ring->name = name;
+}
+bool trace::dump(const std::string &path, uint32_t &events)
+{
+    events = 0;
+
+    std::ofstream file(path.c_str(), std::ios::trunc);
+    if(!file)
+    {
+        return false;
+    }
+
+    // Copy the rings list, so that threads starting during the dump are not blocked.
+    std::vector<boost::shared_ptr<thread_ring>> snapshot;
+    std::vector<std::string> names;
+    {
+        boost::mutex::scoped_lock lock(rings_mutex);
+        snapshot = rings;
+        for(auto ring = rings.begin(); ring != rings.end(); ring++)
+        {
+            names.push_back((*ring)->name);
+        }
+    }
+
+    // Timestamps are written relative to the earliest event, in microseconds.
+    std::vector<std::vector<event>> copies(snapshot.size());
+    uint64_t base = UINT64_MAX;
+    for(uint32_t i = 0; i < snapshot.size(); i++)
+    {
+        thread_ring& ring = *snapshot[i];
+        uint64_t end = ring.head.load(std::memory_order_acquire);
+        uint64_t begin = (end > TRACE_RING_SIZE) ? end - TRACE_RING_SIZE : 0;
+        for(uint64_t index = begin; index < end; index++)
+        {
+            copies[i].push_back(ring.events[index % TRACE_RING_SIZE]);
+        }
+
+        // Discard the events that the thread may have overwritten while they were copied.
+        uint64_t after = ring.head.load(std::memory_order_acquire);
+        uint64_t valid = (after >= TRACE_RING_SIZE) ? after - TRACE_RING_SIZE + 1 : 0;
+        if(valid > begin)
+        {
+            copies[i].erase(copies[i].begin(), copies[i].begin() + static_cast<std::ptrdiff_t>(std::min(valid - begin, end - begin)));
+        }
+        for(auto it = copies[i].begin(); it != copies[i].end(); it++)
+        {
+            base = std::min(base, it->timestamp);
+        }
+    }
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    file << std::fixed << std::setprecision(3);
+    for(uint32_t i = 0; i < snapshot.size(); i++)
+    {
+        uint32_t id = snapshot[i]->id;
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id << ",\"args\":{\"name\":\"";
+        if(names[i].empty())
+        {
+            file << "thread " << id;
+        }
+        else
+        {
+            file << names[i];
+        }
+        file << "\"}}";
+        first = false;
+
+        for(auto it = copies[i].begin(); it != copies[i].end(); it++)
+        {
+            file << ",\n{\"name\":\"" << it->name << "\",\"cat\":\"driver_modem\",\"pid\":1,\"tid\":" << id
+                 << ",\"ts\":" << static_cast<double>(it->timestamp - base) / 1000.0;
+            if(it->complete)
+            {
+                file << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(it->duration) / 1000.0;
+            }
+            else
+            {
+                file << ",\"ph\":\"i\",\"s\":\"t\"";
+            }
+            file << ",\"args\":{\"port\":" << it->port << "}}";
+            events++;
+        }
+    }
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+}
+
+// STATIC PROPERTIES
+bool trace::p_enabled()
+{
+#ifdef DRIVER_MODEM_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
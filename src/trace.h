@@ -0,0 +1,78 @@
+/// \file trace.h
+/// \brief Defines the trace class and its recording macros.
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+/// \brief Records timestamped events on every thread for export as a Chrome trace.
+/// \details Each thread writes into its own fixed-size ring without locks or allocation, overwriting its oldest
+/// events.  Events are only recorded through the TRACE_* macros, which compile to nothing unless the driver is built
+/// with DRIVER_MODEM_TRACING, so release builds pay nothing for them.
+class trace
+{
+public:
+    // CLASSES
+    /// \brief Records a complete event spanning the lifetime of the object.
+    class scope
+    {
+    public:
+        /// \brief Starts the event.
+        /// \param name The name of the event, which must be a string literal.
+        /// \param port The port that the event belongs to.
+        scope(const char* name, uint32_t port);
+        /// \brief Records the event.
+        ~scope();
+
+    private:
+        /// \brief The name of the event.
+        const char* m_name;
+        /// \brief The port that the event belongs to.
+        uint32_t m_port;
+        /// \brief The time the event started.
+        uint64_t m_start;
+    };
+
+    // METHODS: STATIC
+    /// \brief Records an instant event on the calling thread.
+    /// \param name The name of the event, which must be a string literal.
+    /// \param port The port that the event belongs to.
+    static void instant(const char* name, uint32_t port);
+    /// \brief Records a complete event on the calling thread.
+    /// \param name The name of the event, which must be a string literal.
+    /// \param port The port that the event belongs to.
+    /// \param start The time the event started, in steady clock nanoseconds.
+    /// \param duration The duration of the event in nanoseconds.
+    static void complete(const char* name, uint32_t port, uint64_t start, uint64_t duration);
+    /// \brief Names the calling thread in exported traces.
+    /// \param name The name of the thread.
+    static void name_thread(const std::string& name);
+    /// \brief Writes the events of every thread to a Chrome trace JSON file.
+    /// \param path The path of the file.
+    /// \param events Returns the number of events written.
+    /// \return TRUE if the file was written, otherwise FALSE.
+    /// \details Threads keep recording while the dump runs.  Events that may have been overwritten during the dump
+    /// are left out.
+    static bool dump(const std::string& path, uint32_t& events);
+
+    // PROPERTIES: STATIC
+    /// \brief Indicates if the driver was built with tracing.
+    /// \return TRUE if the TRACE_* macros record events, otherwise FALSE.
+    static bool p_enabled();
+};
+
+#ifdef DRIVER_MODEM_TRACING
+/// \brief Records a complete event from this point until the end of the enclosing block.
+#define TRACE_SCOPE(name, port) trace::scope trace_scope(name, port)
+/// \brief Records an instant event.
+#define TRACE_INSTANT(name, port) trace::instant(name, port)
+/// \brief Names the calling thread in exported traces.
+#define TRACE_THREAD(name) trace::name_thread(name)
+#else
+#define TRACE_SCOPE(name, port) do {} while(false)
+#define TRACE_INSTANT(name, port) do {} while(false)
+#define TRACE_THREAD(name) do {} while(false)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,219 @@
+#include "tunnel.h"
+
+#include <cstring>
+
+// The channel header is: magic and logical protocol (1), and logical port (2, big endian).
+// Stream transports follow the header with the message length as a varint.
+#define TUNNEL_MAGIC 0xA8
+#define TUNNEL_MAGIC_MASK 0xFC
+#define TUNNEL_HEADER_SIZE 3
+// The largest message accepted from a stream, which guards against corrupt length prefixes.
+#define TUNNEL_MAX_MESSAGE (1u << 26)
+
+// CONSTRUCTORS
+tunnel::tunnel(bool stream)
+    // Initialize counters.
+    : m_dropped(0)
+{
+    tunnel::m_stream = stream;
+}
+
+// PUBLIC METHODS: CHANNELS
+void tunnel::add_channel(protocol type, uint16_t port)
+{
+    boost::mutex::scoped_lock lock(tunnel::m_mutex);
+    tunnel::m_channels.insert(std::make_pair(type, port));
+}
+void tunnel::remove_channel(protocol type, uint16_t port)
+{
+    boost::mutex::scoped_lock lock(tunnel::m_mutex);
+    tunnel::m_channels.erase(std::make_pair(type, port));
+}
+
+// PUBLIC METHODS: IO
+void tunnel::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    tunnel::m_rx_callback = callback;
+}
+void tunnel::attach_corrupt_session_callback(std::function<void(tcp::endpoint)> callback)
+{
+    tunnel::m_corrupt_session_callback = callback;
+}
+void tunnel::encode(protocol type, uint16_t port, const uint8_t *data, uint32_t length, std::vector<uint8_t> &output) const
+{
+    output.clear();
+    output.reserve(TUNNEL_HEADER_SIZE + 5 + length);
+    output.push_back(static_cast<uint8_t>(TUNNEL_MAGIC | static_cast<uint8_t>(type)));
+    output.push_back(static_cast<uint8_t>(port >> 8));
+    output.push_back(static_cast<uint8_t>(port));
+
+    if(tunnel::m_stream)
+    {
+        uint32_t remaining = length;
+        while(remaining >= 0x80)
+        {
+            output.push_back(static_cast<uint8_t>(remaining | 0x80));
+            remaining >>= 7;
+        }
+        output.push_back(static_cast<uint8_t>(remaining));
+    }
+
+    output.insert(output.end(), data, data + length);
+}
+void tunnel::rx(protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
+{
+    // The transport's own protocol and port are not needed, since every message carries its channel.
+    (void)type;
+    (void)port;
+
+    protocol channel_type;
+    uint16_t channel_port;
+    uint32_t message_length;
+
+    if(!tunnel::m_stream)
+    {
+        // Each datagram holds exactly one message.
+        int32_t header_size = tunnel::parse_header(data, length, channel_type, channel_port, message_length);
+        if(header_size > 0)
+        {
+            tunnel::deliver(channel_type, channel_port, data + header_size, length - static_cast<uint32_t>(header_size), source);
+        }
+        else
+        {
+            tunnel::m_dropped++;
+        }
+        delete [] data;
+        return;
+    }
+
+    // Separate the complete messages from the session's stream.
+    // NOTE: Messages are delivered after releasing the lock, so callbacks never run while holding it.
+    tcp::endpoint session = tcp_session::rx_endpoint();
+    std::vector<std::pair<std::pair<protocol, uint16_t>, std::vector<uint8_t>>> messages;
+    bool corrupt = false;
+    {
+        boost::mutex::scoped_lock lock(tunnel::m_mutex);
+
+        std::vector<uint8_t>& buffer = tunnel::m_partials[session];
+        buffer.insert(buffer.end(), data, data + length);
+
+        uint32_t offset = 0;
+        while(offset < buffer.size())
+        {
+            uint32_t available = static_cast<uint32_t>(buffer.size()) - offset;
+            int32_t header_size = tunnel::parse_header(buffer.data() + offset, available, channel_type, channel_port, message_length);
+            if(header_size < 0)
+            {
+                // The stream is corrupt and cannot be resynchronized, so discard everything received so far.
+                tunnel::m_dropped++;
+                offset = static_cast<uint32_t>(buffer.size());
+                corrupt = true;
+                break;
+            }
+            if(header_size == 0 || available - static_cast<uint32_t>(header_size) < message_length)
+            {
+                // Wait for the rest of the message.
+                break;
+            }
+
+            const uint8_t* message = buffer.data() + offset + header_size;
+            messages.push_back(std::make_pair(std::make_pair(channel_type, channel_port), std::vector<uint8_t>(message, message + message_length)));
+            offset += static_cast<uint32_t>(header_size) + message_length;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+        if(buffer.empty())
+        {
+            tunnel::m_partials.erase(session);
+        }
+    }
+    delete [] data;
+
+    for(auto it = messages.begin(); it != messages.end(); it++)
+    {
+        tunnel::deliver(it->first.first, it->first.second, it->second.data(), static_cast<uint32_t>(it->second.size()), source);
+    }
+
+    // Close the session, since anything it sends afterwards would be parsed from the middle of a message.
+    if(corrupt && tunnel::m_corrupt_session_callback)
+    {
+        tunnel::m_corrupt_session_callback(session);
+    }
+}
+void tunnel::close_session(const tcp::endpoint &session)
+{
+    boost::mutex::scoped_lock lock(tunnel::m_mutex);
+    tunnel::m_partials.erase(session);
+}
+void tunnel::reset()
+{
+    boost::mutex::scoped_lock lock(tunnel::m_mutex);
+    tunnel::m_partials.clear();
+}
+
+// PROPERTIES
+uint64_t tunnel::p_dropped() const
+{
+    return tunnel::m_dropped;
+}
+
+// PRIVATE METHODS
+int32_t tunnel::parse_header(const uint8_t *data, uint32_t length, protocol &type, uint16_t &port, uint32_t &message_length) const
+{
+    if(length < TUNNEL_HEADER_SIZE)
+    {
+        // A datagram is always complete, so a short one is malformed.
+        return tunnel::m_stream ? 0 : -1;
+    }
+    if((data[0] & TUNNEL_MAGIC_MASK) != TUNNEL_MAGIC)
+    {
+        return -1;
+    }
+    uint8_t type_value = data[0] & ~TUNNEL_MAGIC_MASK;
+    if(type_value != static_cast<uint8_t>(protocol::TCP) && type_value != static_cast<uint8_t>(protocol::UDP))
+    {
+        return -1;
+    }
+    type = static_cast<protocol>(type_value);
+    port = static_cast<uint16_t>((data[1] << 8) | data[2]);
+
+    if(!tunnel::m_stream)
+    {
+        message_length = length - TUNNEL_HEADER_SIZE;
+        return TUNNEL_HEADER_SIZE;
+    }
+
+    // Read the varint message length.
+    message_length = 0;
+    for(uint32_t i = TUNNEL_HEADER_SIZE; i < TUNNEL_HEADER_SIZE + 5; i++)
+    {
+        if(i >= length)
+        {
+            return 0;
+        }
+        message_length |= static_cast<uint32_t>(data[i] & 0x7F) << (7 * (i - TUNNEL_HEADER_SIZE));
+        if((data[i] & 0x80) == 0)
+        {
+            return (message_length <= TUNNEL_MAX_MESSAGE) ? static_cast<int32_t>(i + 1) : -1;
+        }
+    }
+
+    return -1;
+}
+void tunnel::deliver(protocol type, uint16_t port, const uint8_t *data, uint32_t length, address source)
+{
+    {
+        boost::mutex::scoped_lock lock(tunnel::m_mutex);
+        if(tunnel::m_channels.count(std::make_pair(type, port)) == 0)
+        {
+            tunnel::m_dropped++;
+            return;
+        }
+    }
+
+    if(tunnel::m_rx_callback)
+    {
+        uint8_t* output_array = new uint8_t[length];
+        std::memcpy(output_array, data, length);
+        tunnel::m_rx_callback(type, port, output_array, length, source);
+    }
+}
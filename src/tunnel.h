@@ -0,0 +1,119 @@
+/// \file tunnel.h
+/// \brief Defines the tunnel class.
+#ifndef TUNNEL_H
+#define TUNNEL_H
+
+#include "driver_modem/protocol.h"
+#include "tcp_session.h"
+
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Multiplexes the messages of many logical ports over a single transport connection.
+/// \details Every message carries a compact channel header with its logical protocol and port.  Over datagram
+/// transports (UDP) each datagram holds one message, while over stream transports (TCP) each message is also
+/// prefixed with its length (varint) so messages can be separated again.  Messages for channels that are not
+/// registered on this end are dropped.
+class tunnel
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new tunnel.
+    /// \param stream Indicates if the transport is a byte stream (TCP) rather than datagrams (UDP).
+    tunnel(bool stream);
+
+    // METHODS: CHANNELS
+    /// \brief Registers a logical port, so its messages are delivered.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    void add_channel(protocol type, uint16_t port);
+    /// \brief Unregisters a logical port.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    void remove_channel(protocol type, uint16_t port);
+
+    // METHODS: IO
+    /// \brief Attaches a callback for handling messages received on logical ports.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Attaches a callback for closing stream sessions whose data is corrupt.
+    /// \param callback The callback that closes the session with the given remote endpoint on the transport.
+    /// \details A corrupt stream cannot be resynchronized, so the session must be closed for a new one to start on
+    /// a message boundary.
+    void attach_corrupt_session_callback(std::function<void(tcp::endpoint)> callback);
+    /// \brief Wraps a message of a logical port for transmission on the transport.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    /// \param data The message to wrap.
+    /// \param length The length of the message in bytes.
+    /// \param output The wrapped message.
+    void encode(protocol type, uint16_t port, const uint8_t* data, uint32_t length, std::vector<uint8_t>& output) const;
+    /// \brief Handles data received on the transport, delivering the messages that it completes.
+    /// \param type The protocol of the transport.
+    /// \param port The port of the transport.
+    /// \param data The received data.  Ownership is taken.
+    /// \param length The length of the data in bytes.
+    /// \param source The source address of the data.
+    /// \details Stream data is reassembled separately for each session, identified by tcp_session::rx_endpoint(),
+    /// since a server may have several sessions from the same address.
+    void rx(protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
+    /// \brief Discards the partially received stream message of a session.
+    /// \param session The remote endpoint of the session that closed.
+    /// \details Called when a session closes, so that its next session from the same endpoint starts cleanly.
+    void close_session(const tcp::endpoint& session);
+    /// \brief Discards partially received stream messages.
+    /// \details Called when the transport's sessions are re-established, since a new session starts on a message boundary.
+    void reset();
+
+    // PROPERTIES
+    /// \brief Gets the number of received messages that were dropped for being malformed or on unregistered channels.
+    /// \return The number of dropped messages.
+    uint64_t p_dropped() const;
+
+private:
+    // VARIABLES
+    /// \brief Indicates if the transport is a byte stream.
+    bool m_stream;
+    /// \brief The registered channels, by protocol and logical port.
+    std::set<std::pair<protocol, uint16_t>> m_channels;
+    /// \brief The partially received stream data, by the remote endpoint of the session.
+    std::map<tcp::endpoint, std::vector<uint8_t>> m_partials;
+    /// \brief Protects the channels and partial stream data.
+    mutable boost::mutex m_mutex;
+    /// \brief The number of dropped messages.
+    std::atomic<uint64_t> m_dropped;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when a message is received on a logical port.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+    /// \brief The callback to raise when a session's stream is corrupt.
+    std::function<void(tcp::endpoint)> m_corrupt_session_callback;
+
+    // METHODS
+    /// \brief Parses a message header.
+    /// \param data The data starting with the header.
+    /// \param length The number of bytes available.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    /// \param message_length The length of the message (stream only).
+    /// \return The size of the header in bytes, zero if more data is needed, or -1 if the header is malformed.
+    int32_t parse_header(const uint8_t* data, uint32_t length, protocol& type, uint16_t& port, uint32_t& message_length) const;
+    /// \brief Delivers a message if its channel is registered.
+    /// \param type The protocol of the logical port.
+    /// \param port The logical port.
+    /// \param data The message.
+    /// \param length The length of the message in bytes.
+    /// \param source The source address of the message.
+    void deliver(protocol type, uint16_t port, const uint8_t* data, uint32_t length, address source);
+};
+
+#endif // TUNNEL_H
@@ -0,0 +1,276 @@
+#include "udp_bond.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// The bond header is: magic (1), type (1), epoch (2, big endian), sequence (4, big endian).
+#define BOND_MAGIC 0xB0
+#define BOND_HEADER_SIZE 8
+
+// CONSTRUCTORS
+udp_bond::udp_bond(boost::asio::io_service& io_service,
+                   udp::endpoint primary_local_endpoint, udp::endpoint primary_remote_endpoint,
+                   udp::endpoint backup_local_endpoint, udp::endpoint backup_remote_endpoint,
+                   bool duplicate_send, double probe_interval, double probe_timeout)
+    // Initialize timer.
+    : m_timer_probe(io_service)
+{
+    // Create the paths.
+    udp_bond::m_paths[0] = boost::shared_ptr<udp_connection>(new udp_connection(io_service, primary_local_endpoint, primary_remote_endpoint));
+    udp_bond::m_paths[1] = boost::shared_ptr<udp_connection>(new udp_connection(io_service, backup_local_endpoint, backup_remote_endpoint));
+
+    // Store parameters.
+    udp_bond::m_duplicate_send = duplicate_send;
+    udp_bond::m_probe_interval = boost::posix_time::microseconds(static_cast<int64_t>(probe_interval * 1000000.0));
+    udp_bond::m_probe_timeout = boost::posix_time::microseconds(static_cast<int64_t>(probe_timeout * 1000000.0));
+
+    // Initialize sequencing.
+    udp_bond::m_epoch = static_cast<uint16_t>(std::random_device()());
+    udp_bond::m_tx_sequence = 0;
+    udp_bond::m_rx_epoch = 0;
+    udp_bond::m_rx_retired_epoch = 0;
+    udp_bond::m_rx_retired = false;
+    udp_bond::m_rx_sequence = 0;
+    udp_bond::m_rx_started = false;
+}
+
+// PUBLIC METHODS
+bool udp_bond::connect()
+{
+    // Attach the rx callback of each path, tagged with the path index.
+    // NOTE: The paths only hold a weak reference, since the bond owns the paths.
+    boost::weak_ptr<udp_bond> bond = udp_bond::shared_from_this();
+    for(uint32_t path = 0; path < 2; path++)
+    {
+        udp_bond::m_paths[path]->attach_rx_callback([bond, path](protocol type, uint16_t port, uint8_t* data, uint32_t length, address source)
+        {
+            boost::shared_ptr<udp_bond> instance = bond.lock();
+            if(instance)
+            {
+                instance->rx_callback(path, type, port, data, length, source);
+            }
+            else
+            {
+                delete [] data;
+            }
+        });
+        if(!udp_bond::m_paths[path]->connect())
+        {
+            return false;
+        }
+    }
+
+    // Start probing.
+    udp_bond::schedule_probe();
+
+    return true;
+}
+bool udp_bond::disconnect(double drain_timeout)
+{
+    udp_bond::m_timer_probe.cancel();
+
+    // Share the drain timeout between both paths.
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    bool drained = udp_bond::m_paths[0]->disconnect(drain_timeout);
+    double remaining = std::max(0.0, drain_timeout - (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0);
+    return udp_bond::m_paths[1]->disconnect(remaining) && drained;
+}
+void udp_bond::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    udp_bond::m_rx_callback = callback;
+}
+bool udp_bond::tx(const uint8_t *data, uint32_t length)
+{
+    uint32_t sequence = udp_bond::m_tx_sequence++;
+
+    if(udp_bond::m_duplicate_send)
+    {
+        bool primary = udp_bond::tx_path(0, message_type::DATA, sequence, data, length);
+        bool backup = udp_bond::tx_path(1, message_type::DATA, sequence, data, length);
+        return primary || backup;
+    }
+    else
+    {
+        // Send on the active path, falling back to the other path if the send fails.
+        uint32_t path = udp_bond::p_active_path();
+        return udp_bond::tx_path(path, message_type::DATA, sequence, data, length) ||
+               udp_bond::tx_path(1 - path, message_type::DATA, sequence, data, length);
+    }
+}
+void udp_bond::set_remote_endpoint(udp::endpoint remote_endpoint)
+{
+    udp_bond::m_paths[0]->set_remote_endpoint(remote_endpoint);
+}
+
+// STATIC METHODS
+uint32_t udp_bond::overhead()
+{
+    return BOND_HEADER_SIZE;
+}
+
+// PROPERTIES
+uint32_t udp_bond::p_active_path()
+{
+    boost::mutex::scoped_lock lock(udp_bond::m_mutex_paths);
+
+    // Prefer the primary path, unless only the backup path is healthy.
+    return (!udp_bond::healthy(0) && udp_bond::healthy(1)) ? 1 : 0;
+}
+connection_stats::snapshot udp_bond::p_stats() const
+{
+    connection_stats::snapshot output = udp_bond::m_paths[0]->p_stats();
+    output += udp_bond::m_paths[1]->p_stats();
+    return output;
+}
+
+// PRIVATE METHODS
+bool udp_bond::tx_path(uint32_t path, message_type type, uint32_t sequence, const uint8_t *data, uint32_t length)
+{
+    // Build the message.
+    std::vector<uint8_t> message(BOND_HEADER_SIZE + length);
+    message[0] = BOND_MAGIC;
+    message[1] = static_cast<uint8_t>(type);
+    message[2] = static_cast<uint8_t>(udp_bond::m_epoch >> 8);
+    message[3] = static_cast<uint8_t>(udp_bond::m_epoch);
+    message[4] = static_cast<uint8_t>(sequence >> 24);
+    message[5] = static_cast<uint8_t>(sequence >> 16);
+    message[6] = static_cast<uint8_t>(sequence >> 8);
+    message[7] = static_cast<uint8_t>(sequence);
+    if(length > 0)
+    {
+        std::memcpy(message.data() + BOND_HEADER_SIZE, data, length);
+    }
+
+    return udp_bond::m_paths[path]->tx(message.data(), static_cast<uint32_t>(message.size()));
+}
+bool udp_bond::healthy(uint32_t path) const
+{
+    return !udp_bond::m_last_heard[path].is_not_a_date_time() &&
+           boost::posix_time::microsec_clock::universal_time() - udp_bond::m_last_heard[path] < udp_bond::m_probe_timeout;
+}
+bool udp_bond::accept_sequence(uint16_t epoch, uint32_t sequence)
+{
+    const uint32_t window = static_cast<uint32_t>(udp_bond::m_rx_window.size());
+
+    // A new epoch means the peer has restarted its sequence space.
+    if(udp_bond::m_rx_started && epoch != udp_bond::m_rx_epoch)
+    {
+        // Late duplicates from before the restart must not reset the window again.
+        if(udp_bond::m_rx_retired && epoch == udp_bond::m_rx_retired_epoch)
+        {
+            return false;
+        }
+        udp_bond::m_rx_retired_epoch = udp_bond::m_rx_epoch;
+        udp_bond::m_rx_retired = true;
+        udp_bond::m_rx_started = false;
+    }
+
+    if(!udp_bond::m_rx_started)
+    {
+        udp_bond::m_rx_started = true;
+        udp_bond::m_rx_epoch = epoch;
+        udp_bond::m_rx_sequence = sequence;
+        udp_bond::m_rx_window.reset();
+        udp_bond::m_rx_window.set(0);
+        return true;
+    }
+
+    // Use wrapping arithmetic to find how far ahead of the highest sequence this one is.
+    uint32_t ahead = sequence - udp_bond::m_rx_sequence;
+    uint32_t behind = udp_bond::m_rx_sequence - sequence;
+    if(ahead != 0 && ahead < 0x80000000)
+    {
+        // Newer message.  Slide the window forward.
+        udp_bond::m_rx_window = (ahead < window) ? (udp_bond::m_rx_window << ahead) : std::bitset<1024>();
+        udp_bond::m_rx_window.set(0);
+        udp_bond::m_rx_sequence = sequence;
+        return true;
+    }
+    else if(behind < window)
+    {
+        // Within the window.  Accept only if not yet seen.
+        if(udp_bond::m_rx_window.test(behind))
+        {
+            return false;
+        }
+        udp_bond::m_rx_window.set(behind);
+        return true;
+    }
+    else
+    {
+        // Far older than the window, so it cannot be told apart from a duplicate.
+        return false;
+    }
+}
+void udp_bond::schedule_probe()
+{
+    udp_bond::m_timer_probe.expires_from_now(udp_bond::m_probe_interval);
+    udp_bond::m_timer_probe.async_wait(boost::bind(&udp_bond::probe_callback, udp_bond::shared_from_this(), boost::placeholders::_1));
+}
+
+// CALLBACKS
+void udp_bond::rx_callback(uint32_t path, protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
+{
+    // Ignore anything that isn't a bond message.
+    if(length < BOND_HEADER_SIZE || data[0] != BOND_MAGIC)
+    {
+        delete [] data;
+        return;
+    }
+
+    message_type message = static_cast<message_type>(data[1]);
+    uint16_t epoch = static_cast<uint16_t>((data[2] << 8) | data[3]);
+    uint32_t sequence = (static_cast<uint32_t>(data[4]) << 24) | (static_cast<uint32_t>(data[5]) << 16) |
+                        (static_cast<uint32_t>(data[6]) << 8) | static_cast<uint32_t>(data[7]);
+
+    // Any bond traffic shows that the path is healthy.
+    {
+        boost::mutex::scoped_lock lock(udp_bond::m_mutex_paths);
+        udp_bond::m_last_heard[path] = boost::posix_time::microsec_clock::universal_time();
+    }
+
+    switch(message)
+    {
+    case message_type::DATA:
+    {
+        // Forward the payload of new messages only.
+        if(udp_bond::accept_sequence(epoch, sequence) && udp_bond::m_rx_callback)
+        {
+            uint32_t payload_length = length - BOND_HEADER_SIZE;
+            uint8_t* payload = new uint8_t[payload_length];
+            std::memcpy(payload, data + BOND_HEADER_SIZE, payload_length);
+            udp_bond::m_rx_callback(type, port, payload, payload_length, source);
+        }
+        break;
+    }
+    case message_type::PROBE:
+    {
+        // Reply on the same path so the peer can measure the path's health.
+        udp_bond::tx_path(path, message_type::PROBE_REPLY, sequence, nullptr, 0);
+        break;
+    }
+    case message_type::PROBE_REPLY:
+    {
+        break;
+    }
+    }
+
+    delete [] data;
+}
+void udp_bond::probe_callback(const boost::system::error_code &error)
+{
+    if(error)
+    {
+        return;
+    }
+
+    // Probe both paths.
+    udp_bond::tx_path(0, message_type::PROBE, 0, nullptr, 0);
+    udp_bond::tx_path(1, message_type::PROBE, 0, nullptr, 0);
+
+    udp_bond::schedule_probe();
+}
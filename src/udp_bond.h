@@ -0,0 +1,161 @@
+/// \file udp_bond.h
+/// \brief Defines the udp_bond class.
+#ifndef UDP_BOND_H
+#define UDP_BOND_H
+
+#include "udp_connection.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <bitset>
+#include <functional>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Provides a single logical UDP port backed by a primary and a backup network path.
+/// \details Each path is a separate udp_connection with its own local and remote endpoint.  Both ends of the
+/// link must be bonded, since every datagram carries a small header with its type, epoch, and sequence number.
+/// Paths are health probed, and messages are sent on the healthy path (preferring the primary) or duplicated
+/// onto both paths.  Received duplicates are discarded by sequence number.
+class udp_bond
+        : public boost::enable_shared_from_this<udp_bond>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new bonded UDP connection.
+    /// \param io_service The global IO Service to run the connection on.
+    /// \param primary_local_endpoint The local endpoint of the primary path.
+    /// \param primary_remote_endpoint The remote endpoint of the primary path.
+    /// \param backup_local_endpoint The local endpoint of the backup path.
+    /// \param backup_remote_endpoint The remote endpoint of the backup path.
+    /// \param duplicate_send Indicates if every message is sent on both paths.
+    /// \param probe_interval The interval in seconds between health probes on each path.
+    /// \param probe_timeout The time in seconds without traffic after which a path is considered unhealthy.
+    udp_bond(boost::asio::io_service& io_service,
+             udp::endpoint primary_local_endpoint, udp::endpoint primary_remote_endpoint,
+             udp::endpoint backup_local_endpoint, udp::endpoint backup_remote_endpoint,
+             bool duplicate_send, double probe_interval, double probe_timeout);
+
+    // METHODS
+    /// \brief Starts receiving and probing on both paths.
+    /// \return TRUE if both paths were started, otherwise FALSE.
+    bool connect();
+    /// \brief Stops receiving and probing on both paths.
+    /// \param drain_timeout The maximum time in seconds to wait for queued datagrams to be sent before closing.
+    /// \return TRUE if all queued datagrams were sent, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
+    /// \brief Attaches a callback for handling received messages.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Transmits data on the active path, or on both paths if duplicating.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the data was transmitted on at least one path, otherwise FALSE.
+    bool tx(const uint8_t *data, uint32_t length);
+    /// \brief Retargets the primary path to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint of the primary path.
+    void set_remote_endpoint(udp::endpoint remote_endpoint);
+
+    // METHODS: STATIC
+    /// \brief Gets the number of header bytes added to each message.
+    /// \return The header size in bytes.
+    static uint32_t overhead();
+
+    // PROPERTIES
+    /// \brief Gets the path that messages are currently sent on when not duplicating.
+    /// \return 0 for the primary path, 1 for the backup path.
+    uint32_t p_active_path();
+    /// \brief Gets the traffic counters of the bond, summed over both paths.
+    /// \return A snapshot of the bond's counters.
+    connection_stats::snapshot p_stats() const;
+
+private:
+    // ENUMERATIONS
+    /// \brief Enumerates the types of datagram exchanged between bonded peers.
+    enum class message_type
+    {
+        DATA = 0,           ///< A data message.
+        PROBE = 1,          ///< A health probe request.
+        PROBE_REPLY = 2     ///< A health probe reply.
+    };
+
+    // VARIABLES: PATHS
+    /// \brief The primary [0] and backup [1] paths.
+    boost::shared_ptr<udp_connection> m_paths[2];
+    /// \brief The time that traffic was last received on each path.
+    boost::posix_time::ptime m_last_heard[2];
+    /// \brief Protects the path health state.
+    boost::mutex m_mutex_paths;
+    /// \brief Indicates if every message is sent on both paths.
+    bool m_duplicate_send;
+    /// \brief The interval between health probes.
+    boost::posix_time::time_duration m_probe_interval;
+    /// \brief The time without traffic after which a path is unhealthy.
+    boost::posix_time::time_duration m_probe_timeout;
+    /// \brief The timer for sending health probes.
+    boost::asio::deadline_timer m_timer_probe;
+
+    // VARIABLES: SEQUENCING
+    /// \brief A random identifier of this sender's sequence space, which lets the receiver detect restarts.
+    uint16_t m_epoch;
+    /// \brief The sequence number of the next transmitted message.
+    uint32_t m_tx_sequence;
+    /// \brief The epoch of the peer's sequence space.
+    uint16_t m_rx_epoch;
+    /// \brief The peer's previous epoch, whose late duplicates are discarded.
+    uint16_t m_rx_retired_epoch;
+    /// \brief Indicates if the peer has restarted, so that m_rx_retired_epoch is valid.
+    bool m_rx_retired;
+    /// \brief The highest sequence number received.
+    uint32_t m_rx_sequence;
+    /// \brief Indicates if any sequenced message has been received.
+    bool m_rx_started;
+    /// \brief Marks which of the most recent sequence numbers have been received.
+    /// \details Bit i represents sequence number m_rx_sequence - i.
+    std::bitset<1024> m_rx_window;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when a message is received.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+
+    // METHODS
+    /// \brief Transmits a message with the bond header on a single path.
+    /// \param path The path to transmit on.
+    /// \param type The type of message.
+    /// \param sequence The sequence number of the message.
+    /// \param data The payload of the message.
+    /// \param length The length of the payload in bytes.
+    /// \return TRUE if the message was transmitted, otherwise FALSE.
+    bool tx_path(uint32_t path, message_type type, uint32_t sequence, const uint8_t* data, uint32_t length);
+    /// \brief Checks if a path has received traffic within the probe timeout.
+    /// \param path The path to check.
+    /// \return TRUE if the path is healthy, otherwise FALSE.
+    /// \note m_mutex_paths must be held.
+    bool healthy(uint32_t path) const;
+    /// \brief Records a received sequence number.
+    /// \param epoch The epoch of the peer's sequence space.
+    /// \param sequence The received sequence number.
+    /// \return TRUE if the sequence number is new, FALSE if it is a duplicate.
+    /// \details A new epoch restarts the window.  Messages older than the window are treated as duplicates.
+    bool accept_sequence(uint16_t epoch, uint32_t sequence);
+    /// \brief Schedules the next round of health probes.
+    void schedule_probe();
+
+    // CALLBACKS
+    /// \brief The callback for handling messages received on a path.
+    /// \param path The path that received the message.
+    /// \param type The protocol of the message.
+    /// \param port The local port of the path.
+    /// \param data The received message.
+    /// \param length The length of the message in bytes.
+    /// \param source The source address of the message.
+    void rx_callback(uint32_t path, protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
+    /// \brief The callback for sending health probes.
+    /// \param error The error code provided by the timer.
+    void probe_callback(const boost::system::error_code& error);
+};
+
+#endif // UDP_BOND_H
@@ -1,51 +1,507 @@
 #include "udp_connection.h"
+#include "latency_histogram.h"
+#include "trace.h"
 
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <sys/ioctl.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/filter.h>
+#include <linux/sockios.h>
+#endif
 
 // CONSTRUCTORS
-udp_connection::udp_connection(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint, uint32_t buffer_size)
+udp_connection::udp_connection(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint, uint32_t buffer_size, uint32_t rx_shards, bool rx_ordered, uint32_t rx_batch)
     // Initialize socket.
-    :m_socket(io_service, local_endpoint)
+    :m_socket(io_service),
+     m_loss_generator(std::random_device()())
 {
-    // Dynamically allocate buffer.
+    // Open and bind the socket, sharing the port if sharded.
+    // NOTE: Failures are reported by connect(), so that the constructor never throws.
+    udp_connection::m_opened = udp_connection::open_socket(udp_connection::m_socket, local_endpoint, rx_shards > 1);
+    udp_connection::m_local_port = local_endpoint.port();
+    udp_connection::m_filter_echo = false;
+    udp_connection::m_tx_loss = 0.0;
+
+    // Dynamically allocate buffer for a batch of messages.
+    // NOTE: The extra byte lets single reads detect datagrams larger than the buffer size.
+    udp_connection::m_rx_batch = std::max(1u, rx_batch);
     udp_connection::m_buffer_size = buffer_size;
-    udp_connection::m_buffer = new uint8_t[buffer_size];
+    udp_connection::m_buffer = new uint8_t[buffer_size * udp_connection::m_rx_batch + 1];
+    udp_connection::prepare_batch(udp_connection::m_batch, udp_connection::m_buffer);
 
     // Store remote endpoint.
     udp_connection::m_remote_endpoint = remote_endpoint;
+
+    // Open additional shards on the same port.
+    for(uint32_t i = 1; i < rx_shards && udp_connection::m_opened; i++)
+    {
+        boost::shared_ptr<rx_shard> shard(new rx_shard(buffer_size * udp_connection::m_rx_batch + 1));
+        udp_connection::prepare_batch(shard->batch, shard->buffer);
+        udp_connection::m_opened = udp_connection::open_socket(shard->socket, local_endpoint, true);
+        udp_connection::m_shards.push_back(shard);
+    }
+    if(udp_connection::m_opened && !rx_ordered && !udp_connection::m_shards.empty())
+    {
+        udp_connection::m_opened = udp_connection::distribute_shards();
+    }
 }
 udp_connection::~udp_connection()
 {
     delete [] udp_connection::m_buffer;
 }
+udp_connection::rx_shard::rx_shard(uint32_t buffer_size)
+    : socket(service)
+{
+    buffer = new uint8_t[buffer_size];
+}
+udp_connection::rx_shard::~rx_shard()
+{
+    delete [] buffer;
+}
 
 // METHODS
-void udp_connection::connect()
+bool udp_connection::connect()
 {
+    // Do not start if a socket could not be set up.
+    if(!udp_connection::m_opened)
+    {
+        return false;
+    }
+
     // Start asynchronous rx.
     udp_connection::async_rx();
+
+    // Start asynchronous rx on each shard, and run each shard on its own thread.
+    for(auto it = udp_connection::m_shards.begin(); it != udp_connection::m_shards.end(); it++)
+    {
+        udp_connection::async_rx(*it);
+        udp_connection::m_shard_threads.create_thread(boost::bind(&boost::asio::io_service::run, &(*it)->service));
+    }
+
+    return true;
 }
-void udp_connection::disconnect()
+bool udp_connection::disconnect(double drain_timeout)
 {
+    // Wait for datagrams queued in the kernel to be sent.
+    bool drained = true;
+#ifdef SIOCOUTQ
+    boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(static_cast<int64_t>(drain_timeout * 1000000.0));
+    while(drain_timeout > 0.0)
+    {
+        int queued = 0;
+        if(ioctl(udp_connection::m_socket.native_handle(), SIOCOUTQ, &queued) != 0 || queued == 0)
+        {
+            break;
+        }
+        if(boost::posix_time::microsec_clock::universal_time() >= deadline)
+        {
+            drained = false;
+            break;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+#endif
+
+    // Stop redirecting the port, which releases the XDP socket once no other port uses it.
+    if(udp_connection::m_xdp)
+    {
+        udp_connection::m_xdp->remove_port(udp_connection::m_local_port);
+        udp_connection::m_xdp.reset();
+    }
+
     // Close the socket to stop all async operations.
-    udp_connection::m_socket.close();
+    boost::system::error_code error;
+    udp_connection::m_socket.close(error);
+
+    // Close each shard's socket on its own thread, which ends the thread once its operations are aborted.
+    for(auto it = udp_connection::m_shards.begin(); it != udp_connection::m_shards.end(); it++)
+    {
+        boost::shared_ptr<rx_shard> shard = *it;
+        shard->service.post([shard]{boost::system::error_code error; shard->socket.close(error);});
+    }
+    udp_connection::m_shard_threads.join_all();
+
+    return drained;
 }
 
 void udp_connection::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
 {
     udp_connection::m_rx_callback = callback;
 }
-void udp_connection::tx(const uint8_t *data, uint32_t length)
+bool udp_connection::tx(const uint8_t *data, uint32_t length)
 {
-    udp_connection::m_socket.send_to(boost::asio::buffer(data, length), udp_connection::m_remote_endpoint);
+    TRACE_SCOPE("udp_send", udp_connection::m_local_port);
+
+    // Drop injected losses as if they were lost on the network.
+    if(udp_connection::m_tx_loss > 0.0)
+    {
+        boost::mutex::scoped_lock lock(udp_connection::m_mutex_loss);
+        if(std::uniform_real_distribution<double>(0.0, 1.0)(udp_connection::m_loss_generator) < udp_connection::m_tx_loss)
+        {
+            udp_connection::m_stats.record_drop();
+            return true;
+        }
+    }
+
+    // Take a copy of the remote endpoint, since it may be retargeted from another thread.
+    udp::endpoint remote_endpoint;
+    {
+        boost::mutex::scoped_lock lock(udp_connection::m_mutex_remote);
+        remote_endpoint = udp_connection::m_remote_endpoint;
+    }
+
+    // Send through the XDP socket when it can build the frame, and otherwise through the kernel.
+    if(udp_connection::m_xdp && udp_connection::m_xdp->tx(udp_connection::m_local_port, remote_endpoint, data, length))
+    {
+        udp_connection::m_stats.record_tx(length);
+        return true;
+    }
+
+    // Send message with error reporting, since the network may be unreachable.
+    boost::system::error_code error;
+    udp_connection::m_socket.send_to(boost::asio::buffer(data, length), remote_endpoint, 0, error);
+    if(error)
+    {
+        udp_connection::m_stats.record_tx_error();
+        return false;
+    }
+    udp_connection::m_stats.record_tx(length);
+
+    return true;
+}
+void udp_connection::set_remote_endpoint(udp::endpoint remote_endpoint)
+{
+    boost::mutex::scoped_lock lock(udp_connection::m_mutex_remote);
+    udp_connection::m_remote_endpoint = remote_endpoint;
+}
+bool udp_connection::join_group(address group, address interface_address, uint32_t ttl, bool loopback)
+{
+    boost::system::error_code error;
+
+    if(group.is_v4())
+    {
+        // IPv4 interfaces are selected by their address.
+        address_v4 interface_v4 = interface_address.is_v4() ? interface_address.to_v4() : address_v4::any();
+        udp_connection::m_socket.set_option(multicast::join_group(group.to_v4(), interface_v4), error);
+        if(!error && !interface_v4.is_unspecified())
+        {
+            udp_connection::m_socket.set_option(multicast::outbound_interface(interface_v4), error);
+        }
+    }
+    else
+    {
+        // IPv6 interfaces are selected by index, which is the scope of a link-local interface address.
+        unsigned long interface_index = interface_address.is_v6() ? interface_address.to_v6().scope_id() : 0;
+        udp_connection::m_socket.set_option(multicast::join_group(group.to_v6(), interface_index), error);
+        if(!error && interface_index != 0)
+        {
+            udp_connection::m_socket.set_option(multicast::outbound_interface(static_cast<unsigned int>(interface_index)), error);
+        }
+    }
+
+    // Configure transmission.
+    if(!error)
+    {
+        udp_connection::m_socket.set_option(multicast::hops(static_cast<int>(ttl)), error);
+    }
+    if(!error)
+    {
+        udp_connection::m_socket.set_option(multicast::enable_loopback(loopback), error);
+    }
+
+    return !error;
+}
+bool udp_connection::enable_xdp(boost::shared_ptr<xdp_socket> socket)
+{
+    if(!socket->add_port(udp_connection::m_local_port, std::bind(&udp_connection::xdp_rx_callback, udp_connection::shared_from_this(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)))
+    {
+        return false;
+    }
+    udp_connection::m_xdp = socket;
+
+    return true;
+}
+void udp_connection::set_tx_loss(double probability)
+{
+    udp_connection::m_tx_loss = probability;
+}
+bool udp_connection::enable_broadcast(bool filter_echo)
+{
+    boost::system::error_code error;
+    boost::asio::socket_base::broadcast option(true);
+    udp_connection::m_socket.set_option(option, error);
+    if(error)
+    {
+        return false;
+    }
+
+    // Broadcasts are looped back to this host, and arrive from one of its interface addresses.
+    udp_connection::m_filter_echo = filter_echo;
+    if(filter_echo)
+    {
+        udp_connection::m_echo_addresses = udp_connection::local_addresses();
+    }
+
+    return true;
+}
+
+// STATIC METHODS
+bool udp_connection::subnet_broadcast(address local_address, address &result)
+{
+    if(!local_address.is_v4())
+    {
+        return false;
+    }
+
+    ifaddrs* interfaces;
+    if(getifaddrs(&interfaces) != 0)
+    {
+        return false;
+    }
+
+    // Find the interface with the local address, and read its broadcast address.
+    bool found = false;
+    for(ifaddrs* it = interfaces; it != nullptr && !found; it = it->ifa_next)
+    {
+        if(it->ifa_addr != nullptr && it->ifa_addr->sa_family == AF_INET && (it->ifa_flags & IFF_BROADCAST) && it->ifa_broadaddr != nullptr)
+        {
+            sockaddr_in* interface_address = reinterpret_cast<sockaddr_in*>(it->ifa_addr);
+            if(ntohl(interface_address->sin_addr.s_addr) == local_address.to_v4().to_ulong())
+            {
+                result = address_v4(ntohl(reinterpret_cast<sockaddr_in*>(it->ifa_broadaddr)->sin_addr.s_addr));
+                found = true;
+            }
+        }
+    }
+
+    freeifaddrs(interfaces);
+    return found;
+}
+
+// PROPERTIES
+connection_stats::snapshot udp_connection::p_stats()
+{
+    connection_stats::snapshot output = udp_connection::m_stats.p_snapshot();
+
+    // Add the kernel queues of every socket receiving on the port.
+    connection_stats::add_queues(udp_connection::m_socket.native_handle(), false, output);
+    for(auto it = udp_connection::m_shards.cbegin(); it != udp_connection::m_shards.cend(); it++)
+    {
+        connection_stats::add_queues((*it)->socket.native_handle(), false, output);
+    }
+
+    return output;
+}
+
+// PRIVATE METHODS
+std::vector<address> udp_connection::local_addresses()
+{
+    std::vector<address> addresses;
+
+    ifaddrs* interfaces;
+    if(getifaddrs(&interfaces) == 0)
+    {
+        for(ifaddrs* it = interfaces; it != nullptr; it = it->ifa_next)
+        {
+            if(it->ifa_addr != nullptr && it->ifa_addr->sa_family == AF_INET)
+            {
+                addresses.push_back(address_v4(ntohl(reinterpret_cast<sockaddr_in*>(it->ifa_addr)->sin_addr.s_addr)));
+            }
+        }
+        freeifaddrs(interfaces);
+    }
+
+    return addresses;
+}
+bool udp_connection::is_echo(const udp::endpoint &source) const
+{
+    // NOTE: Other sockets on this host sharing the local port are indistinguishable from an echo.
+    if(!udp_connection::m_filter_echo || source.port() != udp_connection::m_local_port)
+    {
+        return false;
+    }
+
+    address source_address = source.address();
+    if(source_address.is_v6() && source_address.to_v6().is_v4_mapped())
+    {
+        source_address = source_address.to_v6().to_v4();
+    }
+    return std::find(udp_connection::m_echo_addresses.begin(), udp_connection::m_echo_addresses.end(), source_address) != udp_connection::m_echo_addresses.end();
+}
+bool udp_connection::open_socket(udp::socket &socket, const udp::endpoint &local_endpoint, bool reuse_port)
+{
+    // Open the socket.
+    boost::system::error_code error;
+    socket.open(local_endpoint.protocol(), error);
+
+    // Accept IPv4 traffic on IPv6 sockets for dual-stack operation.
+    if(!error && local_endpoint.address().is_v6())
+    {
+        boost::asio::ip::v6_only option(false);
+        socket.set_option(option, error);
+    }
+
+    // Allow other listeners on this host to bind to the same multicast group.
+    if(!error && local_endpoint.address().is_multicast())
+    {
+        boost::asio::socket_base::reuse_address option(true);
+        socket.set_option(option, error);
+    }
+
+    // Allow shards to bind to the same port.
+    if(!error && reuse_port)
+    {
+        boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> option(true);
+        socket.set_option(option, error);
+    }
+
+    // Bind socket to the local endpoint.
+    if(!error)
+    {
+        socket.bind(local_endpoint, error);
+    }
+
+    return !error;
+}
+bool udp_connection::distribute_shards()
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    // By default, the kernel hashes each source onto a single socket of the group.
+    // Replace the hash with a random socket index so that a single source is spread across all shards.
+    sock_filter code[] = {{BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_RANDOM)},
+                          {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(udp_connection::m_shards.size() + 1)},
+                          {BPF_RET | BPF_A, 0, 0, 0}};
+    sock_fprog program = {sizeof(code) / sizeof(code[0]), code};
+    return setsockopt(udp_connection::m_socket.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+#else
+    // Unordered shards are not supported on this platform.
+    return false;
+#endif
 }
 void udp_connection::async_rx()
 {
-    // Start asynchronous receive, and store the source endpoint in m_remote_endpoint.
-    udp_connection::m_socket.async_receive_from(boost::asio::buffer(udp_connection::m_buffer, udp_connection::m_buffer_size),
-                                                udp_connection::m_remote_endpoint,
+    TRACE_INSTANT("async_rx", udp_connection::m_local_port);
+
+    // Batches are read directly once the socket is readable.
+    if(udp_connection::m_rx_batch > 1)
+    {
+        udp_connection::m_socket.async_wait(udp::socket::wait_read,
+                                            boost::bind(&udp_connection::batch_rx_callback, udp_connection::shared_from_this(), boost::shared_ptr<rx_shard>(), boost::asio::placeholders::error));
+        return;
+    }
+
+    // Start asynchronous receive, and store the source endpoint in m_source_endpoint.
+    // NOTE: The source is kept separate so that received traffic never retargets transmissions.
+    udp_connection::m_socket.async_receive_from(boost::asio::buffer(udp_connection::m_buffer, udp_connection::m_buffer_size + 1),
+                                                udp_connection::m_source_endpoint,
                                                 boost::bind(&udp_connection::rx_callback, udp_connection::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 }
+void udp_connection::async_rx(boost::shared_ptr<rx_shard> shard)
+{
+    TRACE_INSTANT("async_rx", udp_connection::m_local_port);
+
+    if(udp_connection::m_rx_batch > 1)
+    {
+        shard->socket.async_wait(udp::socket::wait_read,
+                                 boost::bind(&udp_connection::batch_rx_callback, udp_connection::shared_from_this(), shard, boost::asio::placeholders::error));
+        return;
+    }
+
+    shard->socket.async_receive_from(boost::asio::buffer(shard->buffer, udp_connection::m_buffer_size + 1),
+                                     shard->source_endpoint,
+                                     boost::bind(&udp_connection::shard_rx_callback, udp_connection::shared_from_this(), shard, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+void udp_connection::prepare_batch(rx_batch &batch, uint8_t *buffer)
+{
+    batch.headers.resize(udp_connection::m_rx_batch);
+    batch.slices.resize(udp_connection::m_rx_batch);
+    batch.sources.resize(udp_connection::m_rx_batch);
+    for(uint32_t i = 0; i < udp_connection::m_rx_batch; i++)
+    {
+        batch.slices[i].iov_base = buffer + i * udp_connection::m_buffer_size;
+        batch.slices[i].iov_len = udp_connection::m_buffer_size;
+        std::memset(&batch.headers[i], 0, sizeof(mmsghdr));
+        batch.headers[i].msg_hdr.msg_iov = &batch.slices[i];
+        batch.headers[i].msg_hdr.msg_iovlen = 1;
+        batch.headers[i].msg_hdr.msg_name = &batch.sources[i];
+    }
+}
+bool udp_connection::receive_batch(udp::socket &socket, rx_batch &batch, uint8_t *buffer)
+{
+    // Reset the source address lengths, which recvmmsg overwrites.
+    for(uint32_t i = 0; i < udp_connection::m_rx_batch; i++)
+    {
+        batch.headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+
+    int count = recvmmsg(socket.native_handle(), batch.headers.data(), udp_connection::m_rx_batch, MSG_DONTWAIT, nullptr);
+    if(count < 0)
+    {
+        // A spurious wakeup leaves nothing to read.
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return true;
+        }
+        udp_connection::m_stats.record_rx_error();
+        return false;
+    }
+    latency_histogram::mark_rx();
+
+    for(int i = 0; i < count; i++)
+    {
+        udp::endpoint source;
+        std::memcpy(source.data(), &batch.sources[i], batch.headers[i].msg_hdr.msg_namelen);
+        source.resize(batch.headers[i].msg_hdr.msg_namelen);
+        if(batch.headers[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            udp_connection::m_stats.record_truncation();
+        }
+        udp_connection::deliver(buffer + i * udp_connection::m_buffer_size, batch.headers[i].msg_len, source);
+    }
+
+    return true;
+}
+std::size_t udp_connection::truncate(std::size_t bytes_read)
+{
+    // Single reads have room for one byte beyond the buffer size, which only a longer datagram fills.
+    if(bytes_read > udp_connection::m_buffer_size)
+    {
+        udp_connection::m_stats.record_truncation();
+        return udp_connection::m_buffer_size;
+    }
+
+    return bytes_read;
+}
+void udp_connection::deliver(const uint8_t *buffer, std::size_t bytes_read, const udp::endpoint &source)
+{
+    // Discard broadcasts echoed back from this connection.
+    if(udp_connection::is_echo(source))
+    {
+        return;
+    }
+    udp_connection::m_stats.record_rx(bytes_read);
+    TRACE_SCOPE("udp_deliver", udp_connection::m_local_port);
+
+    // Deep copy the data into a new output array.
+    uint8_t* output_array = new uint8_t[bytes_read];
+    std::memcpy(output_array, buffer, bytes_read);
+
+    // Raise the callback.
+    udp_connection::m_rx_callback(protocol::UDP,
+                                  udp_connection::m_local_port,
+                                  output_array, static_cast<uint32_t>(bytes_read),
+                                  source.address());
+}
 
 // CALLBACKS
 void udp_connection::rx_callback(const boost::system::error_code &error, std::size_t bytes_read)
@@ -53,16 +509,10 @@ void udp_connection::rx_callback(const boost::system::error_code &error, std::si
     // Make sure there are no errors, and that the rx callback is attached.
     if(!error && udp_connection::m_rx_callback)
     {
-        // Deep copy the data into a new output array.
-        uint8_t* output_array = new uint8_t[bytes_read];
-        std::memcpy(output_array, udp_connection::m_buffer, bytes_read);
-
         // Raise the callback.
-        // NOTE: async_recieve_from stores the remote_endpoint in m_remote_endpoint.
-        udp_connection::m_rx_callback(protocol::UDP,
-                                      udp_connection::m_socket.local_endpoint().port(),
-                                      output_array, static_cast<uint32_t>(bytes_read),
-                                      udp_connection::m_remote_endpoint.address());
+        // NOTE: async_recieve_from stores the source endpoint in m_source_endpoint.
+        latency_histogram::mark_rx();
+        udp_connection::deliver(udp_connection::m_buffer, udp_connection::truncate(bytes_read), udp_connection::m_source_endpoint);
 
         // Start a new asynchronous receive.
         udp_connection::async_rx();
@@ -75,3 +525,68 @@ void udp_connection::rx_callback(const boost::system::error_code &error, std::si
         }
     }
 }
+void udp_connection::shard_rx_callback(boost::shared_ptr<rx_shard> shard, const boost::system::error_code &error, std::size_t bytes_read)
+{
+    // Make sure there are no errors, and that the rx callback is attached.
+    if(!error && udp_connection::m_rx_callback)
+    {
+        // Raise the callback from this shard's thread.
+        latency_histogram::mark_rx();
+        udp_connection::deliver(shard->buffer, udp_connection::truncate(bytes_read), shard->source_endpoint);
+
+        // Start a new asynchronous receive.
+        udp_connection::async_rx(shard);
+    }
+    else
+    {
+        if(error != boost::asio::error::operation_aborted)
+        {
+            throw std::runtime_error("udp_connection::shard_rx_callback: " + error.message());
+        }
+    }
+}
+void udp_connection::batch_rx_callback(boost::shared_ptr<rx_shard> shard, const boost::system::error_code &error)
+{
+    // Make sure there are no errors, and that the rx callback is attached.
+    if(!error && udp_connection::m_rx_callback)
+    {
+        // Read the ready messages, and wait for more.
+        if(shard)
+        {
+            if(udp_connection::receive_batch(shard->socket, shard->batch, shard->buffer))
+            {
+                udp_connection::async_rx(shard);
+            }
+        }
+        else
+        {
+            if(udp_connection::receive_batch(udp_connection::m_socket, udp_connection::m_batch, udp_connection::m_buffer))
+            {
+                udp_connection::async_rx();
+            }
+        }
+    }
+    else
+    {
+        if(error != boost::asio::error::operation_aborted)
+        {
+            throw std::runtime_error("udp_connection::batch_rx_callback: " + error.message());
+        }
+    }
+}
+void udp_connection::xdp_rx_callback(const uint8_t *data, uint32_t length, const udp::endpoint &source)
+{
+    if(!udp_connection::m_rx_callback)
+    {
+        return;
+    }
+
+    // Datagrams are truncated to the rx buffer size, as they are when read from the socket.
+    latency_histogram::mark_rx();
+    if(length > udp_connection::m_buffer_size)
+    {
+        udp_connection::m_stats.record_truncation();
+        length = udp_connection::m_buffer_size;
+    }
+    udp_connection::deliver(data, length, source);
+}
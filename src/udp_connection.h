@@ -4,11 +4,17 @@
 #define UDP_CONNECTION_H
 
 #include "driver_modem/protocol.h"
+#include "connection_stats.h"
+#include "xdp_socket.h"
 
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/thread.hpp>
 
 #include <functional>
+#include <random>
+#include <vector>
+#include <sys/socket.h>
 
 using namespace boost::asio::ip;
 using namespace driver_modem;
@@ -24,48 +30,226 @@ public:
     /// \param local_endpoint The local endpoint to bind to.
     /// \param remote_endpoint The remote endpoint to transmit to.
     /// \param buffer_size The size of the RX buffer in bytes.
-    udp_connection(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint, uint32_t buffer_size=1024);
+    /// \param rx_shards The number of sockets receiving on the local port.
+    /// \param rx_ordered Indicates if messages from each source must be received in order when sharded.
+    /// \param rx_batch The maximum number of messages read from a socket with a single system call.
+    /// \details When rx_shards is greater than one, additional sockets are bound to the same port with SO_REUSEPORT,
+    /// and each is received on its own thread.  Ordered shards let the kernel assign each source to a single shard,
+    /// while unordered shards spread every source across all shards.
+    /// If the local endpoint is a multicast group, the socket is bound to the group with SO_REUSEADDR so that other
+    /// listeners on the same host can share the group.  See join_group.
+    /// When rx_batch is greater than one, each socket waits for readability and then drains up to rx_batch messages
+    /// with one recvmmsg call, instead of one receive operation per message.
+    udp_connection(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint, uint32_t buffer_size=1024, uint32_t rx_shards=1, bool rx_ordered=true, uint32_t rx_batch=1);
     ~udp_connection();
 
     // METHODS
     /// \brief Starts the UDP asynchronous RX operation.
-    void connect();
+    /// \return TRUE if the sockets were set up and RX started, otherwise FALSE.
+    /// \note The sockets are opened by the constructor, so a failure to open, bind, or distribute them is reported here.
+    bool connect();
     /// \brief Stops the UDP asynchronous RX operation.
-    void disconnect();
+    /// \param drain_timeout The maximum time in seconds to wait for queued datagrams to be sent before closing.
+    /// \return TRUE if all queued datagrams were sent, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
     /// \brief Attaches a callback for handling received messages.
     /// \param callback The callback to handle receieved messages.
     void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
     /// \brief Transmits data to the remote endpoint.
     /// \param data The data to transmit.
     /// \param length The length of the data in bytes.
-    void tx(const uint8_t *data, uint32_t length);
+    /// \return TRUE if the data was transmitted, otherwise FALSE.
+    bool tx(const uint8_t *data, uint32_t length);
+    /// \brief Retargets transmissions to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint to transmit to.
+    /// \details The socket remains bound and receiving throughout.  Safe to call while other threads transmit.
+    void set_remote_endpoint(udp::endpoint remote_endpoint);
+    /// \brief Joins a multicast group and configures multicast transmission.
+    /// \param group The multicast group to join.
+    /// \param interface_address The local address of the interface to join on and transmit from.
+    /// An unspecified address lets the kernel choose the interface.
+    /// \param ttl The time to live (hop limit) of transmitted multicast messages.
+    /// \param loopback Indicates if transmitted multicast messages are also received on this host.
+    /// \return TRUE if the group was joined, otherwise FALSE.
+    /// \details The connection should be bound to the group's address and transmit to the group's address.
+    bool join_group(address group, address interface_address, uint32_t ttl, bool loopback);
+    /// \brief Allows transmission to broadcast addresses.
+    /// \param filter_echo Indicates if messages that this host broadcasts from the local port are discarded on receive.
+    /// \return TRUE if broadcast was enabled, otherwise FALSE.
+    /// \details The connection should be bound to the unspecified address so that it receives broadcasts.
+    bool enable_broadcast(bool filter_echo);
+    /// \brief Receives and transmits the local port's datagrams through an AF_XDP socket.
+    /// \param socket The opened XDP socket of the local address's interface queue.
+    /// \return TRUE if the port is redirected into the socket, otherwise FALSE.
+    /// \details Should be called after attaching the rx callback and before connecting.  Datagrams that the XDP program
+    /// passes to the kernel, such as IP fragments, are still received on the connection's socket, and messages are
+    /// transmitted through the socket until the remote's link-layer address is known.
+    bool enable_xdp(boost::shared_ptr<xdp_socket> socket);
+    /// \brief Injects random loss into transmitted messages for testing.
+    /// \param probability The probability (0-1) that each transmitted message is silently dropped.
+    void set_tx_loss(double probability);
+
+    // METHODS: STATIC
+    /// \brief Gets the directed broadcast address of the subnet that a local address belongs to.
+    /// \param local_address The IPv4 address of a local interface.
+    /// \param result The broadcast address of the interface's subnet.
+    /// \return TRUE if the interface was found and supports broadcast, otherwise FALSE.
+    static bool subnet_broadcast(address local_address, address& result);
+
+    // PROPERTIES
+    /// \brief Gets the traffic counters of the connection.
+    /// \return A snapshot of the connection's counters.
+    connection_stats::snapshot p_stats();
 
 private:
     // VARIABLES: SOCKET
     /// \brief The socket implementing the UDP connection.
     udp::socket m_socket;
-    /// \brief Stores the remote endpoint information of received messages.
+    /// \brief The remote endpoint to transmit to.
     udp::endpoint m_remote_endpoint;
+    /// \brief Protects the remote endpoint, which migration replaces while other threads transmit.
+    boost::mutex m_mutex_remote;
+    /// \brief Stores the source endpoint information of received messages.
+    udp::endpoint m_source_endpoint;
+    /// \brief The local port of the connection.
+    uint16_t m_local_port;
+    /// \brief Indicates if all sockets were opened, bound, and configured by the constructor.
+    bool m_opened;
+
+    // VARIABLES: LOSS INJECTION
+    /// \brief The probability that each transmitted message is dropped.
+    double m_tx_loss;
+    /// \brief The random generator for loss injection.
+    std::mt19937 m_loss_generator;
+    /// \brief Protects the random generator for loss injection.
+    boost::mutex m_mutex_loss;
+
+    // VARIABLES: BROADCAST
+    /// \brief Indicates if broadcasts echoed back from this host are discarded.
+    bool m_filter_echo;
+    /// \brief The addresses of this host's interfaces, which identify echoed broadcasts.
+    std::vector<address> m_echo_addresses;
+
+    // VARIABLES: RX BATCHING
+    /// \brief The message headers for reading a batch of messages into a buffer with recvmmsg.
+    struct rx_batch
+    {
+        /// \brief The message header of each message in the batch.
+        std::vector<mmsghdr> headers;
+        /// \brief The slice of the buffer that each message is read into.
+        std::vector<iovec> slices;
+        /// \brief The source address of each message.
+        std::vector<sockaddr_storage> sources;
+    };
+    /// \brief The maximum number of messages read with one system call.
+    uint32_t m_rx_batch;
+    /// \brief The batch headers of the main socket.
+    rx_batch m_batch;
+
+    // VARIABLES: RX SHARDS
+    /// \brief An additional socket receiving on the local port with its own IO service.
+    struct rx_shard
+    {
+        /// \brief Creates a new shard with an unopened socket.
+        /// \param buffer_size The size of the RX buffer in bytes.
+        rx_shard(uint32_t buffer_size);
+        ~rx_shard();
+        /// \brief The shard's batch headers.
+        rx_batch batch;
+        /// \brief The IO service that the shard's socket runs on.
+        boost::asio::io_service service;
+        /// \brief The shard's socket.
+        udp::socket socket;
+        /// \brief The shard's buffer for storing received messages.
+        uint8_t* buffer;
+        /// \brief Stores the source endpoint information of received messages.
+        udp::endpoint source_endpoint;
+    };
+    /// \brief The additional RX shards of the connection.
+    std::vector<boost::shared_ptr<rx_shard>> m_shards;
+    /// \brief The threads running each shard's IO service.
+    boost::thread_group m_shard_threads;
+
+    // VARIABLES: XDP
+    /// \brief The AF_XDP socket that the local port is redirected into, if any.
+    boost::shared_ptr<xdp_socket> m_xdp;
 
     // VARIABLES: RX BUFFER
     /// \brief The internal buffer for storing received messages.
+    /// \details Holds rx_batch consecutive messages of m_buffer_size bytes each, plus one byte for detecting truncation.
     uint8_t* m_buffer;
-    /// \brief The size of the internal buffer in bytes.
+    /// \brief The size of the internal buffer for each message in bytes.
     uint32_t m_buffer_size;
 
+    // VARIABLES: STATS
+    /// \brief The traffic counters of the connection.
+    connection_stats m_stats;
+
     // VARIABLES: CALLBACKS
     /// \brief The callback to raise when a message is received.
     std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
 
     // METHODS
+    /// \brief Opens and binds a socket to the local endpoint.
+    /// \param socket The socket to open.
+    /// \param local_endpoint The local endpoint to bind to.
+    /// \param reuse_port Indicates if the port is shared with other sockets.
+    /// \return TRUE if the socket was opened and bound, otherwise FALSE.
+    static bool open_socket(udp::socket& socket, const udp::endpoint& local_endpoint, bool reuse_port);
+    /// \brief Gets the addresses of all of this host's interfaces.
+    /// \return The interface addresses.
+    static std::vector<address> local_addresses();
+    /// \brief Checks if a received message is a broadcast echoed back from this connection.
+    /// \param source The source endpoint of the message.
+    /// \return TRUE if the message should be discarded, otherwise FALSE.
+    bool is_echo(const udp::endpoint& source) const;
+    /// \brief Spreads received messages randomly across all sockets sharing the local port.
+    /// \return TRUE if the filter was attached, otherwise FALSE.
+    bool distribute_shards();
     /// \brief Initiates an asynchronous read of a single UDP packet.
     void async_rx();
+    /// \brief Initiates an asynchronous read of a single UDP packet on a shard.
+    /// \param shard The shard to read from.
+    void async_rx(boost::shared_ptr<rx_shard> shard);
+    /// \brief Prepares batch headers that read into consecutive slices of a buffer.
+    /// \param batch The batch headers to prepare.
+    /// \param buffer The buffer holding rx_batch messages.
+    void prepare_batch(rx_batch& batch, uint8_t* buffer);
+    /// \brief Reads and delivers all messages that are ready on a socket, up to one batch.
+    /// \param socket The readable socket.
+    /// \param batch The socket's batch headers.
+    /// \param buffer The buffer that the batch headers read into.
+    /// \return TRUE if the socket is still usable, otherwise FALSE.
+    bool receive_batch(udp::socket& socket, rx_batch& batch, uint8_t* buffer);
+    /// \brief Limits a single read to the buffer size, counting a truncation if the datagram was longer.
+    /// \param bytes_read The number of bytes read, up to one more than the buffer size.
+    /// \return The number of bytes to deliver.
+    std::size_t truncate(std::size_t bytes_read);
+    /// \brief Copies a received message and raises the rx callback.
+    /// \param buffer The buffer containing the message.
+    /// \param bytes_read The length of the message in bytes.
+    /// \param source The source endpoint of the message.
+    void deliver(const uint8_t* buffer, std::size_t bytes_read, const udp::endpoint& source);
 
     // CALLBACKS
     /// \brief The internal callback for handling messages received asynchronously.
     /// \param error The error code provided by the async read operation.
     /// \param bytes_read The number of bytes ready by the async read operation.
     void rx_callback(const boost::system::error_code& error, std::size_t bytes_read);
+    /// \brief The internal callback for handling messages received asynchronously on a shard.
+    /// \param shard The shard that received the message.
+    /// \param error The error code provided by the async read operation.
+    /// \param bytes_read The number of bytes ready by the async read operation.
+    void shard_rx_callback(boost::shared_ptr<rx_shard> shard, const boost::system::error_code& error, std::size_t bytes_read);
+    /// \brief The internal callback for handling a socket becoming readable when receiving in batches.
+    /// \param shard The shard that became readable, or null for the main socket.
+    /// \param error The error code provided by the async wait operation.
+    void batch_rx_callback(boost::shared_ptr<rx_shard> shard, const boost::system::error_code& error);
+    /// \brief The internal callback for handling datagrams received from the XDP socket on its thread.
+    /// \param data The payload of the datagram in the socket's UMEM.
+    /// \param length The length of the payload in bytes.
+    /// \param source The source endpoint of the datagram.
+    void xdp_rx_callback(const uint8_t* data, uint32_t length, const udp::endpoint& source);
 };
 
 #endif // UDP_CONNECTION_H
@@ -0,0 +1,353 @@
+#include "udp_fec.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+// The shard header is: magic (1), type (1), index (1), count (1), and block number (4, big endian).
+// Data shards carry the message length (2, big endian) followed by the message.  Parity shards carry the parity of
+// the length prefixed messages, so a recovered shard includes the length of its message.
+#define FEC_MAGIC 0xA6
+#define FEC_HEADER_SIZE 8
+#define FEC_LENGTH_SIZE 2
+// The size of the underlying connection's RX buffer, which bounds every shard.
+#define FEC_DATAGRAM_SIZE 1024
+// The number of blocks held by the receiver, which bounds its memory and how late a block can be recovered.
+#define FEC_MAX_BLOCKS 64
+// Blocks further than this behind the oldest accepted block indicate that the sender restarted.
+#define FEC_RESTART_DISTANCE 1024
+
+// CONSTRUCTORS
+udp_fec::udp_fec(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint,
+                 uint32_t data_shards, uint32_t parity_shards, double flush_interval)
+    // Initialize codec and timer.
+    : m_codec(parity_shards),
+      m_timer_flush(io_service)
+{
+    // Create the underlying connection.
+    udp_fec::m_connection = boost::shared_ptr<udp_connection>(new udp_connection(io_service, local_endpoint, remote_endpoint, FEC_DATAGRAM_SIZE));
+    udp_fec::m_local_port = local_endpoint.port();
+
+    // Initialize sender.  Block numbers start at random so that a restarted sender is not mistaken for stale blocks.
+    udp_fec::m_data_shards = std::max(1u, std::min(data_shards, udp_fec::m_codec.p_max_data_shards()));
+    udp_fec::m_flush_interval = flush_interval;
+    udp_fec::m_tx_block = std::random_device()();
+
+    // Initialize receiver.
+    udp_fec::m_rx_floor = 0;
+    udp_fec::m_rx_started = false;
+    udp_fec::m_recovered = 0;
+    udp_fec::m_unrecoverable = 0;
+}
+
+// PUBLIC METHODS
+bool udp_fec::connect()
+{
+    // NOTE: The connection only holds a weak reference, since this instance owns the connection.
+    boost::weak_ptr<udp_fec> fec = udp_fec::shared_from_this();
+    udp_fec::m_connection->attach_rx_callback([fec](protocol type, uint16_t port, uint8_t* data, uint32_t length, address source)
+    {
+        boost::shared_ptr<udp_fec> instance = fec.lock();
+        if(instance)
+        {
+            instance->rx_callback(type, port, data, length, source);
+        }
+        else
+        {
+            delete [] data;
+        }
+    });
+    return udp_fec::m_connection->connect();
+}
+bool udp_fec::disconnect(double drain_timeout)
+{
+    // Protect the messages of the partial block before closing.
+    {
+        boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+        if(!udp_fec::m_tx_shards.empty())
+        {
+            udp_fec::flush_block();
+        }
+    }
+    udp_fec::m_timer_flush.cancel();
+
+    return udp_fec::m_connection->disconnect(drain_timeout);
+}
+void udp_fec::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    udp_fec::m_rx_callback = callback;
+}
+bool udp_fec::tx(const uint8_t *data, uint32_t length)
+{
+    // Every shard must fit in a single datagram.
+    if(length > FEC_DATAGRAM_SIZE - FEC_HEADER_SIZE - FEC_LENGTH_SIZE)
+    {
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+
+    // Build the length prefixed shard.
+    std::vector<uint8_t> datagram(FEC_HEADER_SIZE + FEC_LENGTH_SIZE + length);
+    udp_fec::write_header(datagram.data(), shard_type::DATA, static_cast<uint8_t>(udp_fec::m_tx_shards.size()), 0, udp_fec::m_tx_block);
+    datagram[FEC_HEADER_SIZE] = static_cast<uint8_t>(length >> 8);
+    datagram[FEC_HEADER_SIZE + 1] = static_cast<uint8_t>(length);
+    if(length > 0)
+    {
+        std::memcpy(datagram.data() + FEC_HEADER_SIZE + FEC_LENGTH_SIZE, data, length);
+    }
+
+    // Transmit the message right away, and keep its shard for the block's parity.
+    bool sent = udp_fec::m_connection->tx(datagram.data(), static_cast<uint32_t>(datagram.size()));
+    udp_fec::m_tx_shards.push_back(std::vector<uint8_t>(datagram.begin() + FEC_HEADER_SIZE, datagram.end()));
+
+    if(udp_fec::m_tx_shards.size() >= udp_fec::m_data_shards)
+    {
+        udp_fec::flush_block();
+    }
+    else if(udp_fec::m_tx_shards.size() == 1)
+    {
+        // Bound how long the first message of a partial block waits for protection.
+        udp_fec::m_timer_flush.expires_from_now(boost::posix_time::microseconds(static_cast<int64_t>(udp_fec::m_flush_interval * 1000000.0)));
+        udp_fec::m_timer_flush.async_wait(boost::bind(&udp_fec::flush_callback, udp_fec::shared_from_this(), udp_fec::m_tx_block, boost::placeholders::_1));
+    }
+
+    return sent;
+}
+void udp_fec::set_remote_endpoint(udp::endpoint remote_endpoint)
+{
+    udp_fec::m_connection->set_remote_endpoint(remote_endpoint);
+}
+void udp_fec::set_tx_loss(double probability)
+{
+    udp_fec::m_connection->set_tx_loss(probability);
+}
+
+// STATIC METHODS
+uint32_t udp_fec::overhead()
+{
+    return FEC_HEADER_SIZE + FEC_LENGTH_SIZE;
+}
+
+// PROPERTIES
+uint64_t udp_fec::p_recovered() const
+{
+    boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+    return udp_fec::m_recovered;
+}
+uint64_t udp_fec::p_unrecoverable() const
+{
+    boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+    return udp_fec::m_unrecoverable;
+}
+connection_stats::snapshot udp_fec::p_stats() const
+{
+    return udp_fec::m_connection->p_stats();
+}
+
+// PRIVATE METHODS
+void udp_fec::write_header(uint8_t *datagram, shard_type type, uint8_t index, uint8_t count, uint32_t block)
+{
+    datagram[0] = FEC_MAGIC;
+    datagram[1] = static_cast<uint8_t>(type);
+    datagram[2] = index;
+    datagram[3] = count;
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        datagram[4 + i] = static_cast<uint8_t>(block >> (24 - 8 * i));
+    }
+}
+void udp_fec::flush_block()
+{
+    std::vector<std::vector<uint8_t>> parity;
+    udp_fec::m_codec.encode(udp_fec::m_tx_shards, parity);
+
+    // Parity shards carry the block's final message count, since a flushed block may be partial.
+    std::vector<uint8_t> datagram;
+    for(uint32_t i = 0; i < parity.size(); i++)
+    {
+        datagram.resize(FEC_HEADER_SIZE + parity[i].size());
+        udp_fec::write_header(datagram.data(), shard_type::PARITY, static_cast<uint8_t>(i), static_cast<uint8_t>(udp_fec::m_tx_shards.size()), udp_fec::m_tx_block);
+        std::memcpy(datagram.data() + FEC_HEADER_SIZE, parity[i].data(), parity[i].size());
+        udp_fec::m_connection->tx(datagram.data(), static_cast<uint32_t>(datagram.size()));
+    }
+
+    // Start a new block.
+    udp_fec::m_tx_shards.clear();
+    udp_fec::m_tx_block++;
+}
+udp_fec::rx_block* udp_fec::find_block(uint32_t block)
+{
+    if(!udp_fec::m_rx_started)
+    {
+        udp_fec::m_rx_started = true;
+        udp_fec::m_rx_floor = block;
+    }
+    else if(udp_fec::sequence_less()(block, udp_fec::m_rx_floor))
+    {
+        // Ignore shards of discarded blocks, unless the sender has restarted.
+        if(udp_fec::m_rx_floor - block < FEC_RESTART_DISTANCE)
+        {
+            return nullptr;
+        }
+        udp_fec::m_rx_blocks.clear();
+        udp_fec::m_rx_floor = block;
+    }
+
+    rx_block& state = udp_fec::m_rx_blocks[block];
+
+    // Discard the oldest blocks, counting the messages they never recovered.
+    while(udp_fec::m_rx_blocks.size() > FEC_MAX_BLOCKS)
+    {
+        auto oldest = udp_fec::m_rx_blocks.begin();
+        if(!oldest->second.complete)
+        {
+            udp_fec::m_unrecoverable += udp_fec::missing_shards(oldest->second);
+        }
+        udp_fec::m_rx_floor = oldest->first + 1;
+        udp_fec::m_rx_blocks.erase(oldest);
+    }
+
+    return udp_fec::m_rx_blocks.count(block) > 0 ? &state : nullptr;
+}
+void udp_fec::recover_block(rx_block &state, std::vector<std::vector<uint8_t>> &messages)
+{
+    // The block size is only known once parity arrives.
+    if(state.complete || state.count == 0)
+    {
+        return;
+    }
+    state.data.resize(std::max<std::size_t>(state.data.size(), state.count));
+    state.present.resize(state.data.size(), false);
+
+    uint32_t missing = udp_fec::missing_shards(state);
+    if(missing > 0)
+    {
+        // Only the block's data shards take part in the code.
+        std::vector<std::vector<uint8_t>> shards(state.data.begin(), state.data.begin() + state.count);
+        std::vector<bool> present(state.present.begin(), state.present.begin() + state.count);
+        if(!udp_fec::m_codec.decode(shards, present, state.parity))
+        {
+            return;
+        }
+
+        // Extract each recovered message from its length prefixed shard.
+        for(uint32_t j = 0; j < state.count; j++)
+        {
+            if(!present[j] && shards[j].size() >= FEC_LENGTH_SIZE)
+            {
+                uint32_t length = (static_cast<uint32_t>(shards[j][0]) << 8) | shards[j][1];
+                if(FEC_LENGTH_SIZE + length <= shards[j].size())
+                {
+                    messages.push_back(std::vector<uint8_t>(shards[j].begin() + FEC_LENGTH_SIZE, shards[j].begin() + FEC_LENGTH_SIZE + length));
+                    udp_fec::m_recovered++;
+                }
+            }
+        }
+    }
+
+    // Release the block's shards, but remember it so late shards are ignored.
+    state.complete = true;
+    state.data.clear();
+    state.present.clear();
+    state.parity.clear();
+}
+uint32_t udp_fec::missing_shards(const rx_block &state)
+{
+    // Without parity, only gaps before the last received message are known to be missing.
+    uint32_t count = state.count > 0 ? state.count : static_cast<uint32_t>(state.present.size());
+    uint32_t missing = 0;
+    for(uint32_t j = 0; j < count; j++)
+    {
+        if(j >= state.present.size() || !state.present[j])
+        {
+            missing++;
+        }
+    }
+    return missing;
+}
+
+// CALLBACKS
+void udp_fec::rx_callback(protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
+{
+    std::vector<std::vector<uint8_t>> messages;
+
+    // Ignore anything that isn't a shard.
+    if(length >= FEC_HEADER_SIZE && data[0] == FEC_MAGIC)
+    {
+        uint32_t index = data[2];
+        uint32_t count = data[3];
+        uint32_t block = 0;
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            block = (block << 8) | data[4 + i];
+        }
+
+        boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+        rx_block* state = udp_fec::find_block(block);
+        if(state && !state->complete)
+        {
+            switch(static_cast<shard_type>(data[1]))
+            {
+            case shard_type::DATA:
+            {
+                // Deliver new messages right away.
+                uint32_t message_length = length >= FEC_HEADER_SIZE + FEC_LENGTH_SIZE ? (static_cast<uint32_t>(data[FEC_HEADER_SIZE]) << 8) | data[FEC_HEADER_SIZE + 1] : 0;
+                if(length >= FEC_HEADER_SIZE + FEC_LENGTH_SIZE && FEC_HEADER_SIZE + FEC_LENGTH_SIZE + message_length == length &&
+                   (index >= state->present.size() || !state->present[index]))
+                {
+                    if(index >= state->data.size())
+                    {
+                        state->data.resize(index + 1);
+                        state->present.resize(index + 1, false);
+                    }
+                    state->data[index].assign(data + FEC_HEADER_SIZE, data + length);
+                    state->present[index] = true;
+                    messages.push_back(std::vector<uint8_t>(data + FEC_HEADER_SIZE + FEC_LENGTH_SIZE, data + length));
+                }
+                break;
+            }
+            case shard_type::PARITY:
+            {
+                if(count > 0 && state->parity.count(index) == 0)
+                {
+                    state->count = count;
+                    state->parity[index].assign(data + FEC_HEADER_SIZE, data + length);
+                }
+                break;
+            }
+            }
+
+            udp_fec::recover_block(*state, messages);
+        }
+    }
+
+    delete [] data;
+
+    // Raise the callback outside of the lock.
+    if(udp_fec::m_rx_callback)
+    {
+        for(auto it = messages.begin(); it != messages.end(); it++)
+        {
+            uint8_t* output_array = new uint8_t[it->size()];
+            std::memcpy(output_array, it->data(), it->size());
+            udp_fec::m_rx_callback(protocol::UDP, udp_fec::m_local_port, output_array, static_cast<uint32_t>(it->size()), source);
+        }
+    }
+}
+void udp_fec::flush_callback(uint32_t block, const boost::system::error_code &error)
+{
+    if(error)
+    {
+        return;
+    }
+
+    // Flush the block only if it is still the current, partial block.
+    boost::mutex::scoped_lock lock(udp_fec::m_mutex);
+    if(udp_fec::m_tx_block == block && !udp_fec::m_tx_shards.empty())
+    {
+        udp_fec::flush_block();
+    }
+}
@@ -0,0 +1,192 @@
+/// \file udp_fec.h
+/// \brief Defines the udp_fec class.
+#ifndef UDP_FEC_H
+#define UDP_FEC_H
+
+#include "udp_connection.h"
+#include "fec_codec.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Protects a UDP connection with forward error correction, so lost messages are recovered without retransmission.
+/// \details Both ends of the link must use FEC, since every datagram carries a small header.
+/// Messages are transmitted immediately and grouped into blocks of k data shards.  Once a block is full, or when the
+/// flush interval elapses, m parity shards are transmitted.  The receiver delivers messages as they arrive, and
+/// recovers up to m lost messages per block from the parity shards.  Recovered messages are delivered late.
+class udp_fec
+        : public boost::enable_shared_from_this<udp_fec>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new FEC protected UDP connection.
+    /// \param io_service The global IO Service to run the connection on.
+    /// \param local_endpoint The local endpoint to bind to.
+    /// \param remote_endpoint The remote endpoint to transmit to.
+    /// \param data_shards The number of messages per block (k).
+    /// \param parity_shards The number of parity shards per block (m).
+    /// \param flush_interval The maximum time in seconds between a block's first message and its parity shards.
+    udp_fec(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint,
+            uint32_t data_shards, uint32_t parity_shards, double flush_interval);
+
+    // METHODS
+    /// \brief Starts receiving.
+    /// \return TRUE if the underlying connection was started, otherwise FALSE.
+    bool connect();
+    /// \brief Transmits the parity of the current block and stops receiving.
+    /// \param drain_timeout The maximum time in seconds to wait for queued data to be sent.
+    /// \return TRUE if all queued data was sent, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
+    /// \brief Attaches a callback for handling received and recovered messages.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Transmits a message as the next data shard of the current block.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the message was transmitted, FALSE if it failed or is too long for a single datagram.
+    bool tx(const uint8_t *data, uint32_t length);
+    /// \brief Retargets transmissions to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint to transmit to.
+    void set_remote_endpoint(udp::endpoint remote_endpoint);
+    /// \brief Injects random loss into transmitted datagrams for testing.
+    /// \param probability The probability (0-1) that each transmitted datagram is dropped.
+    void set_tx_loss(double probability);
+
+    // METHODS: STATIC
+    /// \brief Gets the number of header bytes added to each message.
+    /// \return The header size in bytes.
+    static uint32_t overhead();
+
+    // PROPERTIES
+    /// \brief Gets the number of lost messages recovered from parity.
+    /// \return The number of recovered messages since the connection was created.
+    uint64_t p_recovered() const;
+    /// \brief Gets the number of lost messages that could not be recovered.
+    /// \return The number of unrecoverable messages since the connection was created.
+    /// \details Losses are counted when their block is discarded to make room for newer blocks.
+    uint64_t p_unrecoverable() const;
+    /// \brief Gets the traffic counters of the underlying connection.
+    /// \return A snapshot of the counters, which include parity shards.
+    connection_stats::snapshot p_stats() const;
+
+private:
+    // ENUMERATIONS
+    /// \brief Enumerates the types of shard exchanged between FEC peers.
+    enum class shard_type
+    {
+        DATA = 0,   ///< A message.
+        PARITY = 1  ///< A parity shard of a block.
+    };
+
+    // STRUCTURES
+    /// \brief Orders block numbers across wraparound.
+    struct sequence_less
+    {
+        bool operator()(uint32_t a, uint32_t b) const
+        {
+            return static_cast<int32_t>(a - b) < 0;
+        }
+    };
+    /// \brief A block being received.
+    struct rx_block
+    {
+        rx_block() : count(0), complete(false) {}
+        /// \brief The received data shards, by index.
+        std::vector<std::vector<uint8_t>> data;
+        /// \brief Indicates which data shards were received.
+        std::vector<bool> present;
+        /// \brief The received parity shards, by parity index.
+        std::map<uint32_t, std::vector<uint8_t>> parity;
+        /// \brief The number of data shards in the block, or zero until a parity shard is received.
+        uint32_t count;
+        /// \brief Indicates if every data shard has been delivered.
+        bool complete;
+    };
+
+    // VARIABLES: CONNECTION
+    /// \brief The underlying UDP connection.
+    boost::shared_ptr<udp_connection> m_connection;
+    /// \brief The local port of the connection.
+    uint16_t m_local_port;
+    /// \brief The erasure code.
+    fec_codec m_codec;
+    /// \brief Protects the sender and receiver state.
+    mutable boost::mutex m_mutex;
+
+    // VARIABLES: SENDER
+    /// \brief The number of messages per block.
+    uint32_t m_data_shards;
+    /// \brief The maximum time in seconds between a block's first message and its parity shards.
+    double m_flush_interval;
+    /// \brief The timer for flushing partial blocks.
+    boost::asio::deadline_timer m_timer_flush;
+    /// \brief The number of the current block.
+    uint32_t m_tx_block;
+    /// \brief The data shards of the current block.
+    std::vector<std::vector<uint8_t>> m_tx_shards;
+
+    // VARIABLES: RECEIVER
+    /// \brief The blocks being received, by block number.
+    std::map<uint32_t, rx_block, sequence_less> m_rx_blocks;
+    /// \brief The oldest block number that is still accepted.
+    uint32_t m_rx_floor;
+    /// \brief Indicates if any shard has been received, which sets the floor.
+    bool m_rx_started;
+    /// \brief The number of recovered messages.
+    uint64_t m_recovered;
+    /// \brief The number of unrecoverable messages.
+    uint64_t m_unrecoverable;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when a message is delivered.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+
+    // METHODS
+    /// \brief Writes a shard header.
+    /// \param datagram The datagram to write the header into.
+    /// \param type The type of the shard.
+    /// \param index The index of the data or parity shard within its block.
+    /// \param count The number of data shards in the block (parity only).
+    /// \param block The block number.
+    static void write_header(uint8_t* datagram, shard_type type, uint8_t index, uint8_t count, uint32_t block);
+    /// \brief Transmits the parity shards of the current block and starts a new block.
+    /// \note m_mutex must be held.
+    void flush_block();
+    /// \brief Gets the state of a received block, discarding the oldest blocks to bound memory.
+    /// \param block The block number.
+    /// \return The block's state, or nullptr if the block is too old.
+    /// \note m_mutex must be held.
+    rx_block* find_block(uint32_t block);
+    /// \brief Recovers a block's lost messages if enough shards have been received.
+    /// \param state The block's state.
+    /// \param messages The list to append recovered messages to.
+    /// \note m_mutex must be held.
+    void recover_block(rx_block& state, std::vector<std::vector<uint8_t>>& messages);
+    /// \brief Counts the messages of a block that are still missing.
+    /// \param state The block's state.
+    /// \return The number of missing messages.
+    static uint32_t missing_shards(const rx_block& state);
+
+    // CALLBACKS
+    /// \brief The callback for handling datagrams received on the connection.
+    /// \param type The protocol of the datagram.
+    /// \param port The local port of the connection.
+    /// \param data The received datagram.
+    /// \param length The length of the datagram in bytes.
+    /// \param source The source address of the datagram.
+    void rx_callback(protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
+    /// \brief The callback for flushing a partial block.
+    /// \param block The block that the timer was started for.
+    /// \param error The error code provided by the timer.
+    void flush_callback(uint32_t block, const boost::system::error_code& error);
+};
+
+#endif // UDP_FEC_H
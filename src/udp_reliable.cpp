@@ -0,0 +1,387 @@
+#include "udp_reliable.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// The reliable header is: magic (1), type (1), epoch (2), and two 4 byte fields, all big endian.
+// DATA carries the sequence number in the first field.  ACK carries the cumulative sequence number in the first field
+// and the length of the selective bitmap in the second, followed by the bitmap itself.  Bit i of the bitmap marks that
+// sequence number cumulative + 1 + i has been received, so a single ACK covers the entire reorder window.
+#define RELIABLE_MAGIC 0xA5
+#define RELIABLE_HEADER_SIZE 12
+// The size of the receive buffer at each end, which must hold an ACK whose bitmap spans the entire window.
+#define RELIABLE_BUFFER_SIZE 1024
+#define RELIABLE_MAX_WINDOW ((RELIABLE_BUFFER_SIZE - RELIABLE_HEADER_SIZE) * 8)
+
+// CONSTRUCTORS
+udp_reliable::udp_reliable(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint,
+                           uint32_t window, double min_rto, double max_rto)
+    // Initialize timer.
+    : m_timer_retransmit(io_service)
+{
+    // Create the underlying connection.
+    udp_reliable::m_connection = boost::shared_ptr<udp_connection>(new udp_connection(io_service, local_endpoint, remote_endpoint, RELIABLE_BUFFER_SIZE));
+    udp_reliable::m_local_port = local_endpoint.port();
+
+    // Store parameters.
+    udp_reliable::m_window = std::min(std::max(1u, window), static_cast<uint32_t>(RELIABLE_MAX_WINDOW));
+    udp_reliable::m_min_rto = min_rto;
+    udp_reliable::m_max_rto = std::max(min_rto, max_rto);
+
+    // Initialize sender.  The RTO starts at one second until the round trip time is measured.
+    udp_reliable::m_epoch = static_cast<uint16_t>(std::random_device()());
+    udp_reliable::m_tx_next = 0;
+    udp_reliable::m_srtt = 0.0;
+    udp_reliable::m_rttvar = 0.0;
+    udp_reliable::m_rto = std::min(udp_reliable::m_max_rto, std::max(udp_reliable::m_min_rto, 1.0));
+    udp_reliable::m_retransmissions = 0;
+
+    // Initialize receiver.
+    udp_reliable::m_rx_next = 0;
+    udp_reliable::m_rx_epoch = 0;
+    udp_reliable::m_rx_started = false;
+}
+
+// PUBLIC METHODS
+bool udp_reliable::connect()
+{
+    // NOTE: The connection only holds a weak reference, since this instance owns the connection.
+    boost::weak_ptr<udp_reliable> reliable = udp_reliable::shared_from_this();
+    udp_reliable::m_connection->attach_rx_callback([reliable](protocol type, uint16_t port, uint8_t* data, uint32_t length, address source)
+    {
+        boost::shared_ptr<udp_reliable> instance = reliable.lock();
+        if(instance)
+        {
+            instance->rx_callback(type, port, data, length, source);
+        }
+        else
+        {
+            delete [] data;
+        }
+    });
+    if(!udp_reliable::m_connection->connect())
+    {
+        return false;
+    }
+
+    // Start checking for retransmission timeouts.
+    udp_reliable::schedule_retransmit();
+
+    return true;
+}
+bool udp_reliable::disconnect(double drain_timeout)
+{
+    // Wait for unacknowledged messages to be acknowledged while the IO service keeps retransmitting.
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    boost::posix_time::ptime deadline = start + boost::posix_time::microseconds(static_cast<int64_t>(drain_timeout * 1000000.0));
+    bool drained = true;
+    while(drain_timeout > 0.0)
+    {
+        {
+            boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+            if(udp_reliable::m_tx_unacked.empty())
+            {
+                break;
+            }
+        }
+        if(boost::posix_time::microsec_clock::universal_time() >= deadline)
+        {
+            drained = false;
+            break;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    udp_reliable::m_timer_retransmit.cancel();
+
+    double remaining = std::max(0.0, drain_timeout - (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0);
+    return udp_reliable::m_connection->disconnect(remaining) && drained;
+}
+void udp_reliable::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    udp_reliable::m_rx_callback = callback;
+}
+bool udp_reliable::tx(const uint8_t *data, uint32_t length)
+{
+    boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+
+    // Refuse new messages while the send window is full.  The window spans from the oldest unacknowledged message,
+    // since the receiver only buffers messages within the window beyond its next expected message.
+    if(!udp_reliable::m_tx_unacked.empty() && udp_reliable::m_tx_next - udp_reliable::m_tx_unacked.begin()->first >= udp_reliable::m_window)
+    {
+        return false;
+    }
+
+    // Build and store the message until it is acknowledged.
+    uint32_t sequence = udp_reliable::m_tx_next++;
+    unacked& message = udp_reliable::m_tx_unacked[sequence];
+    message.datagram.resize(RELIABLE_HEADER_SIZE + length);
+    udp_reliable::write_header(message.datagram.data(), message_type::DATA, udp_reliable::m_epoch, sequence, 0);
+    if(length > 0)
+    {
+        std::memcpy(message.datagram.data() + RELIABLE_HEADER_SIZE, data, length);
+    }
+    message.sent = boost::posix_time::microsec_clock::universal_time();
+    message.transmissions = 1;
+
+    // A failed send is recovered by retransmission.
+    udp_reliable::m_connection->tx(message.datagram.data(), static_cast<uint32_t>(message.datagram.size()));
+
+    return true;
+}
+void udp_reliable::set_remote_endpoint(udp::endpoint remote_endpoint)
+{
+    udp_reliable::m_connection->set_remote_endpoint(remote_endpoint);
+}
+void udp_reliable::set_tx_loss(double probability)
+{
+    udp_reliable::m_connection->set_tx_loss(probability);
+}
+
+// STATIC METHODS
+uint32_t udp_reliable::overhead()
+{
+    return RELIABLE_HEADER_SIZE;
+}
+
+// PROPERTIES
+uint64_t udp_reliable::p_retransmissions() const
+{
+    boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+    return udp_reliable::m_retransmissions;
+}
+double udp_reliable::p_srtt() const
+{
+    boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+    return udp_reliable::m_srtt;
+}
+connection_stats::snapshot udp_reliable::p_stats() const
+{
+    return udp_reliable::m_connection->p_stats();
+}
+
+// PRIVATE METHODS
+void udp_reliable::write_header(uint8_t *datagram, message_type type, uint16_t epoch, uint32_t first, uint32_t second)
+{
+    datagram[0] = RELIABLE_MAGIC;
+    datagram[1] = static_cast<uint8_t>(type);
+    datagram[2] = static_cast<uint8_t>(epoch >> 8);
+    datagram[3] = static_cast<uint8_t>(epoch);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        datagram[4 + i] = static_cast<uint8_t>(first >> (24 - 8 * i));
+        datagram[8 + i] = static_cast<uint8_t>(second >> (24 - 8 * i));
+    }
+}
+void udp_reliable::send_ack()
+{
+    // Size the bitmap to the furthest buffered message.
+    uint32_t bits = 0;
+    if(!udp_reliable::m_rx_buffered.empty())
+    {
+        bits = udp_reliable::m_rx_buffered.rbegin()->first - udp_reliable::m_rx_next;
+    }
+
+    std::vector<uint8_t> datagram(RELIABLE_HEADER_SIZE + (bits + 7) / 8, 0);
+    udp_reliable::write_header(datagram.data(), message_type::ACK, udp_reliable::m_rx_epoch, udp_reliable::m_rx_next, bits);
+    for(auto it = udp_reliable::m_rx_buffered.begin(); it != udp_reliable::m_rx_buffered.end(); it++)
+    {
+        uint32_t offset = it->first - udp_reliable::m_rx_next - 1;
+        datagram[RELIABLE_HEADER_SIZE + offset / 8] |= static_cast<uint8_t>(1u << (offset % 8));
+    }
+    udp_reliable::m_connection->tx(datagram.data(), static_cast<uint32_t>(datagram.size()));
+}
+void udp_reliable::update_rtt(double sample)
+{
+    // Smooth the round trip time as TCP does (RFC 6298).
+    if(udp_reliable::m_srtt == 0.0)
+    {
+        udp_reliable::m_srtt = sample;
+        udp_reliable::m_rttvar = sample / 2.0;
+    }
+    else
+    {
+        udp_reliable::m_rttvar = 0.75 * udp_reliable::m_rttvar + 0.25 * std::fabs(udp_reliable::m_srtt - sample);
+        udp_reliable::m_srtt = 0.875 * udp_reliable::m_srtt + 0.125 * sample;
+    }
+    udp_reliable::m_rto = std::min(udp_reliable::m_max_rto, std::max(udp_reliable::m_min_rto, udp_reliable::m_srtt + 4.0 * udp_reliable::m_rttvar));
+}
+void udp_reliable::handle_data(uint32_t sequence, uint16_t epoch, const uint8_t *payload, uint32_t length, address source)
+{
+    std::vector<std::vector<uint8_t>> deliverable;
+    {
+        boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+
+        // A new epoch means the peer has (re)started its sequence space at zero.
+        // A receiver joining a sender that is already far along starts from the current message instead.
+        if(!udp_reliable::m_rx_started || epoch != udp_reliable::m_rx_epoch)
+        {
+            udp_reliable::m_rx_started = true;
+            udp_reliable::m_rx_epoch = epoch;
+            udp_reliable::m_rx_next = (sequence < udp_reliable::m_window) ? 0 : sequence;
+            udp_reliable::m_rx_buffered.clear();
+        }
+
+        // Use wrapping arithmetic to find how far ahead of the next expected message this one is.
+        uint32_t ahead = sequence - udp_reliable::m_rx_next;
+        if(ahead < udp_reliable::m_window)
+        {
+            // Buffer the message, ignoring duplicates.
+            if(ahead != 0 && udp_reliable::m_rx_buffered.count(sequence) == 0)
+            {
+                udp_reliable::m_rx_buffered[sequence].assign(payload, payload + length);
+            }
+            else if(ahead == 0)
+            {
+                // Deliver the message and any buffered messages that now follow it in order.
+                deliverable.push_back(std::vector<uint8_t>(payload, payload + length));
+                udp_reliable::m_rx_next++;
+                for(auto it = udp_reliable::m_rx_buffered.find(udp_reliable::m_rx_next); it != udp_reliable::m_rx_buffered.end(); it = udp_reliable::m_rx_buffered.find(udp_reliable::m_rx_next))
+                {
+                    deliverable.push_back(std::move(it->second));
+                    udp_reliable::m_rx_buffered.erase(it);
+                    udp_reliable::m_rx_next++;
+                }
+            }
+        }
+        // NOTE: Messages already delivered or beyond the reorder window are only acknowledged.
+
+        udp_reliable::send_ack();
+    }
+
+    // Raise the callback outside of the lock.
+    if(udp_reliable::m_rx_callback)
+    {
+        for(auto it = deliverable.begin(); it != deliverable.end(); it++)
+        {
+            uint8_t* output_array = new uint8_t[it->size()];
+            std::memcpy(output_array, it->data(), it->size());
+            udp_reliable::m_rx_callback(protocol::UDP, udp_reliable::m_local_port, output_array, static_cast<uint32_t>(it->size()), source);
+        }
+    }
+}
+void udp_reliable::handle_ack(uint32_t cumulative, const uint8_t *selective, uint32_t bits)
+{
+    boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    // Remove every message below the cumulative sequence number, and every selectively acknowledged message.
+    // Only messages sent once give an unambiguous round trip time sample (Karn's algorithm).
+    double sample = -1.0;
+    uint32_t highest_selective = cumulative;
+    for(auto it = udp_reliable::m_tx_unacked.begin(); it != udp_reliable::m_tx_unacked.end();)
+    {
+        uint32_t behind = cumulative - it->first;
+        uint32_t offset = it->first - cumulative - 1;
+        bool acknowledged = (behind != 0 && behind < 0x80000000) ||
+                            (offset < bits && (selective[offset / 8] & (1u << (offset % 8))));
+        if(acknowledged)
+        {
+            if(it->second.transmissions == 1)
+            {
+                sample = (now - it->second.sent).total_microseconds() / 1000000.0;
+            }
+            if(offset < bits)
+            {
+                highest_selective = it->first;
+            }
+            it = udp_reliable::m_tx_unacked.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    if(sample >= 0.0)
+    {
+        udp_reliable::update_rtt(sample);
+    }
+
+    // Messages sent before a selectively acknowledged one were most likely lost.  Retransmit them right away
+    // instead of waiting for the timeout, but only once, so that the timeout handles repeated losses.
+    for(auto it = udp_reliable::m_tx_unacked.begin(); it != udp_reliable::m_tx_unacked.end(); it++)
+    {
+        uint32_t before = highest_selective - it->first;
+        if(before != 0 && before < 0x80000000 && it->second.transmissions == 1)
+        {
+            it->second.sent = now;
+            it->second.transmissions++;
+            udp_reliable::m_retransmissions++;
+            udp_reliable::m_connection->tx(it->second.datagram.data(), static_cast<uint32_t>(it->second.datagram.size()));
+        }
+    }
+}
+void udp_reliable::schedule_retransmit()
+{
+    // Check often enough to honor the minimum timeout.
+    udp_reliable::m_timer_retransmit.expires_from_now(boost::posix_time::microseconds(static_cast<int64_t>(std::max(0.001, udp_reliable::m_min_rto / 4.0) * 1000000.0)));
+    udp_reliable::m_timer_retransmit.async_wait(boost::bind(&udp_reliable::retransmit_callback, udp_reliable::shared_from_this(), boost::placeholders::_1));
+}
+
+// CALLBACKS
+void udp_reliable::rx_callback(protocol type, uint16_t port, uint8_t *data, uint32_t length, address source)
+{
+    // Ignore anything that isn't a reliable message.
+    if(length >= RELIABLE_HEADER_SIZE && data[0] == RELIABLE_MAGIC)
+    {
+        uint16_t epoch = static_cast<uint16_t>((data[2] << 8) | data[3]);
+        uint32_t first = 0, second = 0;
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            first = (first << 8) | data[4 + i];
+            second = (second << 8) | data[8 + i];
+        }
+
+        switch(static_cast<message_type>(data[1]))
+        {
+        case message_type::DATA:
+        {
+            udp_reliable::handle_data(first, epoch, data + RELIABLE_HEADER_SIZE, length - RELIABLE_HEADER_SIZE, source);
+            break;
+        }
+        case message_type::ACK:
+        {
+            // Ignore acknowledgements of a previous epoch, and truncated bitmaps.
+            if(epoch == udp_reliable::m_epoch && (length - RELIABLE_HEADER_SIZE) * 8 >= second)
+            {
+                udp_reliable::handle_ack(first, data + RELIABLE_HEADER_SIZE, second);
+            }
+            break;
+        }
+        }
+    }
+
+    delete [] data;
+}
+void udp_reliable::retransmit_callback(const boost::system::error_code &error)
+{
+    if(error)
+    {
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(udp_reliable::m_mutex);
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+        // Retransmit timed out messages, doubling each message's timeout after every retransmission.
+        for(auto it = udp_reliable::m_tx_unacked.begin(); it != udp_reliable::m_tx_unacked.end(); it++)
+        {
+            double timeout = std::min(udp_reliable::m_max_rto, udp_reliable::m_rto * std::pow(2.0, it->second.transmissions - 1));
+            if((now - it->second.sent).total_microseconds() >= static_cast<int64_t>(timeout * 1000000.0))
+            {
+                it->second.sent = now;
+                it->second.transmissions++;
+                udp_reliable::m_retransmissions++;
+                udp_reliable::m_connection->tx(it->second.datagram.data(), static_cast<uint32_t>(it->second.datagram.size()));
+            }
+        }
+    }
+
+    udp_reliable::schedule_retransmit();
+}
@@ -0,0 +1,199 @@
+/// \file udp_reliable.h
+/// \brief Defines the udp_reliable class.
+#ifndef UDP_RELIABLE_H
+#define UDP_RELIABLE_H
+
+#include "udp_connection.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Provides reliable, in-order delivery over a UDP connection using selective repeat.
+/// \details Both ends of the link must be reliable, since every datagram carries a small header.
+/// Each message is sequenced and held until it is acknowledged.  The receiver acknowledges every datagram with
+/// its next expected sequence number and a bitmap of the messages it holds beyond it (selective ACK), so only
+/// lost messages are retransmitted.  Retransmission timeouts follow the measured round trip time.
+/// Unlike TCP, a lost message only delays the messages behind it, never the sender's transmissions.
+class udp_reliable
+        : public boost::enable_shared_from_this<udp_reliable>
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new reliable UDP connection.
+    /// \param io_service The global IO Service to run the connection on.
+    /// \param local_endpoint The local endpoint to bind to.
+    /// \param remote_endpoint The remote endpoint to transmit to.
+    /// \param window The maximum span of unacknowledged messages, which also bounds the receiver's reorder window,
+    /// limited to 8096 so that an ACK covering the window fits in the peer's receive buffer.
+    /// \param min_rto The minimum retransmission timeout in seconds.
+    /// \param max_rto The maximum retransmission timeout in seconds.
+    udp_reliable(boost::asio::io_service& io_service, udp::endpoint local_endpoint, udp::endpoint remote_endpoint,
+                 uint32_t window, double min_rto, double max_rto);
+
+    // METHODS
+    /// \brief Starts receiving and retransmitting.
+    /// \return TRUE if the underlying connection was started, otherwise FALSE.
+    bool connect();
+    /// \brief Stops receiving and retransmitting.
+    /// \param drain_timeout The maximum time in seconds to wait for unacknowledged messages to be acknowledged.
+    /// \return TRUE if all messages were acknowledged, otherwise FALSE.
+    bool disconnect(double drain_timeout = 0.0);
+    /// \brief Attaches a callback for handling received messages, which are delivered in order.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Queues a message for reliable delivery and transmits it.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the message was accepted, FALSE if the send window is full.
+    bool tx(const uint8_t *data, uint32_t length);
+    /// \brief Retargets transmissions to a new remote endpoint.
+    /// \param remote_endpoint The new remote endpoint to transmit to.
+    void set_remote_endpoint(udp::endpoint remote_endpoint);
+    /// \brief Injects random loss into transmitted datagrams for testing.
+    /// \param probability The probability (0-1) that each transmitted datagram is dropped.
+    void set_tx_loss(double probability);
+
+    // METHODS: STATIC
+    /// \brief Gets the number of header bytes added to each message.
+    /// \return The header size in bytes.
+    static uint32_t overhead();
+
+    // PROPERTIES
+    /// \brief Gets the number of retransmitted messages.
+    /// \return The number of retransmissions since the connection was created.
+    uint64_t p_retransmissions() const;
+    /// \brief Gets the current smoothed round trip time.
+    /// \return The smoothed round trip time in seconds, or zero if it has not been measured.
+    double p_srtt() const;
+    /// \brief Gets the traffic counters of the underlying connection.
+    /// \return A snapshot of the counters, which include acknowledgements and retransmissions.
+    connection_stats::snapshot p_stats() const;
+
+private:
+    // ENUMERATIONS
+    /// \brief Enumerates the types of datagram exchanged between reliable peers.
+    enum class message_type
+    {
+        DATA = 0,   ///< A sequenced data message.
+        ACK = 1     ///< A cumulative and selective acknowledgement.
+    };
+
+    // STRUCTURES
+    /// \brief A transmitted message awaiting acknowledgement.
+    struct unacked
+    {
+        /// \brief The complete datagram, including the header.
+        std::vector<uint8_t> datagram;
+        /// \brief The time that the message was last transmitted.
+        boost::posix_time::ptime sent;
+        /// \brief The number of times the message has been transmitted.
+        uint32_t transmissions;
+    };
+
+    /// \brief Orders sequence numbers across wraparound, which is consistent for any window under 2^31 messages.
+    struct sequence_less
+    {
+        bool operator()(uint32_t a, uint32_t b) const
+        {
+            return static_cast<int32_t>(a - b) < 0;
+        }
+    };
+
+    // VARIABLES: CONNECTION
+    /// \brief The underlying UDP connection.
+    boost::shared_ptr<udp_connection> m_connection;
+    /// \brief The local port of the connection.
+    uint16_t m_local_port;
+    /// \brief Protects the sender and receiver state.
+    mutable boost::mutex m_mutex;
+    /// \brief The timer for checking retransmission timeouts.
+    boost::asio::deadline_timer m_timer_retransmit;
+    /// \brief The maximum span of unacknowledged (sender) or buffered (receiver) sequence numbers.
+    uint32_t m_window;
+    /// \brief A random identifier of this sender's sequence space, which lets the receiver detect restarts.
+    uint16_t m_epoch;
+
+    // VARIABLES: SENDER
+    /// \brief The sequence number of the next new message.
+    uint32_t m_tx_next;
+    /// \brief The messages awaiting acknowledgement, by sequence number.
+    std::map<uint32_t, unacked, sequence_less> m_tx_unacked;
+    /// \brief The smoothed round trip time in seconds.
+    double m_srtt;
+    /// \brief The round trip time variation in seconds.
+    double m_rttvar;
+    /// \brief The current retransmission timeout in seconds.
+    double m_rto;
+    /// \brief The minimum retransmission timeout in seconds.
+    double m_min_rto;
+    /// \brief The maximum retransmission timeout in seconds.
+    double m_max_rto;
+    /// \brief The number of retransmitted messages.
+    uint64_t m_retransmissions;
+
+    // VARIABLES: RECEIVER
+    /// \brief The sequence number of the next message to deliver.
+    uint32_t m_rx_next;
+    /// \brief The epoch of the peer's sequence space.
+    uint16_t m_rx_epoch;
+    /// \brief Indicates if any message has been received from the peer.
+    bool m_rx_started;
+    /// \brief Messages received ahead of m_rx_next, by sequence number.
+    std::map<uint32_t, std::vector<uint8_t>, sequence_less> m_rx_buffered;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when a message is delivered.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+
+    // METHODS
+    /// \brief Writes a reliable header.
+    /// \param datagram The datagram to write the header into.
+    /// \param type The type of the datagram.
+    /// \param epoch The epoch of the sequence space.
+    /// \param first The first header field.
+    /// \param second The second header field.
+    static void write_header(uint8_t* datagram, message_type type, uint16_t epoch, uint32_t first, uint32_t second);
+    /// \brief Sends an acknowledgement of the receiver's current state.
+    /// \note m_mutex must be held.
+    void send_ack();
+    /// \brief Updates the round trip time estimate with a new sample.
+    /// \param sample The round trip time sample in seconds.
+    /// \note m_mutex must be held.
+    void update_rtt(double sample);
+    /// \brief Processes a received data message.
+    /// \param sequence The sequence number of the message.
+    /// \param epoch The epoch of the message.
+    /// \param payload The payload of the message.
+    /// \param length The length of the payload in bytes.
+    /// \param source The source address of the message.
+    void handle_data(uint32_t sequence, uint16_t epoch, const uint8_t* payload, uint32_t length, address source);
+    /// \brief Processes a received acknowledgement.
+    /// \param cumulative The peer's next expected sequence number.
+    /// \param selective The bitmap of messages held by the peer after the cumulative sequence number.
+    /// \param bits The number of bits in the bitmap.
+    void handle_ack(uint32_t cumulative, const uint8_t* selective, uint32_t bits);
+    /// \brief Schedules the next retransmission check.
+    void schedule_retransmit();
+
+    // CALLBACKS
+    /// \brief The callback for handling datagrams received on the connection.
+    /// \param type The protocol of the datagram.
+    /// \param port The local port of the connection.
+    /// \param data The received datagram.
+    /// \param length The length of the datagram in bytes.
+    /// \param source The source address of the datagram.
+    void rx_callback(protocol type, uint16_t port, uint8_t* data, uint32_t length, address source);
+    /// \brief The callback for retransmitting timed out messages.
+    /// \param error The error code provided by the timer.
+    void retransmit_callback(const boost::system::error_code& error);
+};
+
+#endif // UDP_RELIABLE_H
@@ -0,0 +1,320 @@
+#include "unix_connection.h"
+#include "latency_histogram.h"
+#include "trace.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// CONSTRUCTORS
+unix_connection::unix_connection(boost::asio::io_service& io_service, uint16_t port, mode connection_mode, std::string local_path, std::string remote_path, uint32_t buffer_size)
+    // Initialize sockets.
+    : m_service(io_service),
+      m_datagram_socket(io_service),
+      m_acceptor(io_service)
+{
+    // Store configuration.
+    unix_connection::m_port = port;
+    unix_connection::m_mode = connection_mode;
+    unix_connection::m_local_path = local_path;
+    unix_connection::m_remote_path = remote_path;
+    unix_connection::m_bound_file = false;
+
+    // Dynamically allocate buffer.
+    unix_connection::m_buffer_size = buffer_size;
+    unix_connection::m_buffer = new uint8_t[buffer_size];
+}
+unix_connection::~unix_connection()
+{
+    delete [] unix_connection::m_buffer;
+}
+unix_connection::stream::stream(boost::asio::io_service& io_service, uint32_t buffer_size)
+    : socket(io_service)
+{
+    buffer = new uint8_t[buffer_size];
+}
+unix_connection::stream::~stream()
+{
+    delete [] buffer;
+}
+
+// PUBLIC METHODS
+bool unix_connection::connect()
+{
+    boost::system::error_code error;
+
+    switch(unix_connection::m_mode)
+    {
+    case mode::DATAGRAM:
+    {
+        // A datagram connection without a local path can only transmit.
+        unix_connection::remove_stale_file();
+        unix_connection::m_datagram_socket.open(boost::asio::local::datagram_protocol(), error);
+        if(!error && !unix_connection::m_local_path.empty())
+        {
+            unix_connection::m_datagram_socket.bind(boost::asio::local::datagram_protocol::endpoint(unix_connection::socket_path(unix_connection::m_local_path)), error);
+        }
+        if(error)
+        {
+            return false;
+        }
+        unix_connection::m_bound_file = !unix_connection::m_local_path.empty() && unix_connection::m_local_path.front() != '@';
+
+        unix_connection::async_rx();
+        return true;
+    }
+    case mode::STREAM_SERVER:
+    {
+        unix_connection::remove_stale_file();
+        unix_connection::m_acceptor.open(boost::asio::local::stream_protocol(), error);
+        if(!error)
+        {
+            unix_connection::m_acceptor.bind(boost::asio::local::stream_protocol::endpoint(unix_connection::socket_path(unix_connection::m_local_path)), error);
+        }
+        if(!error)
+        {
+            unix_connection::m_acceptor.listen(boost::asio::socket_base::max_listen_connections, error);
+        }
+        if(error)
+        {
+            return false;
+        }
+        unix_connection::m_bound_file = !unix_connection::m_local_path.empty() && unix_connection::m_local_path.front() != '@';
+
+        unix_connection::async_accept();
+        return true;
+    }
+    case mode::STREAM_CLIENT:
+    {
+        return unix_connection::connect_stream();
+    }
+    }
+
+    return false;
+}
+void unix_connection::disconnect()
+{
+    // Close all sockets to stop all async operations.
+    boost::system::error_code error;
+    unix_connection::m_datagram_socket.close(error);
+    unix_connection::m_acceptor.close(error);
+    {
+        boost::mutex::scoped_lock lock(unix_connection::m_mutex_streams);
+        for(auto it = unix_connection::m_streams.begin(); it != unix_connection::m_streams.end(); it++)
+        {
+            (*it)->socket.close(error);
+        }
+        unix_connection::m_streams.clear();
+    }
+
+    // Remove the socket file so the path can be bound again.
+    if(unix_connection::m_bound_file)
+    {
+        ::unlink(unix_connection::m_local_path.c_str());
+        unix_connection::m_bound_file = false;
+    }
+}
+void unix_connection::attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t *, uint32_t, address)> callback)
+{
+    unix_connection::m_rx_callback = callback;
+}
+bool unix_connection::tx(const uint8_t *data, uint32_t length)
+{
+    boost::system::error_code error;
+
+    if(unix_connection::m_mode == mode::DATAGRAM)
+    {
+        // Datagrams require a remote path.
+        if(unix_connection::m_remote_path.empty())
+        {
+            return false;
+        }
+        unix_connection::m_datagram_socket.send_to(boost::asio::buffer(data, length), boost::asio::local::datagram_protocol::endpoint(unix_connection::socket_path(unix_connection::m_remote_path)), 0, error);
+        return !error;
+    }
+
+    // Reconnect a client that has lost its server.
+    if(unix_connection::m_mode == mode::STREAM_CLIENT)
+    {
+        bool connected;
+        {
+            boost::mutex::scoped_lock lock(unix_connection::m_mutex_streams);
+            connected = !unix_connection::m_streams.empty();
+        }
+        if(!connected && !unix_connection::connect_stream())
+        {
+            return false;
+        }
+    }
+
+    // Write to each established stream.
+    std::vector<boost::shared_ptr<stream>> streams;
+    {
+        boost::mutex::scoped_lock lock(unix_connection::m_mutex_streams);
+        streams = unix_connection::m_streams;
+    }
+    bool sent = false;
+    for(auto it = streams.begin(); it != streams.end(); it++)
+    {
+        boost::asio::write((*it)->socket, boost::asio::buffer(data, length), error);
+        sent |= !error;
+    }
+
+    return sent;
+}
+
+// STATIC METHODS
+bool unix_connection::parse_mode(const std::string &value, mode &result)
+{
+    if(value == "datagram")
+    {
+        result = mode::DATAGRAM;
+    }
+    else if(value == "server")
+    {
+        result = mode::STREAM_SERVER;
+    }
+    else if(value == "client")
+    {
+        result = mode::STREAM_CLIENT;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// PRIVATE METHODS
+std::string unix_connection::socket_path(const std::string &path)
+{
+    std::string output = path;
+    if(!output.empty() && output.front() == '@')
+    {
+        output[0] = '\0';
+    }
+    return output;
+}
+void unix_connection::remove_stale_file()
+{
+    // Only remove an existing socket file, never a regular file.
+    struct stat info;
+    if(!unix_connection::m_local_path.empty() && unix_connection::m_local_path.front() != '@' &&
+       ::stat(unix_connection::m_local_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+    {
+        ::unlink(unix_connection::m_local_path.c_str());
+    }
+}
+bool unix_connection::connect_stream()
+{
+    boost::shared_ptr<stream> new_stream(new stream(unix_connection::m_service, unix_connection::m_buffer_size));
+
+    boost::system::error_code error;
+    new_stream->socket.connect(boost::asio::local::stream_protocol::endpoint(unix_connection::socket_path(unix_connection::m_remote_path)), error);
+    if(error)
+    {
+        return false;
+    }
+
+    unix_connection::add_stream(new_stream);
+    return true;
+}
+void unix_connection::add_stream(boost::shared_ptr<stream> new_stream)
+{
+    {
+        boost::mutex::scoped_lock lock(unix_connection::m_mutex_streams);
+        unix_connection::m_streams.push_back(new_stream);
+    }
+    unix_connection::async_rx(new_stream);
+}
+void unix_connection::remove_stream(boost::shared_ptr<stream> closed_stream)
+{
+    boost::system::error_code error;
+    closed_stream->socket.close(error);
+
+    boost::mutex::scoped_lock lock(unix_connection::m_mutex_streams);
+    unix_connection::m_streams.erase(std::remove(unix_connection::m_streams.begin(), unix_connection::m_streams.end(), closed_stream), unix_connection::m_streams.end());
+}
+void unix_connection::async_accept()
+{
+    boost::shared_ptr<stream> new_stream(new stream(unix_connection::m_service, unix_connection::m_buffer_size));
+    unix_connection::m_acceptor.async_accept(new_stream->socket,
+                                             boost::bind(&unix_connection::accept_callback, unix_connection::shared_from_this(), new_stream, boost::asio::placeholders::error));
+}
+void unix_connection::async_rx()
+{
+    unix_connection::m_datagram_socket.async_receive(boost::asio::buffer(unix_connection::m_buffer, unix_connection::m_buffer_size),
+                                                     boost::bind(&unix_connection::rx_callback, unix_connection::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+void unix_connection::async_rx(boost::shared_ptr<stream> target)
+{
+    target->socket.async_receive(boost::asio::buffer(target->buffer, unix_connection::m_buffer_size),
+                                 boost::bind(&unix_connection::stream_rx_callback, unix_connection::shared_from_this(), target, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+void unix_connection::deliver(const uint8_t *buffer, std::size_t bytes_read)
+{
+    if(unix_connection::m_rx_callback)
+    {
+        TRACE_SCOPE("unix_deliver", unix_connection::m_port);
+        latency_histogram::mark_rx();
+
+        // Deep copy the data into a new output array.
+        uint8_t* output_array = new uint8_t[bytes_read];
+        std::memcpy(output_array, buffer, bytes_read);
+
+        // Raise the callback.  Local sockets have no source IP address.
+        unix_connection::m_rx_callback(protocol::UNIX,
+                                       unix_connection::m_port,
+                                       output_array, static_cast<uint32_t>(bytes_read),
+                                       address());
+    }
+}
+
+// CALLBACKS
+void unix_connection::accept_callback(boost::shared_ptr<stream> new_stream, const boost::system::error_code &error)
+{
+    if(!error)
+    {
+        unix_connection::add_stream(new_stream);
+
+        // Accept the next client.
+        unix_connection::async_accept();
+    }
+    else if(error != boost::asio::error::operation_aborted)
+    {
+        throw std::runtime_error("unix_connection::accept_callback: " + error.message());
+    }
+}
+void unix_connection::rx_callback(const boost::system::error_code &error, std::size_t bytes_read)
+{
+    if(!error)
+    {
+        unix_connection::deliver(unix_connection::m_buffer, bytes_read);
+
+        // Start a new asynchronous receive.
+        unix_connection::async_rx();
+    }
+    else if(error != boost::asio::error::operation_aborted)
+    {
+        throw std::runtime_error("unix_connection::rx_callback: " + error.message());
+    }
+}
+void unix_connection::stream_rx_callback(boost::shared_ptr<stream> target, const boost::system::error_code &error, std::size_t bytes_read)
+{
+    if(!error)
+    {
+        unix_connection::deliver(target->buffer, bytes_read);
+
+        // Start a new asynchronous receive.
+        unix_connection::async_rx(target);
+    }
+    else if(error != boost::asio::error::operation_aborted)
+    {
+        // The remote process closed the stream.
+        unix_connection::remove_stream(target);
+    }
+}
@@ -0,0 +1,160 @@
+/// \file unix_connection.h
+/// \brief Defines the unix_connection class.
+#ifndef UNIX_CONNECTION_H
+#define UNIX_CONNECTION_H
+
+#include "driver_modem/protocol.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <functional>
+#include <vector>
+
+using namespace boost::asio::ip;
+using namespace driver_modem;
+
+/// \brief Provides a single asynchronous Unix domain socket connection for local processes.
+/// \details Connections are identified by a port number like TCP/UDP connections, and are addressed by a socket path.
+/// Paths beginning with '@' are placed in Linux's abstract namespace, which leaves no file behind.
+class unix_connection
+        : public boost::enable_shared_from_this<unix_connection>
+{
+public:
+    // ENUMERATIONS
+    /// \brief Enumerates the modes of a Unix domain socket connection.
+    enum class mode
+    {
+        DATAGRAM = 0,       ///< Datagrams received on the local path and sent to the remote path.
+        STREAM_SERVER = 1,  ///< A stream listening on the local path for any number of clients.
+        STREAM_CLIENT = 2   ///< A stream connected to a server listening on the remote path.
+    };
+
+    // CONSTRUCTORS
+    /// \brief Creates a new Unix domain socket connection.
+    /// \param io_service The global IO Service to run the connection on.
+    /// \param port The port number that identifies the connection.
+    /// \param connection_mode The mode of the connection.
+    /// \param local_path The path to bind to (datagram and stream server).
+    /// \param remote_path The path to transmit to (datagram) or connect to (stream client).
+    /// \param buffer_size The size of the RX buffer in bytes.
+    unix_connection(boost::asio::io_service& io_service, uint16_t port, mode connection_mode, std::string local_path, std::string remote_path, uint32_t buffer_size=1024);
+    ~unix_connection();
+
+    // METHODS
+    /// \brief Binds, listens, or connects the socket, and starts receiving.
+    /// \return TRUE if the connection was started, otherwise FALSE.
+    bool connect();
+    /// \brief Closes the connection, and removes the socket file of a bound filesystem path.
+    void disconnect();
+    /// \brief Attaches a callback for handling received messages.
+    /// \param callback The callback to handle received messages.
+    void attach_rx_callback(std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> callback);
+    /// \brief Transmits data to the remote path, or to every connected stream client as a server.
+    /// \param data The data to transmit.
+    /// \param length The length of the data in bytes.
+    /// \return TRUE if the data was transmitted, otherwise FALSE.
+    /// \details A stream client that has lost its server reconnects before transmitting.
+    bool tx(const uint8_t *data, uint32_t length);
+
+    // METHODS: STATIC
+    /// \brief Parses a mode from its string representation.
+    /// \param value The string representation ("datagram", "server", or "client").
+    /// \param result The parsed mode.
+    /// \return TRUE if the string is a valid mode, otherwise FALSE.
+    static bool parse_mode(const std::string& value, mode& result);
+
+private:
+    // VARIABLES: CONFIGURATION
+    /// \brief The port number that identifies the connection.
+    uint16_t m_port;
+    /// \brief The mode of the connection.
+    mode m_mode;
+    /// \brief The socket path to bind to.
+    std::string m_local_path;
+    /// \brief The socket path to transmit to or connect to.
+    std::string m_remote_path;
+    /// \brief Indicates if a socket file was created at the local path.
+    bool m_bound_file;
+
+    // VARIABLES: SOCKETS
+    /// \brief The IO service that the connection runs on.
+    boost::asio::io_service& m_service;
+    /// \brief The datagram socket.
+    boost::asio::local::datagram_protocol::socket m_datagram_socket;
+    /// \brief The stream acceptor of a server.
+    boost::asio::local::stream_protocol::acceptor m_acceptor;
+    /// \brief An established stream with its own RX buffer.
+    struct stream
+    {
+        /// \brief Creates a new, unconnected stream.
+        /// \param io_service The IO service to run the stream on.
+        /// \param buffer_size The size of the RX buffer in bytes.
+        stream(boost::asio::io_service& io_service, uint32_t buffer_size);
+        ~stream();
+        /// \brief The stream's socket.
+        boost::asio::local::stream_protocol::socket socket;
+        /// \brief The stream's buffer for storing received messages.
+        uint8_t* buffer;
+    };
+    /// \brief The established streams of the connection.
+    std::vector<boost::shared_ptr<stream>> m_streams;
+    /// \brief Protects the list of established streams.
+    boost::mutex m_mutex_streams;
+
+    // VARIABLES: RX BUFFER
+    /// \brief The internal buffer for storing received datagrams.
+    uint8_t* m_buffer;
+    /// \brief The size of the internal buffers in bytes.
+    uint32_t m_buffer_size;
+
+    // VARIABLES: CALLBACKS
+    /// \brief The callback to raise when a message is received.
+    std::function<void(protocol, uint16_t, uint8_t*, uint32_t, address)> m_rx_callback;
+
+    // METHODS
+    /// \brief Converts a configured path to a socket path, mapping a leading '@' to the abstract namespace.
+    /// \param path The configured path.
+    /// \return The socket path.
+    static std::string socket_path(const std::string& path);
+    /// \brief Removes a stale socket file left at the local path by a previous process.
+    void remove_stale_file();
+    /// \brief Connects a new stream to the remote path.
+    /// \return TRUE if the stream was connected, otherwise FALSE.
+    bool connect_stream();
+    /// \brief Adds an established stream and starts receiving on it.
+    /// \param new_stream The established stream.
+    void add_stream(boost::shared_ptr<stream> new_stream);
+    /// \brief Closes and removes an established stream.
+    /// \param closed_stream The stream to remove.
+    void remove_stream(boost::shared_ptr<stream> closed_stream);
+    /// \brief Initiates an asynchronous accept of a new stream.
+    void async_accept();
+    /// \brief Initiates an asynchronous read of a single datagram.
+    void async_rx();
+    /// \brief Initiates an asynchronous read on a stream.
+    /// \param target The stream to read from.
+    void async_rx(boost::shared_ptr<stream> target);
+    /// \brief Copies a received message and raises the rx callback.
+    /// \param buffer The buffer containing the message.
+    /// \param bytes_read The length of the message in bytes.
+    void deliver(const uint8_t* buffer, std::size_t bytes_read);
+
+    // CALLBACKS
+    /// \brief The internal callback for handling accepted streams.
+    /// \param new_stream The accepted stream.
+    /// \param error The error code provided by the async accept operation.
+    void accept_callback(boost::shared_ptr<stream> new_stream, const boost::system::error_code& error);
+    /// \brief The internal callback for handling datagrams received asynchronously.
+    /// \param error The error code provided by the async read operation.
+    /// \param bytes_read The number of bytes ready by the async read operation.
+    void rx_callback(const boost::system::error_code& error, std::size_t bytes_read);
+    /// \brief The internal callback for handling stream data received asynchronously.
+    /// \param target The stream that received the data.
+    /// \param error The error code provided by the async read operation.
+    /// \param bytes_read The number of bytes ready by the async read operation.
+    void stream_rx_callback(boost::shared_ptr<stream> target, const boost::system::error_code& error, std::size_t bytes_read);
+};
+
+#endif // UNIX_CONNECTION_H
@@ -0,0 +1,920 @@
+#include "xdp_socket.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <net/route.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+// The number of UMEM frames.  The first half receive and the second half transmit.
+#define XDP_FRAME_COUNT 4096
+// The size of each UMEM frame in bytes.
+#define XDP_FRAME_SIZE 2048
+// The number of entries in each ring, which holds every frame of its half of the UMEM.
+#define XDP_RING_SIZE (XDP_FRAME_COUNT / 2)
+// The maximum number of frames handled per pass over the rx ring.
+#define XDP_RX_BATCH 64
+// The length of an Ethernet header.
+#define XDP_ETHERNET_HEADER 14
+// The length of a UDP header.
+#define XDP_UDP_HEADER 8
+// The time in milliseconds that a cached link-layer address is used before it is looked up again.
+#define XDP_NEIGHBOR_LIFETIME 5000
+// The minimum time in milliseconds between refreshes of a link-layer address learned from received frames.
+#define XDP_NEIGHBOR_REFRESH 1000
+
+namespace
+{
+    long bpf(int command, bpf_attr& attributes)
+    {
+        return syscall(__NR_bpf, command, &attributes, sizeof(attributes));
+    }
+    uint64_t pointer(const void* value)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+    }
+    int create_map(uint32_t type, uint32_t entries, const char* name)
+    {
+        bpf_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.map_type = type;
+        attributes.key_size = sizeof(uint32_t);
+        attributes.value_size = sizeof(uint32_t);
+        attributes.max_entries = entries;
+        std::strncpy(attributes.map_name, name, BPF_OBJ_NAME_LEN - 1);
+        return static_cast<int>(bpf(BPF_MAP_CREATE, attributes));
+    }
+    bool update_map(int map, uint32_t key, uint32_t value)
+    {
+        bpf_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.map_fd = static_cast<uint32_t>(map);
+        attributes.key = pointer(&key);
+        attributes.value = pointer(&value);
+        attributes.flags = BPF_ANY;
+        return bpf(BPF_MAP_UPDATE_ELEM, attributes) == 0;
+    }
+
+    /// \brief Assembles a BPF program with jumps to named labels.
+    class program_builder
+    {
+    public:
+        void emit(uint8_t code, uint8_t destination, uint8_t source, int16_t offset, int32_t immediate)
+        {
+            bpf_insn instruction;
+            std::memset(&instruction, 0, sizeof(instruction));
+            instruction.code = code;
+            instruction.dst_reg = destination & 0x0F;
+            instruction.src_reg = source & 0x0F;
+            instruction.off = offset;
+            instruction.imm = immediate;
+            program_builder::m_instructions.push_back(instruction);
+        }
+        void jump(uint8_t operation, uint8_t destination, int32_t immediate, const std::string& target)
+        {
+            program_builder::m_jumps.push_back(std::make_pair(program_builder::m_instructions.size(), target));
+            program_builder::emit(BPF_JMP | operation | BPF_K, destination, 0, 0, immediate);
+        }
+        void jump_register(uint8_t operation, uint8_t destination, uint8_t source, const std::string& target)
+        {
+            program_builder::m_jumps.push_back(std::make_pair(program_builder::m_instructions.size(), target));
+            program_builder::emit(BPF_JMP | operation | BPF_X, destination, source, 0, 0);
+        }
+        void load_map(uint8_t destination, int map)
+        {
+            // 64-bit immediate loads take two instructions.
+            program_builder::emit(BPF_LD | BPF_DW | BPF_IMM, destination, BPF_PSEUDO_MAP_FD, 0, map);
+            program_builder::emit(0, 0, 0, 0, 0);
+        }
+        void label(const std::string& name)
+        {
+            program_builder::m_labels[name] = program_builder::m_instructions.size();
+        }
+        std::vector<bpf_insn> link()
+        {
+            for(auto it = program_builder::m_jumps.begin(); it != program_builder::m_jumps.end(); it++)
+            {
+                program_builder::m_instructions[it->first].off = static_cast<int16_t>(program_builder::m_labels.at(it->second) - it->first - 1);
+            }
+            return program_builder::m_instructions;
+        }
+
+    private:
+        std::vector<bpf_insn> m_instructions;
+        std::map<std::string, std::size_t> m_labels;
+        std::vector<std::pair<std::size_t, std::string>> m_jumps;
+    };
+
+    uint16_t read16(const uint8_t* data)
+    {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+    void write16(uint8_t* data, uint16_t value)
+    {
+        data[0] = static_cast<uint8_t>(value >> 8);
+        data[1] = static_cast<uint8_t>(value);
+    }
+    uint32_t checksum_add(uint32_t sum, const uint8_t* data, uint32_t length)
+    {
+        for(uint32_t i = 0; i + 1 < length; i += 2)
+        {
+            sum += read16(data + i);
+        }
+        if(length % 2 != 0)
+        {
+            sum += static_cast<uint32_t>(data[length - 1]) << 8;
+        }
+        return sum;
+    }
+    uint16_t checksum_fold(uint32_t sum)
+    {
+        while(sum >> 16)
+        {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        return static_cast<uint16_t>(~sum);
+    }
+}
+
+// CONSTRUCTORS
+xdp_socket::xdp_socket()
+    : m_socket(-1),
+      m_program(-1),
+      m_link(-1),
+      m_port_map(-1),
+      m_socket_map(-1),
+      m_interface_index(0),
+      m_mtu(0),
+      m_umem(nullptr),
+      m_tx_id(0),
+      m_stop_event(-1)
+{
+    std::memset(&(xdp_socket::m_fill), 0, sizeof(ring));
+    std::memset(&(xdp_socket::m_completion), 0, sizeof(ring));
+    std::memset(&(xdp_socket::m_rx), 0, sizeof(ring));
+    std::memset(&(xdp_socket::m_tx), 0, sizeof(ring));
+    xdp_socket::m_local_mac.fill(0);
+    xdp_socket::m_last_source_mac.fill(0);
+    xdp_socket::m_last_source_learned = boost::posix_time::min_date_time;
+}
+xdp_socket::~xdp_socket()
+{
+    xdp_socket::close();
+}
+
+// METHODS
+bool xdp_socket::open(const std::string &interface, uint32_t queue, address local_address, bool native)
+{
+#ifdef DRIVER_MODEM_XDP
+    xdp_socket::m_interface = interface;
+    xdp_socket::m_interface_index = if_nametoindex(interface.c_str());
+    if(xdp_socket::m_interface_index == 0 || local_address.is_unspecified())
+    {
+        return false;
+    }
+    if(local_address.is_v6() && local_address.to_v6().is_v4_mapped())
+    {
+        local_address = local_address.to_v6().to_v4();
+    }
+    xdp_socket::m_local_address = local_address;
+
+    // Read the interface's link-layer address and MTU for building transmitted frames.
+    int control = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(control < 0)
+    {
+        return false;
+    }
+    ifreq request;
+    std::memset(&request, 0, sizeof(request));
+    std::strncpy(request.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+    bool configured = ioctl(control, SIOCGIFHWADDR, &request) == 0;
+    std::memcpy(xdp_socket::m_local_mac.data(), request.ifr_hwaddr.sa_data, xdp_socket::m_local_mac.size());
+    configured = configured && ioctl(control, SIOCGIFMTU, &request) == 0;
+    xdp_socket::m_mtu = static_cast<uint32_t>(request.ifr_mtu);
+    ::close(control);
+    if(!configured)
+    {
+        return false;
+    }
+
+    // Load the program and bind the socket to the queue.
+    if(!xdp_socket::load_program() || !xdp_socket::create_socket(queue, native))
+    {
+        xdp_socket::close();
+        return false;
+    }
+
+    // Start receiving before the program is attached, so that redirected frames never wait for the thread.
+    xdp_socket::m_stop_event = eventfd(0, EFD_CLOEXEC);
+    if(xdp_socket::m_stop_event < 0)
+    {
+        xdp_socket::close();
+        return false;
+    }
+    xdp_socket::m_rx_thread = boost::thread(&xdp_socket::rx_loop, this);
+
+    // Attach the program through a link, which detaches it again when the link is closed.
+    bpf_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.link_create.prog_fd = static_cast<uint32_t>(xdp_socket::m_program);
+    attributes.link_create.target_ifindex = xdp_socket::m_interface_index;
+    attributes.link_create.attach_type = BPF_XDP;
+    attributes.link_create.flags = native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    xdp_socket::m_link = static_cast<int>(bpf(BPF_LINK_CREATE, attributes));
+    if(xdp_socket::m_link < 0)
+    {
+        xdp_socket::close();
+        return false;
+    }
+
+    return true;
+#else
+    (void)interface;
+    (void)queue;
+    (void)local_address;
+    (void)native;
+    return false;
+#endif
+}
+void xdp_socket::close()
+{
+    // Stop redirecting frames first.
+    if(xdp_socket::m_link >= 0)
+    {
+        ::close(xdp_socket::m_link);
+        xdp_socket::m_link = -1;
+    }
+
+    // Stop the receiving thread.
+    if(xdp_socket::m_stop_event >= 0)
+    {
+        uint64_t stop = 1;
+        if(write(xdp_socket::m_stop_event, &stop, sizeof(stop)) == sizeof(stop))
+        {
+            xdp_socket::m_rx_thread.join();
+        }
+        ::close(xdp_socket::m_stop_event);
+        xdp_socket::m_stop_event = -1;
+    }
+
+    // Release the socket before the memory it shares with the kernel.
+    if(xdp_socket::m_socket >= 0)
+    {
+        ::close(xdp_socket::m_socket);
+        xdp_socket::m_socket = -1;
+    }
+    ring* rings[] = {&(xdp_socket::m_fill), &(xdp_socket::m_completion), &(xdp_socket::m_rx), &(xdp_socket::m_tx)};
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        if(rings[i]->mapping != nullptr)
+        {
+            munmap(rings[i]->mapping, rings[i]->mapping_length);
+        }
+        std::memset(rings[i], 0, sizeof(ring));
+    }
+    if(xdp_socket::m_umem != nullptr)
+    {
+        munmap(xdp_socket::m_umem, static_cast<std::size_t>(XDP_FRAME_COUNT) * XDP_FRAME_SIZE);
+        xdp_socket::m_umem = nullptr;
+    }
+
+    // Release the program and its maps.
+    int* descriptors[] = {&(xdp_socket::m_program), &(xdp_socket::m_port_map), &(xdp_socket::m_socket_map)};
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        if(*descriptors[i] >= 0)
+        {
+            ::close(*descriptors[i]);
+            *descriptors[i] = -1;
+        }
+    }
+
+    boost::mutex::scoped_lock lock(xdp_socket::m_mutex_ports);
+    xdp_socket::m_ports.clear();
+}
+bool xdp_socket::add_port(uint16_t port, std::function<void (const uint8_t *, uint32_t, const udp::endpoint &)> callback)
+{
+    // Register the callback before frames can arrive for it.
+    {
+        boost::mutex::scoped_lock lock(xdp_socket::m_mutex_ports);
+        xdp_socket::m_ports[port] = callback;
+    }
+
+    // The program reads the port in network byte order, and uses it as the map's index.
+    if(xdp_socket::m_port_map < 0 || !update_map(xdp_socket::m_port_map, htons(port), 1))
+    {
+        boost::mutex::scoped_lock lock(xdp_socket::m_mutex_ports);
+        xdp_socket::m_ports.erase(port);
+        return false;
+    }
+
+    return true;
+}
+void xdp_socket::remove_port(uint16_t port)
+{
+    if(xdp_socket::m_port_map >= 0)
+    {
+        update_map(xdp_socket::m_port_map, htons(port), 0);
+    }
+
+    // Frames still in the rx ring for the port are discarded.
+    boost::mutex::scoped_lock lock(xdp_socket::m_mutex_ports);
+    xdp_socket::m_ports.erase(port);
+}
+bool xdp_socket::tx(uint16_t port, const udp::endpoint &destination, const uint8_t *data, uint32_t length)
+{
+    if(xdp_socket::m_socket < 0)
+    {
+        return false;
+    }
+
+    // Check that the datagram fits in a single frame.
+    address remote = destination.address();
+    if(remote.is_v6() && remote.to_v6().is_v4_mapped())
+    {
+        remote = remote.to_v6().to_v4();
+    }
+    bool v4 = xdp_socket::m_local_address.is_v4();
+    if(remote.is_v4() != v4)
+    {
+        return false;
+    }
+    uint32_t ip_header = v4 ? 20 : 40;
+    uint32_t ip_length = ip_header + XDP_UDP_HEADER + length;
+    if(ip_length > xdp_socket::m_mtu || XDP_ETHERNET_HEADER + ip_length > XDP_FRAME_SIZE)
+    {
+        return false;
+    }
+
+    // Look up the next hop.
+    mac_address remote_mac;
+    if(!xdp_socket::neighbor(remote, remote_mac))
+    {
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock(xdp_socket::m_mutex_tx);
+
+    // Take a free frame.
+    xdp_socket::reclaim_tx();
+    if(xdp_socket::m_tx_frames.empty())
+    {
+        return false;
+    }
+    uint64_t frame_address = xdp_socket::m_tx_frames.back();
+    xdp_socket::m_tx_frames.pop_back();
+    uint8_t* frame = xdp_socket::m_umem + frame_address;
+
+    // Write the Ethernet header.
+    std::memcpy(frame, remote_mac.data(), remote_mac.size());
+    std::memcpy(frame + 6, xdp_socket::m_local_mac.data(), xdp_socket::m_local_mac.size());
+    write16(frame + 12, v4 ? ETH_P_IP : ETH_P_IPV6);
+
+    // Write the IP header, and start the UDP checksum with its pseudo header.
+    uint8_t* ip = frame + XDP_ETHERNET_HEADER;
+    uint32_t sum = 0;
+    if(v4)
+    {
+        address_v4::bytes_type source = xdp_socket::m_local_address.to_v4().to_bytes();
+        address_v4::bytes_type target = remote.to_v4().to_bytes();
+        ip[0] = 0x45;
+        ip[1] = 0;
+        write16(ip + 2, static_cast<uint16_t>(ip_length));
+        write16(ip + 4, xdp_socket::m_tx_id++);
+        write16(ip + 6, 0x4000);
+        ip[8] = 64;
+        ip[9] = IPPROTO_UDP;
+        write16(ip + 10, 0);
+        std::memcpy(ip + 12, source.data(), source.size());
+        std::memcpy(ip + 16, target.data(), target.size());
+        write16(ip + 10, checksum_fold(checksum_add(0, ip, ip_header)));
+        sum = checksum_add(sum, ip + 12, 8);
+    }
+    else
+    {
+        address_v6::bytes_type source = xdp_socket::m_local_address.to_v6().to_bytes();
+        address_v6::bytes_type target = remote.to_v6().to_bytes();
+        ip[0] = 0x60;
+        ip[1] = 0;
+        write16(ip + 2, 0);
+        write16(ip + 4, static_cast<uint16_t>(XDP_UDP_HEADER + length));
+        ip[6] = IPPROTO_UDP;
+        ip[7] = 64;
+        std::memcpy(ip + 8, source.data(), source.size());
+        std::memcpy(ip + 24, target.data(), target.size());
+        sum = checksum_add(sum, ip + 8, 32);
+    }
+
+    // Write the UDP header and payload.
+    uint8_t* udp_header = ip + ip_header;
+    write16(udp_header, port);
+    write16(udp_header + 2, destination.port());
+    write16(udp_header + 4, static_cast<uint16_t>(XDP_UDP_HEADER + length));
+    write16(udp_header + 6, 0);
+    std::memcpy(udp_header + XDP_UDP_HEADER, data, length);
+    sum += IPPROTO_UDP + XDP_UDP_HEADER + length;
+    uint16_t checksum = checksum_fold(checksum_add(sum, udp_header, XDP_UDP_HEADER + length));
+    write16(udp_header + 6, checksum == 0 ? 0xFFFF : checksum);
+
+    // Queue the frame.
+    uint32_t producer = *xdp_socket::m_tx.producer;
+    xdp_desc& descriptor = static_cast<xdp_desc*>(xdp_socket::m_tx.entries)[producer & (xdp_socket::m_tx.size - 1)];
+    descriptor.addr = frame_address;
+    descriptor.len = XDP_ETHERNET_HEADER + ip_length;
+    descriptor.options = 0;
+    __atomic_store_n(xdp_socket::m_tx.producer, producer + 1, __ATOMIC_RELEASE);
+
+    // The kernel only transmits when woken, unless the driver polls the ring itself.
+    // NOTE: A busy or full interface keeps the frame queued until the next wakeup.
+    if(__atomic_load_n(xdp_socket::m_tx.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)
+    {
+        sendto(xdp_socket::m_socket, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+    }
+
+    return true;
+}
+
+// STATIC METHODS
+std::string xdp_socket::interface_name(address local_address)
+{
+    if(local_address.is_v6() && local_address.to_v6().is_v4_mapped())
+    {
+        local_address = local_address.to_v6().to_v4();
+    }
+
+    ifaddrs* interfaces;
+    if(getifaddrs(&interfaces) != 0)
+    {
+        return "";
+    }
+
+    std::string name;
+    for(ifaddrs* it = interfaces; it != nullptr && name.empty(); it = it->ifa_next)
+    {
+        if(it->ifa_addr == nullptr)
+        {
+            continue;
+        }
+        if(it->ifa_addr->sa_family == AF_INET && local_address.is_v4())
+        {
+            if(ntohl(reinterpret_cast<sockaddr_in*>(it->ifa_addr)->sin_addr.s_addr) == local_address.to_v4().to_ulong())
+            {
+                name = it->ifa_name;
+            }
+        }
+        else if(it->ifa_addr->sa_family == AF_INET6 && local_address.is_v6())
+        {
+            address_v6::bytes_type bytes;
+            std::memcpy(bytes.data(), reinterpret_cast<sockaddr_in6*>(it->ifa_addr)->sin6_addr.s6_addr, bytes.size());
+            if(bytes == local_address.to_v6().to_bytes())
+            {
+                name = it->ifa_name;
+            }
+        }
+    }
+
+    freeifaddrs(interfaces);
+    return name;
+}
+
+// PROPERTIES
+uint64_t xdp_socket::p_drops() const
+{
+    xdp_statistics statistics;
+    socklen_t length = sizeof(statistics);
+    if(xdp_socket::m_socket < 0 || getsockopt(xdp_socket::m_socket, SOL_XDP, XDP_STATISTICS, &statistics, &length) != 0)
+    {
+        return 0;
+    }
+
+    return statistics.rx_dropped + statistics.rx_ring_full;
+}
+
+// PRIVATE METHODS
+bool xdp_socket::load_program()
+{
+    // The port map flags each redirected port by its network byte order value.
+    // The socket map holds the socket receiving each queue, and is indexed by the frame's queue.
+    xdp_socket::m_port_map = create_map(BPF_MAP_TYPE_ARRAY, 65536, "modem_ports");
+    xdp_socket::m_socket_map = create_map(BPF_MAP_TYPE_XSKMAP, 64, "modem_xsks");
+    if(xdp_socket::m_port_map < 0 || xdp_socket::m_socket_map < 0)
+    {
+        return false;
+    }
+
+    // Assemble the program:
+    //   Pass anything other than an unfragmented IPv4 or IPv6 UDP datagram to the kernel.
+    //   Look up the destination port, and pass unregistered ports to the kernel.
+    //   Redirect to the queue's socket, and pass the frame to the kernel if the queue has no socket.
+    // NOTE: IPv6 extension headers are not followed, so those datagrams are passed to the kernel.
+    program_builder program;
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+    program.emit(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, data), 0);
+    program.emit(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(xdp_md, data_end), 0);
+    // Ethernet.
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_ETHERNET_HEADER);
+    program.jump_register(BPF_JGT, BPF_REG_4, BPF_REG_3, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0);
+    program.jump(BPF_JEQ, BPF_REG_5, htons(ETH_P_IP), "ipv4");
+    program.jump(BPF_JEQ, BPF_REG_5, htons(ETH_P_IPV6), "ipv6");
+    program.jump(BPF_JA, 0, 0, "pass");
+    // IPv4, whose header length varies.
+    program.label("ipv4");
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_ETHERNET_HEADER + 20);
+    program.jump_register(BPF_JGT, BPF_REG_4, BPF_REG_3, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, XDP_ETHERNET_HEADER + 9, 0);
+    program.jump(BPF_JNE, BPF_REG_5, IPPROTO_UDP, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, XDP_ETHERNET_HEADER + 6, 0);
+    program.emit(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, htons(0x3FFF));
+    program.jump(BPF_JNE, BPF_REG_5, 0, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, XDP_ETHERNET_HEADER, 0);
+    program.emit(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, 0x0F);
+    program.emit(BPF_ALU64 | BPF_LSH | BPF_K, BPF_REG_5, 0, 0, 2);
+    program.jump(BPF_JLT, BPF_REG_5, 20, "pass");
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_X, BPF_REG_4, BPF_REG_5, 0, 0);
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_4, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_7, 0, 0, XDP_ETHERNET_HEADER + XDP_UDP_HEADER);
+    program.jump_register(BPF_JGT, BPF_REG_7, BPF_REG_3, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_4, XDP_ETHERNET_HEADER + 2, 0);
+    program.jump(BPF_JA, 0, 0, "lookup");
+    // IPv6.
+    program.label("ipv6");
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_ETHERNET_HEADER + 40 + XDP_UDP_HEADER);
+    program.jump_register(BPF_JGT, BPF_REG_4, BPF_REG_3, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, XDP_ETHERNET_HEADER + 6, 0);
+    program.jump(BPF_JNE, BPF_REG_5, IPPROTO_UDP, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, XDP_ETHERNET_HEADER + 40 + 2, 0);
+    // Port lookup.
+    program.label("lookup");
+    program.emit(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_5, -4, 0);
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0);
+    program.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4);
+    program.load_map(BPF_REG_1, xdp_socket::m_port_map);
+    program.emit(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem);
+    program.jump(BPF_JEQ, BPF_REG_0, 0, "pass");
+    program.emit(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_1, BPF_REG_0, 0, 0);
+    program.jump(BPF_JEQ, BPF_REG_1, 0, "pass");
+    // Redirect.
+    program.emit(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, rx_queue_index), 0);
+    program.load_map(BPF_REG_1, xdp_socket::m_socket_map);
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+    program.emit(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    program.emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    // Pass.
+    program.label("pass");
+    program.emit(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+    program.emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    std::vector<bpf_insn> instructions = program.link();
+
+    // Load the program.
+    const char* license = "Dual MIT/GPL";
+    bpf_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.prog_type = BPF_PROG_TYPE_XDP;
+    attributes.expected_attach_type = BPF_XDP;
+    attributes.insns = pointer(instructions.data());
+    attributes.insn_cnt = static_cast<uint32_t>(instructions.size());
+    attributes.license = pointer(license);
+    std::strncpy(attributes.prog_name, "modem_redirect", BPF_OBJ_NAME_LEN - 1);
+    xdp_socket::m_program = static_cast<int>(bpf(BPF_PROG_LOAD, attributes));
+
+    return xdp_socket::m_program >= 0;
+}
+bool xdp_socket::create_socket(uint32_t queue, bool native)
+{
+    xdp_socket::m_socket = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if(xdp_socket::m_socket < 0 || queue >= 64)
+    {
+        return false;
+    }
+
+    // Register the UMEM.
+    std::size_t umem_length = static_cast<std::size_t>(XDP_FRAME_COUNT) * XDP_FRAME_SIZE;
+    void* umem = mmap(nullptr, umem_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(umem == MAP_FAILED)
+    {
+        return false;
+    }
+    xdp_socket::m_umem = static_cast<uint8_t*>(umem);
+    xdp_umem_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.addr = pointer(umem);
+    registration.len = umem_length;
+    registration.chunk_size = XDP_FRAME_SIZE;
+    registration.headroom = 0;
+    if(setsockopt(xdp_socket::m_socket, SOL_XDP, XDP_UMEM_REG, &registration, sizeof(registration)) != 0)
+    {
+        return false;
+    }
+
+    // Size and map the rings.
+    int size = XDP_RING_SIZE;
+    int options[] = {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING};
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        if(setsockopt(xdp_socket::m_socket, SOL_XDP, options[i], &size, sizeof(size)) != 0)
+        {
+            return false;
+        }
+    }
+    xdp_mmap_offsets offsets;
+    socklen_t offsets_length = sizeof(offsets);
+    if(getsockopt(xdp_socket::m_socket, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_length) != 0 ||
+       !xdp_socket::map_ring(xdp_socket::m_fill, XDP_UMEM_PGOFF_FILL_RING, offsets.fr.producer, offsets.fr.consumer, offsets.fr.flags, offsets.fr.desc, XDP_RING_SIZE, sizeof(uint64_t)) ||
+       !xdp_socket::map_ring(xdp_socket::m_completion, XDP_UMEM_PGOFF_COMPLETION_RING, offsets.cr.producer, offsets.cr.consumer, offsets.cr.flags, offsets.cr.desc, XDP_RING_SIZE, sizeof(uint64_t)) ||
+       !xdp_socket::map_ring(xdp_socket::m_rx, XDP_PGOFF_RX_RING, offsets.rx.producer, offsets.rx.consumer, offsets.rx.flags, offsets.rx.desc, XDP_RING_SIZE, sizeof(xdp_desc)) ||
+       !xdp_socket::map_ring(xdp_socket::m_tx, XDP_PGOFF_TX_RING, offsets.tx.producer, offsets.tx.consumer, offsets.tx.flags, offsets.tx.desc, XDP_RING_SIZE, sizeof(xdp_desc)))
+    {
+        return false;
+    }
+
+    // Hand the receive half of the UMEM to the kernel, and keep the transmit half free.
+    uint64_t* fill = static_cast<uint64_t*>(xdp_socket::m_fill.entries);
+    for(uint32_t i = 0; i < XDP_RING_SIZE; i++)
+    {
+        fill[i] = static_cast<uint64_t>(i) * XDP_FRAME_SIZE;
+    }
+    __atomic_store_n(xdp_socket::m_fill.producer, XDP_RING_SIZE, __ATOMIC_RELEASE);
+    xdp_socket::m_tx_frames.clear();
+    for(uint32_t i = XDP_RING_SIZE; i < XDP_FRAME_COUNT; i++)
+    {
+        xdp_socket::m_tx_frames.push_back(static_cast<uint64_t>(i) * XDP_FRAME_SIZE);
+    }
+
+    // Bind to the queue, preferring zero copy in native mode.
+    sockaddr_xdp binding;
+    std::memset(&binding, 0, sizeof(binding));
+    binding.sxdp_family = AF_XDP;
+    binding.sxdp_ifindex = xdp_socket::m_interface_index;
+    binding.sxdp_queue_id = queue;
+    binding.sxdp_flags = XDP_USE_NEED_WAKEUP | (native ? XDP_ZEROCOPY : XDP_COPY);
+    bool bound = bind(xdp_socket::m_socket, reinterpret_cast<sockaddr*>(&binding), sizeof(binding)) == 0;
+    if(!bound && native)
+    {
+        binding.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        bound = bind(xdp_socket::m_socket, reinterpret_cast<sockaddr*>(&binding), sizeof(binding)) == 0;
+    }
+
+    return bound && update_map(xdp_socket::m_socket_map, queue, static_cast<uint32_t>(xdp_socket::m_socket));
+}
+bool xdp_socket::map_ring(ring &result, off_t offset, uint64_t producer, uint64_t consumer, uint64_t flags, uint64_t entries, uint32_t size, std::size_t entry_size)
+{
+    std::size_t length = entries + size * entry_size;
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xdp_socket::m_socket, offset);
+    if(mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(mapping);
+    result.producer = reinterpret_cast<uint32_t*>(base + producer);
+    result.consumer = reinterpret_cast<uint32_t*>(base + consumer);
+    result.flags = reinterpret_cast<uint32_t*>(base + flags);
+    result.entries = base + entries;
+    result.size = size;
+    result.mapping = mapping;
+    result.mapping_length = length;
+
+    return true;
+}
+void xdp_socket::rx_loop()
+{
+    TRACE_THREAD("xdp");
+
+    pollfd descriptors[2];
+    descriptors[0].fd = xdp_socket::m_socket;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = xdp_socket::m_stop_event;
+    descriptors[1].events = POLLIN;
+    while(true)
+    {
+        if(poll(descriptors, 2, -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if(descriptors[1].revents != 0 || (descriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            break;
+        }
+        if(descriptors[0].revents & POLLIN)
+        {
+            xdp_socket::receive();
+        }
+    }
+}
+void xdp_socket::receive()
+{
+    uint32_t consumer = *xdp_socket::m_rx.consumer;
+    uint32_t available = std::min<uint32_t>(__atomic_load_n(xdp_socket::m_rx.producer, __ATOMIC_ACQUIRE) - consumer, XDP_RX_BATCH);
+    if(available == 0)
+    {
+        return;
+    }
+    TRACE_SCOPE("xdp_rx", 0);
+
+    // The fill ring always has room, since it holds every receive frame.
+    const xdp_desc* descriptors = static_cast<const xdp_desc*>(xdp_socket::m_rx.entries);
+    uint64_t* fill = static_cast<uint64_t*>(xdp_socket::m_fill.entries);
+    uint32_t fill_producer = *xdp_socket::m_fill.producer;
+    {
+        boost::mutex::scoped_lock lock(xdp_socket::m_mutex_ports);
+        for(uint32_t i = 0; i < available; i++)
+        {
+            const xdp_desc& descriptor = descriptors[(consumer + i) & (xdp_socket::m_rx.size - 1)];
+            xdp_socket::deliver(xdp_socket::m_umem + descriptor.addr, descriptor.len);
+
+            // The callback has copied the datagram, so the frame goes back to the kernel.
+            fill[(fill_producer + i) & (xdp_socket::m_fill.size - 1)] = descriptor.addr - descriptor.addr % XDP_FRAME_SIZE;
+        }
+    }
+    __atomic_store_n(xdp_socket::m_rx.consumer, consumer + available, __ATOMIC_RELEASE);
+    __atomic_store_n(xdp_socket::m_fill.producer, fill_producer + available, __ATOMIC_RELEASE);
+
+    if(__atomic_load_n(xdp_socket::m_fill.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)
+    {
+        recvfrom(xdp_socket::m_socket, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+    }
+}
+void xdp_socket::deliver(const uint8_t *frame, uint32_t length)
+{
+    // Find the UDP header and the end of the datagram, since short frames are padded.
+    if(length < XDP_ETHERNET_HEADER)
+    {
+        return;
+    }
+    const uint8_t* ip = frame + XDP_ETHERNET_HEADER;
+    const uint8_t* end = frame + length;
+    const uint8_t* udp_header;
+    address source;
+    if(read16(frame + 12) == ETH_P_IP && length >= XDP_ETHERNET_HEADER + 20)
+    {
+        udp_header = ip + (ip[0] & 0x0F) * 4;
+        end = std::min(end, ip + read16(ip + 2));
+        address_v4::bytes_type bytes;
+        std::memcpy(bytes.data(), ip + 12, bytes.size());
+        source = address_v4(bytes);
+    }
+    else if(read16(frame + 12) == ETH_P_IPV6 && length >= XDP_ETHERNET_HEADER + 40)
+    {
+        udp_header = ip + 40;
+        end = std::min(end, udp_header + read16(ip + 4));
+        address_v6::bytes_type bytes;
+        std::memcpy(bytes.data(), ip + 8, bytes.size());
+        source = address_v6(bytes);
+    }
+    else
+    {
+        return;
+    }
+    if(udp_header + XDP_UDP_HEADER > end || read16(udp_header + 4) < XDP_UDP_HEADER || udp_header + read16(udp_header + 4) > end)
+    {
+        return;
+    }
+
+    auto port = xdp_socket::m_ports.find(read16(udp_header + 2));
+    if(port == xdp_socket::m_ports.end())
+    {
+        return;
+    }
+
+    // Learn the link-layer address that replies are sent to, refreshing it while the source keeps sending.
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if(source != xdp_socket::m_last_source || std::memcmp(xdp_socket::m_last_source_mac.data(), frame + 6, 6) != 0 ||
+       now - xdp_socket::m_last_source_learned >= boost::posix_time::milliseconds(XDP_NEIGHBOR_REFRESH))
+    {
+        xdp_socket::m_last_source = source;
+        std::memcpy(xdp_socket::m_last_source_mac.data(), frame + 6, 6);
+        xdp_socket::m_last_source_learned = now;
+        xdp_socket::learn_neighbor(source, xdp_socket::m_last_source_mac, now);
+    }
+
+    port->second(udp_header + XDP_UDP_HEADER, read16(udp_header + 4) - XDP_UDP_HEADER, udp::endpoint(source, read16(udp_header)));
+}
+void xdp_socket::reclaim_tx()
+{
+    uint32_t consumer = *xdp_socket::m_completion.consumer;
+    uint32_t available = __atomic_load_n(xdp_socket::m_completion.producer, __ATOMIC_ACQUIRE) - consumer;
+    const uint64_t* entries = static_cast<const uint64_t*>(xdp_socket::m_completion.entries);
+    for(uint32_t i = 0; i < available; i++)
+    {
+        xdp_socket::m_tx_frames.push_back(entries[(consumer + i) & (xdp_socket::m_completion.size - 1)]);
+    }
+    __atomic_store_n(xdp_socket::m_completion.consumer, consumer + available, __ATOMIC_RELEASE);
+}
+bool xdp_socket::neighbor(const address &remote, mac_address &result)
+{
+    // Use the cached address until it expires.
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    {
+        boost::mutex::scoped_lock lock(xdp_socket::m_mutex_neighbors);
+        auto entry = xdp_socket::m_neighbors.find(remote);
+        if(entry != xdp_socket::m_neighbors.end())
+        {
+            if(now < entry->second.expiry)
+            {
+                result = entry->second.mac;
+                return true;
+            }
+            xdp_socket::m_neighbors.erase(entry);
+        }
+    }
+
+    // IPv6 neighbors are only learned from received frames.
+    if(!remote.is_v4())
+    {
+        return false;
+    }
+
+    // Remote addresses off the interface's subnets are reached through the gateway of the longest matching route.
+    // NOTE: The kernel prints each address and mask as a native integer holding the network byte order value.
+    uint32_t target = htonl(static_cast<uint32_t>(remote.to_v4().to_ulong()));
+    uint32_t next_hop = target;
+    std::ifstream routes("/proc/net/route");
+    std::string line;
+    std::getline(routes, line);
+    int best_length = -1;
+    while(std::getline(routes, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        uint32_t destination, gateway, flags, references, use, metric, mask;
+        fields >> name >> std::hex >> destination >> gateway >> flags >> std::dec >> references >> use >> metric >> std::hex >> mask;
+        int length = __builtin_popcount(mask);
+        if(fields && name == xdp_socket::m_interface && (flags & RTF_UP) && (target & mask) == destination && length > best_length)
+        {
+            best_length = length;
+            next_hop = (flags & RTF_GATEWAY) ? gateway : target;
+        }
+    }
+
+    // Look up the next hop in the kernel's neighbor table, which the kernel fills when it transmits.
+    std::string next_hop_text = address_v4(ntohl(next_hop)).to_string();
+    std::ifstream neighbors("/proc/net/arp");
+    std::getline(neighbors, line);
+    while(std::getline(neighbors, line))
+    {
+        std::istringstream fields(line);
+        std::string ip, type, flags, mac, mask, name;
+        fields >> ip >> type >> flags >> mac >> mask >> name;
+        unsigned int bytes[6];
+        if(ip == next_hop_text && name == xdp_socket::m_interface && (std::stoul(flags, nullptr, 16) & ATF_COM) &&
+           std::sscanf(mac.c_str(), "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) == 6)
+        {
+            for(uint32_t i = 0; i < 6; i++)
+            {
+                result[i] = static_cast<uint8_t>(bytes[i]);
+            }
+            xdp_socket::learn_neighbor(remote, result, now);
+            return true;
+        }
+    }
+
+    return false;
+}
+void xdp_socket::learn_neighbor(const address &remote, const mac_address &mac, const boost::posix_time::ptime &now)
+{
+    boost::mutex::scoped_lock lock(xdp_socket::m_mutex_neighbors);
+
+    // Drop expired entries before adding a new one, so that past sources do not accumulate.
+    if(xdp_socket::m_neighbors.find(remote) == xdp_socket::m_neighbors.end())
+    {
+        for(auto entry = xdp_socket::m_neighbors.begin(); entry != xdp_socket::m_neighbors.end();)
+        {
+            entry = (now < entry->second.expiry) ? std::next(entry) : xdp_socket::m_neighbors.erase(entry);
+        }
+    }
+
+    neighbor_entry& entry = xdp_socket::m_neighbors[remote];
+    entry.mac = mac;
+    entry.expiry = now + boost::posix_time::milliseconds(XDP_NEIGHBOR_LIFETIME);
+}
@@ -0,0 +1,214 @@
+/// \file xdp_socket.h
+/// \brief Defines the xdp_socket class.
+#ifndef XDP_SOCKET_H
+#define XDP_SOCKET_H
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <array>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace boost::asio::ip;
+
+/// \brief An AF_XDP socket that receives and transmits the UDP datagrams of a set of local ports through shared memory.
+/// \details An XDP program attached to the interface redirects UDP datagrams addressed to the registered ports into
+/// the socket's UMEM, and passes all other traffic (including IP fragments) to the kernel as usual.  Received frames are
+/// parsed in place on the socket's own thread, and transmitted datagrams are written into UMEM frames with their
+/// Ethernet, IP, and UDP headers, bypassing the kernel's network stack in both directions.
+/// One socket serves every port on an interface queue, since only one AF_XDP socket can bind to each queue.
+/// Support is compiled in with DRIVER_MODEM_XDP, and otherwise open() always fails.
+class xdp_socket
+{
+public:
+    // CONSTRUCTORS
+    /// \brief Creates a new unopened XDP socket.
+    xdp_socket();
+    ~xdp_socket();
+
+    // METHODS
+    /// \brief Attaches the XDP program to an interface queue and starts receiving on it.
+    /// \param interface The name of the interface.
+    /// \param queue The receive queue of the interface to bind to.
+    /// \param local_address The local address that datagrams are received on and transmitted from.
+    /// \param native Indicates if the program runs in the driver (native mode) instead of on socket buffers (generic mode).
+    /// \return TRUE if the socket was opened, otherwise FALSE.
+    /// \details Generic mode works on any interface, including veth pairs, but copies every frame.
+    bool open(const std::string& interface, uint32_t queue, address local_address, bool native);
+    /// \brief Detaches the XDP program and closes the socket.
+    void close();
+    /// \brief Redirects a local port's datagrams into the socket.
+    /// \param port The local UDP port.
+    /// \param callback The callback to raise from the socket's thread for each datagram, with its payload and source.
+    /// \return TRUE if the port was added, otherwise FALSE.
+    bool add_port(uint16_t port, std::function<void(const uint8_t*, uint32_t, const udp::endpoint&)> callback);
+    /// \brief Stops redirecting a local port's datagrams.
+    /// \param port The local UDP port.
+    /// \details The port's callback is not raised after this returns.
+    void remove_port(uint16_t port);
+    /// \brief Transmits a datagram from a UMEM frame.
+    /// \param port The local UDP port to transmit from.
+    /// \param destination The remote endpoint to transmit to.
+    /// \param data The payload of the datagram.
+    /// \param length The length of the payload in bytes.
+    /// \return TRUE if the datagram was queued on the interface, otherwise FALSE.
+    /// \details Transmission fails if the destination's link-layer address is not yet known, if the datagram exceeds
+    /// the interface's MTU, or if every transmit frame is in flight.  The caller should then send through the kernel,
+    /// which also resolves the link-layer address for subsequent datagrams.
+    bool tx(uint16_t port, const udp::endpoint& destination, const uint8_t* data, uint32_t length);
+
+    // METHODS: STATIC
+    /// \brief Gets the name of the interface that a local address belongs to.
+    /// \param local_address The address of a local interface.
+    /// \return The name of the interface, or an empty string if not found.
+    static std::string interface_name(address local_address);
+
+    // PROPERTIES
+    /// \brief Gets the number of datagrams the kernel dropped because the socket's rings were full.
+    /// \return The number of dropped datagrams.
+    uint64_t p_drops() const;
+
+private:
+    // STRUCTURES
+    /// \brief A single-producer single-consumer ring shared with the kernel.
+    struct ring
+    {
+        /// \brief The producer index.
+        uint32_t* producer;
+        /// \brief The consumer index.
+        uint32_t* consumer;
+        /// \brief The ring's wakeup flags.
+        uint32_t* flags;
+        /// \brief The ring's entries.
+        void* entries;
+        /// \brief The number of entries in the ring.
+        uint32_t size;
+        /// \brief The start of the ring's memory mapping.
+        void* mapping;
+        /// \brief The length of the ring's memory mapping.
+        std::size_t mapping_length;
+    };
+    /// \brief A link-layer (MAC) address.
+    typedef std::array<uint8_t, 6> mac_address;
+    /// \brief A cached link-layer address.
+    struct neighbor_entry
+    {
+        /// \brief The link-layer address.
+        mac_address mac;
+        /// \brief The time after which the address must be looked up again.
+        boost::posix_time::ptime expiry;
+    };
+
+    // VARIABLES: SOCKET
+    /// \brief The AF_XDP socket.
+    int m_socket;
+    /// \brief The BPF program redirecting datagrams into the socket.
+    int m_program;
+    /// \brief The BPF link attaching the program to the interface.
+    int m_link;
+    /// \brief The BPF map of redirected ports.
+    int m_port_map;
+    /// \brief The BPF map of the sockets that receive each queue.
+    int m_socket_map;
+    /// \brief The index of the interface.
+    uint32_t m_interface_index;
+    /// \brief The name of the interface.
+    std::string m_interface;
+    /// \brief The MTU of the interface.
+    uint32_t m_mtu;
+    /// \brief The local address of datagrams.
+    address m_local_address;
+    /// \brief The link-layer address of the interface.
+    mac_address m_local_mac;
+
+    // VARIABLES: UMEM
+    /// \brief The packet memory shared with the kernel.
+    uint8_t* m_umem;
+    /// \brief The ring of free frames that the kernel receives into.
+    ring m_fill;
+    /// \brief The ring of frames the kernel has finished transmitting.
+    ring m_completion;
+    /// \brief The ring of received frames.
+    ring m_rx;
+    /// \brief The ring of frames to transmit.
+    ring m_tx;
+
+    // VARIABLES: TX
+    /// \brief The addresses of the transmit frames that are not in flight.
+    std::vector<uint64_t> m_tx_frames;
+    /// \brief The identification field of the next transmitted IPv4 datagram.
+    uint16_t m_tx_id;
+    /// \brief Protects the transmit and completion rings.
+    boost::mutex m_mutex_tx;
+
+    // VARIABLES: NEIGHBORS
+    /// \brief The link-layer address of each remote address, learned from received frames and the neighbor table.
+    /// \details Entries expire so that a changed neighbor or gateway is picked up again.
+    std::map<address, neighbor_entry> m_neighbors;
+    /// \brief Protects the neighbor cache.
+    boost::mutex m_mutex_neighbors;
+    /// \brief The source address of the last received frame, which only the receiving thread accesses.
+    address m_last_source;
+    /// \brief The link-layer source address of the last received frame.
+    mac_address m_last_source_mac;
+    /// \brief The time the last received frame's source was last stored in the neighbor cache.
+    boost::posix_time::ptime m_last_source_learned;
+
+    // VARIABLES: PORTS
+    /// \brief The callback of each redirected port.
+    std::map<uint16_t, std::function<void(const uint8_t*, uint32_t, const udp::endpoint&)>> m_ports;
+    /// \brief Protects the port callbacks.
+    boost::mutex m_mutex_ports;
+
+    // VARIABLES: RX THREAD
+    /// \brief The thread receiving from the socket.
+    boost::thread m_rx_thread;
+    /// \brief The event that stops the receiving thread.
+    int m_stop_event;
+
+    // METHODS
+    /// \brief Loads the XDP program that redirects the registered ports into the socket map.
+    /// \return TRUE if the program was loaded, otherwise FALSE.
+    bool load_program();
+    /// \brief Creates the UMEM and the socket's rings, and binds the socket to the interface queue.
+    /// \param queue The receive queue of the interface.
+    /// \param native Indicates if zero-copy mode is attempted.
+    /// \return TRUE if the socket was bound, otherwise FALSE.
+    bool create_socket(uint32_t queue, bool native);
+    /// \brief Maps one of the socket's rings into memory.
+    /// \param result The ring to populate.
+    /// \param offset The offset of the ring's mapping.
+    /// \param producer The offset of the producer index within the mapping.
+    /// \param consumer The offset of the consumer index within the mapping.
+    /// \param flags The offset of the flags within the mapping.
+    /// \param entries The offset of the entries within the mapping.
+    /// \param size The number of entries in the ring.
+    /// \param entry_size The size of each entry in bytes.
+    /// \return TRUE if the ring was mapped, otherwise FALSE.
+    bool map_ring(ring& result, off_t offset, uint64_t producer, uint64_t consumer, uint64_t flags, uint64_t entries, uint32_t size, std::size_t entry_size);
+    /// \brief Receives frames until the socket is closed.
+    void rx_loop();
+    /// \brief Parses the UDP datagrams of received frames, raises their port's callback, and returns the frames to the kernel.
+    void receive();
+    /// \brief Parses a received frame and raises its port's callback.
+    /// \param frame The Ethernet frame.
+    /// \param length The length of the frame in bytes.
+    void deliver(const uint8_t* frame, uint32_t length);
+    /// \brief Returns the frames the kernel has finished transmitting to the free list.
+    void reclaim_tx();
+    /// \brief Looks up the link-layer address of a remote address.
+    /// \param remote The remote address.
+    /// \param result The link-layer address.
+    /// \return TRUE if the address is known, otherwise FALSE.
+    bool neighbor(const address& remote, mac_address& result);
+    /// \brief Stores the link-layer address of a remote address in the neighbor cache.
+    /// \param remote The remote address.
+    /// \param mac The link-layer address.
+    /// \param now The current time.
+    void learn_neighbor(const address& remote, const mac_address& mac, const boost::posix_time::ptime& now);
+};
+
+#endif // XDP_SOCKET_H